@@ -0,0 +1,104 @@
+#include "bench_report.hpp"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+
+std::string quote(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            } else {
+                out += c;
+            }
+        }
+    }
+    return out + "\"";
+}
+
+// JSON has no NaN or infinity
+std::string number(double value) {
+    if (!std::isfinite(value)) {
+        return "null";
+    }
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.6g", value);
+    return text;
+}
+
+}  // namespace
+
+BenchReport::BenchReport(const std::string& suite) : suite_(suite) {
+}
+
+void BenchReport::set_info(const std::string& key, const std::string& value) {
+    info_.emplace_back(key, value);
+}
+
+void BenchReport::add(const std::string& name, const Values& values, bool passed) {
+    cases_.push_back({name, values, passed});
+
+    std::cout << std::left << std::setw(40) << name << std::right << (passed ? "  " : "! ");
+    for (const auto& value : values) {
+        std::cout << "  " << value.first << " " << number(value.second);
+    }
+    std::cout << std::endl;
+}
+
+bool BenchReport::passed() const {
+    for (const Case& c : cases_) {
+        if (!c.passed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string BenchReport::to_json() const {
+    std::string out = "{\"suite\":" + quote(suite_) + ",\"info\":{";
+    for (size_t i = 0; i < info_.size(); i++) {
+        out += (i ? "," : "") + quote(info_[i].first) + ":" + quote(info_[i].second);
+    }
+    out += std::string("},\"passed\":") + (passed() ? "true" : "false") + ",\"cases\":[";
+    for (size_t i = 0; i < cases_.size(); i++) {
+        const Case& c = cases_[i];
+        out += (i ? ",{\"name\":" : "{\"name\":") + quote(c.name) + ",\"passed\":" + (c.passed ? "true" : "false") +
+               ",\"values\":{";
+        for (size_t v = 0; v < c.values.size(); v++) {
+            out += (v ? "," : "") + quote(c.values[v].first) + ":" + number(c.values[v].second);
+        }
+        out += "}}";
+    }
+    return out + "]}\n";
+}
+
+bool BenchReport::write_json(const std::string& path) const {
+    if (path == "-") {
+        std::cout << to_json();
+        return true;
+    }
+    std::ofstream out(path);
+    out << to_json();
+    if (!out) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
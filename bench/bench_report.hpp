@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Results of realsense_bench and realsense_stress, for people and for
+// scripts. Each case is printed as it finishes; write_json() then puts the
+// whole run in one document, which a CI job can keep to spot regressions:
+//
+//   {"suite":"bench","info":{...},"passed":true,
+//    "cases":[{"name":"assemble/synthetic_848x480/split","passed":true,
+//              "values":{"frames_per_sec":812.4,...}},...]}
+//
+// Value names carry their unit (frames_per_sec, rss_mb).
+class BenchReport {
+public:
+    using Values = std::vector<std::pair<std::string, double>>;
+
+    explicit BenchReport(const std::string& suite);
+
+    // Facts about the run: host, SIMD level, settings
+    void set_info(const std::string& key, const std::string& value);
+    void add(const std::string& name, const Values& values, bool passed = true);
+
+    bool passed() const;
+    std::string to_json() const;
+    // "-" writes to stdout
+    bool write_json(const std::string& path) const;
+
+private:
+    struct Case {
+        std::string name;
+        Values values;
+        bool passed;
+    };
+
+    std::string suite_;
+    std::vector<std::pair<std::string, std::string>> info_;
+    std::vector<Case> cases_;
+};
@@ -0,0 +1,177 @@
+// Wakeup latency of the capture thread, with and without real-time settings.
+//
+// A UsbCaptureEngine reads from a simulated endpoint whose data falls due on
+// a strict 1 ms schedule, filled by a SimulatedDevice. The time from a
+// payload falling due to the event thread filling it is the thread's wakeup
+// latency, which is what decides whether a real device's FIFO overflows.
+// Measured idle, under load from threads that spin through memory on every
+// CPU, and under the same load with the event thread pinned, SCHED_FIFO, and
+// its buffers locked, on huge pages and on the thread's NUMA node. Settings
+// the process is not allowed are reported as missing and the run goes on
+// without them.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "simulated_device.hpp"
+#include "simulated_endpoint.hpp"
+#include "thread_affinity.hpp"
+#include "usb_capture_engine.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+constexpr auto kPeriod = std::chrono::microseconds(1000);
+constexpr int kQueueDepth = 4;
+constexpr int kPriority = 80;
+constexpr size_t kLoadBytes = 32 * 1024 * 1024;    // Per load thread, well past the caches
+
+using Clock = std::chrono::steady_clock;
+
+struct Setup {
+    const char* name;
+    bool load;
+    bool realtime;
+};
+
+bool running_fifo() {
+#ifdef __linux__
+    int policy;
+    sched_param param;
+    return pthread_getschedparam(pthread_self(), &policy, &param) == 0 && policy == SCHED_FIFO;
+#else
+    return false;
+#endif
+}
+
+const char* yes_no(bool value) {
+    return value ? "yes" : "no";
+}
+
+bool run(const Setup& setup, double seconds) {
+    SimulatedDevice::Config device_config;
+    device_config.width = 848;
+    device_config.height = 480;
+    device_config.fps = 0.0;                        // The endpoint keeps the time
+    device_config.payload_size = 64 * 1024;
+    SimulatedDevice device(device_config);
+
+    // Touched only on the event thread: the bus asks for the due time and
+    // calls the fill from there
+    LatencyHistogram wakeups;
+    uint64_t overruns = 0;
+    bool fifo = false;
+    bool first = true;
+    Clock::time_point due = Clock::now() + kPeriod;
+
+    SimulatedBus bus;
+    SimulatedEndpoint endpoint(
+        bus,
+        [&](uint8_t* buffer, size_t capacity) {
+            Clock::time_point now = Clock::now();
+            if (first) {
+                fifo = running_fifo();
+                first = false;
+            }
+            wakeups.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - due).count());
+            due += kPeriod;
+            if (due <= now) {
+                // Woke so late a whole period went by; a device would have
+                // had to buffer it
+                overruns += (now - due) / kPeriod + 1;
+                due = now + kPeriod;
+            }
+            return device.read_payload(buffer, capacity);
+        },
+        [&due] { return due; }, SimulatedEndpoint::Config());
+
+    int cpu = setup.realtime ? ThreadAffinity::cpu_count() - 1 : -1;
+    FrameMemory::Options memory;
+    if (setup.realtime) {
+        memory.lock = true;
+        memory.huge_pages = true;
+        memory.numa_node = ThreadAffinity::numa_node(cpu);
+    }
+    FramePool pool(kQueueDepth, device.max_payload_size(), memory);
+
+    UsbCaptureEngine::Config config;
+    config.transfer_size = device.max_payload_size();
+    config.queue_depth = kQueueDepth;
+    config.pool = &pool;
+    config.cpu = cpu;
+    config.priority = setup.realtime ? kPriority : 0;
+    UsbCaptureEngine engine(endpoint, config);
+
+    std::atomic<bool> loading(setup.load);
+    std::vector<std::thread> load;
+    for (int i = 0; setup.load && i < ThreadAffinity::cpu_count(); i++) {
+        load.emplace_back([&loading] {
+            std::vector<uint8_t> memory(kLoadBytes);
+            uint8_t value = 0;
+            while (loading.load(std::memory_order_relaxed)) {
+                for (size_t offset = 0; offset < memory.size(); offset += 64) {
+                    memory[offset] = value++;
+                }
+            }
+        });
+    }
+
+    if (!engine.start([](Frame&) {})) {
+        std::cerr << "Failed to start the capture engine" << std::endl;
+        loading = false;
+        for (std::thread& thread : load) {
+            thread.join();
+        }
+        return false;
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    engine.stop();
+    loading = false;
+    for (std::thread& thread : load) {
+        thread.join();
+    }
+
+    LatencyHistogram::Snapshot snapshot = wakeups.snapshot();
+    FramePool::Stats pool_stats = pool.stats();
+    std::cout << std::setw(22) << setup.name << std::setw(6) << yes_no(fifo) << std::setw(8)
+              << yes_no(pool_stats.memory_locked) << std::setw(6) << yes_no(pool_stats.huge_pages) << std::setw(10)
+              << snapshot.percentile(0.5) / 1e3 << std::setw(10) << snapshot.percentile(0.99) / 1e3 << std::setw(10)
+              << snapshot.percentile(0.999) / 1e3 << std::setw(10) << snapshot.max_ns / 1e3 << std::setw(10)
+              << overruns << std::endl;
+    return snapshot.count > 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    double seconds = argc > 1 ? std::stod(argv[1]) : 3.0;
+    // Settings the process is not allowed show in the table instead
+    Logger::instance().set_level(LogLevel::Error);
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "1 ms payload schedule, " << ThreadAffinity::cpu_count() << " CPUs, wakeup latency in us"
+              << std::endl;
+    std::cout << std::setw(22) << "setup" << std::setw(6) << "fifo" << std::setw(8) << "locked" << std::setw(6)
+              << "huge" << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "p99.9"
+              << std::setw(10) << "max" << std::setw(10) << "overruns" << std::endl;
+    const Setup setups[] = {
+        {"idle", false, false},
+        {"loaded", true, false},
+        {"loaded, real-time", true, true},
+    };
+    bool ok = true;
+    for (const Setup& setup : setups) {
+        ok = run(setup, seconds) && ok;
+    }
+    return ok ? 0 : 1;
+}
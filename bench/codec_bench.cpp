@@ -0,0 +1,185 @@
+// Lossless depth codec ratio and speed.
+//
+// Encodes and decodes 640x480 frames from SimulatedDevice as rendered, the
+// same frames with depth-proportional stereo noise, and optionally the
+// frames of a recording, with plain bit-packing and with the Rice entropy
+// stage. Prints the compression ratio and encode/decode throughput on one
+// core and on the whole pool, and checks every frame decodes bit-exact.
+//
+// Usage: codec_bench [RECORDING]
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "depth_codec.hpp"
+#include "recording_reader.hpp"
+#include "simulated_device.hpp"
+
+namespace {
+
+constexpr int kWidth = 640;
+constexpr int kHeight = 480;
+constexpr int kRecordedFrames = 16;
+constexpr int kPasses = 8;
+
+using Clock = std::chrono::steady_clock;
+using FrameSet = std::vector<std::vector<uint16_t>>;
+
+double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+FrameSet record_simulated() {
+    SimulatedDevice::Config config;
+    config.width = kWidth;
+    config.height = kHeight;
+    config.fps = 0.0;
+    SimulatedDevice device(config);
+
+    FrameSet frames;
+    std::vector<uint8_t> buffer(device.max_payload_size());
+    while (frames.size() < kRecordedFrames) {
+        size_t length = device.read_payload(buffer.data(), buffer.size());
+        size_t header = buffer[0];
+        if (length - header != device.frame_size()) {
+            continue;
+        }
+        std::vector<uint16_t> frame(device.frame_size() / sizeof(uint16_t));
+        std::memcpy(frame.data(), buffer.data() + header, device.frame_size());
+        frames.push_back(std::move(frame));
+    }
+    return frames;
+}
+
+// Stereo depth error grows with the square of the distance: about 2 mm at
+// 1 m and 16 mm at 4 m for a D4xx class camera
+FrameSet add_noise(const FrameSet& clean) {
+    std::mt19937 rng(3);
+    std::normal_distribution<double> unit(0.0, 1.0);
+    FrameSet noisy = clean;
+    for (auto& frame : noisy) {
+        for (uint16_t& value : frame) {
+            if (value != 0) {
+                double sigma = 2.0 * (value / 1000.0) * (value / 1000.0);
+                value = static_cast<uint16_t>(std::max(1.0, std::round(value + sigma * unit(rng))));
+            }
+        }
+    }
+    return noisy;
+}
+
+FrameSet load_recording(const std::string& path, int& width, int& height) {
+    FrameSet frames;
+    RecordingReader reader;
+    if (!reader.open(path)) {
+        return frames;
+    }
+    width = reader.width();
+    height = reader.height();
+    DepthCodec codec;
+    for (size_t i = 0; i < reader.frame_count() && frames.size() < 64; i++) {
+        RecordingReader::FrameView view;
+        if (!reader.frame(i, view) || view.raw_size != static_cast<size_t>(width) * height * sizeof(uint16_t)) {
+            continue;
+        }
+        std::vector<uint16_t> frame(static_cast<size_t>(width) * height);
+        if (view.codec == RecordCodec::Raw) {
+            std::memcpy(frame.data(), view.data, view.size);
+        } else if (!codec.decode(view.data, view.size, frame.data(), width, height)) {
+            continue;
+        }
+        frames.push_back(std::move(frame));
+    }
+    return frames;
+}
+
+struct Result {
+    double ratio = 0.0;
+    double encode_mbps = 0.0;
+    double decode_mbps = 0.0;
+    bool exact = true;
+};
+
+Result measure(const FrameSet& frames, int width, int height, bool entropy, ThreadPool& pool) {
+    DepthCodec::Config config;
+    config.entropy = entropy;
+    DepthCodec codec(config, &pool);
+
+    std::vector<std::vector<uint8_t>> encoded(frames.size());
+    size_t raw_bytes = frames.size() * frames[0].size() * sizeof(uint16_t);
+    size_t encoded_bytes = 0;
+    auto start = Clock::now();
+    for (int pass = 0; pass < kPasses; pass++) {
+        encoded_bytes = 0;
+        for (size_t i = 0; i < frames.size(); i++) {
+            encoded_bytes += codec.encode(frames[i].data(), width, height, encoded[i]);
+        }
+    }
+    double encode_seconds = seconds_since(start);
+
+    Result result;
+    std::vector<uint16_t> decoded(frames[0].size());
+    start = Clock::now();
+    for (int pass = 0; pass < kPasses; pass++) {
+        for (size_t i = 0; i < frames.size(); i++) {
+            bool ok = codec.decode(encoded[i].data(), encoded[i].size(), decoded.data(), width, height);
+            if (pass == 0 && (!ok || decoded != frames[i])) {
+                result.exact = false;
+            }
+        }
+    }
+    double decode_seconds = seconds_since(start);
+
+    result.ratio = static_cast<double>(raw_bytes) / encoded_bytes;
+    result.encode_mbps = raw_bytes * kPasses / 1e6 / encode_seconds;
+    result.decode_mbps = raw_bytes * kPasses / 1e6 / decode_seconds;
+    return result;
+}
+
+void report(const char* label, const FrameSet& frames, int width, int height) {
+    if (frames.empty()) {
+        return;
+    }
+    ThreadPool single(1);
+    ThreadPool& all = ThreadPool::shared();
+    std::cout << std::endl << label << ": " << frames.size() << " frames of " << width << "x" << height << std::endl
+              << std::left << std::setw(10) << "stage" << std::right << std::setw(8) << "ratio"
+              << std::setw(14) << "enc MB/s/core" << std::setw(14) << "dec MB/s/core"
+              << std::setw(12) << "enc MB/s" << std::setw(12) << "dec MB/s" << std::setw(8) << "exact" << std::endl;
+    for (bool entropy : {false, true}) {
+        Result one = measure(frames, width, height, entropy, single);
+        Result many = measure(frames, width, height, entropy, all);
+        std::cout << std::left << std::setw(10) << (entropy ? "rice" : "packed") << std::right << std::fixed
+                  << std::setprecision(2) << std::setw(8) << one.ratio << std::setprecision(0)
+                  << std::setw(14) << one.encode_mbps << std::setw(14) << one.decode_mbps
+                  << std::setw(12) << many.encode_mbps << std::setw(12) << many.decode_mbps
+                  << std::setw(8) << (one.exact && many.exact ? "yes" : "NO") << std::endl;
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::cout << "Pool threads: " << ThreadPool::shared().size() << std::endl;
+
+    FrameSet clean = record_simulated();
+    report("Synthetic", clean, kWidth, kHeight);
+    report("Synthetic with stereo noise", add_noise(clean), kWidth, kHeight);
+
+    if (argc > 1) {
+        int width = 0;
+        int height = 0;
+        FrameSet recorded = load_recording(argv[1], width, height);
+        if (recorded.empty()) {
+            std::cout << "No usable frames in " << argv[1] << std::endl;
+            return 1;
+        }
+        report("Recorded", recorded, width, height);
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+// Depth colorization cost per frame.
+//
+// Colorizes frames recorded from SimulatedDevice at 640x480 and 1280x720
+// with each range mode, once per SIMD level the CPU supports, and checks
+// every level produces the same image as the scalar kernels.
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "colorizer.hpp"
+#include "simulated_device.hpp"
+
+namespace {
+
+constexpr int kRecordedFrames = 8;
+constexpr int kFrames = 200;
+
+struct Case {
+    const char* label;
+    Colorizer::Colormap colormap;
+    Colorizer::RangeMode range;
+};
+
+std::vector<std::vector<uint16_t>> record(int width, int height) {
+    SimulatedDevice::Config config;
+    config.width = width;
+    config.height = height;
+    config.fps = 0.0;
+    SimulatedDevice device(config);
+
+    std::vector<std::vector<uint16_t>> frames;
+    std::vector<uint8_t> buffer(device.max_payload_size());
+    while (frames.size() < kRecordedFrames) {
+        size_t length = device.read_payload(buffer.data(), buffer.size());
+        size_t header = buffer[0];
+        if (length - header != device.frame_size()) {
+            continue;
+        }
+        std::vector<uint16_t> frame(device.frame_size() / sizeof(uint16_t));
+        memcpy(frame.data(), buffer.data() + header, device.frame_size());
+        frames.push_back(std::move(frame));
+    }
+    return frames;
+}
+
+// Mean milliseconds per frame; out receives the last frame's colours
+double run(const std::vector<std::vector<uint16_t>>& frames, const Case& c, SimdLevel level,
+           std::vector<uint8_t>& out) {
+    Colorizer::Config config;
+    config.colormap = c.colormap;
+    config.range = c.range;
+    Colorizer colorizer(config);
+    colorizer.set_simd_level(level);
+
+    size_t pixels = frames[0].size();
+    out.resize(pixels * 4);
+    colorizer.colorize(frames[0].data(), pixels, out.data());
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 1; i <= kFrames; i++) {
+        colorizer.colorize(frames[i % frames.size()].data(), pixels, out.data());
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / kFrames;
+}
+
+}  // namespace
+
+int main() {
+    const int sizes[][2] = {{640, 480}, {1280, 720}};
+    const Case cases[] = {
+        {"fixed/jet", Colorizer::Colormap::Jet, Colorizer::RangeMode::Fixed},
+        {"fixed/turbo", Colorizer::Colormap::Turbo, Colorizer::RangeMode::Fixed},
+        {"auto/turbo", Colorizer::Colormap::Turbo, Colorizer::RangeMode::Auto},
+        {"equalized/turbo", Colorizer::Colormap::Turbo, Colorizer::RangeMode::Equalized},
+    };
+    const SimdLevel levels[] = {SimdLevel::Scalar, SimdLevel::Sse41, SimdLevel::Avx2};
+
+    std::cout << "Best SIMD level: " << CpuFeatures::name(CpuFeatures::simd_level()) << std::endl;
+    std::cout << std::left << std::setw(11) << "size" << std::setw(17) << "mode" << std::setw(8) << "simd"
+              << std::right << std::setw(10) << "ms/frame" << std::setw(10) << "Mpix/s"
+              << std::setw(9) << "speedup" << std::setw(8) << "match" << std::endl;
+
+    for (const auto& size : sizes) {
+        std::vector<std::vector<uint16_t>> frames = record(size[0], size[1]);
+        std::ostringstream label;
+        label << size[0] << "x" << size[1];
+
+        for (const Case& c : cases) {
+            std::vector<uint8_t> reference;
+            double scalar_ms = 0.0;
+            for (SimdLevel level : levels) {
+                if (CpuFeatures::clamp(level) != level) {
+                    continue;
+                }
+                std::vector<uint8_t> out;
+                double ms = run(frames, c, level, out);
+                if (level == SimdLevel::Scalar) {
+                    reference = out;
+                    scalar_ms = ms;
+                }
+                double mpix = static_cast<double>(frames[0].size()) / (ms * 1000.0);
+                std::cout << std::left << std::setw(11) << label.str() << std::setw(17) << c.label
+                          << std::setw(8) << CpuFeatures::name(level) << std::right << std::fixed
+                          << std::setprecision(3) << std::setw(10) << ms
+                          << std::setprecision(0) << std::setw(10) << mpix
+                          << std::setprecision(2) << std::setw(8) << scalar_ms / ms << "x"
+                          << std::setw(8) << (out == reference ? "yes" : "NO") << std::endl;
+            }
+        }
+    }
+    return 0;
+}
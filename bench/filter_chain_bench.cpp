@@ -0,0 +1,132 @@
+// Post-processing filter chain cost per frame.
+//
+// Runs decimation, spatial, temporal and hole filling over frames recorded
+// from SimulatedDevice (with dropouts) at 640x480 and 1280x720, at each SIMD
+// level, with and without pass fusion, and prints the CPU time of every
+// filter plus the wall time of the whole chain. Each configuration's output
+// is checked against the scalar chain.
+
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "filter_chain.hpp"
+#include "simulated_device.hpp"
+
+namespace {
+
+constexpr int kRecordedFrames = 16;
+constexpr int kFrames = 200;
+
+std::vector<std::vector<uint16_t>> record(int width, int height) {
+    SimulatedDevice::Config config;
+    config.width = width;
+    config.height = height;
+    config.fps = 0.0;
+    SimulatedDevice device(config);
+
+    std::vector<std::vector<uint16_t>> frames;
+    std::vector<uint8_t> buffer(device.max_payload_size());
+    while (frames.size() < kRecordedFrames) {
+        size_t length = device.read_payload(buffer.data(), buffer.size());
+        size_t header = buffer[0];
+        if (length - header != device.frame_size()) {
+            continue;
+        }
+        std::vector<uint16_t> frame(device.frame_size() / sizeof(uint16_t));
+        memcpy(frame.data(), buffer.data() + header, device.frame_size());
+        frames.push_back(std::move(frame));
+    }
+    return frames;
+}
+
+void build(FilterChain& chain, bool decimate, HoleFillingFilter::Mode fill) {
+    if (decimate) {
+        chain.add(std::make_unique<DecimationFilter>(2));
+    }
+    chain.add(std::make_unique<SpatialFilter>(20));
+    chain.add(std::make_unique<TemporalFilter>(0.4f, 20, 3));
+    chain.add(std::make_unique<HoleFillingFilter>(fill));
+}
+
+// Runs the chain over every frame; returns the checksum of the last output
+uint64_t run(FilterChain& chain, const std::vector<std::vector<uint16_t>>& frames, int width, int height,
+             std::vector<uint16_t>& out) {
+    for (int i = 0; i < kFrames; i++) {
+        const std::vector<uint16_t>& frame = frames[i % frames.size()];
+        out.assign(frame.begin(), frame.end());
+        int w = width;
+        int h = height;
+        chain.process(out.data(), w, h);
+        out.resize(static_cast<size_t>(w) * h);
+    }
+    uint64_t checksum = 0;
+    for (uint16_t v : out) {
+        checksum = checksum * 31 + v;
+    }
+    return checksum;
+}
+
+}  // namespace
+
+int main() {
+    const int sizes[][2] = {{640, 480}, {1280, 720}};
+    const SimdLevel levels[] = {SimdLevel::Scalar, SimdLevel::Sse41, SimdLevel::Avx2};
+    const HoleFillingFilter::Mode fills[] = {HoleFillingFilter::Mode::FillFromLeft,
+                                              HoleFillingFilter::Mode::NearestFromAround};
+
+    std::cout << "Best SIMD level: " << CpuFeatures::name(CpuFeatures::simd_level())
+              << ", pool threads: " << ThreadPool::shared().size() << std::endl;
+    std::cout << "Mean ms per frame (filters: CPU time over all threads; frame: wall time)" << std::endl;
+
+    for (const auto& size : sizes) {
+        std::vector<std::vector<uint16_t>> frames = record(size[0], size[1]);
+        for (bool decimate : {false, true}) {
+            for (HoleFillingFilter::Mode fill : fills) {
+                std::ostringstream label;
+                label << size[0] << "x" << size[1] << (decimate ? " decimate+" : " ")
+                      << "spatial+temporal+" << (fill == HoleFillingFilter::Mode::FillFromLeft ? "fill_left" : "fill_nearest");
+                std::cout << std::endl << label.str() << std::endl;
+
+                uint64_t reference = 0;
+                bool header = true;
+                for (SimdLevel level : levels) {
+                    if (CpuFeatures::clamp(level) != level) {
+                        continue;
+                    }
+                    for (bool fusion : {false, true}) {
+                        FilterChain chain;
+                        build(chain, decimate, fill);
+                        chain.set_simd_level(level);
+                        chain.set_fusion(fusion);
+
+                        std::vector<uint16_t> out;
+                        uint64_t checksum = run(chain, frames, size[0], size[1], out);
+                        if (level == SimdLevel::Scalar && !fusion) {
+                            reference = checksum;
+                        }
+
+                        std::vector<FilterChain::FilterTiming> timings = chain.timings();
+                        if (header) {
+                            std::cout << std::left << std::setw(8) << "simd" << std::setw(8) << "fused" << std::right;
+                            for (const auto& timing : timings) {
+                                std::cout << std::setw(12) << timing.name;
+                            }
+                            std::cout << std::setw(10) << "frame" << std::setw(8) << "match" << std::endl;
+                            header = false;
+                        }
+                        std::cout << std::left << std::setw(8) << CpuFeatures::name(level) << std::setw(8)
+                                  << (fusion ? "yes" : "no") << std::right << std::fixed << std::setprecision(3);
+                        for (const auto& timing : timings) {
+                            std::cout << std::setw(12) << timing.mean_ms();
+                        }
+                        std::cout << std::setw(10) << chain.frame_timing().mean_ms()
+                                  << std::setw(8) << (checksum == reference ? "yes" : "NO") << std::endl;
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
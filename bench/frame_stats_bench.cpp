@@ -0,0 +1,193 @@
+// Depth statistics fused into frame assembly, against separate passes.
+//
+// Assembles frames recorded from SimulatedDevice at 640x480 and 1280x720,
+// delivered whole or in 16383-byte payloads (odd, so pixels straddle
+// payloads as they can over USB), four ways per SIMD level:
+//
+//   copy      gathering the payloads alone, the floor
+//   4 passes  the copy, then min/max, valid count, histogram and checksum
+//             each in a scalar pass of its own, as separate consumers would
+//   +1 pass   the copy, then DepthStatsAccumulator over the finished frame
+//   fused     DepthStatsAccumulator copying each payload as it summarizes it
+//
+// Every level's statistics must match the scalar ones and every copy the
+// source. The ways run in alternating rounds and the fastest round of each
+// is reported, which keeps frequency changes and other load out of the
+// ratios.
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "depth_stats.hpp"
+#include "simulated_device.hpp"
+
+namespace {
+
+constexpr int kRecordedFrames = 8;
+constexpr int kFrames = 200;
+constexpr int kRounds = 5;
+constexpr size_t kSplitPayload = 16383;
+
+using Clock = std::chrono::steady_clock;
+
+// Keeps the compiler from dropping the separate passes
+volatile uint32_t g_sink;
+
+enum class Way { Copy, SeparatePasses, OnePass, Fused };
+constexpr int kWays = 4;
+
+std::vector<std::vector<uint16_t>> record(int width, int height) {
+    SimulatedDevice::Config config;
+    config.width = width;
+    config.height = height;
+    config.fps = 0.0;
+    SimulatedDevice device(config);
+
+    std::vector<std::vector<uint16_t>> frames;
+    std::vector<uint8_t> buffer(device.max_payload_size());
+    while (frames.size() < kRecordedFrames) {
+        size_t length = device.read_payload(buffer.data(), buffer.size());
+        size_t header = buffer[0];
+        if (length - header != device.frame_size()) {
+            continue;
+        }
+        std::vector<uint16_t> frame(device.frame_size() / sizeof(uint16_t));
+        memcpy(frame.data(), buffer.data() + header, device.frame_size());
+        frames.push_back(std::move(frame));
+    }
+    return frames;
+}
+
+// What a consumer computing each statistic on its own would write
+uint32_t separate_passes(const uint16_t* depth, size_t pixels) {
+    uint16_t lo = 0xffff;
+    uint16_t hi = 0;
+    for (size_t i = 0; i < pixels; i++) {
+        if (depth[i]) {
+            lo = std::min(lo, depth[i]);
+            hi = std::max(hi, depth[i]);
+        }
+    }
+    uint32_t valid = 0;
+    for (size_t i = 0; i < pixels; i++) {
+        valid += depth[i] != 0;
+    }
+    uint32_t histogram[DepthStats::HISTOGRAM_BINS] = {};
+    for (size_t i = 0; i < pixels; i++) {
+        if (depth[i]) {
+            const uint16_t* edge = std::upper_bound(std::begin(DepthStats::BIN_EDGES),
+                                                    std::end(DepthStats::BIN_EDGES), depth[i]);
+            histogram[edge - std::begin(DepthStats::BIN_EDGES)]++;
+        }
+    }
+    uint32_t a = 0;
+    uint32_t b = 0;
+    for (size_t i = 0; i < pixels; i++) {
+        a += depth[i];
+        b += a;
+    }
+    return lo ^ hi ^ valid ^ histogram[0] ^ histogram[DepthStats::HISTOGRAM_BINS - 1] ^ a ^ b;
+}
+
+// Mean microseconds per frame
+double run(Way way, const std::vector<std::vector<uint16_t>>& frames, size_t payload, SimdLevel level,
+           std::vector<uint8_t>& dst, DepthStats& stats) {
+    DepthStatsAccumulator accumulator;
+    accumulator.set_simd_level(level);
+    size_t frame_size = frames[0].size() * sizeof(uint16_t);
+
+    auto start = Clock::now();
+    for (int i = 0; i < kFrames; i++) {
+        const uint8_t* src = reinterpret_cast<const uint8_t*>(frames[i % frames.size()].data());
+        for (size_t offset = 0; offset < frame_size; offset += payload) {
+            size_t length = std::min(payload, frame_size - offset);
+            if (way == Way::Fused) {
+                accumulator.add(src + offset, dst.data() + offset, length);
+            } else {
+                memcpy(dst.data() + offset, src + offset, length);
+            }
+        }
+        const uint16_t* depth = reinterpret_cast<const uint16_t*>(dst.data());
+        switch (way) {
+        case Way::Copy:
+            break;
+        case Way::SeparatePasses:
+            g_sink = separate_passes(depth, frames[0].size());
+            break;
+        case Way::OnePass:
+            DepthStatsAccumulator::compute(depth, frames[0].size(), stats, level);
+            break;
+        case Way::Fused:
+            accumulator.finish(stats);
+            break;
+        }
+    }
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / kFrames;
+}
+
+bool same(const DepthStats& a, const DepthStats& b) {
+    return a.computed == b.computed && a.min_depth == b.min_depth && a.max_depth == b.max_depth &&
+           a.valid_pixels == b.valid_pixels && a.zero_pixels == b.zero_pixels && a.depth_sum == b.depth_sum &&
+           std::equal(std::begin(a.histogram), std::end(a.histogram), std::begin(b.histogram)) &&
+           a.checksum == b.checksum;
+}
+
+}  // namespace
+
+int main() {
+    const SimdLevel levels[] = {SimdLevel::Scalar, SimdLevel::Sse41, SimdLevel::Avx2};
+    const int sizes[][2] = {{640, 480}, {1280, 720}};
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << std::setw(10) << "frame" << std::setw(9) << "payload" << std::setw(8) << "level" << std::setw(9)
+              << "copy us" << std::setw(11) << "4 passes" << std::setw(9) << "+1 pass" << std::setw(9) << "fused"
+              << std::setw(16) << "fused over copy" << std::endl;
+
+    bool ok = true;
+    for (const int* size : sizes) {
+        std::vector<std::vector<uint16_t>> frames = record(size[0], size[1]);
+        size_t pixels = frames[0].size();
+        std::vector<uint8_t> dst(pixels * sizeof(uint16_t));
+
+        // The last frame run is frames[(kFrames - 1) % frames.size()]
+        DepthStats reference;
+        DepthStatsAccumulator::compute(frames[(kFrames - 1) % frames.size()].data(), pixels, reference,
+                                       SimdLevel::Scalar);
+
+        for (size_t payload : {pixels * sizeof(uint16_t), kSplitPayload}) {
+            for (SimdLevel level : levels) {
+                if (CpuFeatures::clamp(level) != level) {
+                    continue;
+                }
+                double best[kWays];
+                std::fill(best, best + kWays, 1e30);
+                for (int round = 0; round < kRounds; round++) {
+                    for (int w = 0; w < kWays; w++) {
+                        DepthStats stats;
+                        Way way = static_cast<Way>(w);
+                        best[w] = std::min(best[w], run(way, frames, payload, level, dst, stats));
+                        bool copied = memcmp(dst.data(), frames[(kFrames - 1) % frames.size()].data(),
+                                             dst.size()) == 0;
+                        bool matches = way == Way::Copy || way == Way::SeparatePasses || same(stats, reference);
+                        if (!copied || !matches) {
+                            std::cerr << CpuFeatures::name(level) << " way " << w << " at " << size[0] << "x"
+                                      << size[1] << ": " << (copied ? "statistics differ" : "copy differs")
+                                      << " from scalar" << std::endl;
+                            ok = false;
+                        }
+                    }
+                }
+                std::cout << std::setw(6) << size[0] << "x" << std::setw(3) << std::left << size[1] << std::right
+                          << std::setw(9) << (payload == kSplitPayload ? "split" : "whole") << std::setw(8)
+                          << CpuFeatures::name(level) << std::setw(9) << best[0] << std::setw(11) << best[1]
+                          << std::setw(9) << best[2] << std::setw(9) << best[3] << std::setw(15)
+                          << (best[3] / best[0] - 1.0) * 100.0 << "%" << std::endl;
+            }
+        }
+    }
+
+    return ok ? 0 : 1;
+}
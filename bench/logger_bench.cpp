@@ -0,0 +1,115 @@
+// Cost of a log statement on the calling thread.
+//
+// Times LOG_* calls that are compiled out, filtered at run time, enqueued
+// and rate-limited, with per-call latency percentiles for the enqueued
+// case, then floods the ring from several threads to show that producers
+// drop rather than wait when the writer falls behind. Output goes to
+// /dev/null so the writer thread is not limited by a terminal.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "logger.hpp"
+
+#define LOG_COMPONENT "bench"
+
+namespace {
+
+constexpr int kCalls = 200000;
+constexpr int kLatencySamples = 20000;
+constexpr int kFloodThreads = 4;
+constexpr int kFloodCalls = 100000;
+
+using Clock = std::chrono::steady_clock;
+
+double ns_since(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+template <typename Fn>
+void time_calls(const char* label, Fn&& fn) {
+    auto start = Clock::now();
+    for (int i = 0; i < kCalls; i++) {
+        fn(i);
+    }
+    double ns = ns_since(start) / kCalls;
+    std::cout << std::left << std::setw(24) << label << std::right << std::fixed
+              << std::setprecision(1) << std::setw(8) << ns << " ns/call" << std::endl;
+}
+
+void enqueue_latency() {
+    // Paced so the writer keeps up and no sample hits a full ring
+    std::vector<double> samples;
+    samples.reserve(kLatencySamples);
+    for (int i = 0; i < kLatencySamples; i++) {
+        auto start = Clock::now();
+        LOG_INFO("Transfer %d completed with %d bytes", i, 16384);
+        samples.push_back(ns_since(start));
+        if (i % 256 == 255) {
+            Logger::instance().flush();
+        }
+    }
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&](double p) { return samples[static_cast<size_t>(p * (samples.size() - 1))]; };
+    std::cout << "Enqueue latency: p50 " << std::setprecision(0) << percentile(0.5)
+              << " ns, p99 " << percentile(0.99) << " ns, p99.9 " << percentile(0.999)
+              << " ns, max " << samples.back() << " ns" << std::endl;
+}
+
+void flood() {
+    Logger::Stats before = Logger::instance().stats();
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    std::vector<double> worst(kFloodThreads, 0.0);
+    for (int t = 0; t < kFloodThreads; t++) {
+        threads.emplace_back([&, t] {
+            while (!go.load()) {
+            }
+            for (int i = 0; i < kFloodCalls; i++) {
+                auto start = Clock::now();
+                LOG_INFO("Thread %d message %d", t, i);
+                worst[t] = std::max(worst[t], ns_since(start));
+            }
+        });
+    }
+    auto start = Clock::now();
+    go = true;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double ms = ns_since(start) / 1e6;
+    Logger::instance().flush();
+    Logger::Stats after = Logger::instance().stats();
+
+    std::cout << "Flood, " << kFloodThreads << " threads x " << kFloodCalls << " calls: "
+              << std::setprecision(1) << ms << " ms, written " << after.written - before.written
+              << ", dropped " << after.dropped - before.dropped << ", worst call "
+              << std::setprecision(0) << *std::max_element(worst.begin(), worst.end()) << " ns" << std::endl;
+}
+
+}
+
+int main() {
+    Logger& logger = Logger::instance();
+    if (!logger.set_output("/dev/null")) {
+        return 1;
+    }
+    logger.set_level(LogLevel::Info);
+
+    std::cout << "LOG_MIN_LEVEL " << LOG_MIN_LEVEL << ", ring " << Logger::RING_SIZE << " slots" << std::endl;
+    time_calls("compiled out (trace)", [](int i) { LOG_TRACE("Payload %d header %d", i, 12); (void)i; });
+    time_calls("filtered (debug)", [](int i) { LOG_DEBUG("Payload %d header %d", i, 12); });
+    time_calls("rate-limited (error)", [](int i) { LOG_ERROR("Bulk transfer %d failed: %s", i, "LIBUSB_ERROR_IO"); });
+    logger.flush();
+    enqueue_latency();
+    flood();
+
+    Logger::Stats stats = logger.stats();
+    std::cout << "Total written " << stats.written << ", dropped " << stats.dropped
+              << ", rate-limited " << stats.suppressed << std::endl;
+    return 0;
+}
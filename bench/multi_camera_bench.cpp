@@ -0,0 +1,111 @@
+// Multi-camera capture on simulated devices.
+//
+// Streams 1, 2, 4 and 6 simulated 640x480 cameras at 90 fps through a
+// CameraRig, each with its own capture and pipeline threads, and reads
+// time-aligned sets the way a fusion stage would. Cameras either start
+// together, like a hardware-synced rig where only arrival jitter separates
+// them, or at random offsets within a frame period, like free-running
+// cameras, where only some frames fall within the sync tolerance. Runs
+// once unpinned and once with each camera's threads pinned to a CPU.
+// Prints aggregate throughput, sets per second, frames without a partner
+// and the skew within sets.
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+#include "camera_rig.hpp"
+#include "logger.hpp"
+#include "simulated_transport.hpp"
+#include "thread_affinity.hpp"
+
+namespace {
+
+constexpr double kFps = 90.0;
+constexpr double kJitterUs = 200.0;
+constexpr double kSeconds = 3.0;
+constexpr uint64_t kToleranceNs = 2000000;
+
+using Clock = std::chrono::steady_clock;
+
+void run(int cameras, bool synced, bool pinned) {
+    CameraRig::Config config;
+    config.sync_tolerance_ns = kToleranceNs;
+    if (pinned) {
+        for (int cpu = 0; cpu < ThreadAffinity::cpu_count(); cpu++) {
+            config.cpus.push_back(cpu);
+        }
+    }
+    CameraRig rig(config);
+
+    std::mt19937 rng(static_cast<uint32_t>(cameras));
+    std::uniform_real_distribution<double> offset(0.0, 1e6 / kFps);
+    for (int i = 0; i < cameras; i++) {
+        SimulatedDevice::Config device;
+        device.fps = kFps;
+        device.jitter_us = kJitterUs;
+        device.seed = static_cast<uint32_t>(i + 1);
+        device.start_offset_us = synced ? 0.0 : offset(rng);
+        rig.add_camera(std::make_unique<CameraDevice>(std::make_unique<SimulatedTransport>(device)));
+    }
+    if (!rig.start()) {
+        std::cerr << "Failed to start " << cameras << " simulated cameras" << std::endl;
+        return;
+    }
+
+    std::vector<double> skew_us;
+    FrameSynchronizer::FrameSet set;
+    auto start = Clock::now();
+    auto deadline = start + std::chrono::duration<double>(kSeconds);
+    while (Clock::now() < deadline) {
+        if (rig.next(set, 100)) {
+            skew_us.push_back(set.skew_ns / 1e3);
+            set.frames.clear();
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::vector<CameraRig::CameraStats> cameras_stats = rig.camera_stats();
+    FrameSynchronizer::Stats sync = rig.sync_stats();
+    rig.stop();
+
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    for (const CameraRig::CameraStats& stats : cameras_stats) {
+        frames += stats.frames;
+        bytes += stats.bytes;
+    }
+    std::sort(skew_us.begin(), skew_us.end());
+    auto percentile = [&](double p) {
+        size_t index = std::min(skew_us.size() - 1, static_cast<size_t>(skew_us.size() * p));
+        return skew_us.empty() ? 0.0 : skew_us[index];
+    };
+    std::cout << std::setw(8) << cameras << std::setw(8) << (synced ? "yes" : "no") << std::setw(8)
+              << (pinned ? "yes" : "no") << std::setw(10) << frames / seconds << std::setw(9)
+              << bytes / seconds / 1e6 << std::setw(8) << skew_us.size() / seconds << std::setw(11)
+              << sync.unmatched << std::setw(9) << percentile(0.5) << std::setw(9) << percentile(0.99)
+              << std::setw(9) << (skew_us.empty() ? 0.0 : skew_us.back()) << std::endl;
+}
+
+}  // namespace
+
+int main() {
+    Logger::instance().set_level(LogLevel::Warn);
+    std::cout << std::fixed << std::setprecision(1) << "Simulated 640x480 cameras at " << kFps << " fps, "
+              << kJitterUs << " us jitter, sync tolerance " << kToleranceNs / 1e6 << " ms, "
+              << ThreadAffinity::cpu_count() << " CPUs" << std::endl
+              << std::setw(8) << "cameras" << std::setw(8) << "synced" << std::setw(8) << "pinned"
+              << std::setw(10) << "frames/s" << std::setw(9) << "MB/s" << std::setw(8) << "sets/s"
+              << std::setw(11) << "unmatched" << std::setw(9) << "skew p50" << std::setw(9) << "p99 us"
+              << std::setw(9) << "max us" << std::endl;
+    for (bool synced : {true, false}) {
+        for (bool pinned : {false, true}) {
+            for (int cameras : {1, 2, 4, 6}) {
+                run(cameras, synced, pinned);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,216 @@
+// Depth, color and IMU from one simulated device on a shared event thread.
+//
+// A SimulatedBus carries three endpoints, like a D435i's: 848x480 depth at
+// 90 fps in whole-frame payloads, 1280x720 color at 30 fps split into 64 KB
+// payloads (YUY2 is two bytes a pixel like Z16, so a SimulatedDevice stands
+// in for the color sensor), and the IMU's accelerometer and gyro reports at
+// 250 and 400 Hz. A StreamManager captures all three with one event thread
+// while a consumer per stream reads them. Runs with every consumer keeping
+// up, with the color consumer too slow for its stream, and with the depth
+// consumer hoarding frames until the depth pool runs dry. Prints each
+// stream's delivered rate against the device's, and the longest gap between
+// IMU samples, which shows whether the event thread ever fell behind. Fails
+// if a stream whose consumer keeps up loses more than 5% of its rate.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "logger.hpp"
+#include "simulated_device.hpp"
+#include "simulated_endpoint.hpp"
+#include "simulated_imu.hpp"
+#include "stream_manager.hpp"
+
+namespace {
+
+constexpr double kDepthFps = 90.0;
+constexpr double kColorFps = 30.0;
+constexpr double kAccelHz = 250.0;
+constexpr double kGyroHz = 400.0;
+constexpr size_t kColorPayload = 64 * 1024;
+constexpr double kBusBandwidth = 400.0 * 1024 * 1024;
+constexpr double kCompletionLatencyUs = 125.0;
+constexpr double kMinRate = 0.95;                   // Of the device's, for a stream that keeps up
+constexpr auto kSlowColor = std::chrono::milliseconds(100);
+constexpr auto kHoardPeriod = std::chrono::milliseconds(500);
+
+using Clock = std::chrono::steady_clock;
+
+enum class Scenario { KeepUp, SlowColor, HoardDepth };
+
+const char* scenario_name(Scenario scenario) {
+    switch (scenario) {
+    case Scenario::KeepUp:
+        return "all keep up";
+    case Scenario::SlowColor:
+        return "slow color";
+    case Scenario::HoardDepth:
+        return "depth hoards";
+    }
+    return "";
+}
+
+void report(const char* stream, double expected, double delivered, uint64_t torn, uint64_t skipped,
+            const std::string& note) {
+    std::cout << std::setw(16) << "" << std::setw(8) << stream << std::setw(12) << expected << std::setw(12)
+              << delivered << std::setw(8) << torn << std::setw(10) << skipped << "  " << note << std::endl;
+}
+
+bool run(Scenario scenario, double seconds) {
+    SimulatedBus bus;
+    SimulatedEndpoint::Config endpoint_config;
+    endpoint_config.bandwidth_bytes_per_sec = kBusBandwidth;
+    endpoint_config.completion_latency_us = kCompletionLatencyUs;
+
+    SimulatedDevice::Config depth_config;
+    depth_config.width = 848;
+    depth_config.height = 480;
+    depth_config.fps = kDepthFps;
+    SimulatedDevice depth(depth_config);
+
+    SimulatedDevice::Config color_config;
+    color_config.width = 1280;
+    color_config.height = 720;
+    color_config.fps = kColorFps;
+    color_config.payload_size = kColorPayload;
+    color_config.seed = 2;
+    SimulatedDevice color(color_config);
+
+    SimulatedImu::Config imu_config;
+    imu_config.accel_hz = kAccelHz;
+    imu_config.gyro_hz = kGyroHz;
+    SimulatedImu imu(imu_config);
+
+    SimulatedEndpoint depth_endpoint(
+        bus, [&depth](uint8_t* buffer, size_t capacity) { return depth.read_payload(buffer, capacity); },
+        [&depth] { return depth.next_payload_due(); }, endpoint_config);
+    SimulatedEndpoint color_endpoint(
+        bus, [&color](uint8_t* buffer, size_t capacity) { return color.read_payload(buffer, capacity); },
+        [&color] { return color.next_payload_due(); }, endpoint_config);
+    SimulatedEndpoint imu_endpoint(
+        bus, [&imu](uint8_t* buffer, size_t capacity) { return imu.read_reports(buffer, capacity); },
+        [&imu] { return imu.next_report_due(); }, endpoint_config);
+
+    StreamManager manager;
+    StreamManager::StreamConfig stream;
+    stream.kind = StreamKind::Depth;
+    stream.backend = &depth_endpoint;
+    stream.transfer_size = depth.max_payload_size();
+    stream.frame_size = depth.frame_size();
+    manager.add_stream(stream);
+    stream.kind = StreamKind::Color;
+    stream.backend = &color_endpoint;
+    stream.transfer_size = color.max_payload_size();
+    stream.frame_size = color.frame_size();
+    stream.queue_depth = 8;
+    manager.add_stream(stream);
+    stream.kind = StreamKind::Imu;
+    stream.backend = &imu_endpoint;
+    stream.transfer_size = 32;
+    stream.frame_size = 0;
+    manager.add_stream(stream);
+
+    if (!manager.start()) {
+        std::cerr << "Failed to start the simulated streams" << std::endl;
+        return false;
+    }
+
+    std::atomic<bool> running(true);
+    std::atomic<uint64_t> delivered[2] = {{0}, {0}};
+    std::thread video_consumers[2];
+    for (int i = 0; i < 2; i++) {
+        StreamKind kind = i == 0 ? StreamKind::Depth : StreamKind::Color;
+        video_consumers[i] = std::thread([&, kind, i] {
+            std::vector<Frame> hoard;
+            auto release_at = Clock::now() + kHoardPeriod;
+            Frame frame;
+            while (running) {
+                if (Clock::now() >= release_at) {
+                    hoard.clear();
+                    release_at = Clock::now() + kHoardPeriod;
+                }
+                if (!manager.get_frame(kind, frame, 10)) {
+                    continue;
+                }
+                delivered[i].fetch_add(1, std::memory_order_relaxed);
+                if (kind == StreamKind::Color && scenario == Scenario::SlowColor) {
+                    std::this_thread::sleep_for(kSlowColor);
+                }
+                if (kind == StreamKind::Depth && scenario == Scenario::HoardDepth) {
+                    // Keeps every frame for a while, like a consumer stuck
+                    // on a batch, so the depth pool runs out
+                    hoard.push_back(std::move(frame));
+                }
+                frame.reset();
+            }
+        });
+    }
+
+    uint64_t samples = 0;
+    uint64_t max_gap_ns = 0;
+    uint64_t last_ns = 0;
+    std::vector<ImuSample> batch(256);
+    auto start = Clock::now();
+    auto end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    while (Clock::now() < end) {
+        size_t count = manager.read_imu(batch.data(), batch.size(), 100);
+        for (size_t i = 0; i < count; i++) {
+            if (last_ns != 0) {
+                max_gap_ns = std::max(max_gap_ns, batch[i].timestamp_ns - last_ns);
+            }
+            last_ns = batch[i].timestamp_ns;
+        }
+        samples += count;
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    running = false;
+    for (std::thread& consumer : video_consumers) {
+        consumer.join();
+    }
+    manager.stop();
+
+    double depth_rate = delivered[0] / elapsed;
+    double color_rate = delivered[1] / elapsed;
+    double imu_rate = samples / elapsed;
+    StreamManager::Stats depth_stats = manager.stats(StreamKind::Depth);
+    StreamManager::Stats color_stats = manager.stats(StreamKind::Color);
+
+    std::cout << std::setw(16) << scenario_name(scenario) << std::endl;
+    report("depth", kDepthFps, depth_rate, depth_stats.assembly.torn_frames,
+           manager.mailbox_stats(StreamKind::Depth).dropped,
+           std::to_string(depth_stats.transfers.starved) + " starved resubmits");
+    report("color", kColorFps, color_rate, color_stats.assembly.torn_frames,
+           manager.mailbox_stats(StreamKind::Color).dropped,
+           std::to_string(color_stats.assembly.copied_bytes / 1000000) + " MB gathered");
+    std::ostringstream gap;
+    gap << std::fixed << std::setprecision(2) << "max gap " << max_gap_ns / 1e6 << " ms, " << manager.imu_stats().overruns
+        << " overruns";
+    report("imu", kAccelHz + kGyroHz, imu_rate, 0, 0, gap.str());
+
+    bool ok = color_rate >= kMinRate * kColorFps || scenario == Scenario::SlowColor;
+    ok = ok && (depth_rate >= kMinRate * kDepthFps || scenario == Scenario::HoardDepth);
+    ok = ok && imu_rate >= kMinRate * (kAccelHz + kGyroHz);
+    return ok;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    double seconds = argc > 1 ? std::stod(argv[1]) : 2.0;
+    Logger::instance().set_level(LogLevel::Warn);
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << std::setw(16) << "scenario" << std::setw(8) << "stream" << std::setw(12) << "device/s"
+              << std::setw(12) << "delivered/s" << std::setw(8) << "torn" << std::setw(10) << "skipped"
+              << std::endl;
+    bool ok = true;
+    for (Scenario scenario : {Scenario::KeepUp, Scenario::SlowColor, Scenario::HoardDepth}) {
+        ok = run(scenario, seconds) && ok;
+    }
+    return ok ? 0 : 1;
+}
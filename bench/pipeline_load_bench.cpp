@@ -0,0 +1,105 @@
+// Headless load test of the capture and assembly path on a SimulatedDevice.
+//
+// Runs CameraDevice against the simulated camera at multiples of the real
+// 30 fps rate (and unthrottled) and reports delivered frame rate alongside
+// what the device produced. The pool columns show steady-state heap
+// allocations and bytes copied per delivered frame, both of which should be
+// zero for whole-frame payloads. The last rows pace the consumer at 60 Hz,
+// like a vsync'd renderer, to show how each delivery policy behaves.
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include "camera_device.hpp"
+#include "simulated_transport.hpp"
+
+namespace {
+
+struct Case {
+    double fps;
+    double loss;
+    double short_payload;
+    double consumer_hz;   // 0 = consume as fast as frames arrive
+    FrameMailbox::Policy policy;
+};
+
+void run(const Case& c, double seconds) {
+    SimulatedDevice::Config config;
+    config.fps = c.fps;
+    config.jitter_us = c.fps > 0.0 ? 200.0 : 0.0;
+    config.payload_loss = c.loss;
+    config.short_payload = c.short_payload;
+
+    auto transport = std::make_unique<SimulatedTransport>(config);
+    SimulatedTransport* sim = transport.get();
+    CameraDevice camera(std::move(transport));
+    camera.set_delivery_policy(c.policy);
+    if (!camera.initialize() || !camera.start_streaming()) {
+        std::cerr << "Failed to start simulated camera" << std::endl;
+        return;
+    }
+
+    Frame frame;
+    uint64_t delivered = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::duration<double>(seconds);
+    auto next_tick = start;
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (c.consumer_hz > 0.0) {
+            next_tick += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(1.0 / c.consumer_hz));
+            std::this_thread::sleep_until(next_tick);
+            if (camera.get_depth_frame(frame, 0)) {
+                delivered++;
+                frame.reset();
+            }
+        } else if (camera.get_depth_frame(frame)) {
+            delivered++;
+            frame.reset();
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    UsbCaptureEngine::Stats stats = sim->engine_stats();
+    CameraDevice::Stats camera_stats = camera.stats();
+    FramePool::Stats pool_stats = camera.pool_stats();
+    FrameMailbox::Stats mailbox_stats = camera.mailbox_stats();
+    camera.stop_streaming();
+
+    std::cout << std::setw(8) << (c.fps > 0.0 ? std::to_string(static_cast<int>(c.fps)) : std::string("max"))
+              << std::setw(7) << c.loss << std::setw(7) << c.short_payload
+              << std::setw(7) << (c.consumer_hz > 0.0 ? std::to_string(static_cast<int>(c.consumer_hz)) : std::string("-"))
+              << std::setw(8) << (c.policy == FrameMailbox::Policy::Block ? "block" : "drop")
+              << std::setw(10) << sim->device().frames_generated() / elapsed
+              << std::setw(10) << delivered / elapsed
+              << std::setw(10) << stats.bytes / elapsed / (1024.0 * 1024.0)
+              << std::setw(8) << pool_stats.allocations
+              << std::setw(12) << (delivered ? camera_stats.copied_bytes / static_cast<double>(delivered) : 0.0)
+              << std::setw(9) << mailbox_stats.dropped
+              << std::setw(8) << mailbox_stats.producer_waits << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    double seconds = argc > 1 ? std::stod(argv[1]) : 2.0;
+
+    std::cout << std::setw(8) << "target" << std::setw(7) << "loss" << std::setw(7) << "short"
+              << std::setw(7) << "cons" << std::setw(8) << "policy"
+              << std::setw(10) << "gen fps" << std::setw(10) << "got fps" << std::setw(10) << "MB/s"
+              << std::setw(8) << "allocs" << std::setw(12) << "copy B/fr"
+              << std::setw(9) << "dropped" << std::setw(8) << "waits" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+
+    const FrameMailbox::Policy drop = FrameMailbox::Policy::DropOldest;
+    const FrameMailbox::Policy block = FrameMailbox::Policy::Block;
+    for (double fps : {30.0, 90.0, 300.0, 0.0}) {
+        run({fps, 0.0, 0.0, 0.0, drop}, seconds);
+    }
+    run({90.0, 0.01, 0.01, 0.0, drop}, seconds);
+    run({90.0, 0.0, 0.0, 60.0, drop}, seconds);
+    run({90.0, 0.0, 0.0, 60.0, block}, seconds);
+    return 0;
+}
@@ -0,0 +1,112 @@
+// Depth-to-point-cloud deprojection throughput.
+//
+// Deprojects frames recorded from SimulatedDevice at 640x480 and 1280x720,
+// dense and compacted, at each SIMD level on one thread and on the whole
+// pool. Every run is checked against the single-threaded scalar result.
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "point_cloud.hpp"
+#include "simulated_device.hpp"
+
+namespace {
+
+constexpr int kRecordedFrames = 8;
+constexpr int kFrames = 200;
+
+std::vector<std::vector<uint16_t>> record(int width, int height) {
+    SimulatedDevice::Config config;
+    config.width = width;
+    config.height = height;
+    config.fps = 0.0;
+    SimulatedDevice device(config);
+
+    std::vector<std::vector<uint16_t>> frames;
+    std::vector<uint8_t> buffer(device.max_payload_size());
+    while (frames.size() < kRecordedFrames) {
+        size_t length = device.read_payload(buffer.data(), buffer.size());
+        size_t header = buffer[0];
+        if (length - header != device.frame_size()) {
+            continue;
+        }
+        std::vector<uint16_t> frame(device.frame_size() / sizeof(uint16_t));
+        memcpy(frame.data(), buffer.data() + header, device.frame_size());
+        frames.push_back(std::move(frame));
+    }
+    return frames;
+}
+
+bool same_points(const PointCloud::Points& a, const PointCloud::Points& b) {
+    return a.count == b.count &&
+           memcmp(a.x.data(), b.x.data(), a.count * sizeof(float)) == 0 &&
+           memcmp(a.y.data(), b.y.data(), a.count * sizeof(float)) == 0 &&
+           memcmp(a.z.data(), b.z.data(), a.count * sizeof(float)) == 0;
+}
+
+}  // namespace
+
+int main() {
+    const int sizes[][2] = {{640, 480}, {1280, 720}};
+    const SimdLevel levels[] = {SimdLevel::Scalar, SimdLevel::Sse41, SimdLevel::Avx2};
+    ThreadPool single(1);
+    ThreadPool& shared = ThreadPool::shared();
+
+    std::cout << "Best SIMD level: " << CpuFeatures::name(CpuFeatures::simd_level())
+              << ", pool threads: " << shared.size() << std::endl;
+    std::cout << std::left << std::setw(11) << "size" << std::setw(9) << "output" << std::setw(8) << "simd"
+              << std::right << std::setw(8) << "threads" << std::setw(10) << "ms/frame" << std::setw(12) << "Mpoints/s"
+              << std::setw(10) << "points" << std::setw(8) << "match" << std::endl;
+
+    for (const auto& size : sizes) {
+        std::vector<std::vector<uint16_t>> frames = record(size[0], size[1]);
+        CameraIntrinsics intrinsics = CameraIntrinsics::nominal(size[0], size[1]);
+        std::ostringstream label;
+        label << size[0] << "x" << size[1];
+
+        for (bool compact : {false, true}) {
+            // Reference: scalar, single-threaded, on the last frame of a run
+            PointCloud::Config config;
+            config.compact = compact;
+            config.pool = &single;
+            PointCloud reference_cloud(intrinsics, config);
+            reference_cloud.set_simd_level(SimdLevel::Scalar);
+            PointCloud::Points reference;
+            reference_cloud.deproject(frames[kFrames % frames.size()].data(), reference);
+
+            for (SimdLevel level : levels) {
+                if (CpuFeatures::clamp(level) != level) {
+                    continue;
+                }
+                for (ThreadPool* pool : {&single, &shared}) {
+                    if (pool == &shared && shared.size() == 1) {
+                        continue;
+                    }
+                    config.pool = pool;
+                    PointCloud cloud(intrinsics, config);
+                    cloud.set_simd_level(level);
+                    PointCloud::Points points;
+                    cloud.deproject(frames[0].data(), points);
+
+                    size_t total = 0;
+                    auto start = std::chrono::steady_clock::now();
+                    for (int i = 1; i <= kFrames; i++) {
+                        total += cloud.deproject(frames[i % frames.size()].data(), points);
+                    }
+                    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                    std::cout << std::left << std::setw(11) << label.str() << std::setw(9)
+                              << (compact ? "compact" : "dense") << std::setw(8) << CpuFeatures::name(level)
+                              << std::right << std::setw(8) << pool->size() << std::fixed << std::setprecision(3)
+                              << std::setw(10) << seconds * 1000.0 / kFrames << std::setprecision(0)
+                              << std::setw(12) << total / seconds / 1e6 << std::setw(10) << points.count
+                              << std::setw(8) << (same_points(points, reference) ? "yes" : "NO") << std::endl;
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,137 @@
+// Size-specialized kernels against the generic ones, per stream profile.
+//
+// For each of the common D435i depth profiles, runs the colorizer (auto
+// range, so the range scan is included), the spatial filter and decimation
+// by two over frames recorded from SimulatedDevice, once with the kernels
+// built for that frame size and once with the run-time-sized fallback, at
+// the scalar and the best SIMD level. Both must produce the same output.
+// The two run in alternating rounds and the fastest round of each is
+// reported, which keeps frequency changes and other load out of the ratio.
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "colorizer.hpp"
+#include "depth_filter.hpp"
+#include "simulated_device.hpp"
+#include "stream_profile.hpp"
+
+namespace {
+
+constexpr int kRecordedFrames = 8;
+constexpr int kFrames = 100;
+constexpr int kRounds = 5;              // Generic and specialized alternate; the best round counts
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<std::vector<uint16_t>> record(const StreamProfile& profile) {
+    SimulatedDevice::Config config;
+    config.width = profile.width;
+    config.height = profile.height;
+    config.fps = 0.0;
+    SimulatedDevice device(config);
+
+    std::vector<std::vector<uint16_t>> frames;
+    std::vector<uint8_t> buffer(device.max_payload_size());
+    while (frames.size() < kRecordedFrames) {
+        size_t length = device.read_payload(buffer.data(), buffer.size());
+        size_t header = buffer[0];
+        if (length - header != device.frame_size()) {
+            continue;
+        }
+        std::vector<uint16_t> frame(device.frame_size() / sizeof(uint16_t));
+        memcpy(frame.data(), buffer.data() + header, device.frame_size());
+        frames.push_back(std::move(frame));
+    }
+    return frames;
+}
+
+// Mean microseconds per frame; out holds the last frame's output
+double colorize(const std::vector<std::vector<uint16_t>>& frames, SimdLevel level, bool specialized,
+                std::vector<uint8_t>& out) {
+    Colorizer::Config config;
+    config.range = Colorizer::RangeMode::Auto;
+    Colorizer colorizer(config);
+    colorizer.set_simd_level(level);
+    colorizer.set_specialized(specialized);
+    size_t pixels = frames[0].size();
+    out.resize(pixels * 4);
+
+    auto start = Clock::now();
+    for (int i = 0; i < kFrames; i++) {
+        colorizer.colorize(frames[i % frames.size()].data(), pixels, out.data());
+    }
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / kFrames;
+}
+
+double filter(DepthFilter& filter, const std::vector<std::vector<uint16_t>>& frames, const StreamProfile& profile,
+              SimdLevel level, bool specialized, std::vector<uint16_t>& out) {
+    filter.set_simd_level(level);
+    filter.set_specialized(specialized);
+    filter.configure(profile.width, profile.height);
+    out.assign(static_cast<size_t>(filter.out_width()) * filter.out_height(), 0);
+
+    auto start = Clock::now();
+    for (int i = 0; i < kFrames; i++) {
+        filter.process_rows(frames[i % frames.size()].data(), out.data(), 0, filter.out_height());
+    }
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / kFrames;
+}
+
+void report(const StreamProfile& profile, const char* kernel, SimdLevel level, double generic, double specialized,
+            bool same) {
+    std::cout << std::setw(10) << (std::to_string(profile.width) + "x" + std::to_string(profile.height))
+              << std::setw(12) << kernel << std::setw(8) << CpuFeatures::name(level) << std::setw(14) << generic
+              << std::setw(14) << specialized << std::setw(10) << generic / specialized << "x"
+              << (same ? "" : "  OUTPUT DIFFERS") << std::endl;
+}
+
+}  // namespace
+
+int main() {
+    const StreamProfile profiles[] = {{1280, 720, 30}, {848, 480, 90}, {640, 480, 90}, {480, 270, 300}};
+    std::vector<SimdLevel> levels = {SimdLevel::Scalar};
+    if (CpuFeatures::simd_level() != SimdLevel::Scalar) {
+        levels.push_back(CpuFeatures::simd_level());
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << std::setw(10) << "size" << std::setw(12) << "kernel" << std::setw(8) << "simd"
+              << std::setw(14) << "generic us" << std::setw(14) << "fixed us" << std::setw(11) << "speedup"
+              << std::endl;
+    bool all_same = true;
+    for (const StreamProfile& profile : profiles) {
+        std::vector<std::vector<uint16_t>> frames = record(profile);
+        for (SimdLevel level : levels) {
+            std::vector<uint8_t> rgba[2];
+            std::vector<uint16_t> depth[2];
+            double best[3][2] = {{1e30, 1e30}, {1e30, 1e30}, {1e30, 1e30}};
+            for (int round = 0; round < kRounds; round++) {
+                for (int fixed = 0; fixed < 2; fixed++) {
+                    best[0][fixed] = std::min(best[0][fixed], colorize(frames, level, fixed, rgba[fixed]));
+                }
+            }
+            report(profile, "colorize", level, best[0][0], best[0][1], rgba[0] == rgba[1]);
+            all_same = all_same && rgba[0] == rgba[1];
+
+            SpatialFilter spatial(20);
+            DecimationFilter decimation(2);
+            DepthFilter* filters[] = {&spatial, &decimation};
+            for (int f = 0; f < 2; f++) {
+                for (int round = 0; round < kRounds; round++) {
+                    for (int fixed = 0; fixed < 2; fixed++) {
+                        best[1 + f][fixed] = std::min(best[1 + f][fixed],
+                                                      filter(*filters[f], frames, profile, level, fixed, depth[fixed]));
+                    }
+                }
+                report(profile, f == 0 ? "spatial" : "decimate", level, best[1 + f][0], best[1 + f][1],
+                       depth[0] == depth[1]);
+                all_same = all_same && depth[0] == depth[1];
+            }
+        }
+    }
+    return all_same ? 0 : 1;
+}
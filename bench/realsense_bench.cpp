@@ -0,0 +1,356 @@
+// The driver's hot paths, one case each, with JSON results.
+//
+//   parse/<data>            UVC header parsing over 16 KB payloads, in payloads/s
+//   assemble/<data>/whole   FrameAssembler, one payload per frame (zero copy)
+//   assemble/<data>/split   FrameAssembler gathering 16 KB payloads
+//   colorize/<data>/<mode>  Colorizer, fixed, auto and equalized range
+//   filter/<data>/<filter>  each post-processing filter alone, then the chain
+//
+// Assembly copies every payload into a pooled buffer first, standing in for
+// the transfer that would have landed it there. The data is frames from
+// SimulatedDevice at the common profiles, and with --recording the frames
+// of a DepthRecorder file too. Each case runs for --seconds and reports its
+// rate; the parse and assemble cases fail if any frame comes out torn.
+//
+// Usage: realsense_bench [--seconds S] [--only SUBSTRING] [--recording FILE] [--json FILE|-]
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "bench_report.hpp"
+#include "colorizer.hpp"
+#include "depth_codec.hpp"
+#include "filter_chain.hpp"
+#include "frame_assembler.hpp"
+#include "logger.hpp"
+#include "recording_reader.hpp"
+#include "simulated_device.hpp"
+#include "thread_affinity.hpp"
+#include "uvc_payload_parser.hpp"
+#include "uvc_protocol.hpp"
+
+namespace {
+
+constexpr int kSyntheticFrames = 16;           // Even, so the FID toggles cleanly as the frames repeat
+constexpr int kRecordedFrames = 64;
+constexpr size_t kSplitPayload = 16 * 1024;
+
+using Clock = std::chrono::steady_clock;
+
+struct DataSet {
+    std::string name;
+    int width;
+    int height;
+    std::vector<std::vector<uint16_t>> frames;
+
+    size_t frame_bytes() const { return static_cast<size_t>(width) * height * sizeof(uint16_t); }
+};
+
+// Splits frames into UVC payloads as the device sends them
+struct PayloadStream {
+    std::vector<std::vector<uint8_t>> payloads;
+    std::vector<size_t> frame_starts;      // First payload of each frame
+    size_t max_payload = 0;
+};
+
+struct Rate {
+    double frames_per_sec;
+    double mb_per_sec;
+    double us_per_frame;
+};
+
+DataSet synthetic(int width, int height) {
+    SimulatedDevice::Config config;
+    config.width = width;
+    config.height = height;
+    config.fps = 0.0;
+    SimulatedDevice device(config);
+
+    DataSet data{"synthetic_" + std::to_string(width) + "x" + std::to_string(height), width, height, {}};
+    std::vector<uint8_t> buffer(device.max_payload_size());
+    while (data.frames.size() < kSyntheticFrames) {
+        size_t length = device.read_payload(buffer.data(), buffer.size());
+        size_t header = buffer[0];
+        if (length - header != device.frame_size()) {
+            continue;
+        }
+        std::vector<uint16_t> frame(device.frame_size() / sizeof(uint16_t));
+        memcpy(frame.data(), buffer.data() + header, device.frame_size());
+        data.frames.push_back(std::move(frame));
+    }
+    return data;
+}
+
+bool recorded(const std::string& path, DataSet& data) {
+    RecordingReader reader;
+    if (!reader.open(path)) {
+        return false;
+    }
+    data.name = "recorded_" + std::to_string(reader.width()) + "x" + std::to_string(reader.height());
+    data.width = reader.width();
+    data.height = reader.height();
+    DepthCodec codec;
+    size_t count = std::min<size_t>(reader.frame_count(), kRecordedFrames) & ~size_t(1);
+    for (size_t i = 0; i < count; i++) {
+        RecordingReader::FrameView view;
+        if (!reader.frame(i, view)) {
+            return false;
+        }
+        std::vector<uint16_t> frame(static_cast<size_t>(data.width) * data.height);
+        if (view.codec == RecordCodec::Lossless) {
+            if (!codec.decode(view.data, view.size, frame.data(), data.width, data.height)) {
+                return false;
+            }
+        } else if (view.size == data.frame_bytes()) {
+            memcpy(frame.data(), view.data, view.size);
+        } else {
+            return false;
+        }
+        data.frames.push_back(std::move(frame));
+    }
+    return !data.frames.empty();
+}
+
+void write_le32(uint8_t* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+PayloadStream packetize(const DataSet& data, size_t payload_size) {
+    PayloadStream stream;
+    for (size_t f = 0; f < data.frames.size(); f++) {
+        const uint8_t* pixels = reinterpret_cast<const uint8_t*>(data.frames[f].data());
+        stream.frame_starts.push_back(stream.payloads.size());
+        for (size_t offset = 0; offset < data.frame_bytes(); offset += payload_size) {
+            size_t length = std::min(payload_size, data.frame_bytes() - offset);
+            std::vector<uint8_t> payload(UvcHeader::MAX_LENGTH + length, 0);
+            payload[0] = UvcHeader::MAX_LENGTH;
+            payload[1] = UvcHeader::EOH | UvcHeader::PTS | UvcHeader::SCR | (f & 1 ? UvcHeader::FID : 0);
+            if (offset + length == data.frame_bytes()) {
+                payload[1] |= UvcHeader::EOF_BIT;
+            }
+            write_le32(payload.data() + 2, static_cast<uint32_t>(f * 1000));
+            memcpy(payload.data() + UvcHeader::MAX_LENGTH, pixels + offset, length);
+            stream.max_payload = std::max(stream.max_payload, payload.size());
+            stream.payloads.push_back(std::move(payload));
+        }
+    }
+    stream.frame_starts.push_back(stream.payloads.size());
+    return stream;
+}
+
+// Calls step(i) for frames i = 0, 1, ... for at least seconds, after one
+// warm-up call
+template <typename Step>
+Rate measure(double seconds, size_t frame_bytes, Step&& step) {
+    step(0);
+    uint64_t frames = 0;
+    auto start = Clock::now();
+    auto end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    do {
+        step(++frames);
+    } while (Clock::now() < end);
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    return {frames / elapsed, frames * frame_bytes / elapsed / 1e6, elapsed / frames * 1e6};
+}
+
+BenchReport::Values values(const Rate& rate) {
+    return {{"frames_per_sec", rate.frames_per_sec}, {"mb_per_sec", rate.mb_per_sec},
+            {"us_per_frame", rate.us_per_frame}};
+}
+
+class Suite {
+public:
+    Suite(BenchReport& report, double seconds, const std::string& only)
+        : report_(report), seconds_(seconds), only_(only) {}
+
+    void run(const DataSet& data) {
+        parse(data);
+        assemble(data, "whole", data.frame_bytes());
+        assemble(data, "split", kSplitPayload);
+        const std::pair<const char*, Colorizer::RangeMode> modes[] = {
+            {"fixed", Colorizer::RangeMode::Fixed},
+            {"auto", Colorizer::RangeMode::Auto},
+            {"equalized", Colorizer::RangeMode::Equalized},
+        };
+        for (const auto& mode : modes) {
+            colorize(data, mode.first, mode.second);
+        }
+        for (const char* filter : {"decimation", "spatial", "temporal", "hole_fill", "chain"}) {
+            this->filter(data, filter);
+        }
+    }
+
+private:
+    bool wanted(const std::string& name) const {
+        return only_.empty() || name.find(only_) != std::string::npos;
+    }
+
+    void parse(const DataSet& data) {
+        std::string name = "parse/" + data.name;
+        if (!wanted(name)) {
+            return;
+        }
+        PayloadStream stream = packetize(data, kSplitPayload);
+        UvcPayloadParser parser(data.frame_bytes());
+        size_t frames = data.frames.size();
+        Rate rate = measure(seconds_, data.frame_bytes(), [&](uint64_t i) {
+            size_t f = i % frames;
+            for (size_t p = stream.frame_starts[f]; p < stream.frame_starts[f + 1]; p++) {
+                parser.parse(stream.payloads[p].data(), stream.payloads[p].size());
+            }
+        });
+        // Only the headers are read, so a byte rate would mean nothing here
+        double payloads_per_frame = static_cast<double>(stream.payloads.size()) / frames;
+        BenchReport::Values result = {{"frames_per_sec", rate.frames_per_sec},
+                                      {"payloads_per_sec", rate.frames_per_sec * payloads_per_frame},
+                                      {"us_per_frame", rate.us_per_frame}};
+        result.emplace_back("torn_frames", static_cast<double>(parser.stats().torn_frames));
+        report_.add(name, result, parser.stats().torn_frames == 0);
+    }
+
+    void assemble(const DataSet& data, const char* kind, size_t payload_size) {
+        std::string name = "assemble/" + data.name + "/" + kind;
+        if (!wanted(name)) {
+            return;
+        }
+        PayloadStream stream = packetize(data, payload_size);
+        // Payload buffers as deep as a transfer ring; zero-copy frames keep
+        // theirs only until the next iteration
+        FramePool transfers(8, stream.max_payload);
+        FramePool assembly(4, data.frame_bytes());
+        FrameAssembler assembler(data.frame_bytes());
+        assembler.set_statistics(true);
+        size_t frames = data.frames.size();
+        uint64_t assembled = 0;
+        uint64_t fed = 0;
+        Rate rate = measure(seconds_, data.frame_bytes(), [&](uint64_t i) {
+            size_t f = i % frames;
+            for (size_t p = stream.frame_starts[f]; p < stream.frame_starts[f + 1]; p++) {
+                Frame payload = transfers.acquire();
+                memcpy(payload.storage(), stream.payloads[p].data(), stream.payloads[p].size());
+                payload.set_data(0, stream.payloads[p].size());
+                Frame frame;
+                assembled += assembler.add(payload, assembly, frame);
+            }
+            fed++;
+        });
+        FrameAssembler::Stats stats = assembler.stats();
+        BenchReport::Values result = values(rate);
+        result.emplace_back("torn_frames", static_cast<double>(stats.torn_frames));
+        result.emplace_back("dropped_frames", static_cast<double>(stats.dropped_frames));
+        report_.add(name, result, assembled == fed && stats.torn_frames == 0);
+    }
+
+    void colorize(const DataSet& data, const char* mode_name, Colorizer::RangeMode mode) {
+        std::string name = "colorize/" + data.name + "/" + mode_name;
+        if (!wanted(name)) {
+            return;
+        }
+        Colorizer::Config config;
+        config.range = mode;
+        Colorizer colorizer(config);
+        size_t pixels = data.frames[0].size();
+        std::vector<uint8_t> rgba(pixels * 4);
+        Rate rate = measure(seconds_, data.frame_bytes(), [&](uint64_t i) {
+            colorizer.colorize(data.frames[i % data.frames.size()].data(), pixels, rgba.data());
+        });
+        report_.add(name, values(rate));
+    }
+
+    void filter(const DataSet& data, const std::string& filter_name) {
+        std::string name = "filter/" + data.name + "/" + filter_name;
+        if (!wanted(name)) {
+            return;
+        }
+        FilterChain chain;
+        if (filter_name == "decimation" || filter_name == "chain") {
+            chain.add(std::make_unique<DecimationFilter>(2));
+        }
+        if (filter_name == "spatial" || filter_name == "chain") {
+            chain.add(std::make_unique<SpatialFilter>(20));
+        }
+        if (filter_name == "temporal" || filter_name == "chain") {
+            chain.add(std::make_unique<TemporalFilter>(0.4f, 20, 3));
+        }
+        if (filter_name == "hole_fill" || filter_name == "chain") {
+            chain.add(std::make_unique<HoleFillingFilter>(HoleFillingFilter::Mode::FillFromLeft));
+        }
+        std::vector<uint16_t> out;
+        Rate rate = measure(seconds_, data.frame_bytes(), [&](uint64_t i) {
+            const std::vector<uint16_t>& frame = data.frames[i % data.frames.size()];
+            out.assign(frame.begin(), frame.end());
+            int width = data.width;
+            int height = data.height;
+            chain.process(out.data(), width, height);
+        });
+        report_.add(name, values(rate));
+    }
+
+    BenchReport& report_;
+    double seconds_;
+    std::string only_;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    double seconds = 1.0;
+    std::string only;
+    std::string recording;
+    std::string json_path;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--seconds" && has_value) {
+            seconds = std::stod(argv[++i]);
+        } else if (arg == "--only" && has_value) {
+            only = argv[++i];
+        } else if (arg == "--recording" && has_value) {
+            recording = argv[++i];
+        } else if (arg == "--json" && has_value) {
+            json_path = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--seconds S] [--only SUBSTRING] [--recording FILE]"
+                      << " [--json FILE|-]" << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+    Logger::instance().set_level(LogLevel::Warn);
+
+    BenchReport report("bench");
+    report.set_info("simd", CpuFeatures::name(CpuFeatures::simd_level()));
+    report.set_info("cpus", std::to_string(ThreadAffinity::cpu_count()));
+    report.set_info("pool_threads", std::to_string(ThreadPool::shared().size()));
+    report.set_info("seconds_per_case", std::to_string(seconds));
+
+    const int sizes[][2] = {{640, 480}, {848, 480}, {1280, 720}};
+    std::vector<DataSet> data_sets;
+    for (const int* size : sizes) {
+        data_sets.push_back(synthetic(size[0], size[1]));
+    }
+    if (!recording.empty()) {
+        DataSet data;
+        if (!recorded(recording, data)) {
+            std::cerr << "Failed to read frames from " << recording << std::endl;
+            return 1;
+        }
+        report.set_info("recording", recording);
+        data_sets.push_back(std::move(data));
+    }
+
+    Suite suite(report, seconds, only);
+    for (const DataSet& data : data_sets) {
+        suite.run(data);
+    }
+
+    if (!json_path.empty() && !report.write_json(json_path)) {
+        return 1;
+    }
+    return report.passed() ? 0 : 1;
+}
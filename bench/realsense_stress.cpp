@@ -0,0 +1,235 @@
+// Soak test: a simulated camera streaming for a long time through the full
+// pipeline, watching for throughput regressions and memory growth.
+//
+// A CameraDevice on a SimulatedTransport streams the given profile, with
+// payload loss and unplugs if asked for, while a consumer colorizes and
+// filters every frame as the viewer would. Every --interval seconds the
+// delivered frame rate, the resident set size and the frames held are
+// sampled and reported. The run fails if, after the first interval (pools
+// filling, caches and the allocator warming up):
+//
+//   - the frame rate over the run falls below --min-rate of the device's,
+//     discounting the time the device was unplugged;
+//   - the resident set grows by more than --max-growth-mb;
+//   - frames are still held once streaming has stopped.
+//
+// Defaults to 60 s of 848x480@90 sampled every 5 s; CI soaks run longer.
+//
+// Usage: realsense_stress [--duration S] [--interval S] [--profile WxH@FPS] [--payload BYTES]
+//                         [--loss P] [--unplug-every N] [--unplug-ms MS] [--no-process]
+//                         [--min-rate R] [--max-growth-mb MB] [--json FILE|-]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "bench_report.hpp"
+#include "camera_device.hpp"
+#include "colorizer.hpp"
+#include "filter_chain.hpp"
+#include "logger.hpp"
+#include "simulated_transport.hpp"
+#include "stream_profile.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Resident set size in MB, 0 where /proc is not available
+double resident_mb() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0;
+    size_t resident = 0;
+    if (!(statm >> pages >> resident)) {
+        return 0.0;
+    }
+    return resident * static_cast<double>(sysconf(_SC_PAGESIZE)) / (1024.0 * 1024.0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    double duration = 60.0;
+    double interval = 5.0;
+    StreamProfile profile;
+    StreamProfile::parse("848x480@90", profile);
+    SimulatedDevice::Config sim_config;
+    bool process = true;
+    double min_rate = 0.95;
+    double max_growth_mb = 16.0;
+    std::string json_path;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--duration" && has_value) {
+            duration = std::stod(argv[++i]);
+        } else if (arg == "--interval" && has_value) {
+            interval = std::stod(argv[++i]);
+        } else if (arg == "--profile" && has_value) {
+            if (!StreamProfile::parse(argv[++i], profile)) {
+                std::cerr << "Expected a profile like 848x480@90: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--payload" && has_value) {
+            sim_config.payload_size = std::stoul(argv[++i]);
+        } else if (arg == "--loss" && has_value) {
+            sim_config.payload_loss = std::stod(argv[++i]);
+        } else if (arg == "--unplug-every" && has_value) {
+            sim_config.unplug_every = std::stoull(argv[++i]);
+        } else if (arg == "--unplug-ms" && has_value) {
+            sim_config.unplug_ms = std::stod(argv[++i]);
+        } else if (arg == "--no-process") {
+            process = false;
+        } else if (arg == "--min-rate" && has_value) {
+            min_rate = std::stod(argv[++i]);
+        } else if (arg == "--max-growth-mb" && has_value) {
+            max_growth_mb = std::stod(argv[++i]);
+        } else if (arg == "--json" && has_value) {
+            json_path = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--duration S] [--interval S] [--profile WxH@FPS]"
+                      << " [--payload BYTES] [--loss P] [--unplug-every N] [--unplug-ms MS] [--no-process]"
+                      << " [--min-rate R] [--max-growth-mb MB] [--json FILE|-]" << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+    Logger::instance().set_level(LogLevel::Warn);
+
+    sim_config.width = profile.width;
+    sim_config.height = profile.height;
+    sim_config.fps = profile.fps;
+
+    BenchReport report("stress");
+    report.set_info("profile", profile.to_string());
+    report.set_info("duration_s", std::to_string(duration));
+    report.set_info("payload_size", std::to_string(sim_config.payload_size));
+    report.set_info("payload_loss", std::to_string(sim_config.payload_loss));
+    report.set_info("unplug_every", std::to_string(sim_config.unplug_every));
+    report.set_info("processing", process ? "colorize+filters" : "none");
+
+    CameraDevice camera(std::make_unique<SimulatedTransport>(sim_config));
+    camera.set_profile(profile);
+    if (!camera.initialize() || !camera.start_streaming()) {
+        std::cerr << "Failed to start the simulated camera" << std::endl;
+        return 1;
+    }
+
+    std::atomic<bool> running(true);
+    std::atomic<uint64_t> delivered(0);
+    std::thread consumer([&] {
+        Colorizer colorizer;
+        FilterChain chain;
+        chain.add(std::make_unique<SpatialFilter>(20));
+        chain.add(std::make_unique<TemporalFilter>(0.4f, 20, 3));
+        chain.add(std::make_unique<HoleFillingFilter>(HoleFillingFilter::Mode::FillFromLeft));
+        std::vector<uint8_t> rgba;
+        std::vector<uint16_t> depth;
+        Frame frame;
+        while (running) {
+            if (!camera.get_depth_frame(frame, 100)) {
+                continue;
+            }
+            if (process) {
+                const uint16_t* pixels = reinterpret_cast<const uint16_t*>(frame.data());
+                size_t count = frame.size() / sizeof(uint16_t);
+                rgba.resize(count * 4);
+                colorizer.colorize(pixels, count, rgba.data());
+                depth.assign(pixels, pixels + count);
+                int width = profile.width;
+                int height = profile.height;
+                chain.process(depth.data(), width, height);
+            }
+            frame.reset();
+            delivered.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    // The first interval is warm-up; growth and rate are measured after it
+    auto start = Clock::now();
+    auto next = start;
+    uint64_t warm_frames = 0;
+    double warm_rss = 0.0;
+    double warm_at = 0.0;
+    uint64_t warm_recovery_ns = 0;
+    uint64_t last_frames = 0;
+    double peak_rss = 0.0;
+    double min_interval_rate = 1e30;
+    int intervals = std::max(2, static_cast<int>(duration / interval + 0.5));
+    for (int n = 0; n < intervals; n++) {
+        next += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(interval));
+        std::this_thread::sleep_until(next);
+        double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        uint64_t frames = delivered.load(std::memory_order_relaxed);
+        double rss = resident_mb();
+        double rate = (frames - last_frames) / interval;
+        last_frames = frames;
+        peak_rss = std::max(peak_rss, rss);
+        if (n == 0) {
+            warm_frames = frames;
+            warm_rss = rss;
+            warm_at = elapsed;
+            warm_recovery_ns = camera.stats().recovery_ns;
+        } else {
+            min_interval_rate = std::min(min_interval_rate, rate);
+        }
+        report.add("interval/" + std::to_string(n),
+                   {{"elapsed_s", elapsed},
+                    {"frames_per_sec", rate},
+                    {"rss_mb", rss},
+                    {"frames_in_use", static_cast<double>(camera.pool_stats().in_use)}});
+    }
+    double end_at = std::chrono::duration<double>(Clock::now() - start).count();
+    uint64_t end_frames = delivered.load(std::memory_order_relaxed);
+    double end_rss = resident_mb();
+    uint64_t end_recovery_ns = camera.stats().recovery_ns;
+
+    running = false;
+    consumer.join();
+    camera.stop_streaming();
+
+    CameraDevice::Stats stats = camera.stats();
+    FramePool::Stats pool = camera.pool_stats();
+
+    // Time spent unplugged delivers nothing by design. Only outages the
+    // camera recovered from after warm-up count, as long as they took.
+    double measured = end_at - warm_at;
+    double unplugged = (end_recovery_ns - warm_recovery_ns) / 1e9;
+    double streaming = std::max(measured - unplugged, 1e-3);
+    double rate = (end_frames - warm_frames) / streaming;
+    double growth = end_rss - warm_rss;
+    bool rate_ok = measured <= 0.0 || rate >= min_rate * profile.fps;
+    bool memory_ok = growth <= max_growth_mb;
+    bool released = pool.in_use == 0;
+
+    report.add("summary",
+               {{"frames_per_sec", rate},
+                {"device_fps", static_cast<double>(profile.fps)},
+                {"min_interval_fps", min_interval_rate < 1e30 ? min_interval_rate : 0.0},
+                {"rss_growth_mb", growth},
+                {"peak_rss_mb", peak_rss},
+                {"frames_held_after_stop", static_cast<double>(pool.in_use)},
+                {"torn_frames", static_cast<double>(stats.torn_frames)},
+                {"disconnects", static_cast<double>(stats.disconnects)},
+                {"reconnects", static_cast<double>(stats.reconnects)}},
+               rate_ok && memory_ok && released);
+    if (!rate_ok) {
+        std::cerr << "Throughput " << rate << " fps is below " << min_rate * profile.fps << std::endl;
+    }
+    if (!memory_ok) {
+        std::cerr << "Resident set grew " << growth << " MB after warm-up" << std::endl;
+    }
+    if (!released) {
+        std::cerr << pool.in_use << " frames still held after streaming stopped" << std::endl;
+    }
+
+    if (!json_path.empty() && !report.write_json(json_path)) {
+        return 1;
+    }
+    return report.passed() ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+// Startup and reconnection times on a SimulatedDevice.
+//
+// First opens and starts a simulated 90 fps camera repeatedly and reports
+// the time from initialize() to the first frame. Then streams while the
+// device is unplugged every half second for 10, 50 and 200 ms, and
+// reports how long each recovery took from the loss being detected to the
+// next frame, and what it cost beyond the time the device was away: the
+// part the driver is responsible for.
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include "camera_device.hpp"
+#include "logger.hpp"
+#include "simulated_transport.hpp"
+
+namespace {
+
+constexpr double kFps = 90.0;
+constexpr int kStartups = 20;
+constexpr double kSeconds = 4.0;
+constexpr uint64_t kUnplugEvery = 45;
+
+using Clock = std::chrono::steady_clock;
+
+SimulatedDevice::Config device_config() {
+    SimulatedDevice::Config config;
+    config.fps = kFps;
+    return config;
+}
+
+void startup() {
+    LatencyHistogram first_frame;
+    for (int i = 0; i < kStartups; i++) {
+        CameraDevice camera(std::make_unique<SimulatedTransport>(device_config()));
+        camera.set_name("startup");
+        Frame frame;
+        if (!camera.initialize() || !camera.start_streaming() || !camera.get_depth_frame(frame, 1000)) {
+            std::cerr << "Simulated camera did not start" << std::endl;
+            return;
+        }
+        frame.reset();
+        first_frame.record(camera.stats().first_frame_ns);
+        camera.stop_streaming();
+    }
+    LatencyHistogram::Snapshot data = first_frame.snapshot();
+    std::cout << "Time to first frame over " << data.count << " starts: p50 " << data.percentile(0.5) / 1e6
+              << " ms, max " << data.max_ns / 1e6 << " ms" << std::endl;
+}
+
+void recover(double unplug_ms) {
+    SimulatedDevice::Config config = device_config();
+    config.unplug_every = kUnplugEvery;
+    config.unplug_ms = unplug_ms;
+    CameraDevice camera(std::make_unique<SimulatedTransport>(config));
+    std::string name = "unplug_" + std::to_string(static_cast<int>(unplug_ms));
+    camera.set_name(name);
+    if (!camera.initialize() || !camera.start_streaming()) {
+        std::cerr << "Simulated camera did not start" << std::endl;
+        return;
+    }
+
+    Frame frame;
+    uint64_t frames = 0;
+    auto start = Clock::now();
+    while (Clock::now() - start < std::chrono::duration<double>(kSeconds)) {
+        if (camera.get_depth_frame(frame, 100)) {
+            frames++;
+            frame.reset();
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    CameraDevice::Stats stats = camera.stats();
+    camera.stop_streaming();
+
+    LatencyHistogram::Snapshot data = Metrics::instance().histogram(name + "_device_recovery", "").snapshot();
+    std::cout << std::setw(10) << unplug_ms << std::setw(12) << stats.disconnects << std::setw(11)
+              << stats.reconnects << std::setw(10) << frames / seconds << std::setw(12)
+              << data.percentile(0.5) / 1e6 << std::setw(12) << data.max_ns / 1e6 << std::setw(14)
+              << data.percentile(0.5) / 1e6 - unplug_ms << std::endl;
+}
+
+}  // namespace
+
+int main() {
+    // Every unplug logs an error by design
+    Logger::instance().set_level(LogLevel::Off);
+    std::cout << std::fixed << std::setprecision(2);
+    startup();
+
+    std::cout << std::endl << "Unplugged every " << kUnplugEvery << " frames at " << kFps << " fps" << std::endl
+              << std::setw(10) << "away ms" << std::setw(12) << "disconnects" << std::setw(11) << "recovered"
+              << std::setw(10) << "frames/s" << std::setw(12) << "p50 ms" << std::setw(12) << "max ms"
+              << std::setw(14) << "overhead ms" << std::endl;
+    for (double unplug_ms : {10.0, 50.0, 200.0}) {
+        recover(unplug_ms);
+    }
+    return 0;
+}
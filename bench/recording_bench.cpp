@@ -0,0 +1,242 @@
+// Depth recording write, read and seek performance.
+//
+// Records 640x480 frames flat out, where the disk cannot keep up and the
+// recorder has to drop, and then paced at 90 fps, where it must not. Then
+// memory-maps the paced recording, checks every frame comes back intact,
+// and times a sequential pass over the mapped frames and random seeks by
+// frame number and timestamp. Finally clears the index from the header, as
+// if the recorder had died, and checks the reader rebuilds it.
+//
+// Usage: recording_bench [FILE]   (default /tmp/recording_bench.rsd)
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "depth_recorder.hpp"
+#include "recording_reader.hpp"
+
+namespace {
+
+constexpr int kWidth = 640;
+constexpr int kHeight = 480;
+constexpr int kPatterns = 8;
+constexpr int kFrames = 600;
+constexpr uint64_t kFrameIntervalNs = 33333333;
+constexpr int kSeeks = 1000000;
+constexpr double kPacedFps = 90.0;
+
+using Clock = std::chrono::steady_clock;
+
+// Keeps the read pass observable so it is not optimized out
+volatile uint64_t benchmark_sink = 0;
+
+double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::vector<std::vector<uint16_t>> make_patterns() {
+    std::mt19937 rng(7);
+    std::vector<std::vector<uint16_t>> patterns(kPatterns, std::vector<uint16_t>(kWidth * kHeight));
+    for (auto& pattern : patterns) {
+        for (uint16_t& value : pattern) {
+            value = static_cast<uint16_t>(rng() % 4000);
+        }
+    }
+    return patterns;
+}
+
+// fps 0 writes flat out. Returns the number of frames recorded.
+size_t record(const char* label, const std::string& path, const std::vector<std::vector<uint16_t>>& patterns,
+              double fps) {
+    DepthRecorder recorder;
+    if (!recorder.open(path)) {
+        return 0;
+    }
+    std::vector<double> call_us;
+    call_us.reserve(kFrames);
+    auto start = Clock::now();
+    for (int i = 0; i < kFrames; i++) {
+        if (fps > 0.0) {
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(
+                                                      std::chrono::duration<double>(i / fps)));
+        }
+        FrameMetadata metadata;
+        metadata.sequence = i;
+        metadata.timestamp_ns = 1000000000ull + i * kFrameIntervalNs;
+        metadata.device_timestamp = static_cast<uint32_t>(i * 33333);
+        const auto& pattern = patterns[i % kPatterns];
+        auto call_start = Clock::now();
+        recorder.write(reinterpret_cast<const uint8_t*>(pattern.data()), pattern.size() * sizeof(uint16_t),
+                       metadata, RecordCodec::Raw, pattern.size() * sizeof(uint16_t));
+        call_us.push_back(seconds_since(call_start) * 1e6);
+    }
+    double queued = seconds_since(start);
+    DepthRecorder::Stats stats = recorder.stats();
+    bool closed = recorder.close();
+    double total = seconds_since(start);
+    stats = recorder.stats();
+
+    std::sort(call_us.begin(), call_us.end());
+    double mb = stats.bytes / 1e6;
+    std::cout << std::fixed << std::setprecision(1)
+              << label << ": " << stats.frames << " frames, " << stats.dropped << " dropped, " << mb << " MB in "
+              << stats.writes << " writes, " << mb / total << " MB/s to disk" << std::endl
+              << "  write() p50 " << call_us[call_us.size() / 2] << " us, p99 "
+              << call_us[call_us.size() * 99 / 100] << " us, max " << call_us.back() << " us; "
+              << kFrames / queued << " frames/s offered" << std::endl;
+    return closed ? stats.frames : 0;
+}
+
+bool verify(RecordingReader& reader, const std::vector<std::vector<uint16_t>>& patterns, size_t expected) {
+    if (reader.frame_count() != expected) {
+        std::cout << "Frame count " << reader.frame_count() << ", expected " << expected << std::endl;
+        return false;
+    }
+    for (size_t i = 0; i < reader.frame_count(); i++) {
+        RecordingReader::FrameView view;
+        if (!reader.frame(i, view)) {
+            std::cout << "Frame " << i << " is missing" << std::endl;
+            return false;
+        }
+        const auto& pattern = patterns[view.metadata.sequence % kPatterns];
+        if (view.size != pattern.size() * sizeof(uint16_t) || std::memcmp(view.data, pattern.data(), view.size) != 0 ||
+            view.metadata.timestamp_ns != 1000000000ull + view.metadata.sequence * kFrameIntervalNs) {
+            std::cout << "Frame " << i << " does not match what was recorded" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void time_reads(RecordingReader& reader) {
+    // Sequential pass touching every byte of every mapped frame
+    auto start = Clock::now();
+    uint64_t sum = 0;
+    size_t bytes = 0;
+    for (size_t i = 0; i < reader.frame_count(); i++) {
+        RecordingReader::FrameView view;
+        reader.frame(i, view);
+        const uint64_t* words = reinterpret_cast<const uint64_t*>(view.data);
+        for (size_t w = 0; w < view.size / sizeof(uint64_t); w++) {
+            sum += words[w];
+        }
+        bytes += view.size;
+    }
+    benchmark_sink = sum;
+    double elapsed = seconds_since(start);
+    std::cout << "Sequential read: " << bytes / 1e6 / elapsed << " MB/s" << std::endl;
+
+    std::mt19937_64 rng(11);
+    uint64_t first = reader.first_timestamp_ns();
+    uint64_t span = reader.last_timestamp_ns() - first;
+    std::vector<uint64_t> targets(kSeeks);
+    for (uint64_t& target : targets) {
+        target = first + rng() % (span + 1);
+    }
+
+    start = Clock::now();
+    size_t found = 0;
+    for (uint64_t target : targets) {
+        found += reader.find(target);
+    }
+    double find_ns = seconds_since(start) * 1e9 / kSeeks;
+
+    start = Clock::now();
+    for (uint64_t target : targets) {
+        RecordingReader::FrameView view;
+        reader.frame(target % reader.frame_count(), view);
+        found += view.size;
+    }
+    double frame_ns = seconds_since(start) * 1e9 / kSeeks;
+    benchmark_sink = found;
+
+    std::cout << std::setprecision(1) << "Seek: by timestamp " << find_ns << " ns, by frame number "
+              << frame_ns << " ns" << std::endl;
+}
+
+bool patch(const std::string& path, uint64_t offset, const void* data, size_t size) {
+    std::FILE* file = std::fopen(path.c_str(), "r+b");
+    if (!file) {
+        return false;
+    }
+    bool ok = std::fseek(file, static_cast<long>(offset), SEEK_SET) == 0 && std::fwrite(data, size, 1, file) == 1;
+    std::fclose(file);
+    return ok;
+}
+
+bool reopen(const std::string& path, const std::vector<std::vector<uint16_t>>& patterns, size_t frames,
+            const char* what) {
+    RecordingReader reader;
+    bool ok = reader.open(path) && reader.recovered() && verify(reader, patterns, frames);
+    std::cout << "Recovery " << what << ": " << (ok ? "ok" : "FAILED") << std::endl;
+    return ok;
+}
+
+bool check_recovery(const std::string& path, const std::vector<std::vector<uint16_t>>& patterns, size_t frames) {
+    RecordingFileHeader header;
+    RecordingIndexHeader index_header;
+    RecordingIndexEntry entries[2];
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+              std::fseek(file, static_cast<long>(header.index_offset), SEEK_SET) == 0 &&
+              std::fread(&index_header, sizeof(index_header), 1, file) == 1 &&
+              std::fread(entries, sizeof(entries), 1, file) == 1;
+    std::fclose(file);
+    if (!ok) {
+        return false;
+    }
+    uint64_t entries_offset = header.index_offset + sizeof(index_header);
+
+    // An entry count whose byte size wraps around to something small
+    RecordingIndexHeader wrapped = index_header;
+    wrapped.count = (UINT64_MAX / sizeof(RecordingIndexEntry)) + 2;
+    ok = patch(path, header.index_offset, &wrapped, sizeof(wrapped)) &&
+         reopen(path, patterns, frames, "from a wrapped index count");
+    ok = patch(path, header.index_offset, &index_header, sizeof(index_header)) && ok;
+
+    // Entries out of order
+    RecordingIndexEntry swapped[2] = {entries[1], entries[0]};
+    ok = patch(path, entries_offset, swapped, sizeof(swapped)) &&
+         reopen(path, patterns, frames, "from an unordered index") && ok;
+    ok = patch(path, entries_offset, entries, sizeof(entries)) && ok;
+
+    // Drop the index pointer, as if the recorder never got to close()
+    header.index_offset = 0;
+    header.frame_count = 0;
+    return patch(path, 0, &header, sizeof(header)) && reopen(path, patterns, frames, "without index") && ok;
+}
+}
+
+int main(int argc, char** argv) {
+    std::string path = argc > 1 ? argv[1] : "/tmp/recording_bench.rsd";
+    std::vector<std::vector<uint16_t>> patterns = make_patterns();
+
+    size_t burst = record("Flat out", path, patterns, 0.0);
+    size_t paced = record("90 fps", path, patterns, kPacedFps);
+    if (burst == 0 || paced != static_cast<size_t>(kFrames)) {
+        std::cout << "Recording failed or dropped frames at " << kPacedFps << " fps" << std::endl;
+        return 1;
+    }
+
+    RecordingReader reader;
+    if (!reader.open(path) || !verify(reader, patterns, paced)) {
+        return 1;
+    }
+    std::cout << "Read back: " << reader.frame_count() << " frames intact" << std::endl;
+    time_reads(reader);
+    reader.close();
+
+    bool ok = check_recovery(path, patterns, paced);
+    std::remove(path.c_str());
+    return ok ? 0 : 1;
+}
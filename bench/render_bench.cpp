@@ -0,0 +1,124 @@
+// Headless render pipeline timings.
+//
+// Drives an offscreen Visualizer at several resolutions with each upload mode
+// and asynchronous readback enabled, feeding it frames recorded from
+// SimulatedDevice, and reports the mean CPU time spent per stage. Runs
+// without a display: an EGL surfaceless context is used where available.
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "simulated_device.hpp"
+#include "uvc_protocol.hpp"
+#include "visualizer.hpp"
+
+namespace {
+
+constexpr int kRecordedFrames = 8;
+constexpr int kWarmupFrames = 30;
+constexpr int kFrames = 300;
+
+struct Resolution {
+    int width;
+    int height;
+};
+
+std::vector<std::vector<uint8_t>> record(int width, int height) {
+    SimulatedDevice::Config config;
+    config.width = width;
+    config.height = height;
+    config.fps = 0.0;
+    SimulatedDevice device(config);
+
+    std::vector<std::vector<uint8_t>> frames;
+    std::vector<uint8_t> buffer(device.max_payload_size());
+    while (frames.size() < kRecordedFrames) {
+        size_t length = device.read_payload(buffer.data(), buffer.size());
+        if (length < UvcHeader::MIN_LENGTH || length - buffer[0] != device.frame_size()) {
+            continue;
+        }
+        frames.emplace_back(buffer.begin() + buffer[0], buffer.begin() + length);
+    }
+    return frames;
+}
+
+const char* mode_name(Visualizer::UploadMode mode) {
+    switch (mode) {
+    case Visualizer::UploadMode::TexImage: return "teximage";
+    case Visualizer::UploadMode::PboOrphan: return "orphan";
+    case Visualizer::UploadMode::PboPersistent: return "persistent";
+    }
+    return "?";
+}
+
+bool run(const Resolution& resolution, Visualizer::UploadMode mode) {
+    std::vector<std::vector<uint8_t>> frames = record(resolution.width, resolution.height);
+
+    Visualizer visualizer(resolution.width, resolution.height);
+    visualizer.set_headless(true);
+    visualizer.set_readback(true);
+    visualizer.set_upload_mode(mode);
+    if (!visualizer.initialize()) {
+        return false;
+    }
+
+    std::vector<uint8_t> snapshot(static_cast<size_t>(resolution.width) * resolution.height * 4);
+    int snapshots = 0;
+    for (int i = 0; i < kWarmupFrames + kFrames; i++) {
+        if (i == kWarmupFrames) {
+            visualizer.reset_timings();
+        }
+        visualizer.render_frame(frames[i % frames.size()].data());
+        if (i % 10 == 9 && visualizer.read_snapshot(snapshot.data(), snapshot.size())) {
+            snapshots++;
+        }
+    }
+
+    Visualizer::FrameTimings t = visualizer.timings();
+    std::ostringstream size;
+    size << resolution.width << "x" << resolution.height;
+    std::cout << std::left << std::setw(11) << size.str()
+              << std::setw(12) << mode_name(visualizer.upload_mode()) << std::right << std::fixed
+              << std::setprecision(3)
+              << std::setw(10) << t.upload.mean_ms()
+              << std::setw(10) << t.draw.mean_ms()
+              << std::setw(10) << t.readback.mean_ms()
+              << std::setw(10) << t.present.mean_ms()
+              << std::setw(10) << t.frame.mean_ms()
+              << std::setw(10) << std::setprecision(1) << (t.frame.mean_ms() > 0 ? 1000.0 / t.frame.mean_ms() : 0.0)
+              << std::setw(10) << snapshots << std::endl;
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    const Resolution resolutions[] = {
+        {480, 270},
+        {640, 480},
+        {848, 480},
+        {1280, 720},
+    };
+    const Visualizer::UploadMode modes[] = {
+        Visualizer::UploadMode::TexImage,
+        Visualizer::UploadMode::PboOrphan,
+        Visualizer::UploadMode::PboPersistent,
+    };
+
+    std::cout << "Headless render, " << kFrames << " frames per case, mean CPU ms per stage" << std::endl;
+    std::cout << std::left << std::setw(11) << "size" << std::setw(12) << "upload" << std::right
+              << std::setw(10) << "upload" << std::setw(10) << "draw" << std::setw(10) << "readback"
+              << std::setw(10) << "flush" << std::setw(10) << "frame" << std::setw(10) << "fps"
+              << std::setw(10) << "snapshots" << std::endl;
+
+    for (const Resolution& resolution : resolutions) {
+        for (Visualizer::UploadMode mode : modes) {
+            if (!run(resolution, mode)) {
+                std::cerr << "Failed to create a headless context" << std::endl;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,199 @@
+// Shared-memory frame fan-out to subscriber processes.
+//
+// Forks 1, 2, 4 and 8 subscriber processes that each read every 640x480
+// frame in place (summing all of its pixels, as a consumer that looks at
+// the whole frame would) while this process publishes, first flat out and
+// then at 90 fps. Prints the publisher's rate, what each subscriber got,
+// skipped or read torn, and the publish-to-read latency.
+//
+// Linux/POSIX only: uses fork() and a pipe per subscriber for results.
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "frame_publisher.hpp"
+#include "frame_subscriber.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+
+namespace {
+
+constexpr int kWidth = 640;
+constexpr int kHeight = 480;
+constexpr int kFlatOutFrames = 2000;
+constexpr int kPacedFrames = 270;
+constexpr double kPacedFps = 90.0;
+constexpr const char* kRingName = "/realsense_fanout_bench";
+
+using Clock = std::chrono::steady_clock;
+
+struct SubscriberResult {
+    uint64_t received;
+    uint64_t skipped;
+    uint64_t torn;
+    double p50_us;
+    double p99_us;
+    uint64_t checksum;
+};
+
+// Runs in the child: reads until the publisher closes the ring
+SubscriberResult subscribe() {
+    SubscriberResult result{};
+    FrameSubscriber::Config config;
+    config.name = kRingName;
+    FrameSubscriber subscriber(config);
+    if (!subscriber.open()) {
+        return result;
+    }
+    std::vector<double> latency_us;
+    latency_us.reserve(kFlatOutFrames);
+    FrameSubscriber::FrameView view;
+    while (!subscriber.publisher_closed()) {
+        if (!subscriber.next(view, 100)) {
+            continue;
+        }
+        latency_us.push_back((monotonic_ns() - view.published_ns) / 1e3);
+        const uint64_t* words = reinterpret_cast<const uint64_t*>(view.depth);
+        uint64_t sum = 0;
+        for (size_t i = 0; i < view.size / sizeof(uint64_t); i++) {
+            sum += words[i];
+        }
+        if (subscriber.release(view)) {
+            result.checksum += sum;
+        }
+    }
+    FrameSubscriber::Stats stats = subscriber.stats();
+    result.received = stats.received;
+    result.skipped = stats.skipped;
+    result.torn = stats.torn;
+    if (!latency_us.empty()) {
+        std::sort(latency_us.begin(), latency_us.end());
+        result.p50_us = latency_us[latency_us.size() / 2];
+        result.p99_us = latency_us[latency_us.size() * 99 / 100];
+    }
+    return result;
+}
+
+void run(int subscribers, int frames, double fps) {
+    FramePublisher::Config config;
+    config.name = kRingName;
+    config.width = kWidth;
+    config.height = kHeight;
+    FramePublisher publisher(config);
+    if (!publisher.open()) {
+        return;
+    }
+
+    std::vector<pid_t> children;
+    std::vector<int> pipes;
+    for (int i = 0; i < subscribers; i++) {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            break;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            ::close(fds[0]);
+            SubscriberResult result = subscribe();
+            ssize_t written = write(fds[1], &result, sizeof(result));
+            _exit(written == sizeof(result) ? 0 : 1);
+        }
+        ::close(fds[1]);
+        children.push_back(pid);
+        pipes.push_back(fds[0]);
+    }
+
+    // Start once everyone is attached
+    auto wait_start = Clock::now();
+    while (publisher.subscribers().size() < children.size() && Clock::now() - wait_start < std::chrono::seconds(5)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::vector<uint16_t> image(static_cast<size_t>(kWidth) * kHeight);
+    for (size_t i = 0; i < image.size(); i++) {
+        image[i] = static_cast<uint16_t>(500 + i % 3000);
+    }
+    auto start = Clock::now();
+    for (int i = 0; i < frames; i++) {
+        if (fps > 0.0) {
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(
+                                                      std::chrono::duration<double>(i / fps)));
+        }
+        FrameMetadata metadata;
+        metadata.sequence = i;
+        metadata.timestamp_ns = monotonic_ns();
+        image[0] = static_cast<uint16_t>(i);
+        publisher.publish(reinterpret_cast<const uint8_t*>(image.data()), image.size() * sizeof(uint16_t),
+                          metadata);
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // Let the subscribers drain what is still in the ring before closing it
+    auto drain_start = Clock::now();
+    for (;;) {
+        uint64_t lag = 0;
+        for (const FramePublisher::SubscriberInfo& info : publisher.subscribers()) {
+            lag = std::max(lag, info.lag);
+        }
+        if (lag == 0 || Clock::now() - drain_start > std::chrono::seconds(2)) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    publisher.close();
+
+    uint64_t received = 0;
+    uint64_t skipped = 0;
+    uint64_t torn = 0;
+    double p50 = 0.0;
+    double p99 = 0.0;
+    for (size_t i = 0; i < children.size(); i++) {
+        SubscriberResult result{};
+        if (read(pipes[i], &result, sizeof(result)) != sizeof(result)) {
+            std::cout << "Subscriber " << i << " failed" << std::endl;
+        }
+        ::close(pipes[i]);
+        waitpid(children[i], nullptr, 0);
+        received += result.received;
+        skipped += result.skipped;
+        torn += result.torn;
+        p50 = std::max(p50, result.p50_us);
+        p99 = std::max(p99, result.p99_us);
+    }
+
+    double frame_mb = image.size() * sizeof(uint16_t) / 1e6;
+    std::cout << std::right << std::fixed << std::setw(5) << subscribers << std::setprecision(0)
+              << std::setw(11) << frames / seconds << std::setprecision(2) << std::setw(10)
+              << received * frame_mb / seconds / 1e3 << std::setprecision(1) << std::setw(11)
+              << 100.0 * received / (static_cast<double>(frames) * subscribers) << std::setw(9) << skipped
+              << std::setw(7) << torn << std::setw(10) << p50 << std::setw(10) << p99 << std::endl;
+}
+
+void header(const char* title) {
+    std::cout << std::endl << title << std::endl
+              << std::setw(5) << "subs" << std::setw(11) << "frames/s" << std::setw(10) << "read GB/s"
+              << std::setw(11) << "received %" << std::setw(9) << "skipped" << std::setw(7) << "torn"
+              << std::setw(10) << "p50 us" << std::setw(10) << "p99 us" << std::endl;
+}
+
+}  // namespace
+
+int main() {
+    Logger::instance().set_level(LogLevel::Warn);
+    std::cout << "Ring of 8 slots, " << kWidth << "x" << kHeight << " Z16; latency is worst subscriber"
+              << std::endl;
+    header("Flat out");
+    for (int subscribers : {1, 2, 4, 8}) {
+        run(subscribers, kFlatOutFrames, 0.0);
+    }
+    header("90 fps");
+    for (int subscribers : {1, 2, 4, 8}) {
+        run(subscribers, kPacedFrames, kPacedFps);
+    }
+    return 0;
+}
@@ -0,0 +1,210 @@
+// Load generator for the TCP depth streaming server.
+//
+// Runs a StreamServer on a loopback port and feeds it frames of the
+// simulated camera's scene while client threads connect with a mix of
+// stream settings, first at the camera's 90 fps and then flat out. One
+// client reads slowly on purpose, to show that its bounded queue drops its
+// frames without holding back the others. Prints, per client, the frames
+// received and dropped, throughput and the publish-to-receive latency, then
+// the aggregate and how long publish() itself took.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "simulated_device.hpp"
+#include "stream_client.hpp"
+#include "stream_server.hpp"
+
+namespace {
+
+constexpr int kWidth = 640;
+constexpr int kHeight = 480;
+constexpr int kSceneFrames = 16;
+constexpr size_t kUvcHeaderSize = 12;
+constexpr double kSeconds = 3.0;
+constexpr double kCameraFps = 90.0;
+
+using Clock = std::chrono::steady_clock;
+
+struct ClientSpec {
+    const char* name;
+    int decimation;
+    RecordCodec codec;
+    int read_delay_ms;      // Time the client spends on each frame
+};
+
+struct ClientResult {
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    uint64_t dropped = 0;
+    std::vector<double> latency_us;
+};
+
+double percentile(std::vector<double>& values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, static_cast<size_t>(values.size() * p))];
+}
+
+std::vector<std::vector<uint16_t>> make_scene() {
+    SimulatedDevice::Config config;
+    config.width = kWidth;
+    config.height = kHeight;
+    config.fps = 0.0;
+    SimulatedDevice device(config);
+    std::vector<uint8_t> payload(device.max_payload_size());
+    std::vector<std::vector<uint16_t>> scene(kSceneFrames, std::vector<uint16_t>(kWidth * kHeight));
+    for (std::vector<uint16_t>& image : scene) {
+        size_t size = device.read_payload(payload.data(), payload.size());
+        std::memcpy(image.data(), payload.data() + kUvcHeaderSize,
+                    std::min(size - kUvcHeaderSize, image.size() * sizeof(uint16_t)));
+    }
+    return scene;
+}
+
+void receive(const ClientSpec& spec, int port, const std::atomic<bool>& stop, ClientResult& result) {
+    StreamClient::Config config;
+    config.port = port;
+    config.decimation = spec.decimation;
+    config.codec = spec.codec;
+    StreamClient client(config);
+    if (!client.connect()) {
+        return;
+    }
+    std::vector<uint16_t> depth;
+    StreamClient::FrameInfo info;
+    while (!stop) {
+        if (!client.receive(depth, info, 100)) {
+            if (!client.is_connected()) {
+                break;
+            }
+            continue;
+        }
+        result.latency_us.push_back((monotonic_ns() - info.timestamp_ns) / 1e3);
+        result.frames++;
+        result.bytes += info.wire_size;
+        result.dropped = info.dropped;
+        if (spec.read_delay_ms > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(spec.read_delay_ms));
+        }
+    }
+}
+
+void run(const char* title, const std::vector<ClientSpec>& specs, double fps,
+         const std::vector<std::vector<uint16_t>>& scene) {
+    StreamServer::Config config;
+    config.address = "127.0.0.1";
+    config.port = 0;
+    config.width = kWidth;
+    config.height = kHeight;
+    StreamServer server(config);
+    if (!server.start()) {
+        return;
+    }
+
+    std::atomic<bool> stop(false);
+    std::vector<ClientResult> results(specs.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < specs.size(); i++) {
+        threads.emplace_back(receive, std::cref(specs[i]), server.port(), std::cref(stop), std::ref(results[i]));
+    }
+    auto wait_start = Clock::now();
+    while (server.stats().clients < specs.size() && Clock::now() - wait_start < std::chrono::seconds(5)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // Let the hellos land so every client sees the first frame
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    FramePool pool(4, kWidth * kHeight * sizeof(uint16_t));
+    std::vector<double> publish_us;
+    uint64_t published = 0;
+    auto start = Clock::now();
+    auto deadline = start + std::chrono::duration<double>(kSeconds);
+    while (Clock::now() < deadline) {
+        if (fps > 0.0) {
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(
+                                                      std::chrono::duration<double>(published / fps)));
+        }
+        Frame frame = pool.acquire();
+        const std::vector<uint16_t>& image = scene[published % scene.size()];
+        std::memcpy(frame.storage(), image.data(), image.size() * sizeof(uint16_t));
+        frame.set_data(0, image.size() * sizeof(uint16_t));
+        frame.metadata().sequence = published;
+        frame.metadata().timestamp_ns = monotonic_ns();
+        uint64_t before = monotonic_ns();
+        server.publish(frame);
+        publish_us.push_back((monotonic_ns() - before) / 1e3);
+        published++;
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // Give the clients a moment to read what is in flight
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    StreamServer::Stats stats = server.stats();
+    stop = true;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    server.stop();
+
+    std::cout << std::endl << title << ": " << published / seconds << " frames/s published, "
+              << stats.ingest_dropped << " not taken by the server, publish() p50 "
+              << percentile(publish_us, 0.5) << " us, p99 " << percentile(publish_us, 0.99) << " us" << std::endl
+              << std::setw(18) << "client" << std::setw(10) << "frames/s" << std::setw(9) << "MB/s"
+              << std::setw(9) << "dropped" << std::setw(10) << "p50 us" << std::setw(10) << "p99 us" << std::endl;
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    uint64_t dropped = 0;
+    std::vector<double> all_latency;
+    for (size_t i = 0; i < specs.size(); i++) {
+        ClientResult& result = results[i];
+        frames += result.frames;
+        bytes += result.bytes;
+        dropped += result.dropped;
+        all_latency.insert(all_latency.end(), result.latency_us.begin(), result.latency_us.end());
+        std::cout << std::setw(18) << specs[i].name << std::setw(10) << result.frames / seconds
+                  << std::setw(9) << result.bytes / seconds / 1e6 << std::setw(9) << result.dropped
+                  << std::setw(10) << percentile(result.latency_us, 0.5)
+                  << std::setw(10) << percentile(result.latency_us, 0.99) << std::endl;
+    }
+    std::cout << std::setw(18) << "all" << std::setw(10) << frames / seconds << std::setw(9)
+              << bytes / seconds / 1e6 << std::setw(9) << dropped << std::setw(10) << percentile(all_latency, 0.5)
+              << std::setw(10) << percentile(all_latency, 0.99) << std::endl;
+}
+
+}  // namespace
+
+int main() {
+    Logger::instance().set_level(LogLevel::Warn);
+    std::cout << std::fixed << std::setprecision(1) << kWidth << "x" << kHeight << " Z16 over loopback, "
+              << kSeconds << " s per run" << std::endl;
+    std::vector<std::vector<uint16_t>> scene = make_scene();
+
+    std::vector<ClientSpec> mixed = {
+        {"raw", 1, RecordCodec::Raw, 0},
+        {"lossless", 1, RecordCodec::Lossless, 0},
+        {"decimate 2", 2, RecordCodec::Raw, 0},
+        {"lossless dec 2", 2, RecordCodec::Lossless, 0},
+        {"decimate 4", 4, RecordCodec::Raw, 0},
+        {"slow raw", 1, RecordCodec::Raw, 50},
+    };
+    run("Mixed clients at 90 fps", mixed, kCameraFps, scene);
+    run("Mixed clients flat out", mixed, 0.0, scene);
+
+    for (int count : {1, 4, 8}) {
+        std::vector<ClientSpec> raw(count, ClientSpec{"raw", 1, RecordCodec::Raw, 0});
+        std::string title = std::to_string(count) + " raw clients flat out";
+        run(title.c_str(), raw, 0.0, scene);
+    }
+    return 0;
+}
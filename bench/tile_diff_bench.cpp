@@ -0,0 +1,233 @@
+// Dirty-tile detection and delta frames on mostly static depth streams.
+//
+// Three 848x480 streams of kFrames frames:
+//
+//   static     a slanted wall and a floor, with a box sliding across
+//   noisy      the same with every valid pixel off by up to 3, like a sensor
+//   simulated  SimulatedDevice's sweeping sphere, whose random dropouts move
+//              every frame and so touch every tile: the worst case
+//
+// For each, at tile thresholds 0 and 8 (noise of 3 either way can put two
+// frames 6 apart): TileDiff's time per frame at each SIMD level (the
+// fastest of kRounds passes; every level's masks must match the scalar
+// ones), the share of tiles dirty, which is what is left of a texture
+// upload, and the KB per frame of a delta stream with a keyframe every
+// kKeyframeInterval frames, raw and lossless, against sending every frame
+// whole. Each delta stream is decoded again and must come out within the
+// threshold of the source.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "delta_codec.hpp"
+#include "depth_codec.hpp"
+#include "logger.hpp"
+#include "simulated_device.hpp"
+#include "tile_diff.hpp"
+
+namespace {
+
+constexpr int kWidth = 848;
+constexpr int kHeight = 480;
+constexpr int kFrames = 60;
+constexpr int kRounds = 5;
+constexpr int kKeyframeInterval = 30;
+constexpr size_t kFrameBytes = static_cast<size_t>(kWidth) * kHeight * sizeof(uint16_t);
+
+using Clock = std::chrono::steady_clock;
+using Stream = std::vector<std::vector<uint16_t>>;
+
+Stream make_scene(bool noise) {
+    std::mt19937 random(7);
+    std::uniform_int_distribution<int> jitter(-3, 3);
+    Stream frames(kFrames);
+    for (int f = 0; f < kFrames; f++) {
+        std::vector<uint16_t>& frame = frames[f];
+        frame.resize(static_cast<size_t>(kWidth) * kHeight);
+        int box_x = 60 + f * 8;
+        for (int y = 0; y < kHeight; y++) {
+            for (int x = 0; x < kWidth; x++) {
+                int depth = y < 360 ? 3000 + x : 1500 + (kHeight - 1 - y) * 12;
+                if (x >= box_x && x < box_x + 120 && y >= 200 && y < 320) {
+                    depth = 1200;
+                }
+                if (x < kWidth / 16) {
+                    depth = 0;
+                } else if (noise) {
+                    depth += jitter(random);
+                }
+                frame[static_cast<size_t>(y) * kWidth + x] = static_cast<uint16_t>(depth);
+            }
+        }
+    }
+    return frames;
+}
+
+Stream record_simulated() {
+    SimulatedDevice::Config config;
+    config.width = kWidth;
+    config.height = kHeight;
+    config.fps = 0.0;
+    SimulatedDevice device(config);
+
+    Stream frames;
+    std::vector<uint8_t> buffer(device.max_payload_size());
+    while (frames.size() < kFrames) {
+        size_t length = device.read_payload(buffer.data(), buffer.size());
+        size_t header = buffer[0];
+        if (length - header != device.frame_size()) {
+            continue;
+        }
+        std::vector<uint16_t> frame(device.frame_size() / sizeof(uint16_t));
+        memcpy(frame.data(), buffer.data() + header, device.frame_size());
+        frames.push_back(std::move(frame));
+    }
+    return frames;
+}
+
+// Microseconds per frame, fastest pass; masks and dirty tiles of the last
+double time_diff(const Stream& frames, SimdLevel level, uint16_t threshold, std::vector<std::vector<uint8_t>>& masks,
+                 size_t& dirty) {
+    TileDiff diff;
+    diff.set_simd_level(level);
+    diff.set_threshold(threshold);
+    diff.configure(kWidth, kHeight);
+    masks.assign(frames.size(), {});
+    double best = 1e30;
+    for (int round = 0; round < kRounds; round++) {
+        // Each pass starts from the last frame, as if the stream looped
+        diff.set_reference(frames.back().data());
+        dirty = 0;
+        auto start = Clock::now();
+        for (size_t f = 0; f < frames.size(); f++) {
+            dirty += diff.update(frames[f].data(), masks[f]);
+        }
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / frames.size();
+        best = std::min(best, us);
+    }
+    return best;
+}
+
+struct DeltaResult {
+    double kb_per_frame = 0.0;
+    double whole_kb_per_frame = 0.0;
+    int max_error = 0;
+    bool decoded = true;
+};
+
+DeltaResult run_deltas(const Stream& frames, RecordCodec codec, uint16_t threshold) {
+    DeltaEncoder::Config config;
+    config.keyframe_interval = kKeyframeInterval;
+    config.threshold = threshold;
+    DeltaEncoder encoder(config);
+    encoder.configure(kWidth, kHeight);
+    DepthCodec sender_codec;
+    DepthCodec receiver_codec;
+    DeltaDecoder decoder;
+    std::vector<uint8_t> payload;
+    std::vector<uint8_t> whole;
+    std::vector<uint16_t> image(static_cast<size_t>(kWidth) * kHeight);
+
+    DeltaResult result;
+    size_t bytes = 0;
+    size_t whole_bytes = 0;
+    for (const std::vector<uint16_t>& frame : frames) {
+        size_t frame_whole = kFrameBytes;
+        if (codec == RecordCodec::Lossless) {
+            frame_whole = sender_codec.encode(frame.data(), kWidth, kHeight, whole);
+        }
+        whole_bytes += frame_whole;
+
+        if (encoder.update(frame.data())) {
+            size_t size = encoder.write_delta(codec, sender_codec, payload);
+            bytes += size;
+            result.decoded &= decoder.apply(payload.data(), size, codec, receiver_codec, image.data(), kWidth, kHeight);
+        } else {
+            bytes += frame_whole;
+            if (codec == RecordCodec::Raw) {
+                image = frame;
+            } else {
+                result.decoded &= receiver_codec.decode(whole.data(), frame_whole, image.data(), kWidth, kHeight);
+            }
+        }
+        for (size_t i = 0; i < image.size(); i++) {
+            result.max_error = std::max(result.max_error, std::abs(image[i] - frame[i]));
+        }
+    }
+    result.kb_per_frame = bytes / 1024.0 / frames.size();
+    result.whole_kb_per_frame = whole_bytes / 1024.0 / frames.size();
+    return result;
+}
+
+}  // namespace
+
+int main() {
+    Logger::instance().set_level(LogLevel::Warn);
+
+    struct Scene {
+        const char* name;
+        Stream frames;
+    };
+    Scene scenes[] = {
+        {"static", make_scene(false)},
+        {"noisy", make_scene(true)},
+        {"simulated", record_simulated()},
+    };
+    const SimdLevel levels[] = {SimdLevel::Scalar, SimdLevel::Sse41, SimdLevel::Avx2};
+    const uint16_t thresholds[] = {0, 8};
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << kWidth << "x" << kHeight << ", " << TileDiff::TILE_SIZE << "x" << TileDiff::TILE_SIZE
+              << " tiles, keyframe every " << kKeyframeInterval << " frames; diff in us per frame, streams in KB "
+              << "per frame" << std::endl;
+    std::cout << std::setw(10) << "scene" << std::setw(5) << "thr";
+    for (SimdLevel level : levels) {
+        std::cout << std::setw(9) << CpuFeatures::name(level);
+    }
+    std::cout << std::setw(8) << "dirty%" << std::setw(8) << "raw" << std::setw(8) << "delta" << std::setw(10)
+              << "lossless" << std::setw(8) << "delta" << std::setw(8) << "error" << std::endl;
+
+    bool ok = true;
+    for (const Scene& scene : scenes) {
+        for (uint16_t threshold : thresholds) {
+            std::cout << std::setw(10) << scene.name << std::setw(5) << threshold;
+            std::vector<std::vector<uint8_t>> scalar_masks;
+            size_t dirty = 0;
+            for (SimdLevel level : levels) {
+                if (CpuFeatures::clamp(level) != level) {
+                    std::cout << std::setw(9) << "-";
+                    continue;
+                }
+                std::vector<std::vector<uint8_t>> masks;
+                double us = time_diff(scene.frames, level, threshold, masks, dirty);
+                std::cout << std::setw(9) << us;
+                if (level == SimdLevel::Scalar) {
+                    scalar_masks = masks;
+                } else if (masks != scalar_masks) {
+                    std::cout << " MASK MISMATCH";
+                    ok = false;
+                }
+            }
+            size_t tiles = static_cast<size_t>((kWidth + TileDiff::TILE_SIZE - 1) / TileDiff::TILE_SIZE) *
+                           ((kHeight + TileDiff::TILE_SIZE - 1) / TileDiff::TILE_SIZE) * scene.frames.size();
+            std::cout << std::setw(8) << 100.0 * dirty / tiles;
+
+            DeltaResult raw = run_deltas(scene.frames, RecordCodec::Raw, threshold);
+            DeltaResult lossless = run_deltas(scene.frames, RecordCodec::Lossless, threshold);
+            std::cout << std::setw(8) << raw.whole_kb_per_frame << std::setw(8) << raw.kb_per_frame << std::setw(10)
+                      << lossless.whole_kb_per_frame << std::setw(8) << lossless.kb_per_frame << std::setw(8)
+                      << std::max(raw.max_error, lossless.max_error);
+            if (!raw.decoded || !lossless.decoded || raw.max_error > threshold || lossless.max_error > threshold) {
+                std::cout << " DECODE MISMATCH";
+                ok = false;
+            }
+            std::cout << std::endl;
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,299 @@
+// TSDF fusion throughput and surface accuracy.
+//
+// Renders kFrames 848x480 depth frames of a synthetic room (floor, three
+// walls, a sphere and a box) from a camera sweeping a quarter circle
+// around it, with sensor-like noise of up to kNoise mm, and fuses them
+// into a TsdfVolume on one thread and on the whole pool. Reports frames
+// fused per second, blocks touched per frame and pool size.
+//
+// After each frame only the changed blocks are extracted, into points
+// kept per block as a consumer would, and every kFullEvery frames the
+// whole volume too, for the cost of doing it the simple way. At the end
+// the kept points must cover the blocks a full extraction finds, and lie
+// within kMaxMeanError of the true surfaces on average.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <tuple>
+#include <vector>
+#include "logger.hpp"
+#include "tsdf_volume.hpp"
+
+namespace {
+
+constexpr int kWidth = 848;
+constexpr int kHeight = 480;
+constexpr int kFrames = 90;
+constexpr int kNoise = 2;
+constexpr int kFullEvery = 10;
+constexpr float kMaxMeanError = 0.004f;
+
+using Clock = std::chrono::steady_clock;
+using Stream = std::vector<std::vector<uint16_t>>;
+
+// The room, world y down, metres
+constexpr float kFloorY = 1.0f;
+constexpr float kBackZ = 3.5f;
+constexpr float kSideX = 2.5f;
+const float kSphere[3] = {0.0f, 0.6f, 2.0f};
+constexpr float kSphereRadius = 0.4f;
+const float kBoxMin[3] = {0.6f, 0.6f, 1.5f};
+const float kBoxMax[3] = {1.0f, 1.0f, 1.9f};
+
+// Distance along direction from origin to the nearest surface, or 0
+float trace(const float origin[3], const float direction[3]) {
+    float nearest = 1e30f;
+    auto plane = [&](int axis, float value) {
+        if (std::fabs(direction[axis]) > 1e-6f) {
+            float t = (value - origin[axis]) / direction[axis];
+            if (t > 0.0f) {
+                nearest = std::min(nearest, t);
+            }
+        }
+    };
+    plane(1, kFloorY);
+    plane(2, kBackZ);
+    plane(0, -kSideX);
+    plane(0, kSideX);
+
+    float offset[3] = {origin[0] - kSphere[0], origin[1] - kSphere[1], origin[2] - kSphere[2]};
+    float a = direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2];
+    float b = offset[0] * direction[0] + offset[1] * direction[1] + offset[2] * direction[2];
+    float c = offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2] - kSphereRadius * kSphereRadius;
+    float discriminant = b * b - a * c;
+    if (discriminant >= 0.0f) {
+        float t = (-b - std::sqrt(discriminant)) / a;
+        if (t > 0.0f) {
+            nearest = std::min(nearest, t);
+        }
+    }
+
+    float enter = 0.0f;
+    float leave = 1e30f;
+    for (int axis = 0; axis < 3; axis++) {
+        float t0 = (kBoxMin[axis] - origin[axis]) / direction[axis];
+        float t1 = (kBoxMax[axis] - origin[axis]) / direction[axis];
+        enter = std::max(enter, std::min(t0, t1));
+        leave = std::min(leave, std::max(t0, t1));
+    }
+    if (enter < leave && enter > 0.0f) {
+        nearest = std::min(nearest, enter);
+    }
+    return nearest < 1e30f ? nearest : 0.0f;
+}
+
+// Distance from p to the nearest surface of the room
+float surface_distance(float x, float y, float z) {
+    float distance = std::min({std::fabs(y - kFloorY), std::fabs(z - kBackZ), std::fabs(x + kSideX),
+                               std::fabs(x - kSideX)});
+    float dx = x - kSphere[0];
+    float dy = y - kSphere[1];
+    float dz = z - kSphere[2];
+    distance = std::min(distance, std::fabs(std::sqrt(dx * dx + dy * dy + dz * dz) - kSphereRadius));
+
+    float p[3] = {x, y, z};
+    float outside = 0.0f;
+    float inside = -1e30f;
+    for (int axis = 0; axis < 3; axis++) {
+        float d = std::max(kBoxMin[axis] - p[axis], p[axis] - kBoxMax[axis]);
+        outside += std::max(d, 0.0f) * std::max(d, 0.0f);
+        inside = std::max(inside, d);
+    }
+    float box = inside > 0.0f ? std::sqrt(outside) : -inside;
+    return std::min(distance, box);
+}
+
+std::vector<CameraPose> make_poses() {
+    std::vector<CameraPose> poses;
+    const float target[3] = {0.0f, 0.5f, 2.2f};
+    for (int f = 0; f < kFrames; f++) {
+        float angle = (-45.0f + 90.0f * f / (kFrames - 1)) * 3.14159265f / 180.0f;
+        float eye[3] = {target[0] + 1.6f * std::sin(angle), -0.2f, target[2] - 1.6f * std::cos(angle)};
+        poses.push_back(CameraPose::look_at(eye, target));
+    }
+    return poses;
+}
+
+Stream render(const CameraIntrinsics& intrinsics, const std::vector<CameraPose>& poses) {
+    std::mt19937 random(11);
+    std::uniform_int_distribution<int> noise(-kNoise, kNoise);
+    Stream frames;
+    for (const CameraPose& pose : poses) {
+        std::vector<uint16_t> frame(static_cast<size_t>(kWidth) * kHeight);
+        for (int v = 0; v < kHeight; v++) {
+            for (int u = 0; u < kWidth; u++) {
+                float ray[3] = {(u - intrinsics.ppx) / intrinsics.fx, (v - intrinsics.ppy) / intrinsics.fy, 1.0f};
+                float direction[3];
+                for (int i = 0; i < 3; i++) {
+                    direction[i] = pose.rotation[i * 3 + 0] * ray[0] + pose.rotation[i * 3 + 1] * ray[1] +
+                                   pose.rotation[i * 3 + 2] * ray[2];
+                }
+                // With the ray's camera z at 1, the distance along it is depth
+                float depth_mm = trace(pose.translation, direction) * 1000.0f;
+                if (depth_mm > 0.0f && depth_mm < 65000.0f) {
+                    frame[static_cast<size_t>(v) * kWidth + u] =
+                        static_cast<uint16_t>(std::max(1, static_cast<int>(std::lround(depth_mm)) + noise(random)));
+                }
+            }
+        }
+        frames.push_back(std::move(frame));
+    }
+    return frames;
+}
+
+struct Coord {
+    int32_t x;
+    int32_t y;
+    int32_t z;
+    bool operator<(const Coord& other) const {
+        return std::tie(x, y, z) < std::tie(other.x, other.y, other.z);
+    }
+};
+
+using PointMap = std::map<Coord, std::vector<float>>;
+
+// Replaces the points of the blocks in points, as a consumer would
+void keep_points(const TsdfVolume::SurfacePoints& points, PointMap& map) {
+    for (size_t i = 0; i < points.blocks.size(); i++) {
+        const TsdfVolume::BlockCoord& block = points.blocks[i];
+        std::vector<float>& kept = map[Coord{block.x, block.y, block.z}];
+        kept.clear();
+        for (uint32_t p = points.offsets[i]; p < points.offsets[i + 1]; p++) {
+            kept.push_back(points.x[p]);
+            kept.push_back(points.y[p]);
+            kept.push_back(points.z[p]);
+        }
+    }
+}
+
+struct Result {
+    double fps = 0.0;
+    double blocks_per_frame = 0.0;
+    TsdfVolume::Stats stats;
+    double incremental_ms = 0.0;
+    double incremental_blocks = 0.0;
+    double full_ms = 0.0;
+    double full_blocks = 0.0;
+    PointMap kept;
+    TsdfVolume::SurfacePoints full;
+};
+
+Result run(const CameraIntrinsics& intrinsics, const std::vector<CameraPose>& poses, const Stream& frames,
+           ThreadPool& pool) {
+    TsdfVolume::Config config;
+    config.pool = &pool;
+    TsdfVolume volume(intrinsics, config);
+    Result result;
+    TsdfVolume::SurfacePoints points;
+    int full_runs = 0;
+    double integrate_s = 0.0;
+    double incremental_s = 0.0;
+    double full_s = 0.0;
+    for (size_t f = 0; f < frames.size(); f++) {
+        auto start = Clock::now();
+        volume.integrate(frames[f].data(), poses[f]);
+        auto integrated = Clock::now();
+        volume.extract(points);
+        auto extracted = Clock::now();
+        integrate_s += std::chrono::duration<double>(integrated - start).count();
+        incremental_s += std::chrono::duration<double>(extracted - integrated).count();
+        result.blocks_per_frame += volume.stats().last_blocks;
+        result.incremental_blocks += points.blocks.size();
+        keep_points(points, result.kept);
+
+        if ((f + 1) % kFullEvery == 0 || f + 1 == frames.size()) {
+            start = Clock::now();
+            volume.extract(result.full, false);
+            full_s += std::chrono::duration<double>(Clock::now() - start).count();
+            result.full_blocks += result.full.blocks.size();
+            full_runs++;
+        }
+    }
+    result.fps = frames.size() / integrate_s;
+    result.blocks_per_frame /= frames.size();
+    result.incremental_ms = incremental_s * 1e3 / frames.size();
+    result.incremental_blocks /= frames.size();
+    result.full_ms = full_s * 1e3 / full_runs;
+    result.full_blocks /= full_runs;
+    result.stats = volume.stats();
+    return result;
+}
+
+// Mean and largest distance of the kept points from the room's surfaces;
+// false if a block with surface in the full extraction is missing from them
+bool check(const Result& result, double& mean_error, double& max_error, size_t& count) {
+    bool complete = true;
+    for (size_t i = 0; i < result.full.blocks.size(); i++) {
+        const TsdfVolume::BlockCoord& block = result.full.blocks[i];
+        auto kept = result.kept.find(Coord{block.x, block.y, block.z});
+        if (result.full.offsets[i + 1] > result.full.offsets[i] && (kept == result.kept.end() || kept->second.empty())) {
+            complete = false;
+        }
+    }
+
+    double sum = 0.0;
+    max_error = 0.0;
+    count = 0;
+    for (const auto& block : result.kept) {
+        const std::vector<float>& p = block.second;
+        for (size_t i = 0; i < p.size(); i += 3) {
+            double error = surface_distance(p[i], p[i + 1], p[i + 2]);
+            sum += error;
+            max_error = std::max(max_error, error);
+            count++;
+        }
+    }
+    mean_error = count > 0 ? sum / count : 0.0;
+    return complete;
+}
+
+}  // namespace
+
+int main() {
+    Logger::instance().set_level(LogLevel::Warn);
+
+    CameraIntrinsics intrinsics = CameraIntrinsics::nominal(kWidth, kHeight);
+    std::vector<CameraPose> poses = make_poses();
+    Stream frames = render(intrinsics, poses);
+
+    TsdfVolume::Config defaults;
+    ThreadPool single(1);
+    ThreadPool& shared = ThreadPool::shared();
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << kWidth << "x" << kHeight << ", " << kFrames << " frames, voxel " << defaults.voxel_size * 1e3
+              << " mm, truncation " << defaults.truncation * 1e3 << " mm, " << TsdfVolume::BLOCK_SIZE << "^3 blocks"
+              << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(9) << "fps" << std::setw(12) << "blocks/fr" << std::setw(9)
+              << "blocks" << std::setw(9) << "pool MB" << std::setw(14) << "changed ms" << std::setw(12)
+              << "changed bl" << std::setw(11) << "full ms" << std::setw(10) << "full bl" << std::setw(11)
+              << "mean mm" << std::setw(10) << "max mm" << std::endl;
+
+    bool ok = true;
+    for (ThreadPool* pool : {&single, &shared}) {
+        Result result = run(intrinsics, poses, frames, *pool);
+        double mean_error = 0.0;
+        double max_error = 0.0;
+        size_t count = 0;
+        bool complete = check(result, mean_error, max_error, count);
+        std::cout << std::setw(8) << pool->size() << std::setw(9) << result.fps << std::setw(12)
+                  << result.blocks_per_frame << std::setw(9) << result.stats.blocks << std::setw(9)
+                  << result.stats.memory_bytes / 1048576.0 << std::setw(14) << result.incremental_ms << std::setw(12)
+                  << result.incremental_blocks << std::setw(11) << result.full_ms << std::setw(10)
+                  << result.full_blocks << std::setw(11) << mean_error * 1e3 << std::setw(10) << max_error * 1e3;
+        if (!complete) {
+            std::cout << " INCOMPLETE";
+            ok = false;
+        }
+        if (count == 0 || mean_error > kMaxMeanError || result.stats.blocks_dropped > 0) {
+            std::cout << " INACCURATE";
+            ok = false;
+        }
+        std::cout << std::endl;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+// UVC payload parser throughput on bulk-transfer data.
+//
+// Pre-records a payload stream from SimulatedDevice for several payload
+// sizes, then times the parser alone (header decode and frame tracking, in
+// millions of payloads/s) and the parser plus gathering the pixel data into
+// a frame buffer (GB/s). Runs with
+// lost or short payloads also check that every frame the parser reports
+// complete holds exactly the pixels the device sent for it.
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "simulated_device.hpp"
+#include "uvc_payload_parser.hpp"
+
+namespace {
+
+constexpr int kWidth = 640;
+constexpr int kHeight = 480;
+constexpr int kFrames = 32;
+constexpr int kPasses = 20;
+
+// Keeps the gathered frames observable so the copies are not optimized out
+volatile uint64_t benchmark_sink = 0;
+
+struct Stream {
+    std::vector<uint8_t> bytes;
+    std::vector<std::pair<size_t, size_t>> payloads;  // offset, length
+    std::vector<uint64_t> frame_index;                // Per payload: the frame it belongs to
+};
+
+SimulatedDevice::Config device_config(size_t payload_size, double loss, double short_payload) {
+    SimulatedDevice::Config config;
+    config.width = kWidth;
+    config.height = kHeight;
+    config.fps = 0.0;
+    config.payload_size = payload_size;
+    config.payload_loss = loss;
+    config.short_payload = short_payload;
+    return config;
+}
+
+Stream record(size_t payload_size, double loss, double short_payload) {
+    SimulatedDevice device(device_config(payload_size, loss, short_payload));
+
+    Stream stream;
+    std::vector<uint8_t> buffer(device.max_payload_size());
+    while (device.frames_generated() < kFrames) {
+        size_t length = device.read_payload(buffer.data(), buffer.size());
+        stream.payloads.emplace_back(stream.bytes.size(), length);
+        stream.bytes.insert(stream.bytes.end(), buffer.begin(), buffer.begin() + length);
+        // The device counts a frame as generated once its last payload is out
+        UvcPayloadHeader header;
+        bool end_of_frame = UvcPayloadParser::parse_header(buffer.data(), length, header) && header.end_of_frame;
+        stream.frame_index.push_back(device.frames_generated() - (end_of_frame ? 1 : 0));
+    }
+    return stream;
+}
+
+// Every frame the device sends, lossless and whole, indexed by frame number
+std::vector<std::vector<uint8_t>> reference_frames() {
+    SimulatedDevice device(device_config(0, 0.0, 0.0));
+    std::vector<std::vector<uint8_t>> frames;
+    std::vector<uint8_t> buffer(device.max_payload_size());
+    while (device.frames_generated() < kFrames) {
+        size_t length = device.read_payload(buffer.data(), buffer.size());
+        UvcPayloadHeader header;
+        UvcPayloadParser::parse_header(buffer.data(), length, header);
+        frames.emplace_back(buffer.begin() + header.length, buffer.begin() + length);
+    }
+    return frames;
+}
+
+// Frames reported complete whose pixels differ from what the device sent
+uint64_t count_corrupt(const Stream& stream, size_t frame_size) {
+    static const std::vector<std::vector<uint8_t>> reference = reference_frames();
+    std::vector<uint8_t> frame(frame_size);
+    UvcPayloadParser parser(frame_size);
+    uint64_t corrupt = 0;
+    for (size_t i = 0; i < stream.payloads.size(); i++) {
+        const auto& p = stream.payloads[i];
+        UvcPayloadParser::Result result = parser.parse(stream.bytes.data() + p.first, p.second);
+        if (result.accepted) {
+            memcpy(frame.data() + result.offset, result.data, result.length);
+        }
+        if (result.frame_end == UvcPayloadParser::FrameEnd::Complete && frame != reference[stream.frame_index[i]]) {
+            corrupt++;
+        }
+    }
+    return corrupt;
+}
+
+bool run(const char* label, size_t payload_size, double loss, double short_payload) {
+    Stream stream = record(payload_size, loss, short_payload);
+    const size_t frame_size = static_cast<size_t>(kWidth) * kHeight * sizeof(uint16_t);
+    std::vector<uint8_t> frame(frame_size);
+
+    // Parse only
+    auto start = std::chrono::steady_clock::now();
+    UvcPayloadParser parser(frame_size);
+    for (int pass = 0; pass < kPasses; pass++) {
+        for (const auto& p : stream.payloads) {
+            parser.parse(stream.bytes.data() + p.first, p.second);
+        }
+    }
+    double parse_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Parse and gather
+    start = std::chrono::steady_clock::now();
+    UvcPayloadParser assembler(frame_size);
+    uint64_t checksum = 0;
+    for (int pass = 0; pass < kPasses; pass++) {
+        for (const auto& p : stream.payloads) {
+            UvcPayloadParser::Result result = assembler.parse(stream.bytes.data() + p.first, p.second);
+            if (result.accepted) {
+                memcpy(frame.data() + result.offset, result.data, result.length);
+            }
+            if (result.frame_end == UvcPayloadParser::FrameEnd::Complete) {
+                checksum += frame[frame_size / 2];
+            }
+        }
+    }
+    double gather_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t corrupt = loss > 0.0 || short_payload > 0.0 ? count_corrupt(stream, frame_size) : 0;
+
+    // Parsing reads only the headers, so its rate is in payloads; gathering touches every byte
+    double total_payloads = static_cast<double>(stream.payloads.size()) * kPasses;
+    double total_bytes = static_cast<double>(stream.bytes.size()) * kPasses;
+    const UvcPayloadParser::Stats& stats = assembler.stats();
+    std::cout << std::setw(22) << label
+              << std::setw(10) << stream.payloads.size() / kFrames
+              << std::setw(12) << total_payloads / parse_seconds / 1e6
+              << std::setw(12) << total_bytes / gather_seconds / 1e9
+              << std::setw(10) << stats.frames
+              << std::setw(8) << stats.torn_frames
+              << std::setw(9) << corrupt << std::endl;
+    benchmark_sink = checksum;
+    return corrupt == 0;
+}
+
+}  // namespace
+
+int main() {
+    std::cout << std::setw(22) << "stream" << std::setw(10) << "pl/frame"
+              << std::setw(12) << "parse Mpl/s" << std::setw(12) << "+copy GB/s"
+              << std::setw(10) << "frames" << std::setw(8) << "torn" << std::setw(9) << "corrupt" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+
+    bool ok = run("whole-frame payloads", 0, 0.0, 0.0);
+    ok = run("32 KB payloads", 32 * 1024, 0.0, 0.0) && ok;
+    ok = run("16 KB payloads", 16 * 1024, 0.0, 0.0) && ok;
+    ok = run("2 KB payloads", 2 * 1024, 0.0, 0.0) && ok;
+    ok = run("16 KB, 0.5% loss/short", 16 * 1024, 0.005, 0.005) && ok;
+    ok = run("2 KB, 0.1% loss", 2 * 1024, 0.001, 0.0) && ok;
+    return ok ? 0 : 1;
+}
@@ -1,26 +0,0 @@
-
-# Consider dependencies only in project.
-set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
-
-# The set of languages for which implicit dependencies are needed:
-set(CMAKE_DEPENDS_LANGUAGES
-  )
-
-# The set of dependency files which are needed:
-set(CMAKE_DEPENDS_DEPENDENCY_FILES
-  "/Users/zachrizzo/programing/realsesnse_2 _river_custom/src/camera_device.cpp" "CMakeFiles/realsense_driver.dir/src/camera_device.cpp.o" "gcc" "CMakeFiles/realsense_driver.dir/src/camera_device.cpp.o.d"
-  "/Users/zachrizzo/programing/realsesnse_2 _river_custom/src/main.cpp" "CMakeFiles/realsense_driver.dir/src/main.cpp.o" "gcc" "CMakeFiles/realsense_driver.dir/src/main.cpp.o.d"
-  "/Users/zachrizzo/programing/realsesnse_2 _river_custom/src/usb_controller.cpp" "CMakeFiles/realsense_driver.dir/src/usb_controller.cpp.o" "gcc" "CMakeFiles/realsense_driver.dir/src/usb_controller.cpp.o.d"
-  "/Users/zachrizzo/programing/realsesnse_2 _river_custom/src/visualizer.cpp" "CMakeFiles/realsense_driver.dir/src/visualizer.cpp.o" "gcc" "CMakeFiles/realsense_driver.dir/src/visualizer.cpp.o.d"
-  )
-
-# Targets to which this target links which contain Fortran sources.
-set(CMAKE_Fortran_TARGET_LINKED_INFO_FILES
-  )
-
-# Targets to which this target links which contain Fortran sources.
-set(CMAKE_Fortran_TARGET_FORWARD_LINKED_INFO_FILES
-  )
-
-# Fortran module output directory.
-set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -1,17 +0,0 @@
-file(REMOVE_RECURSE
-  "CMakeFiles/realsense_driver.dir/src/camera_device.cpp.o"
-  "CMakeFiles/realsense_driver.dir/src/camera_device.cpp.o.d"
-  "CMakeFiles/realsense_driver.dir/src/main.cpp.o"
-  "CMakeFiles/realsense_driver.dir/src/main.cpp.o.d"
-  "CMakeFiles/realsense_driver.dir/src/usb_controller.cpp.o"
-  "CMakeFiles/realsense_driver.dir/src/usb_controller.cpp.o.d"
-  "CMakeFiles/realsense_driver.dir/src/visualizer.cpp.o"
-  "CMakeFiles/realsense_driver.dir/src/visualizer.cpp.o.d"
-  "realsense_driver"
-  "realsense_driver.pdb"
-)
-
-# Per-language clean rules from dependency scanning.
-foreach(lang CXX)
-  include(CMakeFiles/realsense_driver.dir/cmake_clean_${lang}.cmake OPTIONAL)
-endforeach()
@@ -0,0 +1,59 @@
+// Minimal client of the shared-memory frame ring: follows the frames the
+// driver publishes with --publish and prints, once a second, the frame
+// rate, the depth at the image centre, how far behind it is and what it
+// missed. Links only the client library, not the driver.
+//
+// Usage: depth_subscriber [SHM_NAME] [--latest]
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "frame_subscriber.hpp"
+
+int main(int argc, char** argv) {
+    FrameSubscriber::Config config;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--latest") {
+            config.latest_only = true;
+        } else {
+            config.name = arg;
+        }
+    }
+
+    FrameSubscriber subscriber(config);
+    while (!subscriber.open()) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    std::cout << "Following " << config.name << ", " << subscriber.width() << "x" << subscriber.height()
+              << std::endl;
+
+    auto report_start = std::chrono::steady_clock::now();
+    uint64_t frames = 0;
+    uint16_t center = 0;
+    FrameSubscriber::FrameView view;
+    for (;;) {
+        if (subscriber.next(view, 1000)) {
+            uint16_t depth = view.depth[(view.height / 2) * view.width + view.width / 2];
+            if (subscriber.release(view)) {
+                center = depth;
+                frames++;
+            }
+        } else if (subscriber.publisher_closed()) {
+            std::cout << "Publisher closed, waiting for a new one" << std::endl;
+            while (!subscriber.open()) {
+                std::this_thread::sleep_for(std::chrono::seconds(1));
+            }
+        }
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - report_start).count();
+        if (elapsed >= 1.0) {
+            FrameSubscriber::Stats stats = subscriber.stats();
+            std::cout << frames / elapsed << " fps, centre " << center << " mm, " << stats.lag
+                      << " behind, skipped " << stats.skipped << ", torn " << stats.torn << std::endl;
+            report_start = std::chrono::steady_clock::now();
+            frames = 0;
+        }
+    }
+}
@@ -0,0 +1,84 @@
+// Minimal client of the TCP depth stream: connects to a driver started
+// with --serve and prints, once a second, the frame rate, bandwidth, the
+// depth at the image centre, how long frames waited in the server's queue
+// and how many it dropped for us. Reconnects if the server goes away.
+// With --delta the server sends only the tiles that changed between
+// keyframes, and the line also shows how many frames came that way.
+// Links only the client library, not the driver.
+//
+// Usage: stream_client [HOST] [--port N] [--decimate 1|2|4] [--lossless] [--delta] [--queue N]
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "stream_client.hpp"
+
+int main(int argc, char** argv) {
+    StreamClient::Config config;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--port" && has_value) {
+            config.port = std::stoi(argv[++i]);
+        } else if (arg == "--decimate" && has_value) {
+            config.decimation = std::stoi(argv[++i]);
+        } else if (arg == "--lossless") {
+            config.codec = RecordCodec::Lossless;
+        } else if (arg == "--delta") {
+            config.delta = true;
+        } else if (arg == "--queue" && has_value) {
+            config.queue_frames = std::stoi(argv[++i]);
+        } else if (arg[0] != '-') {
+            config.host = arg;
+        } else {
+            std::cout << "Usage: " << argv[0]
+                      << " [HOST] [--port N] [--decimate 1|2|4] [--lossless] [--delta] [--queue N]" << std::endl;
+            return arg == "--help" ? 0 : -1;
+        }
+    }
+
+    StreamClient client(config);
+    std::vector<uint16_t> depth;
+    StreamClient::FrameInfo info;
+    auto report_start = std::chrono::steady_clock::now();
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    uint64_t deltas = 0;
+    uint64_t sequence = 0;
+    double wait_ms = 0.0;
+    for (;;) {
+        if (!client.is_connected()) {
+            if (!client.connect()) {
+                std::this_thread::sleep_for(std::chrono::seconds(1));
+                continue;
+            }
+            std::cout << "Connected to " << config.host << ":" << config.port << std::endl;
+        }
+        if (client.receive(depth, info, 1000)) {
+            frames++;
+            bytes += info.wire_size;
+            deltas += info.delta;
+            sequence = info.sequence;
+            wait_ms += (info.queued_ns - info.timestamp_ns) / 1e6;
+        }
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - report_start).count();
+        if (elapsed >= 1.0) {
+            uint16_t center = depth.empty() ? 0 : depth[(info.height / 2) * info.width + info.width / 2];
+            std::cout << frames / elapsed << " fps, " << bytes / elapsed / 1e6 << " MB/s, " << info.width << "x"
+                      << info.height << ", centre " << center << " mm, frame " << sequence << ", queued after "
+                      << (frames > 0 ? wait_ms / frames : 0.0) << " ms, dropped " << info.dropped;
+            if (config.delta) {
+                std::cout << ", " << deltas << " deltas";
+            }
+            std::cout << std::endl;
+            report_start = std::chrono::steady_clock::now();
+            frames = 0;
+            bytes = 0;
+            deltas = 0;
+            wait_ms = 0.0;
+        }
+    }
+}
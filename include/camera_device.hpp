@@ -1,34 +1,152 @@
 #pragma once
 
-#include <libusb-1.0/libusb.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <memory>
-#include <vector>
-#include "usb_controller.hpp"
+#include <mutex>
+#include <string>
+#include <thread>
+#include "frame_assembler.hpp"
+#include "frame_mailbox.hpp"
+#include "frame_pool.hpp"
+#include "metrics.hpp"
+#include "stream_profile.hpp"
+#include "transport.hpp"
+#include "uvc_protocol.hpp"
 
 class CameraDevice {
 public:
-    static constexpr int DEFAULT_WIDTH = 640;
-    static constexpr int DEFAULT_HEIGHT = 480;
-    static constexpr size_t DEPTH_FRAME_SIZE = DEFAULT_WIDTH * DEFAULT_HEIGHT * sizeof(uint16_t);
+    static constexpr size_t FRAME_POOL_SIZE = 16;
+    // How long each reconnection attempt waits for the device to come back
+    static constexpr unsigned int RECONNECT_WAIT_MS = 250;
 
+    struct Stats {
+        uint64_t frames = 0;
+        uint64_t zero_copy_frames = 0;   // Published straight from the transfer buffer
+        uint64_t copied_bytes = 0;       // Bytes gathered from multi-payload frames
+        uint64_t dropped_frames = 0;     // No free buffer to assemble into
+        uint64_t torn_frames = 0;        // Lost, short or corrupt payloads
+        uint64_t invalid_payloads = 0;   // Payloads without a valid UVC header
+        uint64_t repeated_frames = 0;    // Identical to the frame before: a stuck sensor
+        uint64_t disconnects = 0;        // Times the device went away mid-stream
+        uint64_t reconnects = 0;         // Times streaming resumed afterwards
+        uint64_t first_frame_ns = 0;     // From initialize() to the first frame
+        uint64_t last_recovery_ns = 0;   // From the last disconnect to the next frame
+        uint64_t recovery_ns = 0;        // The same, summed over every recovery
+    };
+
+    // Uses a UsbTransport for the physical camera
     CameraDevice();
+    explicit CameraDevice(std::unique_ptr<Transport> transport);
     ~CameraDevice();
 
+    // How frames reach a consumer that falls behind. Set before streaming.
+    void set_delivery_policy(FrameMailbox::Policy policy);
+
+    // Sees every frame on the capture thread, before it reaches the mailbox,
+    // for consumers that must not lose frames to a slow reader: recording,
+    // publishing. It must not block, and must copy what it keeps, since the
+    // reader may filter the frame in place. Set before streaming.
+    using FrameTap = std::function<void(const Frame& frame)>;
+    void set_frame_tap(FrameTap tap);
+
+    // Names this camera in its metrics, as "<name>_frames_total" and so on,
+    // so several cameras in one process report separately. Set before
+    // streaming; unnamed cameras use the bare metric names.
+    void set_name(const std::string& name);
+    const std::string& name() const;
+    // Pins the transport's capture thread to a CPU. Set before streaming.
+    void set_cpu(int cpu);
+    // Runs the transport's capture thread SCHED_FIFO at priority, 1 to 99;
+    // 0, the default, leaves it on normal scheduling. Set before streaming.
+    void set_realtime_priority(int priority);
+    // Locks the frame pool, which the transfers read into, in RAM, backs it
+    // with huge pages and puts it on the capture CPU's NUMA node, as far as
+    // the process is allowed to (see FrameMemory). Set before streaming;
+    // memory handed to use_frame_memory() is taken as it is.
+    void set_frame_memory_options(const FrameMemory::Options& options);
+    // Whether to reopen the device and resume streaming when it goes away
+    // mid-stream, if the transport can. On by default. Set before streaming.
+    void set_auto_reconnect(bool enabled);
+
+    // The stream profile to ask the device for. Set before initialize(),
+    // which negotiates it; profile() is what the device agreed to from then
+    // on, and the size of every frame.
+    void set_profile(const StreamProfile& profile);
+    const StreamProfile& profile() const;
+
+    // Rebuilds the frame pool inside caller-owned memory, e.g. a mapped GL
+    // buffer, so transfers land where the renderer can upload from. The
+    // memory must outlive streaming. Set after initialize(), before
+    // streaming.
+    bool use_frame_memory(uint8_t* memory, size_t size);
+    size_t frame_memory_size() const;
+
     bool initialize();
     bool start_streaming();
     bool stop_streaming();
-    bool get_depth_frame(uint8_t* buffer, size_t buffer_size);
+    // The device was lost and is being waited for
+    bool is_recovering() const;
+
+    // Waits up to timeout_ms for the next frame; 0 polls. The frame's buffer
+    // goes back to the pool when the last handle to it is dropped; handles
+    // must not outlive the camera.
+    bool get_depth_frame(Frame& frame, unsigned int timeout_ms = 1000);
+
+    Stats stats() const;
+    FramePool::Stats pool_stats() const;
+    FrameMailbox::Stats mailbox_stats() const;
 
 private:
     bool send_init_sequence();
     bool configure_depth_stream();
+    // Each pool buffer holds one whole UVC payload (header + frame), rounded
+    // up to whole 1 KB packets, so a transfer can land in it directly.
+    size_t payload_buffer_size() const;
+    std::unique_ptr<FramePool> make_frame_pool() const;
+    void on_payload(Frame& payload);
+    void publish(Frame&& frame);
+    void register_metrics();
+    void on_device_lost();
+    void recovery_loop();
+
+    StreamProfile requested_profile_;
+    StreamProfile profile_;
+    int cpu_;
+    FrameMemory::Options memory_options_;
+    std::unique_ptr<FramePool> frame_pool_;
+    std::unique_ptr<FrameMailbox> mailbox_;
+    FrameTap frame_tap_;
+    std::unique_ptr<Transport> transport_;
+    std::atomic<bool> is_streaming_;
+
+    // Frames are assembled on the transport's event thread and handed to
+    // the consumer through mailbox_
+    FrameAssembler assembler_;
+    uint64_t sequence_;
+
+    // Reconnection runs on its own thread, woken when the transport reports
+    // the device gone
+    bool auto_reconnect_;
+    std::thread recovery_thread_;
+    std::mutex recovery_mutex_;
+    std::condition_variable recovery_cv_;
+    bool device_lost_;
+    std::atomic<bool> recovering_;
+    uint64_t lost_ns_;
+    std::atomic<uint64_t> startup_ns_;      // Set until the first frame arrives
 
-    std::unique_ptr<USBController> usb_controller_;
-    libusb_device_handle* device_handle_;
-    bool is_streaming_;
+    std::atomic<uint64_t> frames_;
+    std::atomic<uint64_t> disconnects_;
+    std::atomic<uint64_t> reconnects_;
+    std::atomic<uint64_t> first_frame_ns_;
+    std::atomic<uint64_t> last_recovery_ns_;
+    std::atomic<uint64_t> recovery_ns_;
 
-    // Interface and endpoint numbers (will be set during initialization)
-    uint8_t DEPTH_INTERFACE;
-    uint8_t CONTROL_INTERFACE;
-    uint8_t DEPTH_ENDPOINT_IN;
+    std::string name_;
+    std::string metrics_prefix_;
+    LatencyHistogram* assembly_latency_;
+    LatencyHistogram* delivery_latency_;
+    LatencyHistogram* recovery_latency_;
 };
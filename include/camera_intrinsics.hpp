@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cmath>
+
+// Pinhole model of the depth stream. D400 depth is rectified, so there is
+// no distortion to undo.
+struct CameraIntrinsics {
+    int width = 0;
+    int height = 0;
+    float fx = 0.0f;     // Focal length in pixels
+    float fy = 0.0f;
+    float ppx = 0.0f;    // Principal point
+    float ppy = 0.0f;
+
+    // Nominal D400 depth intrinsics (about 87 x 58 degrees) for when the
+    // device calibration has not been read.
+    static CameraIntrinsics nominal(int width, int height) {
+        CameraIntrinsics intrinsics;
+        intrinsics.width = width;
+        intrinsics.height = height;
+        intrinsics.fx = width / (2.0f * std::tan(87.0f * 3.14159265f / 360.0f));
+        intrinsics.fy = intrinsics.fx;
+        intrinsics.ppx = (width - 1) * 0.5f;
+        intrinsics.ppy = (height - 1) * 0.5f;
+        return intrinsics;
+    }
+};
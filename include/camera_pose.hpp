@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cmath>
+
+// Rigid camera-to-world transform: world = rotation * camera + translation,
+// in metres. Camera axes as in PointCloud (x right, y down, z forward); the
+// world frame is whatever the poses are given in.
+struct CameraPose {
+    float rotation[9] = {1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f};   // Row major
+    float translation[3] = {0.0f, 0.0f, 0.0f};
+
+    // Camera at eye looking at target, its y axis as close to world +y
+    // (down) as the view direction allows
+    static CameraPose look_at(const float eye[3], const float target[3]) {
+        float z[3] = {target[0] - eye[0], target[1] - eye[1], target[2] - eye[2]};
+        normalize(z);
+        // x = down cross z, with down = (0, 1, 0)
+        float x[3] = {z[2], 0.0f, -z[0]};
+        if (!normalize(x)) {
+            // Looking straight up or down
+            x[0] = 1.0f;
+            x[2] = 0.0f;
+        }
+        float y[3] = {z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0]};
+
+        CameraPose pose;
+        for (int row = 0; row < 3; row++) {
+            pose.rotation[row * 3 + 0] = x[row];
+            pose.rotation[row * 3 + 1] = y[row];
+            pose.rotation[row * 3 + 2] = z[row];
+            pose.translation[row] = eye[row];
+        }
+        return pose;
+    }
+
+    // The world-to-camera transform
+    CameraPose inverse() const {
+        CameraPose inverse;
+        for (int row = 0; row < 3; row++) {
+            for (int col = 0; col < 3; col++) {
+                inverse.rotation[row * 3 + col] = rotation[col * 3 + row];
+            }
+        }
+        for (int row = 0; row < 3; row++) {
+            inverse.translation[row] = -(inverse.rotation[row * 3 + 0] * translation[0] +
+                                         inverse.rotation[row * 3 + 1] * translation[1] +
+                                         inverse.rotation[row * 3 + 2] * translation[2]);
+        }
+        return inverse;
+    }
+
+    void transform(const float in[3], float out[3]) const {
+        for (int row = 0; row < 3; row++) {
+            out[row] = rotation[row * 3 + 0] * in[0] + rotation[row * 3 + 1] * in[1] + rotation[row * 3 + 2] * in[2] +
+                       translation[row];
+        }
+    }
+
+private:
+    static bool normalize(float v[3]) {
+        float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        if (length < 1e-6f) {
+            return false;
+        }
+        v[0] /= length;
+        v[1] /= length;
+        v[2] /= length;
+        return true;
+    }
+};
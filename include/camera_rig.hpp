@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "camera_device.hpp"
+#include "frame_synchronizer.hpp"
+
+// Several cameras streaming at once. Each camera keeps its own pipeline:
+// its transport's capture thread, frame pool and mailbox, plus a pipeline
+// thread here that takes its frames, runs the optional per-camera
+// processing and hands them to a FrameSynchronizer, from which next()
+// returns one time-aligned set of frames at a time. A camera's threads can
+// be pinned to a CPU of its own so cameras do not contend for a core.
+class CameraRig {
+public:
+    // Runs on the camera's pipeline thread; returning false drops the frame
+    using Processor = std::function<bool(size_t camera, Frame& frame)>;
+
+    struct Config {
+        uint64_t sync_tolerance_ns = 2000000;
+        size_t sync_queue_frames = 4;
+        // CPU for camera i's capture and pipeline threads is cpus[i], or
+        // cpus[i % size] when there are more cameras; empty pins nothing
+        std::vector<int> cpus;
+        Processor process;
+    };
+
+    struct CameraStats {
+        std::string name;
+        int cpu = -1;
+        uint64_t frames = 0;            // Handed to the synchronizer
+        uint64_t bytes = 0;
+        CameraDevice::Stats device;
+        FrameMailbox::Stats mailbox;
+    };
+
+    CameraRig();
+    explicit CameraRig(const Config& config);
+    ~CameraRig();
+
+    CameraRig(const CameraRig&) = delete;
+    CameraRig& operator=(const CameraRig&) = delete;
+
+    // Adds a camera before start(). Unnamed cameras are called cam0, cam1
+    // and so on, which prefixes their metric names.
+    void add_camera(std::unique_ptr<CameraDevice> camera);
+    // Adds the D435i cameras with these serial numbers or bus paths, or
+    // every one attached when selectors is empty
+    bool add_usb_cameras(const std::vector<std::string>& selectors);
+
+    bool start();
+    void stop();
+    bool is_running() const;
+
+    // Waits up to timeout_ms for the next set with a frame from every camera
+    bool next(FrameSynchronizer::FrameSet& set, unsigned int timeout_ms);
+
+    size_t size() const;
+    CameraDevice& camera(size_t index);
+    std::vector<CameraStats> camera_stats() const;
+    FrameSynchronizer::Stats sync_stats() const;
+
+private:
+    struct Pipeline {
+        std::unique_ptr<CameraDevice> camera;
+        int cpu = -1;
+        std::thread thread;
+        std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> bytes{0};
+    };
+
+    void pipeline_loop(size_t index);
+
+    Config config_;
+    std::vector<std::unique_ptr<Pipeline>> pipelines_;
+    std::unique_ptr<FrameSynchronizer> synchronizer_;
+    std::atomic<bool> running_;
+};
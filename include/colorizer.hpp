@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "cpu_features.hpp"
+
+// Turns Z16 depth into RGBA8 for recording, streaming or snapshots. Every
+// mapping (range clamp, colormap, equalization) is baked into a 65536-entry
+// table, so the per-pixel work is a single lookup. Zero depth means "no
+// data" and always maps to black.
+class Colorizer {
+public:
+    enum class Colormap { Grayscale, Jet, Turbo };
+
+    // How depth values are spread over the colormap:
+    //  Fixed     - near_depth..far_depth from the config
+    //  Auto      - tracks the valid min/max of each frame
+    //  Equalized - histogram equalization. The table applied to a frame is
+    //              built from the previous frame's histogram, which is
+    //              gathered in the same pass, so each frame is read once.
+    enum class RangeMode { Fixed, Auto, Equalized };
+
+    struct Config {
+        Colormap colormap = Colormap::Turbo;
+        RangeMode range = RangeMode::Fixed;
+        uint16_t near_depth = 300;    // Depth units (mm on D400); nearer clamps to the first colour
+        uint16_t far_depth = 4000;    // Farther clamps to the last colour
+    };
+
+    Colorizer();
+    explicit Colorizer(const Config& config);
+
+    void set_config(const Config& config);
+    const Config& config() const;
+
+    // Defaults to CpuFeatures::simd_level(); lowered to what the CPU supports.
+    void set_simd_level(SimdLevel level);
+    SimdLevel simd_level() const;
+    // Frames of the common profiles run kernels built for their size (see
+    // frame_shape.hpp). On by default; off is for comparing.
+    void set_specialized(bool specialized);
+    bool specialized() const;
+
+    // rgba must hold pixel_count * 4 bytes.
+    void colorize(const uint16_t* depth, size_t pixel_count, uint8_t* rgba);
+
+    // Number of times the lookup table has been rebuilt
+    uint64_t table_builds() const;
+
+    // Colormap value at t in [0, 1]; the GL shader uses the same formulas.
+    static void sample(Colormap colormap, float t, uint8_t rgb[3]);
+
+private:
+    static constexpr size_t TABLE_SIZE = 65536;
+    static constexpr int PALETTE_SIZE = 256;
+
+    void build_palette();
+    void build_linear_table(uint16_t near_depth, uint16_t far_depth);
+    void build_equalized_table();
+    void apply(const uint16_t* depth, size_t pixel_count, uint8_t* rgba, bool histogram);
+    void scan_range(const uint16_t* depth, size_t pixel_count, uint16_t& min_depth, uint16_t& max_depth) const;
+
+    Config config_;
+    SimdLevel simd_level_;
+    bool specialized_;
+
+    uint32_t palette_[PALETTE_SIZE];
+    std::vector<uint32_t> table_;
+    std::vector<uint32_t> histogram_;
+
+    // What the table currently encodes, to skip rebuilding it
+    bool table_linear_;
+    uint16_t table_near_;
+    uint16_t table_far_;
+    bool have_histogram_;
+    uint64_t table_builds_;
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+// SIMD kernels are compiled per function with target attributes and picked
+// at run time, so one binary runs everywhere and uses AVX2 where it exists.
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_X86 1
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CPU_X86 0
+#endif
+
+enum class SimdLevel { Scalar, Sse41, Avx2 };
+
+class CpuFeatures {
+public:
+    // Best level this CPU supports. The REALSENSE_SIMD environment variable
+    // (scalar, sse4.1 or avx2) caps it, which is handy for A/B runs.
+    static SimdLevel simd_level();
+    // Lowers level to what the CPU can actually run.
+    static SimdLevel clamp(SimdLevel level);
+    static const char* name(SimdLevel level);
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "depth_codec.hpp"
+#include "recording_format.hpp"
+#include "tile_diff.hpp"
+
+// Delta frames for the network stream: of a mostly static scene only the
+// tiles that changed are sent, against the frame before, with a whole
+// keyframe now and then so receivers that join or lose a frame catch up.
+// The payload of a delta frame (see stream_protocol.hpp) is a bitmap of
+// the dirty tiles, one bit per tile row by row, followed by the dirty
+// tiles' pixels: each tile a full TILE_SIZE x TILE_SIZE block, zero beyond
+// the image edges, one after another. With RecordCodec::Lossless those
+// blocks go as one DepthCodec image TILE_SIZE wide.
+//
+// The encoder runs on the sender. Each update() decides whether the frame
+// goes out as a keyframe or a delta; the delta's payload can then be
+// written in either codec, so receivers wanting raw and compressed frames
+// share one encoder.
+class DeltaEncoder {
+public:
+    struct Config {
+        int keyframe_interval = 30;     // Most frames from one keyframe to the next
+        uint16_t threshold = 0;         // Depth change a tile may skip; 0 keeps the stream exact
+    };
+
+    DeltaEncoder();
+    explicit DeltaEncoder(const Config& config);
+
+    DeltaEncoder(const DeltaEncoder&) = delete;
+    DeltaEncoder& operator=(const DeltaEncoder&) = delete;
+
+    // Size of the frames; the next one is a keyframe
+    void configure(int width, int height);
+    int width() const;
+    int height() const;
+
+    // A receiver lost track: a keyframe as soon as one is allowed. Forced
+    // keyframes come at most every MIN_KEYFRAME_GAP frames, so one slow
+    // receiver cannot turn the whole stream into keyframes.
+    void request_keyframe();
+
+    // Takes the next frame. Returns false if it goes out whole, as a
+    // keyframe, true if as a delta against the frame before, whose payload
+    // write_delta() then makes.
+    bool update(const uint16_t* depth);
+
+    size_t dirty_tiles() const;
+    size_t tile_count() const;
+    // Payload of the last delta. Returns its size.
+    size_t write_delta(RecordCodec codec, DepthCodec& depth_codec, std::vector<uint8_t>& out);
+
+private:
+    static constexpr int MIN_KEYFRAME_GAP = 4;
+
+    Config config_;
+    TileDiff diff_;
+    std::vector<uint8_t> mask_;
+    std::vector<uint16_t> tiles_;       // Dirty tiles of the last delta, packed
+    size_t dirty_;
+    int since_keyframe_;
+    bool keyframe_requested_;
+    std::vector<uint8_t> encoded_;
+};
+
+// Applies delta payloads on the receiver
+class DeltaDecoder {
+public:
+    // Number of bytes of the dirty-tile bitmap for a width x height image
+    static size_t mask_size(int width, int height);
+
+    // Brings image, the frame the delta was made against, up to date.
+    // Returns false if the payload is not a delta for an image that size.
+    bool apply(const uint8_t* data, size_t size, RecordCodec codec, DepthCodec& depth_codec, uint16_t* image,
+               int width, int height);
+
+private:
+    std::vector<uint16_t> tiles_;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "thread_pool.hpp"
+
+// Lossless compression for Z16 depth images. The image is cut into slices
+// of whole rows that are encoded and decoded independently, one ThreadPool
+// task each. Within a slice:
+//
+//   - zero (invalid) pixels are stored as run lengths of a valid/invalid
+//     mask, so holes and the invalid band cost a few bytes per run;
+//   - every valid pixel is predicted from its left, upper and upper-left
+//     neighbours (the LOCO-I median predictor), with invalid neighbours
+//     replaced by valid ones, and only the zigzagged residual is kept;
+//   - residuals go in groups of 16, either bit-packed at the width of the
+//     largest one or, with the entropy stage, Rice coded with a parameter
+//     that adapts to the running residual magnitude in four local-activity
+//     contexts, and a group of all zeros costs one bit.
+//
+// A slice that would come out larger than its raw pixels is stored raw.
+// encode() and decode() reuse buffers, so one codec serves one thread.
+class DepthCodec {
+public:
+    struct Config {
+        int slice_rows = 32;
+        bool entropy = true;     // Rice coding instead of plain bit-packing
+    };
+
+    DepthCodec();
+    explicit DepthCodec(const Config& config, ThreadPool* pool = nullptr);
+
+    DepthCodec(const DepthCodec&) = delete;
+    DepthCodec& operator=(const DepthCodec&) = delete;
+
+    // Largest encoding of a width x height image
+    static size_t max_encoded_size(int width, int height);
+
+    // Encodes the image into out, which is resized to fit. Returns the
+    // encoded size.
+    size_t encode(const uint16_t* depth, int width, int height, std::vector<uint8_t>& out);
+
+    // Decodes into a width x height image. Returns false if the data is not
+    // an encoding of an image that size or is corrupt.
+    bool decode(const uint8_t* data, size_t size, uint16_t* depth, int width, int height);
+
+    // Reads the image size from an encoding
+    static bool peek_size(const uint8_t* data, size_t size, int& width, int& height);
+
+private:
+    static constexpr uint32_t MAGIC = 0x36315a44;   // "DZ16"
+    static constexpr int GROUP_SIZE = 16;           // Residuals per bit-packed group
+
+    enum SliceMode : uint8_t {
+        SLICE_RAW = 0,
+        SLICE_PACKED = 1,
+        SLICE_RICE = 2
+    };
+
+    struct Header {
+        uint32_t magic;
+        uint16_t width;
+        uint16_t height;
+        uint16_t slice_rows;
+        uint16_t reserved;
+        uint32_t slices;
+    };
+
+    static size_t max_slice_size(int width, int rows);
+    // Writes at most max_slice_size() bytes
+    static size_t encode_slice(const uint16_t* depth, int width, int rows, bool entropy, uint8_t* out);
+    static bool decode_slice(const uint8_t* data, size_t size, uint16_t* depth, int width, int rows);
+
+    Config config_;
+    ThreadPool* pool_;
+    std::vector<uint8_t> scratch_;   // Slices encoded at worst-case offsets
+    std::vector<uint32_t> slice_sizes_;
+    std::vector<size_t> slice_offsets_;
+};
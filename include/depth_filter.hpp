@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "cpu_features.hpp"
+
+// One stage of post-processing on Z16 depth, where zero means "no data".
+// Filters work on row ranges so a FilterChain can spread a frame over a
+// thread pool and run several filters over a tile while it is still in
+// cache.
+class DepthFilter {
+public:
+    virtual ~DepthFilter() = default;
+
+    virtual const char* name() const = 0;
+
+    // Row-local filters read and write only the rows they are given, in
+    // place, so they can be fused into the pass of the filter before them.
+    // The others read a neighbourhood and need a separate output buffer.
+    virtual bool row_local() const = 0;
+
+    // Called before the first frame and whenever the input size changes.
+    virtual void configure(int width, int height);
+    int out_width() const { return out_width_; }
+    int out_height() const { return out_height_; }
+
+    // Produces output rows [first_row, last_row). src is the whole input
+    // image; row-local filters get src == dst. Calls for disjoint row
+    // ranges may run concurrently.
+    virtual void process_rows(const uint16_t* src, uint16_t* dst, int first_row, int last_row) = 0;
+
+    // Defaults to CpuFeatures::simd_level(); lowered to what the CPU supports.
+    void set_simd_level(SimdLevel level);
+    SimdLevel simd_level() const;
+    // Frames of the common profiles run kernels built for their size (see
+    // frame_shape.hpp), where the filter has them. On by default; off is
+    // for comparing.
+    void set_specialized(bool specialized);
+    bool specialized() const;
+
+protected:
+    DepthFilter();
+
+    SimdLevel simd_level_;
+    bool specialized_;
+    int width_;
+    int height_;
+    int out_width_;
+    int out_height_;
+};
+
+// Shrinks the image by factor in both directions, each output pixel being
+// the (lower) median of the valid pixels in its factor x factor block.
+class DecimationFilter : public DepthFilter {
+public:
+    explicit DecimationFilter(int factor = 2);
+
+    const char* name() const override { return "decimation"; }
+    bool row_local() const override { return false; }
+    void configure(int width, int height) override;
+    void process_rows(const uint16_t* src, uint16_t* dst, int first_row, int last_row) override;
+
+private:
+    int factor_;
+};
+
+// Edge-preserving 3x3 smoothing: each valid pixel becomes the mean of
+// itself and those neighbours within delta of it, so surfaces are smoothed
+// but depth edges are not blurred across. Holes are left alone.
+class SpatialFilter : public DepthFilter {
+public:
+    explicit SpatialFilter(uint16_t delta = 20);
+
+    const char* name() const override { return "spatial"; }
+    bool row_local() const override { return false; }
+    void process_rows(const uint16_t* src, uint16_t* dst, int first_row, int last_row) override;
+
+private:
+    uint16_t delta_;
+};
+
+// Per-pixel exponential moving average across frames. A jump of more than
+// delta restarts the average so motion does not smear. With persistence,
+// a pixel that drops out keeps its last value while it was valid in at
+// least that many of the last eight frames.
+class TemporalFilter : public DepthFilter {
+public:
+    TemporalFilter(float alpha = 0.4f, uint16_t delta = 20, int persistence = 3);
+
+    const char* name() const override { return "temporal"; }
+    bool row_local() const override { return true; }
+    void configure(int width, int height) override;
+    void process_rows(const uint16_t* src, uint16_t* dst, int first_row, int last_row) override;
+
+    // Forgets the history, for example after a stream restart.
+    void reset();
+
+private:
+    int alpha_;          // Weight of the new sample, in 1/256ths
+    uint16_t delta_;
+    int persistence_;
+
+    std::vector<uint16_t> previous_;
+    std::vector<uint8_t> history_;   // Validity of the last eight frames, bit 0 newest
+};
+
+// Fills holes:
+//  FillFromLeft       - with the nearest valid pixel to the left (row-local)
+//  NearestFromAround  - with the nearest of the 8 neighbours
+//  FarthestFromAround - with the farthest of the 8 neighbours
+class HoleFillingFilter : public DepthFilter {
+public:
+    enum class Mode { FillFromLeft, NearestFromAround, FarthestFromAround };
+
+    explicit HoleFillingFilter(Mode mode = Mode::FillFromLeft);
+
+    const char* name() const override { return "hole_fill"; }
+    bool row_local() const override { return mode_ == Mode::FillFromLeft; }
+    void process_rows(const uint16_t* src, uint16_t* dst, int first_row, int last_row) override;
+
+private:
+    Mode mode_;
+};
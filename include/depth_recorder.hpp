@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "depth_codec.hpp"
+#include "frame_pool.hpp"
+#include "recording_format.hpp"
+#include "thread_pool.hpp"
+
+// Appends depth frames to a recording file (see recording_format.hpp).
+// write() copies the frame into one of a few large staging blocks and
+// returns; a writer thread hands full blocks to the kernel in single
+// sequential writes and grows the file a chunk at a time with preallocated
+// space, so neither the caller nor the capture thread waits for the disk.
+// A lossless recording does not encode in write() either: it copies the
+// frame into one of a few frame slots, and an encoder thread, with a
+// ThreadPool of its own, encodes them in order and fills the blocks. When
+// every slot or block is waiting, frames are dropped and counted. write()
+// and close() must be called from one thread.
+class DepthRecorder {
+public:
+    struct Config {
+        int width = 640;
+        int height = 480;
+        size_t chunk_size = 64 << 20;   // File space preallocated at a time
+        size_t block_size = 8 << 20;    // Bytes per write; must hold a frame record
+        int blocks = 4;                 // Staging blocks
+        RecordCodec codec = RecordCodec::Raw;   // For frames passed to write(const Frame&)
+        int encode_slots = 8;           // Lossless: frames waiting to be encoded
+    };
+
+    struct Stats {
+        uint64_t frames = 0;
+        uint64_t dropped = 0;          // No free staging block or encode slot
+        uint64_t bytes = 0;            // Written to the file, headers included
+        uint64_t writes = 0;
+        uint64_t raw_bytes = 0;        // Frame data before encoding
+    };
+
+    DepthRecorder();
+    explicit DepthRecorder(const Config& config);
+    ~DepthRecorder();
+
+    DepthRecorder(const DepthRecorder&) = delete;
+    DepthRecorder& operator=(const DepthRecorder&) = delete;
+
+    // Creates (or truncates) path and starts the writer thread
+    bool open(const std::string& path);
+    bool is_open() const;
+
+    // Queues a frame, encoded with the configured codec. Returns false if
+    // it was dropped.
+    bool write(const Frame& frame);
+    // Queues already encoded data; raw_size is its decoded size
+    bool write(const uint8_t* data, size_t size, const FrameMetadata& metadata,
+               RecordCodec codec, size_t raw_size);
+
+    // Writes out what is queued, appends the index and trims the file
+    bool close();
+
+    Stats stats() const;
+
+private:
+    struct Block {
+        std::unique_ptr<uint8_t[]> data;
+        size_t used = 0;
+        uint64_t file_offset = 0;
+    };
+
+    // A frame handed to write() of a lossless recording, as given
+    struct Slot {
+        std::vector<uint8_t> data;
+        size_t size = 0;
+        FrameMetadata metadata;
+        RecordCodec codec = RecordCodec::Raw;
+        size_t raw_size = 0;
+        bool encode = false;            // Raw image still to be encoded
+    };
+
+    bool stage(const uint8_t* data, size_t size, const FrameMetadata& metadata, RecordCodec codec,
+               size_t raw_size, bool encode);
+    void encoder_loop();
+    bool append(const uint8_t* data, size_t size, const FrameMetadata& metadata, RecordCodec codec,
+                size_t raw_size);
+    bool take_block();
+    void submit_block();
+    void writer_loop();
+    bool write_at(const void* data, size_t size, uint64_t offset);
+    bool reserve(uint64_t end);
+
+    Config config_;
+    int fd_;
+    std::string path_;
+
+    std::vector<Block> blocks_;
+    Block* current_;                  // Being filled by write(), or the encoder thread
+    uint64_t append_offset_;          // File offset of the next record
+    std::vector<RecordingIndexEntry> index_;
+    std::unique_ptr<ThreadPool> encode_threads_;   // Lossless only
+    DepthCodec codec_;
+    std::vector<uint8_t> encoded_;
+
+    // Lossless recordings: slots travel from write() to the encoder thread
+    std::vector<Slot> slots_;
+    std::mutex slot_mutex_;
+    std::condition_variable staged_cv_;
+    std::deque<Slot*> staged_;
+    std::vector<Slot*> free_slots_;
+    bool encoder_stopping_;
+    std::thread encoder_;
+    uint64_t first_timestamp_ns_;
+    uint64_t last_timestamp_ns_;
+
+    std::mutex mutex_;
+    std::condition_variable work_;
+    std::deque<Block*> full_;         // Waiting for the writer
+    std::vector<Block*> free_;
+    bool stopping_;
+    bool write_failed_;
+    uint64_t allocated_end_;          // File space reserved so far, writer only
+    std::thread writer_;
+
+    std::atomic<uint64_t> frames_;
+    std::atomic<uint64_t> dropped_;
+    std::atomic<uint64_t> bytes_;
+    std::atomic<uint64_t> writes_;
+    std::atomic<uint64_t> raw_bytes_;
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "cpu_features.hpp"
+
+// Summary of one Z16 depth frame, where 0 means no data. Travels with the
+// frame in its metadata, so consumers that only need the range or the fill
+// rate do not scan the pixels again.
+struct DepthStats {
+    static constexpr int HISTOGRAM_BINS = 8;
+    // Lower edges of bins 1 and up, in depth units (mm at the default
+    // scale). Bin 0 starts at 1; the last bin is open-ended.
+    static constexpr uint16_t BIN_EDGES[HISTOGRAM_BINS - 1] = {500, 1000, 1500, 2000, 3000, 4000, 6000};
+
+    bool computed = false;
+    uint16_t min_depth = 0;          // Of valid pixels; both 0 if there are none
+    uint16_t max_depth = 0;
+    uint32_t valid_pixels = 0;
+    uint32_t zero_pixels = 0;
+    uint64_t depth_sum = 0;          // Of valid pixels
+    uint32_t histogram[HISTOGRAM_BINS] = {};
+    // Depends on every pixel and its position: a frame identical to the one
+    // before it means the sensor is stuck, not that the scene is still
+    uint32_t checksum = 0;
+
+    double mean_depth() const;
+    double valid_ratio() const;
+};
+
+// Computes DepthStats over a frame fed to it in order, in pieces of any
+// length, so it can run as payloads arrive. add() can copy each piece to
+// its place in the frame in the same pass, which makes assembling a frame
+// and summarizing it one trip through the data instead of two. SIMD
+// kernels are picked at run time like the colorizer's; every level gives
+// exactly the scalar result.
+class DepthStatsAccumulator {
+public:
+    // Running totals, kept between pieces
+    struct State {
+        static constexpr int LANES = 16;
+
+        uint64_t pixels = 0;
+        uint16_t min_depth = 0xffff;
+        uint16_t max_depth = 0;
+        uint64_t depth_sum = 0;
+        // Pixels at or above 1, then at or above each bin edge
+        uint32_t at_least[DepthStats::HISTOGRAM_BINS] = {};
+        // Fletcher sums per lane, pixel i going to lane i % LANES
+        uint32_t sum_a[LANES] = {};
+        uint32_t sum_b[LANES] = {};
+    };
+
+    DepthStatsAccumulator();
+
+    void set_simd_level(SimdLevel level);
+    SimdLevel simd_level() const;
+
+    void reset();
+    // The next length bytes of the frame. Copies them to dst as well unless
+    // dst is null. A piece may end half way through a pixel.
+    void add(const uint8_t* src, uint8_t* dst, size_t length);
+    // Stats of everything added since the last reset, then resets
+    void finish(DepthStats& stats);
+
+    // One whole frame
+    static void compute(const uint16_t* depth, size_t pixel_count, DepthStats& stats,
+                        SimdLevel level = CpuFeatures::simd_level());
+
+private:
+    void add_pixels(const uint8_t* src, uint8_t* dst, size_t pixel_count);
+
+    SimdLevel simd_level_;
+    State state_;
+    bool have_byte_;                 // First half of a pixel split across pieces
+    uint8_t byte_;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "depth_filter.hpp"
+#include "frame_pool.hpp"
+#include "thread_pool.hpp"
+
+// Runs a sequence of DepthFilters over each frame, in place on the frame's
+// buffer. Work is split into tiles of rows on a ThreadPool. Row-local
+// filters are fused into the pass of the filter before them, so a tile goes
+// through all of them while it is still in cache; only filters that read a
+// neighbourhood start a new pass over memory.
+class FilterChain {
+public:
+    struct FilterTiming {
+        const char* name = "";
+        uint64_t frames = 0;
+        double total_ms = 0.0;   // CPU time summed over all threads
+        double max_ms = 0.0;     // Worst single frame
+
+        double mean_ms() const { return frames ? total_ms / frames : 0.0; }
+    };
+
+    explicit FilterChain(ThreadPool* pool = nullptr);
+
+    FilterChain(const FilterChain&) = delete;
+    FilterChain& operator=(const FilterChain&) = delete;
+
+    void add(std::unique_ptr<DepthFilter> filter);
+    size_t size() const;
+    DepthFilter& filter(size_t index);
+    void set_simd_level(SimdLevel level);
+
+    // With fusion off every filter gets its own pass, for comparison.
+    void set_fusion(bool enabled);
+
+    // Size of the image the chain produces from a width x height input.
+    void output_size(int width, int height, int& out_width, int& out_height);
+
+    // Filters the width x height image and leaves the result in the same
+    // buffer; width and height are updated to the output size.
+    void process(uint16_t* depth, int& width, int& height);
+    // Same for a frame holding a Z16 image; its size is updated too.
+    bool process(Frame& frame, int& width, int& height);
+
+    // Per-filter cost, in chain order, and the wall time of whole frames
+    std::vector<FilterTiming> timings() const;
+    FilterTiming frame_timing() const;
+    void reset_timings();
+
+private:
+    static constexpr int ROWS_PER_TILE = 16;
+
+    // Filters [first, last) in one sweep over the rows. Unless in_place, the
+    // first filter reads the previous buffer and writes the other one.
+    struct Pass {
+        size_t first;
+        size_t last;
+        bool in_place;
+        int height;
+    };
+
+    void plan(int width, int height);
+    void run_pass(const Pass& pass, const uint16_t* src, uint16_t* dst);
+
+    ThreadPool* pool_;
+    bool fusion_;
+    std::vector<std::unique_ptr<DepthFilter>> filters_;
+
+    std::vector<Pass> passes_;
+    bool planned_;
+    int input_width_;
+    int input_height_;
+    int output_width_;
+    int output_height_;
+    std::vector<uint16_t> scratch_;
+
+    std::unique_ptr<std::atomic<uint64_t>[]> frame_ns_;   // Per filter, current frame
+    std::vector<FilterTiming> timings_;
+    FilterTiming frame_timing_;
+};
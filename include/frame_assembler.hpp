@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "depth_stats.hpp"
+#include "frame_pool.hpp"
+#include "uvc_payload_parser.hpp"
+
+// Turns a stream of UVC payloads into whole frames. A frame that arrives in
+// a single payload is handed on in the transfer buffer itself; otherwise its
+// payloads are gathered into a buffer from the pool. Lost, short or corrupt
+// payloads tear the frame they belong to (see UvcPayloadParser).
+//
+// With statistics on, it also fills in each frame's DepthStats. Gathered
+// frames get them from the copy itself, one pass over the data; zero-copy
+// frames from a pass over the transfer buffer while it is still warm.
+//
+// Single-threaded like the parser: feed it from the thread that receives
+// payloads. stats() may be read from any thread.
+class FrameAssembler {
+public:
+    struct Stats {
+        uint64_t zero_copy_frames = 0;   // Handed on in the transfer buffer
+        uint64_t copied_bytes = 0;       // Bytes gathered from multi-payload frames
+        uint64_t dropped_frames = 0;     // No free buffer to assemble into
+        uint64_t torn_frames = 0;        // Lost, short or corrupt payloads
+        uint64_t invalid_payloads = 0;   // Payloads without a valid UVC header
+        uint64_t repeated_frames = 0;    // Same checksum as the frame before: a stuck sensor
+    };
+
+    explicit FrameAssembler(size_t frame_size);
+
+    FrameAssembler(const FrameAssembler&) = delete;
+    FrameAssembler& operator=(const FrameAssembler&) = delete;
+
+    // Feeds the next payload. Returns true when it completed a frame, which
+    // is moved into frame; the payload itself may be moved from. Frames
+    // spanning several payloads are gathered into buffers from pool.
+    bool add(Frame& payload, FramePool& pool, Frame& frame);
+
+    // Drops a partly assembled frame, for example when the stream restarts
+    void reset();
+    // Also resets
+    void set_frame_size(size_t frame_size);
+    size_t frame_size() const;
+
+    // Off by default; only meaningful for Z16 depth
+    void set_statistics(bool enabled);
+    bool statistics() const;
+    void set_simd_level(SimdLevel level);
+
+    Stats stats() const;
+
+private:
+    void finish_statistics(Frame& frame);
+
+    UvcPayloadParser parser_;
+    Frame assembly_frame_;
+    bool statistics_;
+    DepthStatsAccumulator accumulator_;
+    bool have_checksum_;
+    uint32_t last_checksum_;
+
+    std::atomic<uint64_t> zero_copy_frames_;
+    std::atomic<uint64_t> copied_bytes_;
+    std::atomic<uint64_t> dropped_frames_;
+    std::atomic<uint64_t> torn_frames_;
+    std::atomic<uint64_t> invalid_payloads_;
+    std::atomic<uint64_t> repeated_frames_;
+};
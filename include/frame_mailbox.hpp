@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "frame_pool.hpp"
+
+// Single-producer/single-consumer hand-off of frames from the capture thread
+// to a consumer running at its own pace. Both policies are lock-free:
+//
+//  DropOldest - triple buffer. publish() never waits; an unread frame is
+//               replaced by the newer one and counted as dropped.
+//  Block      - bounded ring. publish() waits while the ring is full, pushing
+//               back on the producer instead of losing frames.
+class FrameMailbox {
+public:
+    enum class Policy { DropOldest, Block };
+
+    struct Stats {
+        uint64_t published = 0;
+        uint64_t delivered = 0;
+        uint64_t dropped = 0;
+        uint64_t producer_waits = 0;   // publish() calls that found the ring full
+    };
+
+    explicit FrameMailbox(Policy policy, size_t capacity = 4);
+
+    FrameMailbox(const FrameMailbox&) = delete;
+    FrameMailbox& operator=(const FrameMailbox&) = delete;
+
+    // Producer side. Returns false only if the mailbox was closed while
+    // waiting for space.
+    bool publish(Frame&& frame);
+
+    // Consumer side. consume() waits up to timeout_ms for a frame.
+    bool try_consume(Frame& frame);
+    bool consume(Frame& frame, unsigned int timeout_ms);
+
+    // close() makes publish() fail and wakes any waiter; reopen() drops
+    // whatever is still queued so the mailbox can serve a new stream.
+    void close();
+    void reopen();
+
+    Policy policy() const;
+    Stats stats() const;
+
+private:
+    static constexpr uint8_t FRESH = 0x4;
+    static constexpr uint8_t INDEX_MASK = 0x3;
+
+    bool publish_latest(Frame&& frame);
+    bool publish_queued(Frame&& frame);
+    bool consume_latest(Frame& frame);
+    bool consume_queued(Frame& frame);
+
+    Policy policy_;
+    std::atomic<bool> closed_;
+
+    // DropOldest: slot index owned by each side plus the shared middle slot
+    Frame triple_[3];
+    std::atomic<uint8_t> middle_;
+    uint8_t back_;
+    uint8_t front_;
+
+    // Block: ring of capacity_ slots
+    size_t capacity_;
+    std::unique_ptr<Frame[]> ring_;
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+
+    alignas(64) std::atomic<uint64_t> published_;
+    std::atomic<uint64_t> dropped_;
+    std::atomic<uint64_t> producer_waits_;
+    alignas(64) std::atomic<uint64_t> delivered_;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// One block of buffer memory for a frame pool, set up so that touching it
+// from the capture path never faults: mapped up front, optionally locked
+// into RAM, backed by huge pages and placed on the NUMA node of the CPU
+// that fills it. Every option is best effort. Where the process lacks the
+// privilege (RLIMIT_MEMLOCK, reserved huge pages) or the platform lacks
+// the feature, the memory is still usable, just without it, and the
+// accessors say what was actually achieved.
+class FrameMemory {
+public:
+    struct Options {
+        bool lock = false;          // mlock, so the buffers never page out
+        // 2 MB pages: reserved ones if there are any, transparent ones if not
+        bool huge_pages = false;
+        int numa_node = -1;         // Bind here, -1 to leave placement to the kernel
+
+        bool any() const { return lock || huge_pages || numa_node >= 0; }
+    };
+
+    FrameMemory(size_t size, const Options& options);
+    ~FrameMemory();
+
+    FrameMemory(const FrameMemory&) = delete;
+    FrameMemory& operator=(const FrameMemory&) = delete;
+
+    uint8_t* data() { return data_; }
+    size_t size() const { return size_; }
+
+    bool locked() const { return locked_; }
+    bool huge_pages() const { return huge_pages_; }
+    int numa_node() const { return numa_node_; }
+
+private:
+    static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    uint8_t* data_;
+    size_t size_;
+    size_t mapped_size_;                // 0 when the memory came from the heap
+    std::unique_ptr<uint8_t[]> heap_;
+    bool locked_;
+    bool huge_pages_;
+    int numa_node_;
+};
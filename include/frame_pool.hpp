@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "depth_stats.hpp"
+#include "frame_memory.hpp"
+
+struct FrameMetadata {
+    uint64_t sequence = 0;
+    uint64_t timestamp_ns = 0;       // Host steady clock when the data landed
+    uint64_t assembled_ns = 0;       // Host steady clock when the frame was complete
+    uint32_t device_timestamp = 0;   // UVC PTS, device clock
+    DepthStats depth_stats;          // Filled in during assembly, if enabled
+};
+
+class FramePool;
+
+// Pool-internal bookkeeping for one buffer. Not used directly.
+struct FrameSlot {
+    uint8_t* storage = nullptr;
+    size_t capacity = 0;
+    size_t data_offset = 0;
+    size_t data_size = 0;
+    FrameMetadata metadata;
+    FramePool* pool = nullptr;
+    uint32_t index = 0;
+    std::atomic<uint32_t> refs{0};
+    std::atomic<uint32_t> next_free{0};
+};
+
+// Reference-counted handle to a pooled buffer. Copies share the buffer and
+// the last handle to go away returns it to its pool; no heap traffic either
+// way. A frame's pixels may start part way into its storage (for example
+// after a UVC header), see set_data().
+class Frame {
+public:
+    Frame() noexcept;
+    Frame(const Frame& other) noexcept;
+    Frame(Frame&& other) noexcept;
+    Frame& operator=(const Frame& other) noexcept;
+    Frame& operator=(Frame&& other) noexcept;
+    ~Frame();
+
+    explicit operator bool() const { return slot_ != nullptr; }
+
+    uint8_t* data() { return slot_->storage + slot_->data_offset; }
+    const uint8_t* data() const { return slot_->storage + slot_->data_offset; }
+    size_t size() const { return slot_->data_size; }
+
+    uint8_t* storage() { return slot_->storage; }
+    size_t capacity() const { return slot_->capacity; }
+    void set_data(size_t offset, size_t size);
+
+    FrameMetadata& metadata() { return slot_->metadata; }
+    const FrameMetadata& metadata() const { return slot_->metadata; }
+
+    uint32_t use_count() const;
+    void reset();
+
+private:
+    friend class FramePool;
+    explicit Frame(FrameSlot* slot) noexcept;
+
+    FrameSlot* slot_;
+};
+
+// Fixed set of equally sized buffers allocated once up front. acquire() and
+// release are lock-free, so any thread may drop the last reference.
+class FramePool {
+public:
+    struct Stats {
+        size_t frame_count = 0;
+        size_t in_use = 0;
+        uint64_t acquired = 0;
+        uint64_t released = 0;
+        uint64_t exhausted = 0;     // acquire() calls that found no free frame
+        uint64_t allocations = 0;   // heap allocations made by the pool, ever
+        bool memory_locked = false; // See FrameMemory
+        bool huge_pages = false;
+    };
+
+    FramePool(size_t frame_count, size_t frame_capacity);
+    // With buffers locked, on huge pages or on a NUMA node, as far as the
+    // process is allowed to
+    FramePool(size_t frame_count, size_t frame_capacity, const FrameMemory::Options& memory);
+    // Carves the buffers out of caller-owned memory (for example a mapped GL
+    // buffer), which must outlive the pool and every Frame from it.
+    FramePool(uint8_t* memory, size_t memory_size, size_t frame_capacity);
+    ~FramePool();
+
+    // Bytes of memory needed for frame_count buffers of frame_capacity.
+    static size_t required_memory(size_t frame_count, size_t frame_capacity);
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    // Returns an empty Frame if every buffer is in use.
+    Frame acquire();
+
+    size_t frame_capacity() const;
+    size_t frame_count() const;
+    Stats stats() const;
+
+private:
+    friend class Frame;
+    static constexpr uint32_t EMPTY = 0xffffffffu;
+    static constexpr size_t ALIGNMENT = 64;
+
+    void release(FrameSlot* slot);
+    void push_free(FrameSlot* slot);
+    void init_slots(uint8_t* memory, size_t stride);
+    static size_t stride_for(size_t frame_capacity);
+
+    size_t frame_count_;
+    size_t frame_capacity_;
+    std::unique_ptr<uint8_t[]> storage_;
+    std::unique_ptr<FrameMemory> memory_;
+    std::unique_ptr<FrameSlot[]> slots_;
+
+    // Treiber stack of free slot indices; the high half is an ABA tag
+    std::atomic<uint64_t> free_head_;
+
+    std::atomic<uint64_t> acquired_;
+    std::atomic<uint64_t> released_;
+    std::atomic<uint64_t> exhausted_;
+    uint64_t allocations_;
+};
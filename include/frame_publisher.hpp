@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "frame_pool.hpp"
+#include "shm_ring_format.hpp"
+
+// Publishes depth frames to other processes through a POSIX shared-memory
+// ring (see shm_ring_format.hpp) that any number of FrameSubscribers map
+// and read in place. publish() copies the frame into the next slot and
+// never waits: a subscriber that cannot keep up loses frames, the
+// publisher does not slow down. publish() must be called from one thread.
+class FramePublisher {
+public:
+    struct Config {
+        std::string name = "/realsense_depth";   // shm_open name
+        int width = 640;
+        int height = 480;
+        int slots = 8;
+    };
+
+    struct SubscriberInfo {
+        uint32_t pid = 0;
+        uint64_t lag = 0;               // Frames published it has not read yet
+        uint64_t skipped = 0;
+    };
+
+    FramePublisher();
+    explicit FramePublisher(const Config& config);
+    ~FramePublisher();
+
+    FramePublisher(const FramePublisher&) = delete;
+    FramePublisher& operator=(const FramePublisher&) = delete;
+
+    // Creates the ring, replacing one left by an earlier publisher
+    bool open();
+    // Marks the ring closed for subscribers and unlinks it
+    void close();
+    bool is_open() const;
+
+    bool publish(const Frame& frame);
+    bool publish(const uint8_t* data, size_t size, const FrameMetadata& metadata);
+
+    uint64_t published() const;
+
+    // Subscribers attached now; entries of processes that died are freed
+    std::vector<SubscriberInfo> subscribers();
+
+private:
+    void wake_subscribers();
+    void register_metrics();
+
+    Config config_;
+    int fd_;
+    uint8_t* map_;
+    size_t map_size_;
+    ShmRingHeader* header_;
+    std::atomic<uint64_t> too_large_;
+};
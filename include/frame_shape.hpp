@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+
+// Frame dimensions for kernels instantiated per stream profile. A kernel
+// is written once as a template over the shape and reads width, height and
+// pixels from it: FixedShape makes them compile-time constants, so over the
+// common profiles loops get constant trip counts and strides, and
+// DynamicShape carries them at run time for everything else.
+template <int Width, int Height>
+struct FixedShape {
+    static constexpr int width = Width;
+    static constexpr int height = Height;
+    static constexpr size_t pixels = static_cast<size_t>(Width) * Height;
+};
+
+struct DynamicShape {
+    int width;
+    int height;
+    size_t pixels;
+};
+
+template <typename... Shapes>
+struct ShapeList {};
+
+// The profiles the kernels are specialized on: the D435i's usual depth
+// modes, and 424x240, which is 848x480 after decimation by two
+using SpecializedShapes = ShapeList<FixedShape<1280, 720>, FixedShape<848, 480>, FixedShape<640, 480>,
+                                    FixedShape<480, 270>, FixedShape<424, 240>>;
+
+// Helpers for the two below: run kernel with the matching FixedShape, if any
+template <typename Kernel, typename... Shapes>
+bool dispatch_fixed_shape(ShapeList<Shapes...>, int width, int height, Kernel& kernel) {
+    return ((Shapes::width == width && Shapes::height == height && (kernel(Shapes()), true)) || ...);
+}
+
+template <typename Kernel, typename... Shapes>
+bool dispatch_fixed_shape(ShapeList<Shapes...>, size_t pixels, Kernel& kernel) {
+    return ((Shapes::pixels == pixels && (kernel(Shapes()), true)) || ...);
+}
+
+// Runs kernel(shape) with the FixedShape matching width x height, or with a
+// DynamicShape when there is none or specialized is false.
+template <typename Kernel>
+void dispatch_shape(int width, int height, bool specialized, Kernel&& kernel) {
+    if (!specialized || !dispatch_fixed_shape(SpecializedShapes(), width, height, kernel)) {
+        kernel(DynamicShape{width, height, static_cast<size_t>(width) * height});
+    }
+}
+
+// The same for kernels that only see a pixel count; the specialized
+// profiles all differ in it. The shape's width and height are meaningless
+// in the fallback, which treats the pixels as one row.
+template <typename Kernel>
+void dispatch_pixels(size_t pixels, bool specialized, Kernel&& kernel) {
+    if (!specialized || !dispatch_fixed_shape(SpecializedShapes(), pixels, kernel)) {
+        kernel(DynamicShape{static_cast<int>(pixels), 1, pixels});
+    }
+}
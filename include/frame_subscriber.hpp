@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "frame_pool.hpp"
+#include "shm_ring_format.hpp"
+
+// Reads the depth frames a FramePublisher in another process places in
+// shared memory. Frames are read in place: next() points a view at the
+// slot, and release() says whether the publisher overwrote the slot while
+// the caller was using it, in which case what it read may be torn. A
+// subscriber that falls behind by a whole ring skips to the oldest frame
+// still intact and counts what it missed; the publisher never waits.
+//
+// This is all a client process needs: it uses no camera or USB code.
+class FrameSubscriber {
+public:
+    struct Config {
+        std::string name = "/realsense_depth";
+        bool latest_only = false;       // Always jump to the newest frame instead of reading every one
+    };
+
+    struct FrameView {
+        const uint16_t* depth = nullptr;    // In shared memory
+        size_t size = 0;                    // Bytes
+        int width = 0;
+        int height = 0;
+        uint64_t number = 0;                // Position in the publisher's stream
+        uint64_t published_ns = 0;          // Steady clock, comparable across processes
+        FrameMetadata metadata;
+
+    private:
+        friend class FrameSubscriber;
+        uint64_t version = 0;
+    };
+
+    struct Stats {
+        uint64_t received = 0;
+        uint64_t skipped = 0;           // Overwritten before this subscriber got to them
+        uint64_t torn = 0;              // Overwritten while the caller held them
+        uint64_t lag = 0;               // Published but not read yet, as of the last next()
+    };
+
+    FrameSubscriber();
+    explicit FrameSubscriber(const Config& config);
+    ~FrameSubscriber();
+
+    FrameSubscriber(const FrameSubscriber&) = delete;
+    FrameSubscriber& operator=(const FrameSubscriber&) = delete;
+
+    // Maps the ring and starts from the newest frame. Fails if no publisher
+    // has created it.
+    bool open();
+    void close();
+    bool is_open() const;
+
+    int width() const;
+    int height() const;
+    // The publisher has closed the ring; open() again to follow a new one
+    bool publisher_closed() const;
+
+    // Waits up to timeout_ms for the next frame. Returns false on timeout
+    // or when the publisher has closed the ring.
+    bool next(FrameView& view, unsigned int timeout_ms);
+    // Ends the use of a view; false if its frame was overwritten meanwhile
+    bool release(const FrameView& view);
+    // Copies the next frame out instead, retrying if it is overwritten
+    // while being copied. depth must hold width() * height() pixels.
+    bool next_copy(uint16_t* depth, FrameView& view, unsigned int timeout_ms);
+
+    Stats stats() const;
+
+private:
+    bool wait(uint64_t position, unsigned int timeout_ms);
+    const ShmSlotHeader* slot(uint64_t number) const;
+
+    Config config_;
+    int fd_;
+    uint8_t* map_;
+    size_t map_size_;
+    ShmRingHeader* header_;
+    ShmSubscriberEntry* entry_;     // Our place in the subscriber table, if there was room
+    uint64_t position_;             // Next frame to read
+    Stats stats_;
+};
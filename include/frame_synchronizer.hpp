@@ -0,0 +1,76 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "frame_pool.hpp"
+#include "metrics.hpp"
+
+// Groups frames from several cameras into sets taken at the same moment.
+// Cameras have no common device clock, so frames are matched on the host
+// steady-clock time their data landed (FrameMetadata::timestamp_ns): a set
+// is the oldest frame of every camera once they all lie within the
+// tolerance of each other. A frame older than every other camera's
+// oldest by more than the tolerance can no longer be matched and is
+// discarded, so one camera dropping a frame costs one set, not the sync.
+//
+// Each camera's frames come from its own thread through push(); complete
+// sets wait in a short queue for next(), and when the consumer falls
+// behind the oldest set is dropped.
+class FrameSynchronizer {
+public:
+    struct Config {
+        int cameras = 2;
+        uint64_t tolerance_ns = 2000000;
+        size_t queue_frames = 4;        // Unmatched frames kept per camera
+        size_t queue_sets = 2;          // Complete sets waiting for next()
+    };
+
+    struct FrameSet {
+        std::vector<Frame> frames;      // One per camera, in camera order
+        uint64_t number = 0;
+        uint64_t timestamp_ns = 0;      // The earliest frame's
+        uint64_t skew_ns = 0;           // Latest minus earliest
+    };
+
+    struct Stats {
+        uint64_t sets = 0;
+        uint64_t unmatched = 0;         // Frames no other camera had a partner for
+        uint64_t overflowed = 0;        // Frames dropped from a full camera queue
+        uint64_t dropped_sets = 0;      // Complete sets the consumer never took
+        uint64_t max_skew_ns = 0;
+    };
+
+    FrameSynchronizer();
+    explicit FrameSynchronizer(const Config& config);
+
+    FrameSynchronizer(const FrameSynchronizer&) = delete;
+    FrameSynchronizer& operator=(const FrameSynchronizer&) = delete;
+
+    // Safe to call from one thread per camera at once
+    void push(int camera, Frame&& frame);
+    // Waits up to timeout_ms for the next complete set
+    bool next(FrameSet& set, unsigned int timeout_ms);
+
+    // close() wakes a waiting next(); reopen() drops everything queued
+    void close();
+    void reopen();
+
+    Stats stats() const;
+
+private:
+    void match();
+
+    Config config_;
+    mutable std::mutex mutex_;
+    std::condition_variable ready_cv_;
+    std::vector<std::deque<Frame>> queues_;
+    std::deque<FrameSet> ready_;
+    bool closed_;
+    uint64_t next_number_;
+    Stats stats_;
+    LatencyHistogram& skew_;
+};
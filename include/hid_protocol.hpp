@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// The D435i's IMU streams over a HID interface: one input report per
+// accelerometer or gyro sample, on an interrupt IN endpoint.
+struct ImuHid {
+    static constexpr uint8_t INTERFACE_CLASS = 0x03;
+    static constexpr uint8_t ACCEL_REPORT = 1;      // Report IDs
+    static constexpr uint8_t GYRO_REPORT = 2;
+};
+
+// Input report layout. Multi-byte fields are little-endian on the wire, as
+// on the hosts this runs on.
+#pragma pack(push, 1)
+struct ImuHidReport {
+    uint8_t report_id;
+    uint8_t reserved;
+    uint64_t timestamp_us;              // Device clock
+    int16_t x;                          // Raw axes, in the sensor's units
+    int16_t y;
+    int16_t z;
+    uint8_t custom[16];
+};
+#pragma pack(pop)
+static_assert(sizeof(ImuHidReport) == 32, "IMU HID report layout");
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+enum class ImuSensor : uint8_t { Accel, Gyro };
+
+struct ImuSample {
+    uint64_t timestamp_ns = 0;          // Host steady clock when the report landed
+    uint64_t device_timestamp_us = 0;   // Device clock
+    int16_t x = 0;                      // Raw axes, in the sensor's units
+    int16_t y = 0;
+    int16_t z = 0;
+    ImuSensor sensor = ImuSensor::Accel;
+};
+
+// Single-producer/single-consumer ring of IMU samples. Samples are small
+// and arrive hundreds of times a second, so they are copied by value rather
+// than pooled like frames, and the consumer takes them in batches. When the
+// consumer falls a whole ring behind, new samples are dropped and counted
+// until it catches up; the ones it gets stay contiguous.
+class ImuSampleRing {
+public:
+    struct Stats {
+        uint64_t pushed = 0;
+        uint64_t read = 0;
+        uint64_t overruns = 0;          // Samples dropped on a full ring
+    };
+
+    // Rounded up to a power of two
+    explicit ImuSampleRing(size_t capacity = 4096);
+
+    ImuSampleRing(const ImuSampleRing&) = delete;
+    ImuSampleRing& operator=(const ImuSampleRing&) = delete;
+
+    // Producer side. Returns false if the ring was full.
+    bool push(const ImuSample& sample);
+
+    // Consumer side: copies up to max_samples, oldest first. read() waits up
+    // to timeout_ms for the first one.
+    size_t try_read(ImuSample* samples, size_t max_samples);
+    size_t read(ImuSample* samples, size_t max_samples, unsigned int timeout_ms);
+
+    // Only while neither side is active
+    void clear();
+
+    size_t size() const;
+    size_t capacity() const;
+    Stats stats() const;
+
+private:
+    size_t mask_;
+    std::unique_ptr<ImuSample[]> samples_;
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+    std::atomic<uint64_t> overruns_;
+};
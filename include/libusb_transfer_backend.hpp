@@ -0,0 +1,29 @@
+#pragma once
+
+#include <libusb-1.0/libusb.h>
+#include "transfer_backend.hpp"
+
+// TransferBackend over libusb's asynchronous bulk and interrupt API.
+// Backends on one context share its event loop: handle_events() on any of
+// them services the transfers of all.
+class LibusbTransferBackend : public TransferBackend {
+public:
+    LibusbTransferBackend(libusb_context* context, libusb_device_handle* device_handle,
+                          uint8_t endpoint, unsigned int timeout_ms, bool interrupt = false);
+
+    bool prepare(TransferRequest* request) override;
+    void release(TransferRequest* request) override;
+    TransferStatus submit(TransferRequest* request) override;
+    void cancel(TransferRequest* request) override;
+    bool clear_halt() override;
+    void handle_events(int timeout_ms) override;
+
+private:
+    static void LIBUSB_CALL transfer_callback(libusb_transfer* transfer);
+
+    libusb_context* context_;
+    libusb_device_handle* device_handle_;
+    uint8_t endpoint_;
+    unsigned int timeout_ms_;
+    bool interrupt_;
+};
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Severity levels, also usable in #if (see LOG_MIN_LEVEL below)
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_WARN 3
+#define LOG_LEVEL_ERROR 4
+#define LOG_LEVEL_OFF 5
+
+// Levels below this are compiled out: their LOG_* statements expand to
+// nothing, so the arguments are not even evaluated.
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+enum class LogLevel {
+    Trace = LOG_LEVEL_TRACE,
+    Debug = LOG_LEVEL_DEBUG,
+    Info = LOG_LEVEL_INFO,
+    Warn = LOG_LEVEL_WARN,
+    Error = LOG_LEVEL_ERROR,
+    Off = LOG_LEVEL_OFF
+};
+
+// Per-call-site limit for messages that can repeat at transfer rate. Lets
+// BURST messages through per interval and counts the rest, and the next
+// message that gets through reports how many were dropped. Lock-free.
+class LogRateLimiter {
+public:
+    static constexpr uint32_t BURST = 5;
+    static constexpr uint64_t INTERVAL_NS = 1000000000ull;
+
+    // Returns false if the message should be dropped. Otherwise suppressed
+    // is set to the number dropped since the last one let through.
+    bool allow(uint64_t now_ns, uint32_t& suppressed);
+
+private:
+    std::atomic<uint64_t> window_start_ns_{0};
+    std::atomic<uint32_t> count_{0};
+    std::atomic<uint32_t> suppressed_{0};
+};
+
+// Process-wide asynchronous logger. Callers format into a slot of a fixed
+// ring and return; a background thread writes the slots out. The ring is a
+// bounded multi-producer queue with a sequence number per slot, so logging
+// takes no lock and never waits: when the ring is full the message is
+// dropped and counted instead. Use the LOG_* macros rather than log().
+class Logger {
+public:
+    static constexpr size_t RING_SIZE = 1024;         // Power of two
+    static constexpr size_t MESSAGE_SIZE = 232;
+
+    struct Stats {
+        uint64_t written = 0;
+        uint64_t dropped = 0;        // Ring full
+        uint64_t suppressed = 0;     // Rate-limited
+    };
+
+    static Logger& instance();
+
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    // Messages below level are skipped at run time. Levels below
+    // LOG_MIN_LEVEL are already gone at compile time.
+    void set_level(LogLevel level);
+    LogLevel level() const;
+    bool enabled(LogLevel level) const {
+        return static_cast<int>(level) >= level_.load(std::memory_order_relaxed);
+    }
+
+    // Appends to path instead of writing to stderr. Returns false and keeps
+    // the current output if the file cannot be opened.
+    bool set_output(const std::string& path);
+
+    // printf-style; prefer the macros. limiter may be nullptr.
+    void log(LogLevel level, const char* component, LogRateLimiter* limiter, const char* format, ...)
+#if defined(__GNUC__)
+        __attribute__((format(printf, 5, 6)))
+#endif
+        ;
+
+    // Blocks until everything logged before the call has been written.
+    void flush();
+
+    Stats stats() const;
+
+    static const char* level_name(LogLevel level);
+    static bool parse_level(const std::string& name, LogLevel& level);
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        uint64_t timestamp_ns;
+        LogLevel level;
+        const char* component;
+        char message[MESSAGE_SIZE];
+    };
+
+    Logger();
+
+    void writer_loop();
+    bool write_next();
+
+    std::unique_ptr<Slot[]> slots_;
+    alignas(64) std::atomic<uint64_t> enqueue_pos_;
+    alignas(64) uint64_t dequeue_pos_;     // Guarded by mutex_
+
+    std::atomic<int> level_;
+    std::atomic<uint64_t> written_;
+    std::atomic<uint64_t> dropped_;
+    std::atomic<uint64_t> suppressed_;
+    uint64_t start_ns_;
+
+    // Only the writer thread and flush() take this; producers never do.
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable drained_;
+    bool stopping_;
+    std::FILE* output_;
+    std::thread writer_;
+};
+
+// Source files that log define LOG_COMPONENT after their includes to tag
+// their messages, e.g. #define LOG_COMPONENT "camera".
+#define LOG_AT(level, limiter, ...)                                              \
+    do {                                                                         \
+        Logger& log_instance_ = Logger::instance();                              \
+        if (log_instance_.enabled(level)) {                                      \
+            log_instance_.log(level, LOG_COMPONENT, limiter, __VA_ARGS__);       \
+        }                                                                        \
+    } while (0)
+
+// Warnings and errors are rate-limited per call site, since they are the
+// ones that fire on every failed transfer when a device misbehaves.
+#define LOG_LIMITED(level, ...)                                                  \
+    do {                                                                         \
+        static LogRateLimiter log_limiter_;                                      \
+        LOG_AT(level, &log_limiter_, __VA_ARGS__);                               \
+    } while (0)
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_TRACE
+#define LOG_TRACE(...) LOG_AT(LogLevel::Trace, nullptr, __VA_ARGS__)
+#else
+#define LOG_TRACE(...) do {} while (0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) LOG_AT(LogLevel::Debug, nullptr, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(...) LOG_AT(LogLevel::Info, nullptr, __VA_ARGS__)
+#else
+#define LOG_INFO(...) do {} while (0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(...) LOG_LIMITED(LogLevel::Warn, __VA_ARGS__)
+#else
+#define LOG_WARN(...) do {} while (0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) LOG_LIMITED(LogLevel::Error, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) do {} while (0)
+#endif
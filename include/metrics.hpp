@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Stage timestamps use the steady clock, like FrameMetadata::timestamp_ns.
+// On Linux this is a vDSO read, not a system call.
+inline uint64_t monotonic_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Latency histogram in the style of HdrHistogram: buckets are linear within
+// each power of two, 32 to a power, so any value is kept to within about 3%
+// from nanoseconds up to the full 64-bit range. record() is a few relaxed
+// atomic adds and safe from any number of threads.
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 5;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    struct Snapshot {
+        std::vector<uint64_t> counts;
+        uint64_t count = 0;
+        uint64_t sum_ns = 0;
+        uint64_t max_ns = 0;
+
+        double mean_ns() const { return count ? static_cast<double>(sum_ns) / count : 0.0; }
+        // Upper end of the bucket holding quantile q in [0, 1]
+        uint64_t percentile(double q) const;
+        // What was recorded after earlier was taken
+        Snapshot since(const Snapshot& earlier) const;
+    };
+
+    LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(uint64_t ns);
+    // Records the time from start_ns to now
+    void record_since(uint64_t start_ns);
+
+    Snapshot snapshot() const;
+
+    static int bucket_index(uint64_t value);
+    static uint64_t bucket_upper(int index);
+
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+    std::atomic<uint64_t> sum_ns_;
+    std::atomic<uint64_t> max_ns_;
+};
+
+// Process-wide registry of what the pipeline measures. Histograms are
+// created on first use and live for the whole process, so stages look them
+// up once and then record without touching the registry. Counters and
+// gauges are read through callbacks at snapshot time, so components expose
+// the statistics they already keep instead of counting twice.
+class Metrics {
+public:
+    enum class Kind { Counter, Gauge };
+
+    struct Value {
+        std::string name;
+        std::string help;
+        Kind kind;
+        double value;
+    };
+
+    struct Histogram {
+        std::string name;
+        std::string help;
+        LatencyHistogram::Snapshot data;
+    };
+
+    struct Snapshot {
+        uint64_t timestamp_ns = 0;
+        std::vector<Value> values;
+        std::vector<Histogram> histograms;
+    };
+
+    static Metrics& instance();
+
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    // Returns the histogram called name, creating it the first time
+    LatencyHistogram& histogram(const std::string& name, const std::string& help);
+
+    // Registers a value read by calling read at snapshot time. owner is a
+    // handle for remove(), which must be called before read becomes invalid.
+    void add(const void* owner, const std::string& name, const std::string& help, Kind kind,
+             std::function<double()> read);
+    // Once this returns, none of owner's callbacks is running or will run
+    void remove(const void* owner);
+
+    Snapshot snapshot() const;
+
+private:
+    struct Source {
+        const void* owner;
+        std::string name;
+        std::string help;
+        Kind kind;
+        std::function<double()> read;
+    };
+
+    struct NamedHistogram {
+        std::string help;
+        std::unique_ptr<LatencyHistogram> histogram;
+    };
+
+    Metrics() = default;
+
+    mutable std::mutex mutex_;
+    std::vector<Source> sources_;
+    std::map<std::string, NamedHistogram> histograms_;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include "metrics.hpp"
+
+// Periodically snapshots Metrics and publishes it as JSON or Prometheus
+// text, either by rewriting a file (written aside and renamed, so readers
+// and the node_exporter textfile collector never see half a snapshot) or by
+// serving the latest snapshot to every client of a local Unix socket, e.g.
+// `socat - UNIX-CONNECT:/run/realsense.sock`.
+//
+// Latency quantiles cover the last period; sums and counts are cumulative.
+class MetricsExporter {
+public:
+    enum class Format { Json, Prometheus };
+
+    struct Config {
+        std::string destination;          // File path, or unix:PATH for a socket
+        Format format = Format::Prometheus;
+        int period_ms = 1000;
+    };
+
+    explicit MetricsExporter(const Config& config);
+    ~MetricsExporter();
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    bool start();
+    // Publishes a final snapshot
+    void stop();
+
+    // previous may be nullptr; quantiles then cover everything recorded
+    static std::string format(Format format, const Metrics::Snapshot& current,
+                              const Metrics::Snapshot* previous);
+    static bool parse_format(const std::string& name, Format& format);
+
+private:
+    static constexpr int POLL_MS = 100;   // How quickly stop() is noticed
+
+    bool open_socket(const std::string& path);
+    void run();
+    void publish();
+    bool write_file(const std::string& text);
+    void serve_clients(int timeout_ms);
+
+    Config config_;
+    bool use_socket_;
+    std::string socket_path_;
+    int listen_fd_;
+
+    std::thread thread_;
+    std::atomic<bool> running_;
+
+    Metrics::Snapshot previous_;
+    bool have_previous_;
+    std::string latest_;
+};
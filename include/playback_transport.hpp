@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include "depth_codec.hpp"
+#include "recording_reader.hpp"
+#include "transport.hpp"
+
+// Transport that replays a recording made by DepthRecorder. Each frame is
+// decoded if it was compressed and delivered as a single UVC payload into a
+// buffer from the caller's pool, exactly as the USB transports deliver
+// them, so CameraDevice and every consumer behind it run unchanged.
+class PlaybackTransport : public Transport {
+public:
+    struct Config {
+        std::string path;
+        bool realtime = true;     // Keep the recorded frame timing; otherwise as fast as possible
+        double speed = 1.0;       // Realtime only
+        bool loop = false;
+    };
+
+    explicit PlaybackTransport(const Config& config);
+    ~PlaybackTransport() override;
+
+    bool open() override;
+    bool start(FramePool& pool, PayloadCallback on_payload) override;
+    void stop() override;
+    const char* name() const override;
+    // The recorded size and frame rate, whatever was asked for
+    bool probe(const StreamProfile& requested, StreamProfile& negotiated) override;
+
+    // The reader, open after open(), e.g. for the recorded dimensions
+    const RecordingReader& reader() const;
+    // Replays from this frame on the next start()
+    void seek(size_t frame);
+    // Every frame has been delivered and looping is off
+    bool finished() const;
+
+private:
+    // How long to wait for a free pool buffer before trying again
+    static constexpr int POOL_RETRY_US = 500;
+
+    void replay_loop(FramePool& pool, PayloadCallback on_payload);
+
+    Config config_;
+    RecordingReader reader_;
+    DepthCodec codec_;
+    size_t start_frame_;
+    std::thread thread_;
+    std::atomic<bool> running_;
+    std::atomic<bool> finished_;
+};
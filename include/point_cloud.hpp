@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "camera_intrinsics.hpp"
+#include "cpu_features.hpp"
+#include "thread_pool.hpp"
+
+// Deprojects whole depth frames into 3D points in metres, in the camera
+// frame (x right, y down, z forward). Ray directions are precomputed per
+// column and per row, so a pixel costs one conversion and two multiplies,
+// done eight at a time with AVX2. Row bands are spread over a ThreadPool.
+class PointCloud {
+public:
+    struct Config {
+        float depth_scale = 0.001f;   // Metres per depth unit
+        bool compact = false;         // Drop pixels without depth
+        ThreadPool* pool = nullptr;   // nullptr = ThreadPool::shared()
+    };
+
+    // Structure of arrays. Dense output keeps one point per pixel in row
+    // order, with zeros where there is no depth; compacted output keeps row
+    // order but only valid points.
+    struct Points {
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+        size_t count = 0;
+    };
+
+    PointCloud(const CameraIntrinsics& intrinsics, const Config& config);
+
+    PointCloud(const PointCloud&) = delete;
+    PointCloud& operator=(const PointCloud&) = delete;
+
+    // Defaults to CpuFeatures::simd_level(); lowered to what the CPU supports.
+    void set_simd_level(SimdLevel level);
+    SimdLevel simd_level() const;
+    const CameraIntrinsics& intrinsics() const;
+
+    // depth holds width * height values. Returns points.count.
+    size_t deproject(const uint16_t* depth, Points& points);
+
+private:
+    static constexpr int ROWS_PER_BAND = 16;
+
+    size_t count_valid(const uint16_t* depth, size_t count) const;
+    size_t deproject_rows(const uint16_t* depth, int first_row, int last_row, Points& points,
+                          size_t offset, size_t limit) const;
+
+    CameraIntrinsics intrinsics_;
+    Config config_;
+    SimdLevel simd_level_;
+    ThreadPool* pool_;
+
+    // Ray direction per column (x/z) and per row (y/z)
+    std::vector<float> ray_x_;
+    std::vector<float> ray_y_;
+
+    // Where each band's points start in compacted output
+    std::vector<size_t> band_offsets_;
+};
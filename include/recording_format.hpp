@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// On-disk layout of a depth recording, little-endian:
+//
+//   RecordingFileHeader
+//   frame records, each a RecordingFrameHeader followed by the frame data,
+//   every record starting on a RECORD_ALIGNMENT boundary
+//   RecordingIndexHeader followed by one RecordingIndexEntry per frame
+//
+// The index is written when the recording is closed and the file header
+// then points at it. A file whose header has no index (the recorder did not
+// get to close it) is still readable by walking the records.
+struct RecordingFormat {
+    static constexpr char MAGIC[8] = {'R', 'S', 'D', 'E', 'P', 'T', 'H', '1'};
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t FRAME_MAGIC = 0x314d5246;   // "FRM1"
+    static constexpr uint32_t INDEX_MAGIC = 0x31584449;   // "IDX1"
+    static constexpr size_t RECORD_ALIGNMENT = 64;
+    static constexpr uint32_t PIXEL_FORMAT_Z16 = 1;
+
+    static size_t align(size_t offset) {
+        return (offset + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+    }
+};
+
+// How a frame's data is stored
+enum class RecordCodec : uint16_t {
+    Raw = 0,        // Z16 pixels as captured
+    Lossless = 1    // DepthCodec encoding of the Z16 pixels
+};
+
+struct RecordingFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pixel_format;
+    uint32_t reserved;
+    uint64_t frame_count;           // 0 until the index is written
+    uint64_t index_offset;          // 0 until the index is written
+    uint64_t first_timestamp_ns;
+    uint64_t last_timestamp_ns;
+};
+
+struct RecordingFrameHeader {
+    uint32_t magic;
+    uint16_t codec;                 // RecordCodec
+    uint16_t flags;
+    uint32_t size;                  // Bytes of data following the header
+    uint32_t raw_size;              // Bytes once decoded
+    uint64_t sequence;
+    uint64_t timestamp_ns;          // Host steady clock when the frame landed
+    uint32_t device_timestamp;      // UVC PTS
+    uint8_t reserved[28];           // Keeps the data 64-byte aligned
+};
+
+struct RecordingIndexHeader {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t count;
+};
+
+struct RecordingIndexEntry {
+    uint64_t offset;                // Of the frame's RecordingFrameHeader
+    uint64_t timestamp_ns;
+};
+
+static_assert(sizeof(RecordingFileHeader) == 64, "file header layout");
+static_assert(sizeof(RecordingFrameHeader) == 64, "frame header layout");
+static_assert(sizeof(RecordingIndexHeader) == 16, "index header layout");
+static_assert(sizeof(RecordingIndexEntry) == 16, "index entry layout");
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "frame_pool.hpp"
+#include "recording_format.hpp"
+
+// Read-only view of a recording made by DepthRecorder. The whole file is
+// memory-mapped and frames are handed out as pointers into the mapping, so
+// reading a frame copies nothing. Frame numbers resolve through the trailing
+// index in constant time; timestamps through an interpolated guess that is
+// exact in a step or two at a steady frame rate. A recording that was never
+// closed has no index; one is rebuilt by walking the records.
+class RecordingReader {
+public:
+    struct FrameView {
+        const uint8_t* data = nullptr;   // Into the mapping, valid until close()
+        size_t size = 0;
+        size_t raw_size = 0;
+        RecordCodec codec = RecordCodec::Raw;
+        FrameMetadata metadata;
+    };
+
+    RecordingReader();
+    ~RecordingReader();
+
+    RecordingReader(const RecordingReader&) = delete;
+    RecordingReader& operator=(const RecordingReader&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    bool is_open() const;
+
+    int width() const;
+    int height() const;
+    size_t frame_count() const;
+    uint64_t first_timestamp_ns() const;
+    uint64_t last_timestamp_ns() const;
+    // True if the index had to be rebuilt
+    bool recovered() const;
+
+    bool frame(size_t index, FrameView& view) const;
+    uint64_t timestamp(size_t index) const;
+
+    // Index of the last frame recorded at or before timestamp_ns, or 0 when
+    // it is earlier than the first frame
+    size_t find(uint64_t timestamp_ns) const;
+
+    // Asks the kernel to start reading the frame in, e.g. one ahead of replay
+    void prefetch(size_t index) const;
+
+private:
+    static constexpr int SEEK_STEPS = 4;   // Before falling back to bisection
+
+    static bool index_valid(const RecordingIndexEntry* entries, uint64_t count, uint64_t index_offset);
+    bool rebuild_index();
+
+    int fd_;
+    const uint8_t* map_;
+    size_t map_size_;
+    RecordingFileHeader header_;
+    const RecordingIndexEntry* index_;
+    size_t frame_count_;
+    bool recovered_;
+    std::vector<RecordingIndexEntry> rebuilt_index_;
+};
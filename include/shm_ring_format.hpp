@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Layout of the POSIX shared-memory ring FramePublisher writes and
+// FrameSubscriber reads:
+//
+//   ShmRingHeader, padded to HEADER_SPACE
+//   slot_count slots of slot_stride bytes, each a ShmSlotHeader followed
+//   by up to frame_capacity bytes of Z16 pixels
+//
+// Frame n goes into slot n % slot_count. Each slot is a seqlock: its
+// version is odd (2n + 1) while frame n is being written and 2n + 2 once
+// it is complete, so a reader knows both which frame a slot holds and
+// whether it changed while being read. The publisher never waits for
+// readers; one that falls slot_count - 1 frames behind loses frames.
+//
+// Only lock-free atomics are placed in the mapping, so they work across
+// processes.
+struct ShmRingFormat {
+    static constexpr char MAGIC[8] = {'R', 'S', 'S', 'H', 'M', 'R', 'G', '1'};
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t HEADER_SPACE = 4096;
+    static constexpr size_t SLOT_ALIGNMENT = 4096;
+    static constexpr int MAX_SUBSCRIBERS = 16;
+    static constexpr uint32_t PIXEL_FORMAT_Z16 = 1;
+
+    static size_t slot_stride(size_t frame_capacity);
+};
+
+// Where a subscriber is, so the publisher can report its lag. pid 0 is a
+// free entry.
+struct alignas(64) ShmSubscriberEntry {
+    std::atomic<uint32_t> pid;
+    uint32_t reserved;
+    std::atomic<uint64_t> position;      // Next frame it will read
+    std::atomic<uint64_t> skipped;       // Frames overwritten before it read them
+};
+
+struct ShmRingHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t slot_count;
+    uint32_t slot_stride;
+    uint32_t frame_capacity;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pixel_format;
+    uint32_t publisher_pid;
+    uint32_t reserved;
+
+    alignas(64) std::atomic<uint64_t> published;   // Frames completed
+    std::atomic<uint32_t> wake;                    // Futex word, bumped per frame
+    std::atomic<uint32_t> waiters;                 // Subscribers blocked on wake
+    std::atomic<uint32_t> closed;                  // Publisher has gone
+
+    ShmSubscriberEntry subscribers[ShmRingFormat::MAX_SUBSCRIBERS];
+};
+
+struct alignas(64) ShmSlotHeader {
+    std::atomic<uint64_t> version;
+    uint64_t sequence;
+    uint64_t timestamp_ns;          // Host steady clock when the frame landed
+    uint64_t published_ns;          // Host steady clock when it was published
+    uint32_t device_timestamp;      // UVC PTS
+    uint32_t size;                  // Bytes of pixels following the header
+};
+
+inline size_t ShmRingFormat::slot_stride(size_t frame_capacity) {
+    size_t size = sizeof(ShmSlotHeader) + frame_capacity;
+    return (size + SLOT_ALIGNMENT - 1) & ~(SLOT_ALIGNMENT - 1);
+}
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared-memory counters must be lock-free");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared-memory counters must be lock-free");
+static_assert(sizeof(ShmRingHeader) <= ShmRingFormat::HEADER_SPACE, "ring header layout");
+static_assert(sizeof(ShmSlotHeader) == 64, "slot header layout");
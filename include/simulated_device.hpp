@@ -0,0 +1,83 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "stream_profile.hpp"
+
+// Synthetic RealSense depth source. Produces UVC bulk payloads (12 byte
+// header with FID/EOF/PTS/SCR followed by Z16 pixels) for an animated scene,
+// paced at a configurable frame rate with timing jitter, and can inject lost
+// payloads and short transfers.
+class SimulatedDevice {
+public:
+    struct Config {
+        int width = 640;
+        int height = 480;
+        double fps = 30.0;              // 0 = as fast as the host reads
+        double jitter_us = 0.0;         // Std-dev of frame arrival jitter
+        size_t payload_size = 0;        // Max bytes per payload, 0 = whole frame per payload
+        double payload_loss = 0.0;      // Probability a payload never arrives
+        double short_payload = 0.0;     // Probability a payload is truncated
+        double start_offset_us = 0.0;   // Delay before the first frame, like a camera not hardware-synced
+        uint64_t unplug_every = 0;      // Frames between simulated unplugs, 0 = never
+        double unplug_ms = 100.0;       // How long the device stays unplugged
+        uint32_t seed = 1;
+    };
+
+    explicit SimulatedDevice(const Config& config);
+
+    // Writes the next payload into buffer, blocking until it is due.
+    // Returns the number of bytes written.
+    size_t read_payload(uint8_t* buffer, size_t capacity);
+    // When the next payload is due, without waiting for it: read_payload()
+    // from then on does not block, unless a payload is lost.
+    std::chrono::steady_clock::time_point next_payload_due();
+
+    // False while simulating an unplugged cable. The stream starts afresh
+    // once the device is back.
+    bool present();
+    // Waits up to timeout_ms for present()
+    bool wait_present(unsigned int timeout_ms);
+
+    // The mode it streams in, the only one it offers in negotiation
+    StreamProfile profile() const;
+    // Switches to another mode. Only between streams.
+    void set_profile(const StreamProfile& profile);
+
+    size_t max_payload_size() const;
+    size_t frame_size() const;
+    uint64_t frames_generated() const;
+
+private:
+    static constexpr int ANIMATION_FRAMES = 16;
+
+    void resize();
+    void render_scene();
+    std::chrono::steady_clock::time_point frame_due();
+    void begin_frame();
+
+    Config config_;
+    size_t frame_size_;
+    size_t payload_data_size_;
+    std::vector<std::vector<uint16_t>> scene_frames_;
+
+    std::mt19937 rng_;
+    std::uniform_real_distribution<double> uniform_;
+    std::normal_distribution<double> jitter_;
+
+    std::chrono::steady_clock::time_point stream_start_;
+    std::chrono::steady_clock::time_point frame_due_;
+    bool frame_due_set_;                // frame_due_ is that of frame_index_
+    uint64_t frame_index_;
+    size_t frame_offset_;
+    uint8_t fid_;
+    uint32_t pts_;
+    uint16_t sof_;
+    bool started_;
+    uint64_t stream_first_frame_;
+    uint64_t next_unplug_;
+    bool unplugged_;
+    std::chrono::steady_clock::time_point replug_at_;
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include "transfer_backend.hpp"
+
+class SimulatedEndpoint;
+
+// The event loop of one simulated device. Holds the transfers in flight on
+// all of its endpoints and completes them in time order, so
+// handle_events() on any endpoint services every one of them, the way one
+// libusb context does for all the transfers on it.
+class SimulatedBus {
+public:
+    void handle_events(int timeout_ms);
+
+private:
+    friend class SimulatedEndpoint;
+    using Clock = std::chrono::steady_clock;
+
+    struct Pending {
+        SimulatedEndpoint* endpoint;
+        TransferRequest* request;
+        Clock::time_point complete_at;
+    };
+
+    // The earliest completion among each endpoint's oldest transfer, at the
+    // time it becomes due. Call with the mutex held.
+    std::deque<Pending>::iterator next_completion(Clock::time_point& due);
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Pending> pending_;
+    std::deque<TransferRequest*> cancelled_;
+};
+
+// Hardware-free TransferBackend. Models a bulk IN endpoint as a bus with a
+// fixed bandwidth plus a per-transfer completion latency: a request only
+// starts moving data once it has been submitted and the previous request has
+// finished, so a shallow queue leaves the bus idle exactly like real hardware.
+class SimulatedEndpoint : public TransferBackend {
+public:
+    // Produces up to `capacity` bytes into `buffer`, returns the number written,
+    // or NO_DEVICE to fail the transfer as if the device had been unplugged.
+    using FillFn = std::function<size_t(uint8_t* buffer, size_t capacity)>;
+    // When the endpoint next has data. A transfer completes no earlier, and
+    // the fill then does not have to wait for it.
+    using DueFn = std::function<std::chrono::steady_clock::time_point()>;
+    static constexpr size_t NO_DEVICE = static_cast<size_t>(-1);
+
+    struct Config {
+        double bandwidth_bytes_per_sec = 0.0;  // 0 = unlimited
+        double completion_latency_us = 0.0;
+    };
+
+    // A lone endpoint, with a bus of its own
+    SimulatedEndpoint(FillFn fill, const Config& config);
+    // One of several endpoints on bus, which must outlive it
+    SimulatedEndpoint(SimulatedBus& bus, FillFn fill, DueFn due, const Config& config);
+
+    bool prepare(TransferRequest* request) override;
+    void release(TransferRequest* request) override;
+    TransferStatus submit(TransferRequest* request) override;
+    void cancel(TransferRequest* request) override;
+    bool clear_halt() override;
+    void handle_events(int timeout_ms) override;
+
+private:
+    friend class SimulatedBus;
+    using Clock = std::chrono::steady_clock;
+
+    std::unique_ptr<SimulatedBus> own_bus_;
+    SimulatedBus& bus_;
+    FillFn fill_;
+    DueFn due_;
+    Config config_;
+    Clock::time_point bus_free_at_;     // Guarded by the bus mutex
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+
+// Synthetic D435i IMU. Produces HID input reports (see hid_protocol.hpp) for
+// an accelerometer and a gyro sampling at their own rates, for a camera
+// slowly rocking about one axis, with a little sensor noise.
+class SimulatedImu {
+public:
+    struct Config {
+        double accel_hz = 250.0;
+        double gyro_hz = 400.0;
+        double noise = 4.0;             // Std-dev, raw units
+        uint32_t seed = 1;
+    };
+
+    explicit SimulatedImu(const Config& config);
+
+    // Writes the reports due so far, as many whole ones as fit, oldest
+    // first, blocking until at least one is due. Returns the bytes written.
+    size_t read_reports(uint8_t* buffer, size_t capacity);
+    // When the next report is due, without waiting for it
+    std::chrono::steady_clock::time_point next_report_due();
+
+    uint64_t accel_reports() const;
+    uint64_t gyro_reports() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void start();
+    Clock::time_point due(uint64_t index, double hz) const;
+    bool accel_next() const;
+
+    Config config_;
+    std::mt19937 rng_;
+    std::normal_distribution<double> noise_;
+    bool started_;
+    Clock::time_point start_;
+    uint64_t accel_index_;
+    uint64_t gyro_index_;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <memory>
+#include "transport.hpp"
+#include "simulated_device.hpp"
+#include "simulated_endpoint.hpp"
+#include "usb_capture_engine.hpp"
+
+// Transport backed by a SimulatedDevice. Payloads flow through the same
+// UsbCaptureEngine as real hardware, so everything above the transport runs
+// unchanged without a camera attached.
+class SimulatedTransport : public Transport {
+public:
+    explicit SimulatedTransport(const SimulatedDevice::Config& device_config,
+                                const SimulatedEndpoint::Config& endpoint_config = SimulatedEndpoint::Config());
+    ~SimulatedTransport() override;
+
+    bool open() override;
+    bool start(FramePool& pool, PayloadCallback on_payload) override;
+    void stop() override;
+    const char* name() const override;
+    bool reconnect(unsigned int timeout_ms) override;
+    bool probe(const StreamProfile& requested, StreamProfile& negotiated) override;
+    bool commit(const StreamProfile& profile) override;
+
+    SimulatedDevice& device();
+    UsbCaptureEngine::Stats engine_stats() const;
+
+private:
+    SimulatedDevice device_;
+    SimulatedEndpoint::Config endpoint_config_;
+    std::unique_ptr<SimulatedEndpoint> endpoint_;
+    std::unique_ptr<UsbCaptureEngine> capture_engine_;
+};
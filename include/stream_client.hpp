@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "delta_codec.hpp"
+#include "depth_codec.hpp"
+#include "stream_protocol.hpp"
+
+// Receives depth frames from a StreamServer over TCP. connect() sends the
+// hello describing the stream wanted; receive() then blocks for the next
+// frame and hands back its pixels, decoded if the server compressed them,
+// and with delta frames applied to the frame before. Like FrameSubscriber it
+// needs no camera or USB code.
+class StreamClient {
+public:
+    struct Config {
+        std::string host = "127.0.0.1";
+        int port = StreamProtocol::DEFAULT_PORT;
+        int decimation = 1;             // 1, 2 or 4
+        RecordCodec codec = RecordCodec::Raw;
+        int queue_frames = 0;           // 0 for the server's default
+        bool delta = false;             // Ask for delta frames; receive() still returns whole images
+    };
+
+    struct FrameInfo {
+        int width = 0;
+        int height = 0;
+        RecordCodec codec = RecordCodec::Raw;
+        bool delta = false;             // Arrived as the tiles that changed
+        size_t wire_size = 0;           // Bytes received for the frame, header included
+        uint64_t sequence = 0;
+        uint64_t timestamp_ns = 0;      // Server steady clock when the frame landed
+        uint64_t queued_ns = 0;         // Server steady clock when it was queued for us
+        uint32_t device_timestamp = 0;
+        uint32_t dropped = 0;           // Frames the server dropped for us so far
+    };
+
+    StreamClient();
+    explicit StreamClient(const Config& config);
+    ~StreamClient();
+
+    StreamClient(const StreamClient&) = delete;
+    StreamClient& operator=(const StreamClient&) = delete;
+
+    bool connect();
+    void close();
+    bool is_connected() const;
+
+    // Waits up to timeout_ms for the next frame to start arriving and reads
+    // all of it into depth, resized to fit. Returns false on timeout or when
+    // the connection is lost or sends something malformed, after which the
+    // client is closed. Delta frames that cannot be applied, because their
+    // base frame never arrived, are skipped until the next keyframe.
+    bool receive(std::vector<uint16_t>& depth, FrameInfo& info, unsigned int timeout_ms);
+
+private:
+    bool read_fully(void* data, size_t size);
+
+    Config config_;
+    int fd_;
+    DepthCodec codec_;
+    std::vector<uint8_t> payload_;
+
+    // Delta streams: the last frame received, which the next delta applies to
+    DeltaDecoder delta_decoder_;
+    std::vector<uint16_t> image_;
+    uint64_t image_sequence_;
+    int image_width_;
+    int image_height_;
+};
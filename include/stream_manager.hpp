@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include "frame_assembler.hpp"
+#include "frame_mailbox.hpp"
+#include "frame_pool.hpp"
+#include "imu_sample_ring.hpp"
+#include "transfer_backend.hpp"
+#include "usb_capture_engine.hpp"
+
+enum class StreamKind { Depth, Color, Imu };
+
+// Captures several streams of one device together: depth and color as UVC
+// payloads assembled into frames, the IMU as HID reports decoded into
+// samples. Every stream keeps its own ring of transfers in flight, its own
+// frame pool and its own queue to the consumer, but one event thread
+// services them all, so the streams' backends must share an event loop
+// (one libusb context, one SimulatedBus). Transfers complete in the order
+// the device finishes them, and a stream that runs out of buffers only
+// parks its own reads, so a slow consumer on one stream never holds up the
+// others. For the same reason frames are always delivered DropOldest: a
+// producer blocking for one consumer would stall every stream. Depth frames
+// carry their DepthStats, worked out while they were assembled.
+class StreamManager {
+public:
+    static constexpr int STREAM_KINDS = 3;
+
+    struct StreamConfig {
+        StreamKind kind = StreamKind::Depth;
+        TransferBackend* backend = nullptr;
+        size_t transfer_size = 0;       // Bytes per read; for video, a whole UVC payload
+        int queue_depth = 4;            // Reads kept in flight
+        // Video only: bytes per frame, and frames held downstream or being
+        // assembled on top of the reads
+        size_t frame_size = 0;
+        int frame_count = 8;
+    };
+
+    struct Config {
+        int cpu = -1;                   // Pin the event thread here, -1 for anywhere
+        int priority = 0;               // SCHED_FIFO priority of the event thread, 0 for normal
+        // For every stream's pool; locked or huge-page pools of a pinned
+        // manager go on its CPU's NUMA node unless numa_node says otherwise
+        FrameMemory::Options memory;
+        size_t imu_capacity = 4096;     // IMU samples held for the consumer
+        std::string metrics_prefix;     // Prepended to every metric name
+        // Called once, on the event thread, when the device disappears
+        std::function<void()> on_device_lost;
+    };
+
+    struct Stats {
+        UsbCaptureEngine::Stats transfers;
+        FrameAssembler::Stats assembly; // Video
+        uint64_t frames = 0;            // Video: frames published
+        uint64_t samples = 0;           // IMU: samples decoded
+        uint64_t invalid_reports = 0;   // IMU: reports with an unknown ID or cut short
+    };
+
+    StreamManager();
+    explicit StreamManager(const Config& config);
+    ~StreamManager();
+
+    StreamManager(const StreamManager&) = delete;
+    StreamManager& operator=(const StreamManager&) = delete;
+
+    // One stream of each kind, added before start()
+    bool add_stream(const StreamConfig& config);
+    bool has_stream(StreamKind kind) const;
+    static const char* name(StreamKind kind);
+
+    bool start();
+    void stop();
+    bool is_running() const;
+
+    // Waits up to timeout_ms for the next depth or color frame; 0 polls.
+    // Handles must not outlive the manager.
+    bool get_frame(StreamKind kind, Frame& frame, unsigned int timeout_ms = 1000);
+    // Copies up to max_samples IMU samples, oldest first, waiting up to
+    // timeout_ms for the first one
+    size_t read_imu(ImuSample* samples, size_t max_samples, unsigned int timeout_ms = 100);
+
+    Stats stats(StreamKind kind) const;
+    FramePool::Stats pool_stats(StreamKind kind) const;
+    FrameMailbox::Stats mailbox_stats(StreamKind kind) const;
+    ImuSampleRing::Stats imu_stats() const;
+
+private:
+    struct Stream {
+        explicit Stream(const StreamConfig& config);
+
+        StreamConfig config;
+        std::unique_ptr<FramePool> pool;
+        std::unique_ptr<UsbCaptureEngine> engine;
+        FrameMailbox mailbox;
+        FrameAssembler assembler;
+        uint64_t sequence = 0;
+        std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> samples{0};
+        std::atomic<uint64_t> invalid_reports{0};
+    };
+
+    void on_video_payload(Stream& stream, Frame& payload);
+    void on_imu_payload(Stream& stream, Frame& payload);
+    void on_device_lost();
+    void event_loop();
+    void register_metrics(Stream& stream);
+
+    Config config_;
+    std::unique_ptr<Stream> streams_[STREAM_KINDS];
+    TransferBackend* events_;           // Services every stream's transfers
+    ImuSampleRing imu_ring_;
+    std::thread event_thread_;
+    std::atomic<bool> running_;
+    std::atomic<bool> device_lost_;
+};
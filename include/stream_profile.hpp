@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A depth stream mode: resolution and frame rate of Z16 frames. Which modes
+// a particular camera accepts (a USB 2 link cuts the list down) is settled
+// by UVC probe/commit negotiation in the transport; the table here is what
+// the D435i offers and what the command line accepts.
+struct StreamProfile {
+    int width = 640;
+    int height = 480;
+    int fps = 30;
+
+    size_t pixels() const { return static_cast<size_t>(width) * height; }
+    size_t frame_size() const { return pixels() * sizeof(uint16_t); }
+    bool operator==(const StreamProfile& other) const {
+        return width == other.width && height == other.height && fps == other.fps;
+    }
+    bool operator!=(const StreamProfile& other) const { return !(*this == other); }
+
+    // "848x480@90"
+    std::string to_string() const;
+    // Reads "WxH@FPS", or "WxH" keeping the frame rate already in profile
+    static bool parse(const std::string& text, StreamProfile& profile);
+
+    static const std::vector<StreamProfile>& table();
+
+    // The mode in offered nearest to requested: the same resolution at the
+    // nearest frame rate if there is one, otherwise the resolution nearest
+    // in pixel count. Fails only when nothing is offered.
+    static bool closest(const std::vector<StreamProfile>& offered, const StreamProfile& requested,
+                        StreamProfile& chosen);
+};
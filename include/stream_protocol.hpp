@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "recording_format.hpp"
+
+// Wire format of the TCP depth stream, little-endian.
+//
+// After connecting, the client sends one StreamHello saying how it wants
+// the stream. The server then sends frames for as long as the connection
+// lasts, each a StreamFrameHeader followed by size bytes of data: Z16
+// pixels, or with RecordCodec::Lossless a DepthCodec encoding of them.
+// The server never waits for a slow client; frames it has no room to queue
+// for that client are dropped, and each header carries the running count.
+//
+// A client that sets HELLO_DELTA in its hello may get delta frames: flagged
+// FRAME_DELTA, they carry only the tiles that changed since the frame
+// numbered base_sequence (see delta_codec.hpp) and raw_size is still that of
+// the whole image. Every so often comes a frame flagged FRAME_KEYFRAME,
+// which is complete. A client missing a delta's base frame waits for the
+// next keyframe. Servers that know nothing of deltas ignore the flag.
+struct StreamProtocol {
+    static constexpr uint32_t HELLO_MAGIC = 0x49485352;   // "RSHI"
+    static constexpr uint32_t FRAME_MAGIC = 0x52465352;   // "RSFR"
+    static constexpr uint16_t VERSION = 1;
+    static constexpr int DEFAULT_PORT = 5555;
+
+    // StreamHello::flags
+    static constexpr uint32_t HELLO_DELTA = 1;
+    // StreamFrameHeader::flags
+    static constexpr uint16_t FRAME_KEYFRAME = 1;
+    static constexpr uint16_t FRAME_DELTA = 2;
+};
+
+struct StreamHello {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t codec;                 // RecordCodec
+    uint16_t decimation;            // 1, 2 or 4
+    uint16_t queue_frames;          // 0 for the server's default
+    uint32_t flags;                 // HELLO_DELTA
+};
+
+struct StreamFrameHeader {
+    uint32_t magic;
+    uint16_t codec;                 // RecordCodec
+    uint16_t flags;                 // FRAME_KEYFRAME or FRAME_DELTA, 0 without deltas
+    uint32_t width;
+    uint32_t height;
+    uint32_t size;                  // Bytes of data following the header
+    uint32_t raw_size;              // Bytes once decoded
+    uint64_t sequence;
+    uint64_t timestamp_ns;          // Server steady clock when the frame landed
+    uint64_t queued_ns;             // Server steady clock when it was queued for this client
+    uint32_t device_timestamp;      // UVC PTS
+    uint32_t dropped;               // Frames dropped for this client so far
+    uint64_t base_sequence;         // Delta frames: the frame they apply to
+};
+
+static_assert(sizeof(StreamHello) == 16, "hello layout");
+static_assert(sizeof(StreamFrameHeader) == 64, "frame header layout");
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "delta_codec.hpp"
+#include "depth_codec.hpp"
+#include "depth_filter.hpp"
+#include "frame_pool.hpp"
+#include "stream_protocol.hpp"
+
+// Serves depth frames to TCP clients (see stream_protocol.hpp). One thread
+// runs an epoll loop over the listening socket and every client, all
+// non-blocking. publish() copies a frame into the server's own pool once
+// and hands it to that thread; clients asking for the same decimation and
+// codec share one prepared copy, and each client's queued frames go out
+// with scatter-gather sends straight from the pooled buffers, several
+// frames per system call when a client is behind. Each client's queue is
+// bounded: when it is full the oldest unsent frame is dropped, so a slow
+// client loses frames instead of holding up the others or the camera.
+//
+// Clients that ask for delta frames get only the tiles that changed, from
+// one DeltaEncoder per decimation shared by all of them, and a keyframe
+// every so often. A delta client that joins or loses a frame is sent
+// nothing until the next keyframe, which it then asks for.
+class StreamServer {
+public:
+    struct Config {
+        std::string address = "0.0.0.0";
+        int port = StreamProtocol::DEFAULT_PORT;   // 0 picks a free port
+        int width = 640;
+        int height = 480;
+        int max_clients = 16;
+        int queue_frames = 4;           // Per client, unless the client asks for fewer
+        int pool_frames = 32;
+        DeltaEncoder::Config delta;     // For clients asking for delta frames
+    };
+
+    struct ClientInfo {
+        std::string peer;
+        int decimation = 1;
+        RecordCodec codec = RecordCodec::Raw;
+        bool delta = false;
+        uint64_t sent = 0;
+        uint64_t dropped = 0;
+        uint64_t bytes = 0;
+        size_t queued = 0;
+    };
+
+    struct Stats {
+        size_t clients = 0;
+        uint64_t published = 0;
+        uint64_t ingest_dropped = 0;    // publish() found no free buffer or the loop was still busy
+        uint64_t sent = 0;
+        uint64_t dropped = 0;
+        uint64_t bytes = 0;
+        uint64_t keyframes = 0;         // Sent to delta clients
+        uint64_t delta_frames = 0;
+        // Bytes delta frames saved against sending keyframes, as last sent
+        uint64_t delta_saved_bytes = 0;
+    };
+
+    StreamServer();
+    explicit StreamServer(const Config& config);
+    ~StreamServer();
+
+    StreamServer(const StreamServer&) = delete;
+    StreamServer& operator=(const StreamServer&) = delete;
+
+    bool start();
+    void stop();
+    bool is_running() const;
+    // The port actually listened on
+    int port() const;
+
+    // Queues the frame for every client. Never waits for the network.
+    bool publish(const Frame& frame);
+
+    std::vector<ClientInfo> clients() const;
+    Stats stats() const;
+
+private:
+    static constexpr int MAX_EVENTS = 64;
+    static constexpr int MAX_IOVECS = 32;          // Header and data of 16 frames per send
+    static constexpr int SEND_BUFFER = 1 << 20;            // About two raw frames; the queue does the rest
+
+    struct Queued {
+        Frame frame;
+        StreamFrameHeader header;
+        size_t saved = 0;               // Delta frames: bytes fewer than a keyframe
+    };
+
+    struct Client {
+        int fd = -1;
+        std::string peer;
+        StreamHello hello{};
+        size_t hello_received = 0;
+        bool streaming = false;
+        int decimation = 1;
+        RecordCodec codec = RecordCodec::Raw;
+        bool delta = false;
+        bool need_keyframe = false;     // Deltas are no use until the next keyframe
+        size_t queue_limit = 0;
+        std::deque<Queued> queue;
+        size_t front_sent = 0;          // Bytes of the front frame, header included, already sent
+        bool want_write = false;
+        std::atomic<uint64_t> sent{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<size_t> queued{0};
+    };
+
+    // A published frame as one kind of client wants it
+    struct Variant {
+        int decimation;
+        RecordCodec codec;
+        bool delta;
+        Frame frame;
+        int width;
+        int height;
+        uint16_t flags = 0;             // StreamFrameHeader::flags
+        uint64_t base_sequence = 0;
+        size_t saved = 0;
+    };
+
+    // Delta encoding of one decimation, kept from frame to frame
+    struct DeltaStream {
+        int decimation;
+        DeltaEncoder encoder;
+        uint64_t distributed = 0;       // distribute() call the encoder last took a frame in
+        bool delta = false;             // That frame goes out as a delta
+        uint64_t sequence = 0;          // Its sequence number, and the one before
+        uint64_t base_sequence = 0;
+        size_t keyframe_size[2] = {};   // Of the last keyframe, per RecordCodec
+
+        DeltaStream(int decimation, const DeltaEncoder::Config& config) : decimation(decimation), encoder(config) {}
+    };
+
+    void event_loop();
+    void accept_clients();
+    void read_client(Client& client);
+    void flush_client(Client& client);
+    void set_want_write(Client& client, bool want);
+    void drop_client(Client& client);
+    void distribute(Frame frame);
+    void drop_oldest(Client& client);
+    const Variant* variant(const Frame& frame, int decimation, RecordCodec codec, bool delta);
+    const Variant* delta_variant(const Frame& frame, int decimation, RecordCodec codec);
+    DeltaStream* delta_stream(int decimation);
+    void request_keyframe(int decimation);
+    void register_metrics();
+
+    Config config_;
+    int listen_fd_;
+    int epoll_fd_;
+    int event_fd_;
+    int port_;
+    std::thread thread_;
+    std::atomic<bool> running_;
+
+    FramePool pool_;
+    std::mutex pending_mutex_;
+    Frame pending_;                     // Published, not yet picked up by the loop
+
+    mutable std::mutex clients_mutex_;  // Guards the list, not the clients' queues
+    std::vector<std::unique_ptr<Client>> clients_;
+    std::atomic<size_t> streaming_clients_;
+
+    // Event loop only
+    std::vector<Variant> variants_;
+    std::vector<std::unique_ptr<DeltaStream>> delta_streams_;
+    uint64_t distributed_;
+    DecimationFilter decimate_by_2_;
+    DecimationFilter decimate_by_4_;
+    DepthCodec codec_;
+    std::vector<uint8_t> encoded_;
+
+    std::atomic<uint64_t> published_;
+    std::atomic<uint64_t> ingest_dropped_;
+    std::atomic<uint64_t> sent_;
+    std::atomic<uint64_t> dropped_;
+    std::atomic<uint64_t> bytes_;
+    std::atomic<uint64_t> keyframes_;
+    std::atomic<uint64_t> delta_frames_;
+    std::atomic<uint64_t> delta_saved_bytes_;
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+// Pins threads to CPUs so each camera's capture and pipeline threads stay
+// on cores of their own, and lifts capture threads to real-time priority so
+// other load cannot preempt them long enough for the device's FIFO to
+// overflow. Both are best effort: where the platform does not support them,
+// or the process lacks the privilege, the calls fail and the thread keeps
+// running as before.
+class ThreadAffinity {
+public:
+    // CPUs this process may run on
+    static int cpu_count();
+    // Pins the calling thread to one CPU. A negative cpu does nothing.
+    static bool pin_current_thread(int cpu);
+    // Runs the calling thread SCHED_FIFO at priority, 1 to 99. 0 does
+    // nothing. Needs CAP_SYS_NICE or an RLIMIT_RTPRIO allowance.
+    static bool set_realtime_priority(int priority);
+    // NUMA node of cpu, -1 if unknown or cpu is negative
+    static int numa_node(int cpu);
+};
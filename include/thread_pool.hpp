@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel frame processing. run()
+// gives each thread, the caller included, an even contiguous share of the
+// task indices; a thread that runs out steals the back half of what is left
+// of another's, so neighbouring tasks mostly stay on one core while uneven
+// work still evens out. run() returns once every task has finished. Nothing
+// is allocated per call.
+class ThreadPool {
+public:
+    // threads counts the caller too; 0 means one per hardware thread.
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Threads that execute tasks, including the caller of run()
+    int size() const;
+
+    // Calls fn(task) for every task in [0, tasks), tasks < 2^32. Concurrent
+    // run() calls are serialized.
+    template <typename Fn>
+    void run(size_t tasks, Fn&& fn) {
+        using Callable = typename std::remove_reference<Fn>::type;
+        run_tasks(tasks, [](void* context, size_t task) { (*static_cast<Callable*>(context))(task); }, &fn);
+    }
+
+    // Process-wide pool shared by the processing stages
+    static ThreadPool& shared();
+
+private:
+    using TaskFn = void (*)(void* context, size_t task);
+
+    // Tasks [begin, end) still to run, packed as end << 32 | begin so that
+    // the owner taking the front and thieves taking the back agree through
+    // one compare-and-swap. On its own line so owners do not contend.
+    struct alignas(64) TaskRange {
+        std::atomic<uint64_t> bounds{0};
+    };
+
+    void run_tasks(size_t tasks, TaskFn fn, void* context);
+    void execute(int slot);
+    bool steal(int slot, size_t& task);
+    void worker_loop(int slot);
+
+    std::vector<std::thread> workers_;
+    std::mutex run_mutex_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    uint64_t generation_;
+    int active_workers_;
+    bool stopping_;
+
+    TaskFn fn_;
+    void* context_;
+    std::unique_ptr<TaskRange[]> ranges_;   // One per thread, the caller's first
+};
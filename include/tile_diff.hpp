@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "cpu_features.hpp"
+
+// Finds which square tiles of a depth image changed since the last one, so
+// texture uploads and network streams can carry only those. A tile is dirty
+// when any of its pixels differs from the reference by more than the
+// threshold. Dirty tiles are then copied into the reference, which so holds
+// what a consumer that applied every update has, not simply the previous
+// frame: a slow drift cannot hide under the threshold, since no pixel ever
+// strays further than that from what the consumer last got. SIMD kernels are
+// picked at run time like the colorizer's and give the scalar result.
+class TileDiff {
+public:
+    static constexpr int TILE_SIZE = 32;
+
+    TileDiff();
+
+    void set_simd_level(SimdLevel level);
+    SimdLevel simd_level() const;
+
+    // Largest change a clean tile may hide, in depth units. 0 flags any
+    // change, so the consumer's copy is exact.
+    void set_threshold(uint16_t threshold);
+    uint16_t threshold() const;
+
+    // Sizes the reference for width x height images; the next update()
+    // marks every tile dirty. Tiles on the right and bottom edges are
+    // clipped to the image.
+    void configure(int width, int height);
+    int width() const;
+    int height() const;
+    int tiles_x() const;
+    int tiles_y() const;
+    size_t tile_count() const;
+
+    // The consumer lost its copy: the next update() marks every tile dirty
+    void invalidate();
+    // The consumer got image whole
+    void set_reference(const uint16_t* image);
+
+    // Compares image with the reference and copies the dirty tiles into it.
+    // mask gets one byte per tile, row by row, 1 if dirty. Returns the
+    // number of dirty tiles.
+    size_t update(const uint16_t* image, std::vector<uint8_t>& mask);
+
+    const uint16_t* reference() const;
+
+private:
+    SimdLevel simd_level_;
+    uint16_t threshold_;
+    int width_;
+    int height_;
+    int tiles_x_;
+    int tiles_y_;
+    bool valid_;
+    std::vector<uint16_t> reference_;
+};
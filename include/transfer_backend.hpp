@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+enum class TransferStatus {
+    Completed,
+    TimedOut,
+    Cancelled,
+    Stall,
+    NoDevice,
+    Overflow,
+    Error
+};
+
+struct TransferRequest;
+using TransferCompletionFn = void (*)(TransferRequest* request);
+
+// A single asynchronous read. The capture engine owns these; a backend fills
+// in actual_length/status and then invokes on_complete from handle_events().
+struct TransferRequest {
+    uint8_t* buffer = nullptr;
+    int length = 0;
+    int actual_length = 0;
+    TransferStatus status = TransferStatus::Completed;
+    TransferCompletionFn on_complete = nullptr;
+    void* user_data = nullptr;
+    void* backend_data = nullptr;
+    int index = 0;
+    uint64_t submitted_ns = 0;   // Set by the engine, for latency statistics
+};
+
+// Services asynchronous reads for one IN endpoint. Completions are only ever
+// delivered from inside handle_events(), mirroring libusb semantics, so the
+// engine can drive everything from a single event thread.
+class TransferBackend {
+public:
+    virtual ~TransferBackend() = default;
+
+    virtual bool prepare(TransferRequest* request) = 0;
+    virtual void release(TransferRequest* request) = 0;
+    // Queues the read. Returns Completed if it was queued, NoDevice if the
+    // device is gone, Error for any other failure.
+    virtual TransferStatus submit(TransferRequest* request) = 0;
+    virtual void cancel(TransferRequest* request) = 0;
+    // Clears a halt (stall) on the endpoint. Synchronous, so never called
+    // from inside handle_events().
+    virtual bool clear_halt() = 0;
+    virtual void handle_events(int timeout_ms) = 0;
+};
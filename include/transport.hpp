@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "frame_pool.hpp"
+#include "stream_profile.hpp"
+
+// Byte source underneath CameraDevice. A transport reads raw UVC bulk
+// payloads straight into buffers from the caller's pool and delivers them one
+// per callback, from whatever thread services it.
+class Transport {
+public:
+    using PayloadCallback = std::function<void(Frame& payload)>;
+    using LostCallback = std::function<void()>;
+
+    virtual ~Transport() = default;
+
+    virtual bool open() = 0;
+    virtual bool start(FramePool& pool, PayloadCallback on_payload) = 0;
+    virtual void stop() = 0;
+    virtual const char* name() const = 0;
+
+    // UVC probe, after open(): offers requested to the device and reports
+    // in negotiated the supported profile it settled on. Transports without
+    // a way to negotiate deliver whatever they are asked for.
+    virtual bool probe(const StreamProfile& requested, StreamProfile& negotiated) {
+        negotiated = requested;
+        return true;
+    }
+    // UVC commit of the profile probe() negotiated, before every start()
+    virtual bool commit(const StreamProfile& profile) {
+        (void)profile;
+        return true;
+    }
+
+    // After the device was lost mid-stream and stop() was called: waits up
+    // to timeout_ms for the same device to come back and reopens it, ready
+    // for start(). Transports that cannot reconnect fail at once.
+    virtual bool reconnect(unsigned int timeout_ms) {
+        (void)timeout_ms;
+        return false;
+    }
+
+    // Called once from the transport's thread when the device goes away
+    // while streaming. Set before start().
+    void set_lost_callback(LostCallback on_lost) { on_lost_ = std::move(on_lost); }
+
+    // Set before start(). The CPU the transport's thread is pinned to, -1
+    // for none, its SCHED_FIFO priority, 0 for normal scheduling, and a
+    // prefix keeping its metric names apart from those of other cameras.
+    void set_cpu(int cpu) { cpu_ = cpu; }
+    void set_priority(int priority) { priority_ = priority; }
+    void set_metrics_prefix(const std::string& prefix) { metrics_prefix_ = prefix; }
+
+protected:
+    LostCallback on_lost_;
+    int cpu_ = -1;
+    int priority_ = 0;
+    std::string metrics_prefix_;
+};
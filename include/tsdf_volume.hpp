@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "camera_intrinsics.hpp"
+#include "camera_pose.hpp"
+#include "thread_pool.hpp"
+
+// Fuses depth frames taken from known poses into a truncated signed
+// distance field: each voxel near a surface keeps a running average of its
+// distance to it, clamped to the truncation band. Only space near observed
+// surfaces is stored, as 8x8x8 voxel blocks found through a hash of their
+// block coordinates, so a room costs megabytes rather than a dense grid's
+// gigabytes. Blocks come from a pool of fixed-size chunks that is reused
+// after clear(), and never move, so integrate() can hand them to the
+// ThreadPool directly, one task per block.
+//
+// extract() turns blocks into surface points, where the distance changes
+// sign between neighbouring voxels. By default only the blocks integrate()
+// changed since the last extract(), so a consumer keeping points per block
+// replaces just those. Not thread-safe: integrate() and extract() run on
+// one thread, using the pool inside.
+class TsdfVolume {
+public:
+    static constexpr int BLOCK_SIZE = 8;    // Voxels along each side of a block
+    static constexpr int BLOCK_VOXELS = BLOCK_SIZE * BLOCK_SIZE * BLOCK_SIZE;
+
+    struct Config {
+        float voxel_size = 0.01f;           // Metres
+        float truncation = 0.04f;           // Metres either side of the surface
+        float depth_scale = 0.001f;         // Metres per depth unit
+        float min_depth = 0.2f;             // Depth outside this range is ignored, in metres
+        float max_depth = 4.0f;
+        uint16_t max_weight = 64;           // Frames averaged at most, so the map can follow change
+        size_t max_blocks = 65536;          // Pool limit; 2 KB of voxels per block
+        ThreadPool* pool = nullptr;         // nullptr = ThreadPool::shared()
+    };
+
+    struct BlockCoord {
+        int32_t x;
+        int32_t y;
+        int32_t z;
+    };
+
+    // Structure of arrays, world coordinates in metres. The points of
+    // blocks[i] are [offsets[i], offsets[i + 1]); a block without points no
+    // longer has surface in it.
+    struct SurfacePoints {
+        std::vector<BlockCoord> blocks;
+        std::vector<uint32_t> offsets;
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+        size_t count = 0;
+    };
+
+    struct Stats {
+        uint64_t frames = 0;            // integrate() calls
+        uint64_t integrate_ns = 0;      // Spent in them
+        size_t blocks = 0;              // Allocated
+        size_t memory_bytes = 0;        // Of the block pool
+        uint64_t blocks_dropped = 0;    // Not allocated for lack of pool
+        size_t last_blocks = 0;         // Blocks the last frame touched
+    };
+
+    TsdfVolume(const CameraIntrinsics& intrinsics, const Config& config);
+    ~TsdfVolume();
+
+    TsdfVolume(const TsdfVolume&) = delete;
+    TsdfVolume& operator=(const TsdfVolume&) = delete;
+
+    const CameraIntrinsics& intrinsics() const;
+    const Config& config() const;
+
+    // depth holds intrinsics().width * height values, seen from pose.
+    // Returns the number of blocks it updated.
+    size_t integrate(const uint16_t* depth, const CameraPose& pose);
+
+    // Surface points of the blocks changed since the last call, and of the
+    // neighbours below them whose edges they share; of every block if
+    // changed_only is false. Returns points.count.
+    size_t extract(SurfacePoints& points, bool changed_only = true);
+
+    // Empties the volume, keeping the pool's memory
+    void clear();
+
+    Stats stats() const;
+
+private:
+    static constexpr int ROWS_PER_BAND = 16;
+    static constexpr size_t BLOCKS_PER_CHUNK = 256;
+    static constexpr uint32_t NO_BLOCK = 0xffffffffu;
+    static constexpr uint64_t NO_KEY = ~0ull;
+
+    // Distance in truncations, scaled to +-32767; weight 0 is unobserved
+    struct Voxel {
+        int16_t sdf;
+        uint16_t weight;
+    };
+
+    struct alignas(64) Block {
+        Voxel voxels[BLOCK_VOXELS];     // x fastest, then y, then z
+        BlockCoord coord;
+        uint32_t frame;                 // Last integrate() to touch it
+        uint32_t pass;                  // Last extract() to list it
+        bool changed;                   // Updated by the current integrate()
+        bool queued;                    // In changed_
+    };
+
+    struct Entry {
+        uint64_t key;
+        uint32_t block;
+    };
+
+    uint32_t find(uint64_t key) const;
+    uint32_t find(int64_t x, int64_t y, int64_t z) const;
+    uint32_t find_or_allocate(uint64_t key);
+    void grow_table();
+    Block& block(uint32_t index) const;
+
+    void collect_band(const uint16_t* depth, const CameraPose& camera_to_world, size_t band);
+    bool integrate_block(Block& block, const uint16_t* depth, const CameraPose& world_to_camera) const;
+    size_t surface_points(const Block& block, float* x, float* y, float* z) const;
+
+    CameraIntrinsics intrinsics_;
+    Config config_;
+    ThreadPool* pool_;
+    float block_extent_;    // Metres along a block's side
+
+    // Ray direction per column (x/z) and per row (y/z)
+    std::vector<float> ray_x_;
+    std::vector<float> ray_y_;
+
+    // Open addressing with linear probing, a power of two in size
+    std::vector<Entry> table_;
+    size_t table_used_;
+
+    std::vector<std::unique_ptr<Block[]>> chunks_;
+    uint32_t block_count_;
+
+    uint32_t frame_;
+    uint32_t pass_;
+    std::vector<std::vector<uint64_t>> band_keys_;  // Block keys each band of rows hits
+    std::vector<uint32_t> touched_;                 // Blocks of the current frame
+    std::vector<uint32_t> changed_;                 // Blocks changed since extract()
+    std::vector<uint32_t> extracting_;
+    std::vector<uint32_t> point_counts_;
+
+    std::atomic<uint64_t> frames_;
+    std::atomic<uint64_t> integrate_ns_;
+    std::atomic<uint64_t> blocks_;
+    std::atomic<uint64_t> pool_bytes_;
+    std::atomic<uint64_t> blocks_dropped_;
+    std::atomic<uint64_t> last_blocks_;
+};
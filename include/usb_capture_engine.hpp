@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <memory>
+#include <string>
+#include <vector>
+#include "frame_pool.hpp"
+#include "metrics.hpp"
+#include "transfer_backend.hpp"
+
+// Keeps a ring of large asynchronous reads in flight against a TransferBackend
+// and services their completions from a dedicated event thread, so the bus is
+// never idle waiting for the host to ask for more data. Every transfer reads
+// straight into a pooled Frame.
+//
+// Engines whose backends share one event loop (the endpoints of one device)
+// can also run without a thread of their own, driven by the owner's; see
+// StreamManager.
+class UsbCaptureEngine {
+public:
+    struct Config {
+        size_t transfer_size = 256 * 1024;
+        int queue_depth = 8;
+        // Buffers to read into. Without one the engine allocates its own
+        // pool of queue_depth buffers of transfer_size bytes.
+        FramePool* pool = nullptr;
+        int cpu = -1;                   // Pin the event thread here, -1 for anywhere
+        int priority = 0;               // SCHED_FIFO priority of the event thread, 0 for normal
+        // For the engine's own pool. Locked or huge-page buffers of a pinned
+        // engine go on its CPU's NUMA node unless numa_node says otherwise.
+        FrameMemory::Options memory;
+        std::string metrics_prefix;     // Prepended to every metric name
+        // Called once, on the event thread, when the device disappears, or
+        // when transfers keep failing through max_retries rounds of retries
+        std::function<void()> on_device_lost;
+        int max_retries = 8;
+        // Without an event thread of its own, the owner calls the backend's
+        // handle_events() and then poll(), until in_flight() drops to zero
+        // after cancel(), and only then stop().
+        bool event_thread = true;
+    };
+
+    struct Stats {
+        uint64_t bytes = 0;
+        uint64_t transfers = 0;
+        uint64_t zero_length = 0;
+        uint64_t timeouts = 0;
+        uint64_t errors = 0;
+        uint64_t starved = 0;   // Times no free buffer was available to resubmit
+    };
+
+    // Invoked on the event thread for every completed transfer with data.
+    // The callback may keep the frame by moving it out; otherwise the buffer
+    // is reused for the next read.
+    using PayloadCallback = std::function<void(Frame& payload)>;
+
+    UsbCaptureEngine(TransferBackend& backend, const Config& config);
+    ~UsbCaptureEngine();
+
+    UsbCaptureEngine(const UsbCaptureEngine&) = delete;
+    UsbCaptureEngine& operator=(const UsbCaptureEngine&) = delete;
+
+    bool start(PayloadCallback on_payload);
+    void stop();
+    bool is_running() const;
+    Stats stats() const;
+
+    // For an owner driving the engine's events: poll() resubmits transfers
+    // that were waiting for a buffer or to be retried, starved() says some
+    // are, so events should be polled for briefly. cancel() starts stopping.
+    void poll();
+    bool starved() const;
+    int in_flight() const;
+    void cancel();
+
+private:
+    static void on_transfer_complete(TransferRequest* request);
+    void handle_completion(TransferRequest* request);
+    void event_loop();
+    bool arm(TransferRequest* request);
+    void park(TransferRequest* request);
+    void rearm_parked();
+    void transfer_failed(TransferRequest* request, TransferStatus status);
+    void device_lost();
+
+    TransferBackend& backend_;
+    Config config_;
+    PayloadCallback on_payload_;
+
+    std::unique_ptr<FramePool> own_pool_;
+    FramePool* pool_;
+    std::vector<TransferRequest> requests_;
+    std::vector<Frame> request_frames_;
+    std::vector<bool> parked_;
+    int parked_count_;
+
+    // Failed transfers are parked and retried in rounds, each after twice
+    // the pause of the one before. Event thread only.
+    static constexpr uint64_t RETRY_MIN_NS = 1000000;
+    static constexpr uint64_t RETRY_MAX_NS = 100000000;
+    uint64_t retry_at_ns_;          // When the current round may rearm
+    uint64_t retry_delay_ns_;       // Its pause; 0 after a success
+    int failed_rounds_;
+    bool halted_;                   // A transfer stalled; clear before rearming
+    std::thread event_thread_;
+    bool started_;
+    std::atomic<bool> running_;
+    std::atomic<int> in_flight_;
+
+    std::atomic<uint64_t> bytes_;
+    std::atomic<uint64_t> transfers_;
+    std::atomic<uint64_t> zero_length_;
+    std::atomic<uint64_t> timeouts_;
+    std::atomic<uint64_t> errors_;
+    std::atomic<uint64_t> starved_;
+    LatencyHistogram& transfer_latency_;
+};
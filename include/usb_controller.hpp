@@ -1,21 +1,51 @@
 #pragma once
 
 #include <libusb-1.0/libusb.h>
+#include <string>
+#include <vector>
 
 class USBController {
 public:
     static constexpr uint16_t INTEL_VENDOR_ID = 0x8086;
     static constexpr uint16_t D435I_PRODUCT_ID = 0x0b3a;
 
+    struct DeviceInfo {
+        uint8_t bus = 0;
+        uint8_t address = 0;
+        std::string bus_path;           // Bus and port chain, e.g. "2-1.3"; stable across replugging
+        std::string serial;             // Empty if the device could not be opened to read it
+    };
+
     USBController();
     ~USBController();
 
-    bool connect_to_device(uint16_t vendor_id, uint16_t product_id);
+    // Every attached device with these IDs, in bus order
+    std::vector<DeviceInfo> list_devices(uint16_t vendor_id, uint16_t product_id);
+
+    // Opens the first device with these IDs whose serial number or bus path
+    // is selector, or the first one at all if selector is empty. A device
+    // already in its streaming configuration is used as it is; it is only
+    // reset when it is not, or when force_reset asks for it.
+    bool connect_to_device(uint16_t vendor_id, uint16_t product_id, const std::string& selector = std::string(),
+                           bool force_reset = false);
+    // Closes the device; interfaces must have been released
+    void disconnect();
+    // The device connect_to_device() opened
+    const DeviceInfo& connected_device() const;
     bool claim_interface(uint8_t interface_number);
     bool bulk_transfer(uint8_t endpoint, uint8_t* data, int length, int* actual_length, unsigned int timeout);
+    // Class request to an interface; the direction comes from request's top
+    // bit, as with UVC's GET_ requests. actual_length may be null.
+    bool interface_request(uint8_t request, uint16_t value, uint16_t interface_number, uint8_t* data,
+                           uint16_t length, int* actual_length, unsigned int timeout);
     libusb_device_handle* get_device_handle();
 
 private:
+    static std::string bus_path(libusb_device* device);
+    static std::string serial_number(libusb_device* device, const libusb_device_descriptor& descriptor);
+    static std::string read_serial(libusb_device_handle* handle, uint8_t index);
+
     libusb_device_handle* device_handle_;
+    DeviceInfo connected_;
     bool initialized_;
 };
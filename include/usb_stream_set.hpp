@@ -0,0 +1,64 @@
+#pragma once
+
+#include <libusb-1.0/libusb.h>
+#include <memory>
+#include <string>
+#include "libusb_transfer_backend.hpp"
+#include "stream_manager.hpp"
+#include "usb_controller.hpp"
+
+// The depth, color and IMU endpoints of one D435i, claimed and ready to hand
+// to a StreamManager. open() tells the two video streaming interfaces apart
+// by the formats they offer (Z16 for depth, YUY2 for color), finds the HID
+// interface carrying the IMU, claims all of them and commits each video
+// stream to its first mode of that format, at the device's default rate.
+// The backends all use libusb's default context, so they share one event
+// loop as StreamManager needs.
+//
+// Profiles other than the defaults are negotiated by UsbTransport, for depth
+// alone. The driver's --all-streams captures through this.
+class UsbStreamSet {
+public:
+    // selector picks a camera by serial number or bus path; empty takes the
+    // first one found
+    explicit UsbStreamSet(const std::string& selector = std::string());
+    ~UsbStreamSet();
+
+    UsbStreamSet(const UsbStreamSet&) = delete;
+    UsbStreamSet& operator=(const UsbStreamSet&) = delete;
+
+    // Succeeds if the device has at least one of the streams
+    bool open();
+    // After the StreamManager using the backends has stopped
+    void close();
+
+    bool has_stream(StreamKind kind) const;
+    // Fills in the backend and the transfer and frame sizes of kind; queue
+    // depth and frame count are left as they are
+    bool stream_config(StreamKind kind, StreamManager::StreamConfig& config);
+
+private:
+    static constexpr unsigned int TRANSFER_TIMEOUT_MS = 1000;
+    static constexpr unsigned int CONTROL_TIMEOUT_MS = 1000;
+
+    struct Endpoint {
+        bool found = false;
+        uint8_t interface_number = 0;
+        uint8_t address = 0;
+        uint16_t max_packet_size = 0;
+        bool interrupt = false;
+        uint8_t format_index = 0;       // Video: the Z16 or YUY2 format and its first frame
+        uint8_t frame_index = 0;
+        size_t frame_size = 0;          // Video: as committed
+        size_t payload_size = 0;
+        std::unique_ptr<LibusbTransferBackend> backend;
+    };
+
+    void find_endpoints();
+    bool commit_video(StreamKind kind, Endpoint& endpoint);
+
+    std::string selector_;
+    std::unique_ptr<USBController> usb_controller_;
+    libusb_device_handle* device_handle_;
+    Endpoint endpoints_[StreamManager::STREAM_KINDS];
+};
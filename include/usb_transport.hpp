@@ -0,0 +1,85 @@
+#pragma once
+
+#include <libusb-1.0/libusb.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "transport.hpp"
+#include "usb_controller.hpp"
+#include "libusb_transfer_backend.hpp"
+#include "usb_capture_engine.hpp"
+#include "uvc_protocol.hpp"
+
+// Transport for a physical D435i on the USB bus.
+//
+// Opening is kept short: a device still in its streaming configuration is
+// not reset, and the interface and endpoint layout found on the first open
+// is cached per device (by serial number, else bus path) for the life of
+// the process, so reopening skips the descriptor walk and endpoint probe.
+// reconnect() waits for the same device to reappear, woken by a libusb
+// hotplug callback where the platform has hotplug and polling otherwise.
+// The stream profile is negotiated with UVC probe/commit against the Z16
+// modes in the depth interface's descriptors.
+class UsbTransport : public Transport {
+public:
+    // selector picks a camera by serial number or bus path; empty takes the
+    // first one found
+    explicit UsbTransport(const std::string& selector = std::string());
+    ~UsbTransport() override;
+
+    bool open() override;
+    bool start(FramePool& pool, PayloadCallback on_payload) override;
+    void stop() override;
+    const char* name() const override;
+    bool reconnect(unsigned int timeout_ms) override;
+    bool probe(const StreamProfile& requested, StreamProfile& negotiated) override;
+    bool commit(const StreamProfile& profile) override;
+
+    libusb_device_handle* get_device_handle();
+
+private:
+    static constexpr unsigned int POLL_MS = 100;       // Reconnect polling without hotplug
+    static constexpr unsigned int CONTROL_TIMEOUT_MS = 1000;
+
+    // A Z16 mode from the descriptors, with the indices that select it
+    struct UvcMode {
+        StreamProfile profile;
+        uint8_t format_index;
+        uint8_t frame_index;
+        uint32_t frame_interval;
+    };
+
+    static int LIBUSB_CALL on_hotplug(libusb_context* context, libusb_device* device,
+                                      libusb_hotplug_event event, void* user_data);
+    bool open_device(bool force_reset);
+    void close_device();
+    bool find_depth_endpoint();
+    bool test_endpoint();
+    bool read_modes(std::vector<UvcMode>& modes);
+
+    std::string selector_;
+    std::string device_key_;            // Whatever identifies the opened device best, for reopening it
+    std::unique_ptr<USBController> usb_controller_;
+    libusb_device_handle* device_handle_;
+    bool layout_cached_;                // The layout below came from the cache
+    bool reset_tried_;
+
+    libusb_hotplug_callback_handle hotplug_handle_;
+    bool hotplug_registered_;
+    std::atomic<bool> arrived_;
+
+    // What the last probe settled on, committed before each start
+    UvcStreamingControl probed_;
+    int probed_length_;                 // 26 bytes from UVC 1.0 devices, 34 from later ones
+    StreamProfile probed_profile_;
+
+    std::unique_ptr<LibusbTransferBackend> transfer_backend_;
+    std::unique_ptr<UsbCaptureEngine> capture_engine_;
+
+    // Interface and endpoint numbers (will be set during open)
+    uint8_t DEPTH_INTERFACE;
+    uint8_t CONTROL_INTERFACE;
+    uint8_t DEPTH_ENDPOINT_IN;
+    uint16_t DEPTH_MAX_PACKET_SIZE;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "uvc_protocol.hpp"
+
+struct UvcPayloadHeader {
+    size_t length = 0;
+    uint8_t flags = 0;
+    bool fid = false;
+    bool end_of_frame = false;
+    bool error = false;
+    bool has_pts = false;
+    bool has_scr = false;
+    uint32_t pts = 0;
+    uint32_t scr_stc = 0;
+    uint16_t scr_sof = 0;
+};
+
+// Splits a stream of UVC bulk payloads into frames. Only the header is
+// examined; the caller moves the pixel data, at the offset the parser hands
+// back. Frame boundaries come from the FID toggle and EOF bit, and a frame is
+// only reported complete when exactly frame_size bytes arrived, so a lost or
+// short payload tears that one frame and the next one starts cleanly on its
+// first payload.
+//
+// Single-threaded: feed it from the thread that receives payloads.
+class UvcPayloadParser {
+public:
+    enum class FrameEnd { None, Complete, Torn };
+
+    struct Result {
+        UvcPayloadHeader header;
+        bool abort_frame = false;   // Discard the partially assembled frame first
+        bool accepted = false;      // data/length belong to the current frame at offset
+        bool frame_start = false;   // This payload opens a new frame
+        FrameEnd frame_end = FrameEnd::None;
+        const uint8_t* data = nullptr;
+        size_t length = 0;
+        size_t offset = 0;
+    };
+
+    struct Stats {
+        uint64_t payloads = 0;
+        uint64_t bytes = 0;
+        uint64_t frames = 0;
+        uint64_t torn_frames = 0;
+        uint64_t invalid_headers = 0;
+        uint64_t error_payloads = 0;
+    };
+
+    explicit UvcPayloadParser(size_t frame_size);
+
+    // Decodes just the header. Returns false if it is malformed.
+    static bool parse_header(const uint8_t* payload, size_t length, UvcPayloadHeader& header);
+
+    Result parse(const uint8_t* payload, size_t length);
+    void reset();
+
+    size_t frame_size() const;
+    const Stats& stats() const;
+
+private:
+    size_t frame_size_;
+    bool in_frame_;
+    bool frame_torn_;
+    bool current_fid_;
+    bool have_fid_;
+    size_t frame_bytes_;
+    Stats stats_;
+};
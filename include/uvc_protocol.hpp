@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// UVC 1.5 payload header layout (section 2.4.3.3 of the UVC spec).
+struct UvcHeader {
+    static constexpr uint8_t FID = 0x01;      // Frame ID, toggles every frame
+    static constexpr uint8_t EOF_BIT = 0x02;  // End of frame (EOF clashes with <cstdio>)
+    static constexpr uint8_t PTS = 0x04;      // Presentation time stamp present
+    static constexpr uint8_t SCR = 0x08;      // Source clock reference present
+    static constexpr uint8_t STI = 0x20;      // Still image
+    static constexpr uint8_t ERR = 0x40;      // Error bit
+    static constexpr uint8_t EOH = 0x80;      // End of header
+
+    static constexpr size_t MIN_LENGTH = 2;
+    static constexpr size_t MAX_LENGTH = 12;  // 2 + 4 byte PTS + 6 byte SCR
+};
+
+// Class-specific requests and descriptors of the video streaming interface
+// (sections 3.9 and 4.3 of the UVC spec).
+struct UvcStreaming {
+    static constexpr uint8_t SET_CUR = 0x01;
+    static constexpr uint8_t GET_CUR = 0x81;
+    static constexpr uint16_t PROBE_CONTROL = 0x01;     // Control selectors, sent in wValue's high byte
+    static constexpr uint16_t COMMIT_CONTROL = 0x02;
+
+    static constexpr uint8_t CS_INTERFACE = 0x24;
+    static constexpr uint8_t FORMAT_UNCOMPRESSED = 0x04;
+    static constexpr uint8_t FRAME_UNCOMPRESSED = 0x05;
+    static constexpr uint8_t HINT_FRAME_INTERVAL = 0x01; // bmHint: keep dwFrameInterval fixed
+
+    // Leading bytes of the format GUIDs: depth, and the color sensor's
+    static constexpr uint8_t Z16_FOURCC[4] = {'Z', '1', '6', ' '};
+    static constexpr uint8_t YUY2_FOURCC[4] = {'Y', 'U', 'Y', '2'};
+};
+
+// Probe and commit control block, UVC 1.1 layout. Multi-byte fields are
+// little-endian on the wire, as on the hosts this runs on.
+#pragma pack(push, 1)
+struct UvcStreamingControl {
+    uint16_t hint;
+    uint8_t format_index;
+    uint8_t frame_index;
+    uint32_t frame_interval;            // 100 ns units
+    uint16_t key_frame_rate;
+    uint16_t p_frame_rate;
+    uint16_t comp_quality;
+    uint16_t comp_window_size;
+    uint16_t delay;
+    uint32_t max_video_frame_size;
+    uint32_t max_payload_transfer_size;
+    uint32_t clock_frequency;
+    uint8_t framing_info;
+    uint8_t preferred_version;
+    uint8_t min_version;
+    uint8_t max_version;
+};
+#pragma pack(pop)
+static_assert(sizeof(UvcStreamingControl) == 34, "probe/commit control layout");
@@ -3,27 +3,205 @@
 #define GL_SILENCE_DEPRECATION
 #define GLFW_INCLUDE_GLCOREARB
 #include <GLFW/glfw3.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "colorizer.hpp"
+#include "frame_pool.hpp"
+#include "metrics.hpp"
+#include "tile_diff.hpp"
 
 class Visualizer {
 public:
+    // How depth frames reach the texture:
+    //  TexImage      - glTexImage2D every frame (reallocates, synchronous copy)
+    //  PboOrphan     - immutable texture, PBO ring re-specified each frame
+    //  PboPersistent - immutable texture, persistently mapped PBO ring with
+    //                  fences; needs GL 4.4 or ARB_buffer_storage
+    enum class UploadMode { TexImage, PboOrphan, PboPersistent };
+
+    struct StageTiming {
+        uint64_t count = 0;
+        double total_ms = 0.0;
+        double max_ms = 0.0;
+
+        double mean_ms() const { return count ? total_ms / count : 0.0; }
+    };
+
+    struct FrameTimings {
+        StageTiming upload;
+        StageTiming draw;
+        StageTiming readback;
+        StageTiming present;
+        StageTiming frame;
+    };
+
+    struct UploadStats {
+        uint64_t frames = 0;
+        uint64_t tiles = 0;
+        uint64_t dirty_tiles = 0;
+        uint64_t regions = 0;           // Sub-image uploads
+        uint64_t bytes = 0;             // Uploaded
+        uint64_t skipped_bytes = 0;     // Left out as unchanged
+    };
+
     Visualizer(int width, int height);
     ~Visualizer();
 
+    // Takes effect in initialize(); falls back to the best mode the context
+    // supports.
+    void set_upload_mode(UploadMode mode);
+    UploadMode upload_mode() const;
+
+    // Colormap and near/far clamp (depth units) applied by the fragment
+    // shader. Zero depth is drawn black.
+    void set_colormap(Colorizer::Colormap colormap);
+    void set_depth_range(uint16_t near_depth, uint16_t far_depth);
+
+    // Upload only the tiles of a frame that changed since the texture last
+    // got them, as the fewest rectangles that cover them. A tile whose
+    // pixels all moved by threshold depth units or less counts as unchanged,
+    // which skips sensor noise at the price of the picture being off by up
+    // to that much. On, with threshold 0, by default.
+    void set_dirty_tiles(bool enabled, uint16_t threshold = 0);
+
+    // Render into an offscreen framebuffer instead of a window. Uses an EGL
+    // surfaceless (or pbuffer) context where available, otherwise a hidden
+    // GLFW window. Set before initialize().
+    void set_headless(bool headless);
+    bool is_headless() const;
+
+    // Queue an asynchronous RGBA readback of every rendered frame into a PBO
+    // ring. Set before initialize().
+    void set_readback(bool enabled);
+    // Copies the most recent finished readback (a frame or two behind the
+    // last render) into rgba, which must hold width * height * 4 bytes.
+    bool read_snapshot(uint8_t* rgba, size_t size);
+
     bool initialize();
+    // Pass nullptr to redraw the current texture without uploading.
     void render_frame(const uint8_t* depth_data);
+    // Frames whose memory lies in the frame arena are uploaded straight from
+    // it; the visualizer holds a reference until the GPU is done reading.
+    void render_frame(const Frame& frame);
     bool should_close();
     void process_events();
 
+    // Persistently mapped GL buffer to build a FramePool on, so captured
+    // frames already sit in memory GL can source uploads from. Returns nullptr
+    // when the context cannot map buffers persistently.
+    uint8_t* map_frame_arena(size_t size);
+
+    FrameTimings timings() const;
+    void reset_timings();
+    UploadStats upload_stats() const;
+
 private:
+    static constexpr int PBO_RING_SIZE = 3;
+
+    using Clock = std::chrono::steady_clock;
+    using TexStorage2DFn = void (*)(GLenum, GLsizei, GLenum, GLsizei, GLsizei);
+    using BufferStorageFn = void (*)(GLenum, GLsizeiptr, const void*, GLbitfield);
+
+    bool create_window();
+    bool create_headless_context();
+    void destroy_context();
+    void* get_proc_address(const char* name);
     bool setup_gl();
+    bool setup_offscreen_target();
+    bool setup_upload_path();
     bool compile_shaders();
+    bool has_gl_support(int major, int minor, const char* extension);
+    struct Region {
+        int x;
+        int y;
+        int width;
+        int height;
+    };
+
     void update_texture(const uint8_t* depth_data);
+    bool update_texture_from_arena(const Frame& frame);
+    // Fills regions_ with rectangles covering what the texture lacks of
+    // the frame; false if it lacks nothing
+    bool find_dirty_regions(const uint8_t* depth_data);
+    // Copies regions_ between buffers laid out as whole frames
+    void copy_regions(const uint8_t* src, uint8_t* dst) const;
+    // Sub-image upload of each of regions_ from a whole frame at source: a
+    // pointer, or an offset into the bound unpack buffer
+    void upload_regions(const uint8_t* source);
+    void wait_for_fence(GLsync& fence);
+    void draw_and_present(Clock::time_point frame_start);
+    void queue_readback();
+    static void record(StageTiming& timing, Clock::time_point start, Clock::time_point end);
+    static void record(StageTiming& timing, LatencyHistogram& histogram, Clock::time_point start,
+                       Clock::time_point end);
 
     GLFWwindow* window_;
+    bool glfw_initialized_;
+    bool headless_;
+    bool readback_enabled_;
+
+    // EGL handles, kept opaque so the header does not need EGL
+    void* egl_display_;
+    void* egl_context_;
+    void* egl_surface_;
+
+    // Offscreen colour target for headless mode
+    GLuint framebuffer_;
+    GLuint color_texture_;
+
     int width_;
     int height_;
+    size_t frame_bytes_;
     GLuint texture_id_;
     GLuint shader_program_;
+    GLint colormap_location_;
+    GLint depth_range_location_;
+    Colorizer::Colormap colormap_;
+    uint16_t near_depth_;
+    uint16_t far_depth_;
+
+    UploadMode upload_mode_;
+    TexStorage2DFn tex_storage_2d_;
+    BufferStorageFn buffer_storage_;
+
+    // Staging ring for uploads from ordinary memory
+    GLuint pbos_[PBO_RING_SIZE];
+    uint8_t* pbo_ptrs_[PBO_RING_SIZE];
+    GLsync pbo_fences_[PBO_RING_SIZE];
+    int pbo_index_;
+
+    // Frame arena shared with the frame pool
+    GLuint arena_buffer_;
+    uint8_t* arena_ptr_;
+    size_t arena_size_;
+    Frame arena_frames_[PBO_RING_SIZE];
+    GLsync arena_fences_[PBO_RING_SIZE];
+    int arena_index_;
+
+    // Readback ring; readback_count_ is the number of reads ever queued
+    GLuint readback_pbos_[PBO_RING_SIZE];
+    GLsync readback_fences_[PBO_RING_SIZE];
+    uint64_t readback_count_;
+
+    FrameTimings timings_;
+    LatencyHistogram& upload_latency_;
+    LatencyHistogram& present_latency_;
+    LatencyHistogram& glass_to_glass_latency_;
+
+    // Dirty-tile tracking; tile_diff_'s reference is what the texture holds
+    bool dirty_tiles_;
+    TileDiff tile_diff_;
+    std::vector<uint8_t> tile_mask_;
+    std::vector<Region> regions_;
+    std::atomic<uint64_t> uploaded_frames_;
+    std::atomic<uint64_t> uploaded_tiles_;
+    std::atomic<uint64_t> dirty_tiles_uploaded_;
+    std::atomic<uint64_t> uploaded_regions_;
+    std::atomic<uint64_t> uploaded_bytes_;
+    std::atomic<uint64_t> skipped_bytes_;
 
     static const char* vertex_shader_source;
     static const char* fragment_shader_source;
@@ -1,113 +1,177 @@
 #include "camera_device.hpp"
-#include <iostream>
+#include "logger.hpp"
+#include "thread_affinity.hpp"
+#include "usb_transport.hpp"
+#include "uvc_protocol.hpp"
 #include <thread>
 #include <chrono>
 #include <iomanip>
 
+#define LOG_COMPONENT "camera"
+
 CameraDevice::CameraDevice()
-    : device_handle_(nullptr), is_streaming_(false),
-      DEPTH_INTERFACE(0), CONTROL_INTERFACE(1), DEPTH_ENDPOINT_IN(0x82) {
+    : CameraDevice(std::make_unique<UsbTransport>()) {
+}
+
+CameraDevice::CameraDevice(std::unique_ptr<Transport> transport)
+    : cpu_(-1), frame_pool_(make_frame_pool()),
+      mailbox_(std::make_unique<FrameMailbox>(FrameMailbox::Policy::DropOldest)),
+      transport_(std::move(transport)), is_streaming_(false),
+      assembler_(profile_.frame_size()), sequence_(0),
+      auto_reconnect_(true), device_lost_(false), recovering_(false), lost_ns_(0), startup_ns_(0),
+      frames_(0), disconnects_(0), reconnects_(0),
+      first_frame_ns_(0), last_recovery_ns_(0), recovery_ns_(0),
+      assembly_latency_(nullptr), delivery_latency_(nullptr), recovery_latency_(nullptr) {
+    assembler_.set_statistics(true);
+    set_name(std::string());
 }
 
 CameraDevice::~CameraDevice() {
     if (is_streaming_) {
         stop_streaming();
     }
-    if (device_handle_) {
-        libusb_release_interface(device_handle_, DEPTH_INTERFACE);
-        libusb_release_interface(device_handle_, CONTROL_INTERFACE);
+    Metrics::instance().remove(this);
+}
+
+void CameraDevice::set_delivery_policy(FrameMailbox::Policy policy) {
+    if (is_streaming_) {
+        LOG_ERROR("Cannot change delivery policy while streaming");
+        return;
     }
+    mailbox_ = std::make_unique<FrameMailbox>(policy);
 }
 
-bool CameraDevice::initialize() {
-    usb_controller_ = std::make_unique<USBController>();
-    if (!usb_controller_->connect_to_device(USBController::INTEL_VENDOR_ID, USBController::D435I_PRODUCT_ID)) {
-        std::cerr << "Failed to connect to RealSense device" << std::endl;
-        return false;
+void CameraDevice::set_frame_tap(FrameTap tap) {
+    if (is_streaming_) {
+        LOG_ERROR("Cannot change frame tap while streaming");
+        return;
     }
+    frame_tap_ = std::move(tap);
+}
 
-    device_handle_ = usb_controller_->get_device_handle();
-    if (!device_handle_) {
-        std::cerr << "Invalid device handle" << std::endl;
-        return false;
+void CameraDevice::set_name(const std::string& name) {
+    if (is_streaming_) {
+        LOG_ERROR("Cannot rename camera while streaming");
+        return;
     }
+    name_ = name;
+    metrics_prefix_ = name.empty() ? std::string() : name + "_";
+    transport_->set_metrics_prefix(metrics_prefix_);
+    assembly_latency_ = &Metrics::instance().histogram(
+        metrics_prefix_ + "frame_assembly", "From the first payload of a frame landing to the frame being complete");
+    delivery_latency_ = &Metrics::instance().histogram(
+        metrics_prefix_ + "frame_delivery", "From a frame being complete to the consumer taking it");
+    recovery_latency_ = &Metrics::instance().histogram(
+        metrics_prefix_ + "device_recovery", "From the device disappearing mid-stream to its next frame");
+}
 
-    std::cout << "Initializing camera..." << std::endl;
+const std::string& CameraDevice::name() const {
+    return name_;
+}
 
-    // Get device configuration
-    libusb_config_descriptor* config;
-    int result = libusb_get_active_config_descriptor(libusb_get_device(device_handle_), &config);
-    if (result < 0) {
-        std::cerr << "Failed to get config descriptor: " << libusb_error_name(result) << std::endl;
-        return false;
+void CameraDevice::set_cpu(int cpu) {
+    if (is_streaming_) {
+        LOG_ERROR("Cannot change capture CPU while streaming");
+        return;
     }
+    cpu_ = cpu;
+    transport_->set_cpu(cpu);
+}
 
-    // Find the depth streaming interface (Class 14, SubClass 2)
-    bool found_depth_interface = false;
-    for (int i = 0; i < config->bNumInterfaces; i++) {
-        const libusb_interface* interface = &config->interface[i];
-        for (int j = 0; j < interface->num_altsetting; j++) {
-            const libusb_interface_descriptor* interface_desc = &interface->altsetting[j];
-
-            std::cout << "Interface " << i << " Alt " << j << ":" << std::endl;
-            std::cout << "  bInterfaceNumber: " << (int)interface_desc->bInterfaceNumber << std::endl;
-            std::cout << "  bAlternateSetting: " << (int)interface_desc->bAlternateSetting << std::endl;
-            std::cout << "  bNumEndpoints: " << (int)interface_desc->bNumEndpoints << std::endl;
-            std::cout << "  bInterfaceClass: " << (int)interface_desc->bInterfaceClass << std::endl;
-            std::cout << "  bInterfaceSubClass: " << (int)interface_desc->bInterfaceSubClass << std::endl;
-
-            if (interface_desc->bInterfaceClass == 14 &&
-                interface_desc->bInterfaceSubClass == 2 &&
-                interface_desc->bNumEndpoints > 0) {
-
-                // Check for bulk endpoint
-                for (int k = 0; k < interface_desc->bNumEndpoints; k++) {
-                    const libusb_endpoint_descriptor* endpoint = &interface_desc->endpoint[k];
-                    std::cout << "  Endpoint " << k << ":" << std::endl;
-                    std::cout << "    bEndpointAddress: 0x" << std::hex << (int)endpoint->bEndpointAddress << std::dec << std::endl;
-                    std::cout << "    bmAttributes: 0x" << std::hex << (int)endpoint->bmAttributes << std::dec << std::endl;
-                    std::cout << "    wMaxPacketSize: " << endpoint->wMaxPacketSize << std::endl;
-
-                    // Check if this is a bulk IN endpoint
-                    if ((endpoint->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) == LIBUSB_TRANSFER_TYPE_BULK &&
-                        (endpoint->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_IN) {
-
-                        DEPTH_INTERFACE = interface_desc->bInterfaceNumber;
-                        DEPTH_ENDPOINT_IN = endpoint->bEndpointAddress;
-                        found_depth_interface = true;
-                        break;
-                    }
-                }
-            }
-
-            if (found_depth_interface) {
-                break;
-            }
-        }
-        if (found_depth_interface) {
-            break;
-        }
+void CameraDevice::set_realtime_priority(int priority) {
+    if (is_streaming_) {
+        LOG_ERROR("Cannot change capture priority while streaming");
+        return;
     }
+    transport_->set_priority(priority);
+}
 
-    libusb_free_config_descriptor(config);
+void CameraDevice::set_frame_memory_options(const FrameMemory::Options& options) {
+    if (is_streaming_) {
+        LOG_ERROR("Cannot change frame memory while streaming");
+        return;
+    }
+    memory_options_ = options;
+    frame_pool_ = make_frame_pool();
+}
+
+void CameraDevice::set_auto_reconnect(bool enabled) {
+    if (is_streaming_) {
+        LOG_ERROR("Cannot change reconnection while streaming");
+        return;
+    }
+    auto_reconnect_ = enabled;
+}
+
+void CameraDevice::set_profile(const StreamProfile& profile) {
+    if (is_streaming_) {
+        LOG_ERROR("Cannot change stream profile while streaming");
+        return;
+    }
+    requested_profile_ = profile;
+}
+
+const StreamProfile& CameraDevice::profile() const {
+    return profile_;
+}
 
-    if (!found_depth_interface) {
-        std::cerr << "Failed to find video streaming interface with bulk endpoint" << std::endl;
+bool CameraDevice::use_frame_memory(uint8_t* memory, size_t size) {
+    if (is_streaming_) {
+        LOG_ERROR("Cannot change frame memory while streaming");
+        return false;
+    }
+    if (!memory || size < frame_memory_size()) {
+        LOG_ERROR("Frame memory too small for %zu %s frames", FRAME_POOL_SIZE, profile_.to_string().c_str());
         return false;
     }
+    frame_pool_ = std::make_unique<FramePool>(memory, size, payload_buffer_size());
+    return true;
+}
+
+size_t CameraDevice::frame_memory_size() const {
+    return FramePool::required_memory(FRAME_POOL_SIZE, payload_buffer_size());
+}
+
+size_t CameraDevice::payload_buffer_size() const {
+    return (UvcHeader::MAX_LENGTH + profile_.frame_size() + 1023) / 1024 * 1024;
+}
+
+std::unique_ptr<FramePool> CameraDevice::make_frame_pool() const {
+    FrameMemory::Options memory = memory_options_;
+    if (memory.any() && memory.numa_node < 0) {
+        memory.numa_node = ThreadAffinity::numa_node(cpu_);
+    }
+    return std::make_unique<FramePool>(FRAME_POOL_SIZE, payload_buffer_size(), memory);
+}
 
-    // Claim the depth interface
-    if (!usb_controller_->claim_interface(DEPTH_INTERFACE)) {
-        std::cerr << "Failed to claim depth interface" << std::endl;
+bool CameraDevice::initialize() {
+    startup_ns_ = monotonic_ns();
+    if (!transport_->open()) {
+        LOG_ERROR("Failed to open %s transport", transport_->name());
         return false;
     }
 
+    LOG_INFO("Initializing camera...");
+
     // Send initialization sequence
     if (!send_init_sequence()) {
-        std::cerr << "Failed to send initialization sequence" << std::endl;
+        LOG_ERROR("Failed to send initialization sequence");
         return false;
     }
 
+    StreamProfile negotiated;
+    if (!transport_->probe(requested_profile_, negotiated)) {
+        LOG_ERROR("Failed to negotiate %s", requested_profile_.to_string().c_str());
+        return false;
+    }
+    if (negotiated != profile_ || frame_pool_->frame_capacity() < payload_buffer_size()) {
+        profile_ = negotiated;
+        assembler_.set_frame_size(profile_.frame_size());
+        // Memory handed in by the caller was sized for the old profile; it
+        // has to be handed in again
+        frame_pool_ = make_frame_pool();
+    }
+    LOG_INFO("Depth stream %s", profile_.to_string().c_str());
     return true;
 }
 
@@ -118,36 +182,30 @@ bool CameraDevice::start_streaming() {
 
     // Configure depth stream
     if (!configure_depth_stream()) {
-        std::cerr << "Failed to configure depth stream" << std::endl;
+        LOG_ERROR("Failed to configure depth stream");
         return false;
     }
 
-    // Clear any stall condition
-    int result = libusb_clear_halt(device_handle_, DEPTH_ENDPOINT_IN);
-    if (result < 0) {
-        std::cerr << "Failed to clear endpoint halt: " << libusb_error_name(result) << std::endl;
-        return false;
+    assembler_.reset();
+    mailbox_->reopen();
+    if (startup_ns_ == 0) {
+        startup_ns_ = monotonic_ns();
     }
+    device_lost_ = false;
+    recovering_ = false;
+    transport_->set_lost_callback(auto_reconnect_ ? [this] { on_device_lost(); } : Transport::LostCallback());
 
-    // Test the endpoint with exactly one packet size
-    std::vector<uint8_t> test_buffer(1024);  // Match the endpoint's wMaxPacketSize
-    int actual_length;
-
-    std::cout << "Testing depth endpoint with " << test_buffer.size() << " byte buffer..." << std::endl;
-
-    // Try multiple times in case the first few reads fail
-    for (int attempt = 0; attempt < 3; attempt++) {
-        if (usb_controller_->bulk_transfer(DEPTH_ENDPOINT_IN, test_buffer.data(), test_buffer.size(), &actual_length, 1000)) {
-            std::cout << "Successfully read " << actual_length << " bytes from depth endpoint" << std::endl;
-            is_streaming_ = true;
-            return true;
-        }
-        std::cout << "Attempt " << attempt + 1 << " failed (received " << actual_length << " bytes), retrying..." << std::endl;
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (!transport_->start(*frame_pool_, [this](Frame& payload) { on_payload(payload); })) {
+        LOG_ERROR("Failed to start %s transport", transport_->name());
+        return false;
     }
 
-    std::cerr << "Failed to test depth endpoint after multiple attempts" << std::endl;
-    return false;
+    is_streaming_ = true;
+    if (auto_reconnect_) {
+        recovery_thread_ = std::thread(&CameraDevice::recovery_loop, this);
+    }
+    register_metrics();
+    return true;
 }
 
 bool CameraDevice::stop_streaming() {
@@ -156,66 +214,187 @@ bool CameraDevice::stop_streaming() {
     }
 
     is_streaming_ = false;
+    Metrics::instance().remove(this);
+    if (recovery_thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(recovery_mutex_);
+            recovery_cv_.notify_one();
+        }
+        recovery_thread_.join();
+    }
+    recovering_ = false;
+    // Unblock a producer waiting on a full mailbox before joining it
+    mailbox_->close();
+    transport_->stop();
+    assembler_.reset();
+    mailbox_->reopen();
     return true;
 }
 
+bool CameraDevice::is_recovering() const {
+    return recovering_;
+}
+
+void CameraDevice::on_device_lost() {
+    // Runs on the transport's thread, which is on its way out
+    disconnects_.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(recovery_mutex_);
+    lost_ns_ = monotonic_ns();
+    recovering_ = true;
+    device_lost_ = true;
+    recovery_cv_.notify_one();
+}
+
+void CameraDevice::recovery_loop() {
+    std::unique_lock<std::mutex> lock(recovery_mutex_);
+    for (;;) {
+        recovery_cv_.wait(lock, [this] { return device_lost_ || !is_streaming_; });
+        if (!is_streaming_) {
+            return;
+        }
+        device_lost_ = false;
+        lock.unlock();
+
+        // The capture thread has stopped itself; reap it and let the device go
+        transport_->stop();
+        assembler_.reset();
+        LOG_WARN("Lost the %s device, waiting for it to come back", transport_->name());
+
+        // Same setup as a first start, minus the pool and the consumer side,
+        // which carry on as they were
+        bool resumed = false;
+        while (is_streaming_ && !resumed) {
+            resumed = transport_->reconnect(RECONNECT_WAIT_MS) && send_init_sequence() &&
+                      configure_depth_stream() &&
+                      transport_->start(*frame_pool_, [this](Frame& payload) { on_payload(payload); });
+        }
+        lock.lock();
+    }
+}
+
 bool CameraDevice::send_init_sequence() {
     // For now, we'll skip the initialization sequence since we need to understand
     // the exact protocol for the D435i camera
-    std::cout << "Skipping initialization sequence" << std::endl;
+    LOG_INFO("Skipping initialization sequence");
     return true;
 }
 
 bool CameraDevice::configure_depth_stream() {
-    // For now, we'll skip the stream configuration since we need to understand
-    // the exact protocol for the D435i camera
-    std::cout << "Skipping depth stream configuration" << std::endl;
+    // The profile was probed in initialize(); commit it for this stream
+    if (!transport_->commit(profile_)) {
+        LOG_ERROR("Failed to commit %s", profile_.to_string().c_str());
+        return false;
+    }
     return true;
 }
 
-bool CameraDevice::get_depth_frame(uint8_t* buffer, size_t buffer_size) {
-    if (!buffer || buffer_size != DEPTH_FRAME_SIZE) {
-        std::cerr << "Invalid buffer or size" << std::endl;
+bool CameraDevice::get_depth_frame(Frame& frame, unsigned int timeout_ms) {
+    if (!is_streaming_) {
+        LOG_ERROR("Streaming is not started");
         return false;
     }
 
-    if (!is_streaming_) {
-        std::cerr << "Streaming is not started" << std::endl;
-        return false;
+    bool delivered = timeout_ms == 0 ? mailbox_->try_consume(frame) : mailbox_->consume(frame, timeout_ms);
+    if (delivered) {
+        delivery_latency_->record_since(frame.metadata().assembled_ns);
     }
+    return delivered;
+}
 
-    size_t total_received = 0;
-    const size_t chunk_size = 1024;  // Match the endpoint's wMaxPacketSize
-    std::vector<uint8_t> chunk_buffer(chunk_size);
-    int zero_packets = 0;
-    const int max_zero_packets = 5;
-
-    while (total_received < buffer_size) {
-        int transferred = 0;
-        if (!usb_controller_->bulk_transfer(DEPTH_ENDPOINT_IN, chunk_buffer.data(), chunk_size, &transferred, 1000)) {
-            if (transferred == 0) {
-                zero_packets++;
-                if (zero_packets >= max_zero_packets) {
-                    std::cout << "Received too many zero-length packets, starting new frame" << std::endl;
-                    return false;
-                }
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                continue;
-            }
-            std::cerr << "Failed to read from endpoint" << std::endl;
-            return false;
-        }
+CameraDevice::Stats CameraDevice::stats() const {
+    Stats stats;
+    stats.frames = frames_.load(std::memory_order_relaxed);
+    FrameAssembler::Stats assembly = assembler_.stats();
+    stats.zero_copy_frames = assembly.zero_copy_frames;
+    stats.copied_bytes = assembly.copied_bytes;
+    stats.dropped_frames = assembly.dropped_frames;
+    stats.torn_frames = assembly.torn_frames;
+    stats.invalid_payloads = assembly.invalid_payloads;
+    stats.repeated_frames = assembly.repeated_frames;
+    stats.disconnects = disconnects_.load(std::memory_order_relaxed);
+    stats.reconnects = reconnects_.load(std::memory_order_relaxed);
+    stats.first_frame_ns = first_frame_ns_.load(std::memory_order_relaxed);
+    stats.last_recovery_ns = last_recovery_ns_.load(std::memory_order_relaxed);
+    stats.recovery_ns = recovery_ns_.load(std::memory_order_relaxed);
+    return stats;
+}
 
-        zero_packets = 0;
-        if (total_received + transferred > buffer_size) {
-            std::cerr << "Buffer overflow, truncating frame" << std::endl;
-            transferred = buffer_size - total_received;
-        }
+FramePool::Stats CameraDevice::pool_stats() const {
+    return frame_pool_->stats();
+}
+
+FrameMailbox::Stats CameraDevice::mailbox_stats() const {
+    return mailbox_->stats();
+}
 
-        memcpy(buffer + total_received, chunk_buffer.data(), transferred);
-        total_received += transferred;
-        std::cout << "Received " << transferred << " bytes (" << total_received << "/" << buffer_size << ")" << std::endl;
+void CameraDevice::on_payload(Frame& payload) {
+    // Runs on the transport's event thread
+    Frame frame;
+    if (assembler_.add(payload, *frame_pool_, frame)) {
+        publish(std::move(frame));
     }
+}
 
-    return true;
+void CameraDevice::register_metrics() {
+    // Registered only while streaming: the mailbox can be replaced otherwise
+    Metrics& metrics = Metrics::instance();
+    auto counter = [&](const char* name, const char* help, const std::atomic<uint64_t>& value) {
+        metrics.add(this, metrics_prefix_ + name, help, Metrics::Kind::Counter,
+                    [&value] { return static_cast<double>(value.load(std::memory_order_relaxed)); });
+    };
+    counter("frames_total", "Frames assembled and published", frames_);
+    auto assembly_counter = [&](const char* name, const char* help, uint64_t FrameAssembler::Stats::*field) {
+        metrics.add(this, metrics_prefix_ + name, help, Metrics::Kind::Counter,
+                    [this, field] { return static_cast<double>(assembler_.stats().*field); });
+    };
+    assembly_counter("frames_zero_copy_total", "Frames published straight from the transfer buffer",
+                     &FrameAssembler::Stats::zero_copy_frames);
+    assembly_counter("frames_no_buffer_total", "Frames dropped for lack of a buffer to assemble into",
+                     &FrameAssembler::Stats::dropped_frames);
+    assembly_counter("frames_torn_total", "Frames lost to missing, short or corrupt payloads",
+                     &FrameAssembler::Stats::torn_frames);
+    assembly_counter("invalid_payloads_total", "Payloads without a valid UVC header",
+                     &FrameAssembler::Stats::invalid_payloads);
+    assembly_counter("frames_repeated_total", "Frames identical to the one before, as from a stuck sensor",
+                     &FrameAssembler::Stats::repeated_frames);
+    counter("device_disconnects_total", "Times the device went away mid-stream", disconnects_);
+    counter("device_reconnects_total", "Times streaming resumed after the device came back", reconnects_);
+    metrics.add(this, metrics_prefix_ + "first_frame_seconds", "From initialization to the first frame",
+                Metrics::Kind::Gauge, [this] { return first_frame_ns_.load(std::memory_order_relaxed) / 1e9; });
+    metrics.add(this, metrics_prefix_ + "frames_overwritten_total",
+                "Frames replaced in the mailbox before the consumer took them", Metrics::Kind::Counter,
+                [this] { return static_cast<double>(mailbox_->stats().dropped); });
+    metrics.add(this, metrics_prefix_ + "frames_in_use", "Frame pool buffers held by the pipeline",
+                Metrics::Kind::Gauge, [this] { return static_cast<double>(frame_pool_->stats().in_use); });
+}
+
+void CameraDevice::publish(Frame&& frame) {
+    uint64_t now = monotonic_ns();
+    frame.metadata().assembled_ns = now;
+    assembly_latency_->record(now - frame.metadata().timestamp_ns);
+    frame.metadata().sequence = sequence_++;
+    frames_.fetch_add(1, std::memory_order_relaxed);
+    uint64_t startup = startup_ns_.load(std::memory_order_relaxed);
+    if (startup != 0) {
+        first_frame_ns_.store(now - startup, std::memory_order_relaxed);
+        startup_ns_.store(0, std::memory_order_relaxed);
+        LOG_INFO("First frame %.1f ms after initialization", (now - startup) / 1e6);
+    }
+    if (recovering_.load(std::memory_order_acquire)) {
+        uint64_t lost;
+        {
+            std::lock_guard<std::mutex> lock(recovery_mutex_);
+            lost = lost_ns_;
+        }
+        recovery_latency_->record(now - lost);
+        last_recovery_ns_.store(now - lost, std::memory_order_relaxed);
+        recovery_ns_.fetch_add(now - lost, std::memory_order_relaxed);
+        reconnects_.fetch_add(1, std::memory_order_relaxed);
+        recovering_ = false;
+        LOG_INFO("Streaming again %.1f ms after losing the device", (now - lost) / 1e6);
+    }
+    if (frame_tap_) {
+        frame_tap_(frame);
+    }
+    mailbox_->publish(std::move(frame));
 }
@@ -0,0 +1,164 @@
+#include "camera_rig.hpp"
+#include "logger.hpp"
+#include "thread_affinity.hpp"
+#include "usb_controller.hpp"
+#include "usb_transport.hpp"
+
+#define LOG_COMPONENT "rig"
+
+CameraRig::CameraRig() : CameraRig(Config()) {
+}
+
+CameraRig::CameraRig(const Config& config) : config_(config), running_(false) {
+}
+
+CameraRig::~CameraRig() {
+    stop();
+}
+
+void CameraRig::add_camera(std::unique_ptr<CameraDevice> camera) {
+    if (running_) {
+        LOG_ERROR("Cannot add a camera while streaming");
+        return;
+    }
+    if (camera->name().empty()) {
+        camera->set_name("cam" + std::to_string(pipelines_.size()));
+    }
+    std::unique_ptr<Pipeline> pipeline(new Pipeline());
+    pipeline->camera = std::move(camera);
+    pipelines_.push_back(std::move(pipeline));
+}
+
+bool CameraRig::add_usb_cameras(const std::vector<std::string>& selectors) {
+    std::vector<std::string> wanted = selectors;
+    if (wanted.empty()) {
+        USBController controller;
+        for (const USBController::DeviceInfo& device :
+             controller.list_devices(USBController::INTEL_VENDOR_ID, USBController::D435I_PRODUCT_ID)) {
+            wanted.push_back(device.bus_path);
+        }
+        if (wanted.empty()) {
+            LOG_ERROR("No RealSense cameras found");
+            return false;
+        }
+    }
+    for (const std::string& selector : wanted) {
+        LOG_INFO("Adding camera %s", selector.c_str());
+        add_camera(std::make_unique<CameraDevice>(std::make_unique<UsbTransport>(selector)));
+    }
+    return true;
+}
+
+bool CameraRig::start() {
+    if (running_) {
+        return true;
+    }
+    if (pipelines_.empty()) {
+        LOG_ERROR("No cameras to start");
+        return false;
+    }
+
+    FrameSynchronizer::Config sync_config;
+    sync_config.cameras = static_cast<int>(pipelines_.size());
+    sync_config.tolerance_ns = config_.sync_tolerance_ns;
+    sync_config.queue_frames = config_.sync_queue_frames;
+    synchronizer_ = std::make_unique<FrameSynchronizer>(sync_config);
+
+    for (size_t i = 0; i < pipelines_.size(); i++) {
+        Pipeline& pipeline = *pipelines_[i];
+        CameraDevice& camera = *pipeline.camera;
+        pipeline.cpu = config_.cpus.empty() ? -1 : config_.cpus[i % config_.cpus.size()];
+        camera.set_cpu(pipeline.cpu);
+        if (!camera.initialize() || !camera.start_streaming()) {
+            LOG_ERROR("Failed to start camera %s", camera.name().c_str());
+            running_ = true;
+            stop();
+            return false;
+        }
+    }
+
+    running_ = true;
+    for (size_t i = 0; i < pipelines_.size(); i++) {
+        pipelines_[i]->thread = std::thread(&CameraRig::pipeline_loop, this, i);
+    }
+    LOG_INFO("Streaming %zu cameras", pipelines_.size());
+    return true;
+}
+
+void CameraRig::stop() {
+    if (!running_) {
+        return;
+    }
+    running_ = false;
+    if (synchronizer_) {
+        synchronizer_->close();
+    }
+    for (const auto& pipeline : pipelines_) {
+        if (pipeline->thread.joinable()) {
+            pipeline->thread.join();
+        }
+    }
+    // Synced frames still queued belong to the cameras' pools
+    if (synchronizer_) {
+        synchronizer_->reopen();
+    }
+    for (const auto& pipeline : pipelines_) {
+        pipeline->camera->stop_streaming();
+    }
+}
+
+bool CameraRig::is_running() const {
+    return running_;
+}
+
+void CameraRig::pipeline_loop(size_t index) {
+    Pipeline& pipeline = *pipelines_[index];
+    ThreadAffinity::pin_current_thread(pipeline.cpu);
+    Frame frame;
+    while (running_) {
+        if (!pipeline.camera->get_depth_frame(frame, 100)) {
+            continue;
+        }
+        if (config_.process && !config_.process(index, frame)) {
+            frame.reset();
+            continue;
+        }
+        pipeline.frames.fetch_add(1, std::memory_order_relaxed);
+        pipeline.bytes.fetch_add(frame.size(), std::memory_order_relaxed);
+        synchronizer_->push(static_cast<int>(index), std::move(frame));
+    }
+}
+
+bool CameraRig::next(FrameSynchronizer::FrameSet& set, unsigned int timeout_ms) {
+    if (!running_) {
+        return false;
+    }
+    return synchronizer_->next(set, timeout_ms);
+}
+
+size_t CameraRig::size() const {
+    return pipelines_.size();
+}
+
+CameraDevice& CameraRig::camera(size_t index) {
+    return *pipelines_[index]->camera;
+}
+
+std::vector<CameraRig::CameraStats> CameraRig::camera_stats() const {
+    std::vector<CameraStats> result;
+    for (const auto& pipeline : pipelines_) {
+        CameraStats stats;
+        stats.name = pipeline->camera->name();
+        stats.cpu = pipeline->cpu;
+        stats.frames = pipeline->frames.load(std::memory_order_relaxed);
+        stats.bytes = pipeline->bytes.load(std::memory_order_relaxed);
+        stats.device = pipeline->camera->stats();
+        stats.mailbox = pipeline->camera->mailbox_stats();
+        result.push_back(stats);
+    }
+    return result;
+}
+
+FrameSynchronizer::Stats CameraRig::sync_stats() const {
+    return synchronizer_ ? synchronizer_->stats() : FrameSynchronizer::Stats();
+}
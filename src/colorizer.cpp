@@ -0,0 +1,352 @@
+#include "colorizer.hpp"
+#include "frame_shape.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if CPU_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Table entries are stored as one 32-bit word per pixel, bytes R, G, B, A
+// in memory order on the little-endian hosts this runs on.
+uint32_t pack_rgba(const uint8_t rgb[3]) {
+    return static_cast<uint32_t>(rgb[0]) | static_cast<uint32_t>(rgb[1]) << 8 |
+           static_cast<uint32_t>(rgb[2]) << 16 | 0xff000000u;
+}
+
+uint8_t to_byte(float v) {
+    return static_cast<uint8_t>(std::lround(std::min(std::max(v, 0.0f), 1.0f) * 255.0f));
+}
+
+void apply_scalar(const uint16_t* depth, size_t count, uint32_t* out, const uint32_t* table,
+                  uint32_t* histogram) {
+    if (histogram) {
+        for (size_t i = 0; i < count; i++) {
+            histogram[depth[i]]++;
+            out[i] = table[depth[i]];
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            out[i] = table[depth[i]];
+        }
+    }
+}
+
+void scan_range_scalar(const uint16_t* depth, size_t count, uint16_t& lo, uint16_t& hi) {
+    for (size_t i = 0; i < count; i++) {
+        uint16_t d = depth[i];
+        if (d) {
+            lo = std::min(lo, d);
+            hi = std::max(hi, d);
+        }
+    }
+}
+
+#if CPU_X86
+
+// No gather before AVX2: widen eight pixels and do the loads by hand, which
+// still lets the stores go out as full vectors.
+template <typename Shape>
+TARGET_SSE41 void apply_sse41(const uint16_t* depth, Shape shape, uint32_t* out, const uint32_t* table,
+                              uint32_t* histogram) {
+    const size_t count = shape.pixels;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(depth + i));
+        if (histogram) {
+            for (int k = 0; k < 8; k++) {
+                histogram[depth[i + k]]++;
+            }
+        }
+        __m128i lo = _mm_setr_epi32(table[_mm_extract_epi16(d, 0)], table[_mm_extract_epi16(d, 1)],
+                                    table[_mm_extract_epi16(d, 2)], table[_mm_extract_epi16(d, 3)]);
+        __m128i hi = _mm_setr_epi32(table[_mm_extract_epi16(d, 4)], table[_mm_extract_epi16(d, 5)],
+                                    table[_mm_extract_epi16(d, 6)], table[_mm_extract_epi16(d, 7)]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4), hi);
+    }
+    apply_scalar(depth + i, count - i, out + i, table, histogram);
+}
+
+template <typename Shape>
+TARGET_SSE41 void scan_range_sse41(const uint16_t* depth, Shape shape, uint16_t& lo, uint16_t& hi) {
+    const size_t count = shape.pixels;
+    const __m128i zero = _mm_setzero_si128();
+    __m128i vmin = _mm_set1_epi16(-1);
+    __m128i vmax = zero;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(depth + i));
+        // Zero (no data) becomes 0xffff so it never wins the minimum
+        vmin = _mm_min_epu16(vmin, _mm_or_si128(d, _mm_cmpeq_epi16(d, zero)));
+        vmax = _mm_max_epu16(vmax, d);
+    }
+    uint16_t block_min = static_cast<uint16_t>(_mm_cvtsi128_si32(_mm_minpos_epu16(vmin)));
+    uint16_t block_max = static_cast<uint16_t>(~_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_xor_si128(vmax, _mm_set1_epi16(-1)))));
+    if (block_max) {
+        lo = std::min(lo, block_min);
+        hi = std::max(hi, block_max);
+    }
+    scan_range_scalar(depth + i, count - i, lo, hi);
+}
+
+// Lookups only: with a histogram to count, the gathers compete with the
+// counting for loads and lose to apply_sse41().
+template <typename Shape>
+TARGET_AVX2 void apply_avx2(const uint16_t* depth, Shape shape, uint32_t* out, const uint32_t* table) {
+    const size_t count = shape.pixels;
+    const int* base = reinterpret_cast<const int*>(table);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i idx0 = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(depth + i)));
+        __m256i idx1 = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(depth + i + 8)));
+        __m256i rgba0 = _mm256_i32gather_epi32(base, idx0, 4);
+        __m256i rgba1 = _mm256_i32gather_epi32(base, idx1, 4);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), rgba0);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 8), rgba1);
+    }
+    apply_scalar(depth + i, count - i, out + i, table, nullptr);
+}
+
+template <typename Shape>
+TARGET_AVX2 void scan_range_avx2(const uint16_t* depth, Shape shape, uint16_t& lo, uint16_t& hi) {
+    const size_t count = shape.pixels;
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i vmin = _mm256_set1_epi16(-1);
+    __m256i vmax = zero;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(depth + i));
+        vmin = _mm256_min_epu16(vmin, _mm256_or_si256(d, _mm256_cmpeq_epi16(d, zero)));
+        vmax = _mm256_max_epu16(vmax, d);
+    }
+    __m128i min128 = _mm_min_epu16(_mm256_castsi256_si128(vmin), _mm256_extracti128_si256(vmin, 1));
+    __m128i max128 = _mm_max_epu16(_mm256_castsi256_si128(vmax), _mm256_extracti128_si256(vmax, 1));
+    uint16_t block_min = static_cast<uint16_t>(_mm_cvtsi128_si32(_mm_minpos_epu16(min128)));
+    uint16_t block_max = static_cast<uint16_t>(~_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_xor_si128(max128, _mm_set1_epi16(-1)))));
+    if (block_max) {
+        lo = std::min(lo, block_min);
+        hi = std::max(hi, block_max);
+    }
+    scan_range_scalar(depth + i, count - i, lo, hi);
+}
+
+#endif
+
+}  // namespace
+
+Colorizer::Colorizer() : Colorizer(Config()) {
+}
+
+Colorizer::Colorizer(const Config& config)
+    : config_(config), simd_level_(CpuFeatures::simd_level()), specialized_(true),
+      table_(TABLE_SIZE), histogram_(TABLE_SIZE),
+      table_linear_(false), table_near_(0), table_far_(0), have_histogram_(false), table_builds_(0) {
+    build_palette();
+}
+
+void Colorizer::set_config(const Config& config) {
+    bool colormap_changed = config.colormap != config_.colormap;
+    if (config.range != config_.range) {
+        have_histogram_ = false;
+    }
+    config_ = config;
+    if (colormap_changed) {
+        build_palette();
+        table_linear_ = false;
+    }
+}
+
+const Colorizer::Config& Colorizer::config() const {
+    return config_;
+}
+
+void Colorizer::set_simd_level(SimdLevel level) {
+    simd_level_ = CpuFeatures::clamp(level);
+}
+
+SimdLevel Colorizer::simd_level() const {
+    return simd_level_;
+}
+
+void Colorizer::set_specialized(bool specialized) {
+    specialized_ = specialized;
+}
+
+bool Colorizer::specialized() const {
+    return specialized_;
+}
+
+uint64_t Colorizer::table_builds() const {
+    return table_builds_;
+}
+
+void Colorizer::sample(Colormap colormap, float t, uint8_t rgb[3]) {
+    t = std::min(std::max(t, 0.0f), 1.0f);
+    switch (colormap) {
+    case Colormap::Grayscale: {
+        // Near is bright; the far end stays above black so it reads as
+        // distant rather than missing
+        uint8_t v = to_byte(1.0f - 0.875f * t);
+        rgb[0] = rgb[1] = rgb[2] = v;
+        break;
+    }
+    case Colormap::Jet:
+        rgb[0] = to_byte(1.5f - std::fabs(4.0f * t - 3.0f));
+        rgb[1] = to_byte(1.5f - std::fabs(4.0f * t - 2.0f));
+        rgb[2] = to_byte(1.5f - std::fabs(4.0f * t - 1.0f));
+        break;
+    case Colormap::Turbo: {
+        // Polynomial fit of Google's Turbo colormap
+        float t2 = t * t;
+        float t3 = t2 * t;
+        float t4 = t3 * t;
+        float t5 = t4 * t;
+        rgb[0] = to_byte(0.13572138f + 4.61539260f * t - 42.66032258f * t2 + 132.13108234f * t3
+                         - 152.94239396f * t4 + 59.28637943f * t5);
+        rgb[1] = to_byte(0.09140261f + 2.19418839f * t + 4.84296658f * t2 - 14.18503333f * t3
+                         + 4.27729857f * t4 + 2.82956604f * t5);
+        rgb[2] = to_byte(0.10667330f + 12.64194608f * t - 60.58204836f * t2 + 110.36276771f * t3
+                         - 89.90310912f * t4 + 27.34824973f * t5);
+        break;
+    }
+    }
+}
+
+void Colorizer::build_palette() {
+    for (int i = 0; i < PALETTE_SIZE; i++) {
+        uint8_t rgb[3] = {0, 0, 0};
+        sample(config_.colormap, static_cast<float>(i) / (PALETTE_SIZE - 1), rgb);
+        palette_[i] = pack_rgba(rgb);
+    }
+}
+
+void Colorizer::build_linear_table(uint16_t near_depth, uint16_t far_depth) {
+    if (table_linear_ && table_near_ == near_depth && table_far_ == far_depth) {
+        return;
+    }
+    if (far_depth <= near_depth) {
+        near_depth = std::min<uint16_t>(near_depth, 0xfffe);
+        far_depth = near_depth + 1;
+    }
+
+    uint32_t* table = table_.data();
+    table[0] = 0xff000000u;
+    std::fill(table + 1, table + std::max<size_t>(near_depth, 1), palette_[0]);
+    uint32_t span = far_depth - near_depth;
+    for (uint32_t d = std::max<uint32_t>(near_depth, 1); d <= far_depth; d++) {
+        table[d] = palette_[(d - near_depth) * (PALETTE_SIZE - 1) / span];
+    }
+    std::fill(table + far_depth + 1, table + TABLE_SIZE, palette_[PALETTE_SIZE - 1]);
+
+    table_linear_ = true;
+    table_near_ = near_depth;
+    table_far_ = far_depth;
+    table_builds_++;
+}
+
+void Colorizer::build_equalized_table() {
+    // Cumulative share of valid pixels at or below each depth picks the colour
+    uint64_t total = 0;
+    for (size_t d = 1; d < TABLE_SIZE; d++) {
+        total += histogram_[d];
+    }
+    if (total == 0) {
+        table_linear_ = false;
+        build_linear_table(config_.near_depth, config_.far_depth);
+        return;
+    }
+
+    uint32_t* table = table_.data();
+    table[0] = 0xff000000u;
+    const double scale = static_cast<double>(PALETTE_SIZE - 1) / total;
+    uint64_t running = 0;
+    for (size_t d = 1; d < TABLE_SIZE; d++) {
+        running += histogram_[d];
+        table[d] = palette_[static_cast<int>(running * scale)];
+    }
+    table_linear_ = false;
+    table_builds_++;
+}
+
+void Colorizer::scan_range(const uint16_t* depth, size_t pixel_count, uint16_t& min_depth, uint16_t& max_depth) const {
+    min_depth = 0xffff;
+    max_depth = 0;
+    dispatch_pixels(pixel_count, specialized_, [&](auto shape) {
+        switch (simd_level_) {
+#if CPU_X86
+        case SimdLevel::Avx2:
+            scan_range_avx2(depth, shape, min_depth, max_depth);
+            return;
+        case SimdLevel::Sse41:
+            scan_range_sse41(depth, shape, min_depth, max_depth);
+            return;
+#endif
+        default:
+            scan_range_scalar(depth, shape.pixels, min_depth, max_depth);
+            return;
+        }
+    });
+}
+
+void Colorizer::apply(const uint16_t* depth, size_t pixel_count, uint8_t* rgba, bool histogram) {
+    uint32_t* out = reinterpret_cast<uint32_t*>(rgba);
+    uint32_t* counts = histogram ? histogram_.data() : nullptr;
+    const uint32_t* table = table_.data();
+    dispatch_pixels(pixel_count, specialized_, [&](auto shape) {
+        switch (simd_level_) {
+#if CPU_X86
+        case SimdLevel::Avx2:
+            if (counts) {
+                apply_sse41(depth, shape, out, table, counts);
+            } else {
+                apply_avx2(depth, shape, out, table);
+            }
+            return;
+        case SimdLevel::Sse41:
+            apply_sse41(depth, shape, out, table, counts);
+            return;
+#endif
+        default:
+            apply_scalar(depth, shape.pixels, out, table, counts);
+            return;
+        }
+    });
+}
+
+void Colorizer::colorize(const uint16_t* depth, size_t pixel_count, uint8_t* rgba) {
+    switch (config_.range) {
+    case RangeMode::Fixed:
+        build_linear_table(config_.near_depth, config_.far_depth);
+        apply(depth, pixel_count, rgba, false);
+        break;
+    case RangeMode::Auto: {
+        uint16_t min_depth;
+        uint16_t max_depth;
+        scan_range(depth, pixel_count, min_depth, max_depth);
+        if (max_depth == 0) {
+            min_depth = config_.near_depth;
+            max_depth = config_.far_depth;
+        }
+        build_linear_table(min_depth, max_depth);
+        apply(depth, pixel_count, rgba, false);
+        break;
+    }
+    case RangeMode::Equalized:
+        // The first frame has no history yet and pays for a separate pass
+        if (!have_histogram_) {
+            std::fill(histogram_.begin(), histogram_.end(), 0);
+            for (size_t i = 0; i < pixel_count; i++) {
+                histogram_[depth[i]]++;
+            }
+        }
+        build_equalized_table();
+        std::fill(histogram_.begin(), histogram_.end(), 0);
+        apply(depth, pixel_count, rgba, true);
+        have_histogram_ = true;
+        break;
+    }
+}
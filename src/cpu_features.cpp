@@ -0,0 +1,52 @@
+#include "cpu_features.hpp"
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+SimdLevel detect() {
+#if CPU_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::Avx2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return SimdLevel::Sse41;
+    }
+#endif
+    return SimdLevel::Scalar;
+}
+
+}  // namespace
+
+SimdLevel CpuFeatures::simd_level() {
+    static const SimdLevel level = [] {
+        SimdLevel supported = detect();
+        const char* cap = std::getenv("REALSENSE_SIMD");
+        if (!cap) {
+            return supported;
+        }
+        if (strcmp(cap, "scalar") == 0) {
+            return SimdLevel::Scalar;
+        }
+        if (strcmp(cap, "sse4.1") == 0 && supported != SimdLevel::Scalar) {
+            return SimdLevel::Sse41;
+        }
+        return supported;
+    }();
+    return level;
+}
+
+SimdLevel CpuFeatures::clamp(SimdLevel level) {
+    SimdLevel supported = detect();
+    return static_cast<int>(level) < static_cast<int>(supported) ? level : supported;
+}
+
+const char* CpuFeatures::name(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::Scalar: return "scalar";
+    case SimdLevel::Sse41: return "sse4.1";
+    case SimdLevel::Avx2: return "avx2";
+    }
+    return "?";
+}
@@ -0,0 +1,165 @@
+#include "depth_filter.hpp"
+#include "frame_shape.hpp"
+#include <algorithm>
+
+#if CPU_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Lower median of the valid pixels in each factor x factor block
+void decimate_row_scalar(const uint16_t* src, int src_width, int factor, uint16_t* dst, int first_col, int width) {
+    uint16_t values[64];
+    for (int x = first_col; x < width; x++) {
+        int count = 0;
+        for (int dy = 0; dy < factor; dy++) {
+            const uint16_t* row = src + static_cast<size_t>(dy) * src_width + x * factor;
+            for (int dx = 0; dx < factor; dx++) {
+                if (row[dx]) {
+                    values[count++] = row[dx];
+                }
+            }
+        }
+        if (count == 0) {
+            dst[x] = 0;
+            continue;
+        }
+        std::nth_element(values, values + (count - 1) / 2, values + count);
+        dst[x] = values[(count - 1) / 2];
+    }
+}
+
+#if CPU_X86
+
+// For a 2x2 block the lower median of the valid values is the smallest with
+// one or two valid and the second smallest with three or four. Holes are
+// turned into 0xffff so they sort last.
+// width is that of the output row
+template <typename Shape>
+TARGET_SSE41 int decimate2_row_sse41(const uint16_t* row0, const uint16_t* row1, uint16_t* dst, Shape shape) {
+    const int width = shape.width / 2;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i low_half = _mm_set1_epi32(0xffff);
+    const __m128i two = _mm_set1_epi16(2);
+    const __m128i four = _mm_set1_epi16(4);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 2 * x));
+        __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 2 * x + 8));
+        __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 2 * x));
+        __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 2 * x + 8));
+        __m128i p = _mm_packus_epi32(_mm_and_si128(a0, low_half), _mm_and_si128(a1, low_half));
+        __m128i q = _mm_packus_epi32(_mm_srli_epi32(a0, 16), _mm_srli_epi32(a1, 16));
+        __m128i r = _mm_packus_epi32(_mm_and_si128(b0, low_half), _mm_and_si128(b1, low_half));
+        __m128i s = _mm_packus_epi32(_mm_srli_epi32(b0, 16), _mm_srli_epi32(b1, 16));
+
+        __m128i hp = _mm_cmpeq_epi16(p, zero);
+        __m128i hq = _mm_cmpeq_epi16(q, zero);
+        __m128i hr = _mm_cmpeq_epi16(r, zero);
+        __m128i hs = _mm_cmpeq_epi16(s, zero);
+        __m128i holes = _mm_sub_epi16(_mm_sub_epi16(zero, _mm_add_epi16(hp, hq)), _mm_add_epi16(hr, hs));
+        p = _mm_or_si128(p, hp);
+        q = _mm_or_si128(q, hq);
+        r = _mm_or_si128(r, hr);
+        s = _mm_or_si128(s, hs);
+
+        __m128i lo1 = _mm_min_epu16(p, q);
+        __m128i hi1 = _mm_max_epu16(p, q);
+        __m128i lo2 = _mm_min_epu16(r, s);
+        __m128i hi2 = _mm_max_epu16(r, s);
+        __m128i first = _mm_min_epu16(lo1, lo2);
+        __m128i second = _mm_min_epu16(_mm_max_epu16(lo1, lo2), _mm_min_epu16(hi1, hi2));
+
+        __m128i result = _mm_blendv_epi8(first, second, _mm_cmpgt_epi16(two, holes));
+        result = _mm_andnot_si128(_mm_cmpeq_epi16(holes, four), result);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), result);
+    }
+    return x;
+}
+
+template <typename Shape>
+TARGET_AVX2 int decimate2_row_avx2(const uint16_t* row0, const uint16_t* row1, uint16_t* dst, Shape shape) {
+    const int width = shape.width / 2;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i low_half = _mm256_set1_epi32(0xffff);
+    const __m256i two = _mm256_set1_epi16(2);
+    const __m256i four = _mm256_set1_epi16(4);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + 2 * x));
+        __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + 2 * x + 16));
+        __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + 2 * x));
+        __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + 2 * x + 16));
+        // packus works per 128-bit lane; the permute restores pixel order
+        __m256i p = _mm256_permute4x64_epi64(
+            _mm256_packus_epi32(_mm256_and_si256(a0, low_half), _mm256_and_si256(a1, low_half)), 0xd8);
+        __m256i q = _mm256_permute4x64_epi64(
+            _mm256_packus_epi32(_mm256_srli_epi32(a0, 16), _mm256_srli_epi32(a1, 16)), 0xd8);
+        __m256i r = _mm256_permute4x64_epi64(
+            _mm256_packus_epi32(_mm256_and_si256(b0, low_half), _mm256_and_si256(b1, low_half)), 0xd8);
+        __m256i s = _mm256_permute4x64_epi64(
+            _mm256_packus_epi32(_mm256_srli_epi32(b0, 16), _mm256_srli_epi32(b1, 16)), 0xd8);
+
+        __m256i hp = _mm256_cmpeq_epi16(p, zero);
+        __m256i hq = _mm256_cmpeq_epi16(q, zero);
+        __m256i hr = _mm256_cmpeq_epi16(r, zero);
+        __m256i hs = _mm256_cmpeq_epi16(s, zero);
+        __m256i holes = _mm256_sub_epi16(_mm256_sub_epi16(zero, _mm256_add_epi16(hp, hq)), _mm256_add_epi16(hr, hs));
+        p = _mm256_or_si256(p, hp);
+        q = _mm256_or_si256(q, hq);
+        r = _mm256_or_si256(r, hr);
+        s = _mm256_or_si256(s, hs);
+
+        __m256i lo1 = _mm256_min_epu16(p, q);
+        __m256i hi1 = _mm256_max_epu16(p, q);
+        __m256i lo2 = _mm256_min_epu16(r, s);
+        __m256i hi2 = _mm256_max_epu16(r, s);
+        __m256i first = _mm256_min_epu16(lo1, lo2);
+        __m256i second = _mm256_min_epu16(_mm256_max_epu16(lo1, lo2), _mm256_min_epu16(hi1, hi2));
+
+        __m256i result = _mm256_blendv_epi8(first, second, _mm256_cmpgt_epi16(two, holes));
+        result = _mm256_andnot_si256(_mm256_cmpeq_epi16(holes, four), result);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), result);
+    }
+    return x;
+}
+
+#endif
+
+}  // namespace
+
+DecimationFilter::DecimationFilter(int factor) : factor_(std::min(std::max(factor, 1), 8)) {
+}
+
+void DecimationFilter::configure(int width, int height) {
+    DepthFilter::configure(width, height);
+    out_width_ = width / factor_;
+    out_height_ = height / factor_;
+}
+
+void DecimationFilter::process_rows(const uint16_t* src, uint16_t* dst, int first_row, int last_row) {
+    dispatch_shape(width_, height_, specialized_, [&](auto shape) {
+        const int out_width = shape.width / factor_;
+        for (int y = first_row; y < last_row; y++) {
+            const uint16_t* block = src + static_cast<size_t>(y) * factor_ * shape.width;
+            uint16_t* out = dst + static_cast<size_t>(y) * out_width;
+            int x = 0;
+            if (factor_ == 2) {
+                switch (simd_level_) {
+#if CPU_X86
+                case SimdLevel::Avx2:
+                    x = decimate2_row_avx2(block, block + shape.width, out, shape);
+                    break;
+                case SimdLevel::Sse41:
+                    x = decimate2_row_sse41(block, block + shape.width, out, shape);
+                    break;
+#endif
+                default:
+                    break;
+                }
+            }
+            decimate_row_scalar(block, shape.width, factor_, out, x, out_width);
+        }
+    });
+}
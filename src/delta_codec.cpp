@@ -0,0 +1,177 @@
+#include "delta_codec.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr int TILE = TileDiff::TILE_SIZE;
+constexpr size_t TILE_PIXELS = static_cast<size_t>(TILE) * TILE;
+// DepthCodec keeps image heights in 16 bits
+constexpr size_t MAX_CODED_TILES = 0xffff / TILE;
+
+int tiles_across(int size) {
+    return (size + TILE - 1) / TILE;
+}
+
+// Copies the dirty tiles out of image into full blocks, zero-padded
+void pack_tiles(const uint16_t* image, int width, int height, const std::vector<uint8_t>& mask, uint16_t* out) {
+    int tiles_x = tiles_across(width);
+    for (size_t tile = 0; tile < mask.size(); tile++) {
+        if (!mask[tile]) {
+            continue;
+        }
+        int x = static_cast<int>(tile % tiles_x) * TILE;
+        int y = static_cast<int>(tile / tiles_x) * TILE;
+        int w = std::min(TILE, width - x);
+        for (int row = 0; row < TILE; row++, out += TILE) {
+            if (y + row < height) {
+                std::memcpy(out, image + static_cast<size_t>(y + row) * width + x, w * sizeof(uint16_t));
+                std::fill(out + w, out + TILE, 0);
+            } else {
+                std::fill(out, out + TILE, 0);
+            }
+        }
+    }
+}
+
+// Reverse of pack_tiles(), for the tiles whose bits are set
+void unpack_tiles(const uint16_t* tiles, const uint8_t* bits, size_t tile_count, uint16_t* image, int width,
+                  int height) {
+    int tiles_x = tiles_across(width);
+    for (size_t tile = 0; tile < tile_count; tile++) {
+        if (!(bits[tile >> 3] & (1u << (tile & 7)))) {
+            continue;
+        }
+        int x = static_cast<int>(tile % tiles_x) * TILE;
+        int y = static_cast<int>(tile / tiles_x) * TILE;
+        int w = std::min(TILE, width - x);
+        int h = std::min(TILE, height - y);
+        for (int row = 0; row < h; row++) {
+            std::memcpy(image + static_cast<size_t>(y + row) * width + x, tiles + row * TILE, w * sizeof(uint16_t));
+        }
+        tiles += TILE_PIXELS;
+    }
+}
+
+}  // namespace
+
+DeltaEncoder::DeltaEncoder() : DeltaEncoder(Config()) {
+}
+
+DeltaEncoder::DeltaEncoder(const Config& config)
+    : config_(config), dirty_(0), since_keyframe_(0), keyframe_requested_(false) {
+    config_.keyframe_interval = std::max(config_.keyframe_interval, 1);
+    diff_.set_threshold(config_.threshold);
+}
+
+void DeltaEncoder::configure(int width, int height) {
+    diff_.configure(width, height);
+    dirty_ = 0;
+    since_keyframe_ = config_.keyframe_interval;
+    keyframe_requested_ = false;
+}
+
+int DeltaEncoder::width() const {
+    return diff_.width();
+}
+
+int DeltaEncoder::height() const {
+    return diff_.height();
+}
+
+void DeltaEncoder::request_keyframe() {
+    keyframe_requested_ = true;
+}
+
+bool DeltaEncoder::update(const uint16_t* depth) {
+    bool keyframe = since_keyframe_ >= config_.keyframe_interval ||
+                    (keyframe_requested_ && since_keyframe_ >= MIN_KEYFRAME_GAP);
+    if (!keyframe) {
+        dirty_ = diff_.update(depth, mask_);
+        // A delta of most of the frame saves little, and its tiles compress
+        // worse than the whole image would
+        keyframe = dirty_ * 4 > diff_.tile_count() * 3 || dirty_ > MAX_CODED_TILES;
+    }
+    if (keyframe) {
+        diff_.set_reference(depth);
+        dirty_ = diff_.tile_count();
+        since_keyframe_ = 1;
+        keyframe_requested_ = false;
+        return false;
+    }
+
+    tiles_.resize(dirty_ * TILE_PIXELS);
+    pack_tiles(depth, diff_.width(), diff_.height(), mask_, tiles_.data());
+    since_keyframe_++;
+    return true;
+}
+
+size_t DeltaEncoder::dirty_tiles() const {
+    return dirty_;
+}
+
+size_t DeltaEncoder::tile_count() const {
+    return diff_.tile_count();
+}
+
+size_t DeltaEncoder::write_delta(RecordCodec codec, DepthCodec& depth_codec, std::vector<uint8_t>& out) {
+    size_t bitmap = DeltaDecoder::mask_size(diff_.width(), diff_.height());
+    out.assign(bitmap, 0);
+    for (size_t tile = 0; tile < mask_.size(); tile++) {
+        if (mask_[tile]) {
+            out[tile >> 3] |= static_cast<uint8_t>(1u << (tile & 7));
+        }
+    }
+    if (dirty_ == 0) {
+        return out.size();
+    }
+
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(tiles_.data());
+    size_t size = tiles_.size() * sizeof(uint16_t);
+    if (codec == RecordCodec::Lossless) {
+        size = depth_codec.encode(tiles_.data(), TILE, static_cast<int>(dirty_ * TILE), encoded_);
+        data = encoded_.data();
+    }
+    out.insert(out.end(), data, data + size);
+    return out.size();
+}
+
+size_t DeltaDecoder::mask_size(int width, int height) {
+    size_t tiles = static_cast<size_t>(tiles_across(width)) * tiles_across(height);
+    return (tiles + 7) / 8;
+}
+
+bool DeltaDecoder::apply(const uint8_t* data, size_t size, RecordCodec codec, DepthCodec& depth_codec,
+                         uint16_t* image, int width, int height) {
+    size_t tile_count = static_cast<size_t>(tiles_across(width)) * tiles_across(height);
+    size_t bitmap = mask_size(width, height);
+    if (size < bitmap) {
+        return false;
+    }
+    size_t dirty = 0;
+    for (size_t i = 0; i < bitmap; i++) {
+        dirty += __builtin_popcount(data[i]);
+    }
+    // No bits past the last tile
+    if (tile_count % 8 != 0 && (data[bitmap - 1] >> (tile_count % 8)) != 0) {
+        return false;
+    }
+
+    const uint8_t* payload = data + bitmap;
+    size_t payload_size = size - bitmap;
+    if (dirty == 0) {
+        return payload_size == 0;
+    }
+    tiles_.resize(dirty * TILE_PIXELS);
+    if (codec == RecordCodec::Raw) {
+        if (payload_size != tiles_.size() * sizeof(uint16_t)) {
+            return false;
+        }
+        std::memcpy(tiles_.data(), payload, payload_size);
+    } else if (dirty > MAX_CODED_TILES ||
+               !depth_codec.decode(payload, payload_size, tiles_.data(), TILE, static_cast<int>(dirty * TILE))) {
+        return false;
+    }
+    unpack_tiles(tiles_.data(), data, tile_count, image, width, height);
+    return true;
+}
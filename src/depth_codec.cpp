@@ -0,0 +1,511 @@
+#include "depth_codec.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+constexpr int RICE_CONTEXTS = 4;
+constexpr int RICE_MAX_K = 15;
+constexpr int RICE_RESET = 64;      // Halve the running sums this often
+constexpr int RICE_ESCAPE = 24;     // Quotients this large store the residual verbatim
+
+// Little-endian bit stream, least significant bit first
+class BitWriter {
+public:
+    BitWriter(uint8_t* out, size_t capacity) : out_(out), capacity_(capacity), pos_(0), acc_(0), bits_(0),
+                                                overflow_(false) {}
+
+    // n <= 32
+    void put(uint32_t value, int n) {
+        acc_ |= static_cast<uint64_t>(value) << bits_;
+        bits_ += n;
+        if (bits_ >= 32) {
+            if (pos_ + 4 <= capacity_) {
+                uint32_t word = static_cast<uint32_t>(acc_);
+                std::memcpy(out_ + pos_, &word, sizeof(word));
+                pos_ += 4;
+            } else {
+                overflow_ = true;
+            }
+            acc_ >>= 32;
+            bits_ -= 32;
+        }
+    }
+
+    // Bytes written, or 0 if they did not fit
+    size_t finish() {
+        while (bits_ > 0 && !overflow_) {
+            if (pos_ >= capacity_) {
+                overflow_ = true;
+                break;
+            }
+            out_[pos_++] = static_cast<uint8_t>(acc_);
+            acc_ >>= 8;
+            bits_ = bits_ > 8 ? bits_ - 8 : 0;
+        }
+        return overflow_ ? 0 : pos_;
+    }
+
+private:
+    uint8_t* out_;
+    size_t capacity_;
+    size_t pos_;
+    uint64_t acc_;
+    int bits_;
+    bool overflow_;
+};
+
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size) : data_(data), size_(size), pos_(0), acc_(0), bits_(0) {}
+
+    // Tops the buffer up to at least 56 bits; past the end it reads zeros
+    void refill() {
+        if (pos_ + 8 <= size_) {
+            uint64_t word;
+            std::memcpy(&word, data_ + pos_, sizeof(word));
+            acc_ |= word << bits_;
+            pos_ += (63 - bits_) >> 3;
+            bits_ |= 56;
+            return;
+        }
+        while (bits_ <= 56) {
+            uint64_t byte = pos_ < size_ ? data_[pos_] : 0;
+            acc_ |= byte << bits_;
+            pos_++;
+            bits_ += 8;
+        }
+    }
+
+    uint64_t peek() const { return acc_; }
+
+    // n <= 32, after refill()
+    uint32_t get(int n) {
+        uint32_t value = static_cast<uint32_t>(acc_ & ((uint64_t(1) << n) - 1));
+        skip(n);
+        return value;
+    }
+
+    void skip(int n) {
+        acc_ >>= n;
+        bits_ -= n;
+    }
+
+    // False if more bits were consumed than the stream holds
+    bool in_bounds() const { return pos_ * 8 - bits_ <= size_ * 8; }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_;
+    uint64_t acc_;
+    int bits_;
+};
+
+struct RiceState {
+    uint32_t sum[RICE_CONTEXTS];
+    uint32_t count[RICE_CONTEXTS];
+
+    RiceState() {
+        for (int i = 0; i < RICE_CONTEXTS; i++) {
+            sum[i] = 4;
+            count[i] = 1;
+        }
+    }
+
+    int parameter(int context) const {
+        int k = 0;
+        while ((count[context] << k) < sum[context] && k < RICE_MAX_K) {
+            k++;
+        }
+        return k;
+    }
+
+    void update(int context, uint32_t value) {
+        sum[context] += value;
+        if (++count[context] == RICE_RESET) {
+            sum[context] >>= 1;
+            count[context] >>= 1;
+        }
+    }
+};
+
+// Predicts pixel x of the current row from its decoded neighbours. Invalid
+// (zero) neighbours are replaced by valid ones, so a hole does not turn the
+// residuals around it into full depth values. context is the local
+// activity class for the Rice coder.
+inline uint16_t predict(const uint16_t* row, const uint16_t* up, int x, uint16_t last, int& context) {
+    int a = x > 0 ? row[x - 1] : 0;
+    int b = up ? up[x] : 0;
+    int c = up && x > 0 ? up[x - 1] : 0;
+    if (a == 0) {
+        a = b ? b : last;
+    }
+    if (b == 0) {
+        b = a;
+    }
+    if (c == 0) {
+        c = b;
+    }
+
+    int activity = std::abs(a - c) + std::abs(b - c);
+    context = activity == 0 ? 0 : activity < 8 ? 1 : activity < 64 ? 2 : 3;
+
+    int low = a < b ? a : b;
+    int high = a < b ? b : a;
+    if (c >= high) {
+        return static_cast<uint16_t>(low);
+    }
+    if (c <= low) {
+        return static_cast<uint16_t>(high);
+    }
+    return static_cast<uint16_t>(a + b - c);
+}
+
+// Residuals wrap modulo 2^16, so every one fits 16 bits after zigzagging
+inline uint16_t zigzag(uint16_t value, uint16_t prediction) {
+    int16_t delta = static_cast<int16_t>(static_cast<uint16_t>(value - prediction));
+    return static_cast<uint16_t>((delta << 1) ^ (delta >> 15));
+}
+
+inline uint16_t unzigzag(uint16_t residual, uint16_t prediction) {
+    uint16_t delta = static_cast<uint16_t>((residual >> 1) ^ -(residual & 1));
+    return static_cast<uint16_t>(prediction + delta);
+}
+
+inline int bit_width(uint32_t value) {
+    return value ? 32 - __builtin_clz(value) : 0;
+}
+
+void put_rice(BitWriter& writer, RiceState& rice, int context, uint16_t residual) {
+    int k = rice.parameter(context);
+    uint32_t quotient = residual >> k;
+    if (quotient < RICE_ESCAPE) {
+        writer.put(1u << quotient, quotient + 1);
+        writer.put(residual & ((1u << k) - 1), k);
+    } else {
+        writer.put(1u << RICE_ESCAPE, RICE_ESCAPE + 1);
+        writer.put(residual, 16);
+    }
+    rice.update(context, residual);
+}
+
+bool get_rice(BitReader& reader, RiceState& rice, int context, uint16_t& residual) {
+    int k = rice.parameter(context);
+    uint64_t bits = reader.peek();
+    if ((bits & ((uint64_t(1) << (RICE_ESCAPE + 1)) - 1)) == 0) {
+        return false;
+    }
+    int quotient = __builtin_ctzll(bits);
+    reader.skip(quotient + 1);
+    if (quotient < RICE_ESCAPE) {
+        residual = static_cast<uint16_t>((quotient << k) | reader.get(k));
+    } else {
+        residual = static_cast<uint16_t>(reader.get(16));
+    }
+    rice.update(context, residual);
+    return true;
+}
+
+// Writes a group of residuals: bit-packed at the width of the largest, or
+// Rice coded behind a flag bit that is clear when they are all zero, as
+// they are across flat surfaces
+void put_group(BitWriter& writer, RiceState& rice, bool entropy, const uint16_t* residuals,
+               const uint8_t* contexts, int count, uint32_t group_bits) {
+    if (entropy) {
+        writer.put(group_bits != 0, 1);
+        if (group_bits != 0) {
+            for (int i = 0; i < count; i++) {
+                put_rice(writer, rice, contexts[i], residuals[i]);
+            }
+        }
+        return;
+    }
+    int bits = bit_width(group_bits);
+    writer.put(bits, 5);
+    for (int i = 0; i < count; i++) {
+        writer.put(residuals[i], bits);
+    }
+}
+
+size_t put_varint(uint8_t* out, size_t pos, size_t capacity, uint32_t value) {
+    while (pos < capacity) {
+        if (value < 0x80) {
+            out[pos++] = static_cast<uint8_t>(value);
+            return pos;
+        }
+        out[pos++] = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    return 0;
+}
+
+bool get_varint(const uint8_t* data, size_t size, size_t& pos, uint32_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 32 && pos < size; shift += 7) {
+        uint8_t byte = data[pos++];
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+DepthCodec::DepthCodec() : DepthCodec(Config()) {
+}
+
+DepthCodec::DepthCodec(const Config& config, ThreadPool* pool)
+    : config_(config), pool_(pool ? pool : &ThreadPool::shared()) {
+    if (config_.slice_rows <= 0) {
+        config_.slice_rows = 1;
+    }
+}
+
+size_t DepthCodec::max_slice_size(int width, int rows) {
+    return 1 + static_cast<size_t>(width) * rows * sizeof(uint16_t);
+}
+
+size_t DepthCodec::max_encoded_size(int width, int height) {
+    // Slices are at most one byte larger than their raw pixels, and the
+    // smallest slice is one row
+    return sizeof(Header) + static_cast<size_t>(height) * (sizeof(uint32_t) + 1) +
+           static_cast<size_t>(width) * height * sizeof(uint16_t);
+}
+
+size_t DepthCodec::encode(const uint16_t* depth, int width, int height, std::vector<uint8_t>& out) {
+    const int slice_rows = config_.slice_rows;
+    const size_t slices = (height + slice_rows - 1) / slice_rows;
+    const size_t slice_capacity = max_slice_size(width, slice_rows);
+    scratch_.resize(slices * slice_capacity);
+    slice_sizes_.resize(slices);
+
+    pool_->run(slices, [&](size_t slice) {
+        int first_row = static_cast<int>(slice) * slice_rows;
+        int rows = std::min(slice_rows, height - first_row);
+        slice_sizes_[slice] = static_cast<uint32_t>(
+            encode_slice(depth + static_cast<size_t>(first_row) * width, width, rows, config_.entropy,
+                         scratch_.data() + slice * slice_capacity));
+    });
+
+    Header header{};
+    header.magic = MAGIC;
+    header.width = static_cast<uint16_t>(width);
+    header.height = static_cast<uint16_t>(height);
+    header.slice_rows = static_cast<uint16_t>(slice_rows);
+    header.slices = static_cast<uint32_t>(slices);
+
+    size_t total = sizeof(header) + slices * sizeof(uint32_t);
+    for (uint32_t size : slice_sizes_) {
+        total += size;
+    }
+    out.resize(total);
+    uint8_t* pos = out.data();
+    std::memcpy(pos, &header, sizeof(header));
+    pos += sizeof(header);
+    std::memcpy(pos, slice_sizes_.data(), slices * sizeof(uint32_t));
+    pos += slices * sizeof(uint32_t);
+    for (size_t slice = 0; slice < slices; slice++) {
+        std::memcpy(pos, scratch_.data() + slice * slice_capacity, slice_sizes_[slice]);
+        pos += slice_sizes_[slice];
+    }
+    return total;
+}
+
+size_t DepthCodec::encode_slice(const uint16_t* depth, int width, int rows, bool entropy, uint8_t* out) {
+    const size_t pixels = static_cast<size_t>(width) * rows;
+    const size_t raw_size = pixels * sizeof(uint16_t);
+
+    // Validity mask as alternating run lengths, starting with a valid run
+    size_t pos = 1 + sizeof(uint32_t);
+    bool valid_run = true;
+    uint32_t run = 0;
+    for (size_t i = 0; i < pixels && pos != 0; i++) {
+        if ((depth[i] != 0) != valid_run) {
+            pos = put_varint(out, pos, raw_size, run);
+            valid_run = !valid_run;
+            run = 0;
+        }
+        run++;
+    }
+    if (pos != 0) {
+        pos = put_varint(out, pos, raw_size, run);
+    }
+
+    size_t bits_size = 0;
+    if (pos != 0) {
+        uint32_t mask_size = static_cast<uint32_t>(pos - 1 - sizeof(uint32_t));
+        std::memcpy(out + 1, &mask_size, sizeof(mask_size));
+
+        BitWriter writer(out + pos, raw_size - pos);
+        RiceState rice;
+        uint16_t group[GROUP_SIZE];
+        uint8_t contexts[GROUP_SIZE];
+        int grouped = 0;
+        uint32_t group_bits = 0;
+        uint16_t last = 0;
+        for (int y = 0; y < rows; y++) {
+            const uint16_t* row = depth + static_cast<size_t>(y) * width;
+            const uint16_t* up = y > 0 ? row - width : nullptr;
+            for (int x = 0; x < width; x++) {
+                if (row[x] == 0) {
+                    continue;
+                }
+                int context;
+                uint16_t residual = zigzag(row[x], predict(row, up, x, last, context));
+                last = row[x];
+                contexts[grouped] = static_cast<uint8_t>(context);
+                group[grouped++] = residual;
+                group_bits |= residual;
+                if (grouped == GROUP_SIZE) {
+                    put_group(writer, rice, entropy, group, contexts, grouped, group_bits);
+                    grouped = 0;
+                    group_bits = 0;
+                }
+            }
+        }
+        if (grouped > 0) {
+            put_group(writer, rice, entropy, group, contexts, grouped, group_bits);
+        }
+        bits_size = writer.finish();
+    }
+
+    if (pos == 0 || bits_size == 0 || pos + bits_size > raw_size) {
+        out[0] = SLICE_RAW;
+        std::memcpy(out + 1, depth, raw_size);
+        return 1 + raw_size;
+    }
+    out[0] = entropy ? SLICE_RICE : SLICE_PACKED;
+    return pos + bits_size;
+}
+
+bool DepthCodec::peek_size(const uint8_t* data, size_t size, int& width, int& height) {
+    Header header;
+    if (size < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != MAGIC) {
+        return false;
+    }
+    width = header.width;
+    height = header.height;
+    return true;
+}
+
+bool DepthCodec::decode(const uint8_t* data, size_t size, uint16_t* depth, int width, int height) {
+    Header header;
+    if (size < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != MAGIC || header.width != width || header.height != height || header.slice_rows == 0 ||
+        header.slices != (static_cast<uint32_t>(height) + header.slice_rows - 1) / header.slice_rows ||
+        size < sizeof(header) + static_cast<size_t>(header.slices) * sizeof(uint32_t)) {
+        return false;
+    }
+
+    // Slice offsets from the size table
+    const size_t slices = header.slices;
+    slice_sizes_.resize(slices);
+    std::memcpy(slice_sizes_.data(), data + sizeof(header), slices * sizeof(uint32_t));
+    std::vector<size_t>& offsets = slice_offsets_;
+    offsets.resize(slices);
+    size_t offset = sizeof(header) + slices * sizeof(uint32_t);
+    for (size_t slice = 0; slice < slices; slice++) {
+        offsets[slice] = offset;
+        offset += slice_sizes_[slice];
+    }
+    if (offset != size) {
+        return false;
+    }
+
+    const int slice_rows = header.slice_rows;
+    std::atomic<bool> ok(true);
+    pool_->run(slices, [&](size_t slice) {
+        int first_row = static_cast<int>(slice) * slice_rows;
+        int rows = std::min(slice_rows, height - first_row);
+        if (!decode_slice(data + offsets[slice], slice_sizes_[slice],
+                          depth + static_cast<size_t>(first_row) * width, width, rows)) {
+            ok.store(false, std::memory_order_relaxed);
+        }
+    });
+    return ok.load();
+}
+
+bool DepthCodec::decode_slice(const uint8_t* data, size_t size, uint16_t* depth, int width, int rows) {
+    const size_t pixels = static_cast<size_t>(width) * rows;
+    if (size < 1) {
+        return false;
+    }
+    if (data[0] == SLICE_RAW) {
+        if (size != 1 + pixels * sizeof(uint16_t)) {
+            return false;
+        }
+        std::memcpy(depth, data + 1, pixels * sizeof(uint16_t));
+        return true;
+    }
+    if ((data[0] != SLICE_PACKED && data[0] != SLICE_RICE) || size < 1 + sizeof(uint32_t)) {
+        return false;
+    }
+    const bool entropy = data[0] == SLICE_RICE;
+    uint32_t mask_size;
+    std::memcpy(&mask_size, data + 1, sizeof(mask_size));
+    const size_t mask_end = 1 + sizeof(uint32_t) + static_cast<size_t>(mask_size);
+    if (mask_end > size) {
+        return false;
+    }
+
+    size_t mask_pos = 1 + sizeof(uint32_t);
+    uint32_t run = 0;
+    bool valid = false;   // Flipped by the first run, which is a valid one
+    BitReader reader(data + mask_end, size - mask_end);
+    RiceState rice;
+    int group_left = 0;
+    int group_bits = 0;     // Zero for a Rice group of zeros
+    uint16_t last = 0;
+    for (int y = 0; y < rows; y++) {
+        uint16_t* row = depth + static_cast<size_t>(y) * width;
+        const uint16_t* up = y > 0 ? row - width : nullptr;
+        for (int x = 0; x < width; x++) {
+            while (run == 0) {
+                if (!get_varint(data, mask_end, mask_pos, run)) {
+                    return false;
+                }
+                valid = !valid;
+            }
+            run--;
+            if (!valid) {
+                row[x] = 0;
+                continue;
+            }
+
+            int context;
+            uint16_t prediction = predict(row, up, x, last, context);
+            uint16_t residual;
+            reader.refill();
+            if (group_left == 0) {
+                group_bits = static_cast<int>(reader.get(entropy ? 1 : 5));
+                if (group_bits > 16) {
+                    return false;
+                }
+                group_left = GROUP_SIZE;
+            }
+            group_left--;
+            if (group_bits == 0) {
+                residual = 0;
+            } else if (!entropy) {
+                residual = static_cast<uint16_t>(reader.get(group_bits));
+            } else if (!get_rice(reader, rice, context, residual)) {
+                return false;
+            }
+            row[x] = unzigzag(residual, prediction);
+            last = row[x];
+        }
+    }
+    return run == 0 && mask_pos == mask_end && reader.in_bounds();
+}
@@ -0,0 +1,28 @@
+#include "depth_filter.hpp"
+
+DepthFilter::DepthFilter()
+    : simd_level_(CpuFeatures::simd_level()), specialized_(true), width_(0), height_(0), out_width_(0), out_height_(0) {
+}
+
+void DepthFilter::configure(int width, int height) {
+    width_ = width;
+    height_ = height;
+    out_width_ = width;
+    out_height_ = height;
+}
+
+void DepthFilter::set_simd_level(SimdLevel level) {
+    simd_level_ = CpuFeatures::clamp(level);
+}
+
+SimdLevel DepthFilter::simd_level() const {
+    return simd_level_;
+}
+
+void DepthFilter::set_specialized(bool specialized) {
+    specialized_ = specialized;
+}
+
+bool DepthFilter::specialized() const {
+    return specialized_;
+}
@@ -0,0 +1,380 @@
+#include "depth_recorder.hpp"
+#include "logger.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define LOG_COMPONENT "record"
+
+DepthRecorder::DepthRecorder() : DepthRecorder(Config()) {
+}
+
+DepthRecorder::DepthRecorder(const Config& config)
+    : config_(config), fd_(-1), current_(nullptr), append_offset_(0),
+      encode_threads_(config.codec == RecordCodec::Lossless ? std::make_unique<ThreadPool>() : nullptr),
+      codec_(DepthCodec::Config(), encode_threads_.get()), encoder_stopping_(false),
+      first_timestamp_ns_(0), last_timestamp_ns_(0), stopping_(false), write_failed_(false), allocated_end_(0),
+      frames_(0), dropped_(0), bytes_(0), writes_(0), raw_bytes_(0) {
+}
+
+DepthRecorder::~DepthRecorder() {
+    close();
+}
+
+bool DepthRecorder::open(const std::string& path) {
+    if (fd_ >= 0) {
+        LOG_ERROR("Recorder already has %s open", path_.c_str());
+        return false;
+    }
+    if (config_.blocks <= 0 || config_.block_size < RecordingFormat::RECORD_ALIGNMENT ||
+        config_.chunk_size == 0 || (config_.codec == RecordCodec::Lossless && config_.encode_slots <= 0)) {
+        LOG_ERROR("Invalid recorder configuration");
+        return false;
+    }
+
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+        LOG_ERROR("Failed to create %s: %s", path.c_str(), std::strerror(errno));
+        return false;
+    }
+    path_ = path;
+
+    // Everything the recording needs is allocated here, not per frame
+    blocks_.clear();
+    blocks_.resize(config_.blocks);
+    free_.clear();
+    full_.clear();
+    for (Block& block : blocks_) {
+        block.data.reset(new uint8_t[config_.block_size]);
+        free_.push_back(&block);
+    }
+    current_ = nullptr;
+    index_.clear();
+    index_.reserve(1024);
+    first_timestamp_ns_ = 0;
+    last_timestamp_ns_ = 0;
+    frames_ = 0;
+    dropped_ = 0;
+    bytes_ = 0;
+    writes_ = 0;
+    raw_bytes_ = 0;
+    stopping_ = false;
+    write_failed_ = false;
+    allocated_end_ = 0;
+
+    // Header without an index for now, so an unfinished file is recognizable
+    RecordingFileHeader header{};
+    std::memcpy(header.magic, RecordingFormat::MAGIC, sizeof(header.magic));
+    header.version = RecordingFormat::VERSION;
+    header.header_size = sizeof(RecordingFileHeader);
+    header.width = config_.width;
+    header.height = config_.height;
+    header.pixel_format = RecordingFormat::PIXEL_FORMAT_Z16;
+    append_offset_ = RecordingFormat::align(sizeof(header));
+    if (!reserve(config_.chunk_size) || !write_at(&header, sizeof(header), 0)) {
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    writer_ = std::thread(&DepthRecorder::writer_loop, this);
+    if (config_.codec == RecordCodec::Lossless) {
+        size_t image_size = static_cast<size_t>(config_.width) * config_.height * sizeof(uint16_t);
+        slots_.clear();
+        slots_.resize(config_.encode_slots);
+        staged_.clear();
+        free_slots_.clear();
+        for (Slot& slot : slots_) {
+            slot.data.reserve(image_size);
+            free_slots_.push_back(&slot);
+        }
+        encoder_stopping_ = false;
+        encoder_ = std::thread(&DepthRecorder::encoder_loop, this);
+    }
+    return true;
+}
+
+bool DepthRecorder::is_open() const {
+    return fd_ >= 0;
+}
+
+bool DepthRecorder::write(const Frame& frame) {
+    if (config_.codec == RecordCodec::Lossless) {
+        size_t image_size = static_cast<size_t>(config_.width) * config_.height * sizeof(uint16_t);
+        return stage(frame.data(), frame.size(), frame.metadata(), RecordCodec::Raw, frame.size(),
+                     frame.size() == image_size);
+    }
+    return write(frame.data(), frame.size(), frame.metadata(), RecordCodec::Raw, frame.size());
+}
+
+bool DepthRecorder::write(const uint8_t* data, size_t size, const FrameMetadata& metadata,
+                          RecordCodec codec, size_t raw_size) {
+    // With an encoder thread appending, everything goes through it to keep
+    // the records in order
+    if (config_.codec == RecordCodec::Lossless) {
+        return stage(data, size, metadata, codec, raw_size, false);
+    }
+    return append(data, size, metadata, codec, raw_size);
+}
+
+bool DepthRecorder::stage(const uint8_t* data, size_t size, const FrameMetadata& metadata, RecordCodec codec,
+                          size_t raw_size, bool encode) {
+    if (fd_ < 0) {
+        return false;
+    }
+    Slot* slot;
+    {
+        std::lock_guard<std::mutex> lock(slot_mutex_);
+        if (free_slots_.empty()) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+    }
+    slot->data.assign(data, data + size);
+    slot->size = size;
+    slot->metadata = metadata;
+    slot->codec = codec;
+    slot->raw_size = raw_size;
+    slot->encode = encode;
+    {
+        std::lock_guard<std::mutex> lock(slot_mutex_);
+        staged_.push_back(slot);
+    }
+    staged_cv_.notify_one();
+    return true;
+}
+
+void DepthRecorder::encoder_loop() {
+    std::unique_lock<std::mutex> lock(slot_mutex_);
+    for (;;) {
+        staged_cv_.wait(lock, [this] { return !staged_.empty() || encoder_stopping_; });
+        if (staged_.empty()) {
+            break;
+        }
+        Slot* slot = staged_.front();
+        staged_.pop_front();
+        lock.unlock();
+
+        if (slot->encode) {
+            size_t size = codec_.encode(reinterpret_cast<const uint16_t*>(slot->data.data()), config_.width,
+                                        config_.height, encoded_);
+            append(encoded_.data(), size, slot->metadata, RecordCodec::Lossless, slot->size);
+        } else {
+            append(slot->data.data(), slot->size, slot->metadata, slot->codec, slot->raw_size);
+        }
+
+        lock.lock();
+        free_slots_.push_back(slot);
+    }
+}
+
+bool DepthRecorder::append(const uint8_t* data, size_t size, const FrameMetadata& metadata, RecordCodec codec,
+                           size_t raw_size) {
+    if (fd_ < 0) {
+        return false;
+    }
+
+    size_t record_size = RecordingFormat::align(sizeof(RecordingFrameHeader) + size);
+    if (record_size > config_.block_size) {
+        LOG_ERROR("Frame of %zu bytes does not fit a %zu byte block", size, config_.block_size);
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (current_ && current_->used + record_size > config_.block_size) {
+        submit_block();
+    }
+    if (!current_ && !take_block()) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    uint8_t* out = current_->data.get() + current_->used;
+    RecordingFrameHeader header{};
+    header.magic = RecordingFormat::FRAME_MAGIC;
+    header.codec = static_cast<uint16_t>(codec);
+    header.size = static_cast<uint32_t>(size);
+    header.raw_size = static_cast<uint32_t>(raw_size);
+    header.sequence = metadata.sequence;
+    header.timestamp_ns = metadata.timestamp_ns;
+    header.device_timestamp = metadata.device_timestamp;
+    std::memcpy(out, &header, sizeof(header));
+    std::memcpy(out + sizeof(header), data, size);
+    std::memset(out + sizeof(header) + size, 0, record_size - sizeof(header) - size);
+
+    index_.push_back(RecordingIndexEntry{append_offset_, metadata.timestamp_ns});
+    append_offset_ += record_size;
+    current_->used += record_size;
+    if (frames_.load(std::memory_order_relaxed) == 0) {
+        first_timestamp_ns_ = metadata.timestamp_ns;
+    }
+    last_timestamp_ns_ = metadata.timestamp_ns;
+    frames_.fetch_add(1, std::memory_order_relaxed);
+    raw_bytes_.fetch_add(raw_size, std::memory_order_relaxed);
+    return true;
+}
+
+bool DepthRecorder::take_block() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_.empty()) {
+        return false;
+    }
+    current_ = free_.back();
+    free_.pop_back();
+    current_->used = 0;
+    current_->file_offset = append_offset_;
+    return true;
+}
+
+void DepthRecorder::submit_block() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        full_.push_back(current_);
+    }
+    current_ = nullptr;
+    work_.notify_one();
+}
+
+void DepthRecorder::writer_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        work_.wait(lock, [this] { return !full_.empty() || stopping_; });
+        if (full_.empty()) {
+            break;
+        }
+        Block* block = full_.front();
+        full_.pop_front();
+        bool failed = write_failed_;
+        lock.unlock();
+
+        // After a failed write the rest is dropped; the file is only
+        // readable up to the failure anyway
+        bool ok = !failed && reserve(block->file_offset + block->used) &&
+                  write_at(block->data.get(), block->used, block->file_offset);
+
+        lock.lock();
+        if (!ok) {
+            write_failed_ = true;
+        }
+        free_.push_back(block);
+    }
+}
+
+bool DepthRecorder::reserve(uint64_t end) {
+    while (allocated_end_ < end) {
+#ifdef __linux__
+        // Real blocks, not a sparse hole, so later writes do not stall on
+        // allocation and the file stays contiguous
+        int result = posix_fallocate(fd_, allocated_end_, config_.chunk_size);
+#else
+        int result = ftruncate(fd_, allocated_end_ + config_.chunk_size) == 0 ? 0 : errno;
+#endif
+        if (result != 0) {
+            LOG_ERROR("Failed to preallocate %s: %s", path_.c_str(), std::strerror(result));
+            return false;
+        }
+        allocated_end_ += config_.chunk_size;
+    }
+    return true;
+}
+
+bool DepthRecorder::write_at(const void* data, size_t size, uint64_t offset) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        ssize_t written = pwrite(fd_, bytes, size, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("Failed to write %s: %s", path_.c_str(), std::strerror(errno));
+            return false;
+        }
+        bytes += written;
+        size -= written;
+        offset += written;
+        bytes_.fetch_add(written, std::memory_order_relaxed);
+    }
+    writes_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool DepthRecorder::close() {
+    if (fd_ < 0) {
+        return true;
+    }
+
+    // Whatever is waiting to be encoded still goes into the file
+    if (encoder_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(slot_mutex_);
+            encoder_stopping_ = true;
+        }
+        staged_cv_.notify_one();
+        encoder_.join();
+    }
+
+    if (current_ && current_->used > 0) {
+        submit_block();
+    } else if (current_) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(current_);
+        current_ = nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_.notify_one();
+    writer_.join();
+
+    // Index after the last record, then point the header at it
+    RecordingIndexHeader index_header{};
+    index_header.magic = RecordingFormat::INDEX_MAGIC;
+    index_header.count = index_.size();
+    uint64_t index_offset = append_offset_;
+    uint64_t end = index_offset + sizeof(index_header) + index_.size() * sizeof(RecordingIndexEntry);
+
+    RecordingFileHeader header{};
+    std::memcpy(header.magic, RecordingFormat::MAGIC, sizeof(header.magic));
+    header.version = RecordingFormat::VERSION;
+    header.header_size = sizeof(RecordingFileHeader);
+    header.width = config_.width;
+    header.height = config_.height;
+    header.pixel_format = RecordingFormat::PIXEL_FORMAT_Z16;
+    header.frame_count = index_.size();
+    header.index_offset = index_offset;
+    header.first_timestamp_ns = first_timestamp_ns_;
+    header.last_timestamp_ns = last_timestamp_ns_;
+
+    bool ok = !write_failed_ &&
+              write_at(&index_header, sizeof(index_header), index_offset) &&
+              write_at(index_.data(), index_.size() * sizeof(RecordingIndexEntry), index_offset + sizeof(index_header)) &&
+              ftruncate(fd_, static_cast<off_t>(end)) == 0 &&
+              fsync(fd_) == 0 &&
+              write_at(&header, sizeof(header), 0) &&
+              fsync(fd_) == 0;
+    if (!ok) {
+        LOG_ERROR("Failed to finish %s; it can still be read without its index", path_.c_str());
+    }
+
+    ::close(fd_);
+    fd_ = -1;
+    blocks_.clear();
+    free_.clear();
+    full_.clear();
+    slots_.clear();
+    free_slots_.clear();
+    return ok;
+}
+
+DepthRecorder::Stats DepthRecorder::stats() const {
+    Stats stats;
+    stats.frames = frames_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    stats.bytes = bytes_.load(std::memory_order_relaxed);
+    stats.writes = writes_.load(std::memory_order_relaxed);
+    stats.raw_bytes = raw_bytes_.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,316 @@
+#include "depth_stats.hpp"
+#include <algorithm>
+#include <cstring>
+
+#if CPU_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using State = DepthStatsAccumulator::State;
+
+constexpr int BINS = DepthStats::HISTOGRAM_BINS;
+constexpr int LANES = State::LANES;
+// 16-bit per-lane counters are folded into the totals this often, well
+// before they could wrap
+constexpr size_t BLOCK_GROUPS = 4096;
+
+uint16_t threshold(int k) {
+    return k == 0 ? 1 : DepthStats::BIN_EDGES[k - 1];
+}
+
+// Pixels may sit at any byte offset, since payload data follows a header
+void add_scalar(State& s, const uint8_t* src, uint8_t* dst, size_t count) {
+    if (dst) {
+        memcpy(dst, src, count * 2);
+    }
+    for (size_t i = 0; i < count; i++) {
+        uint16_t d;
+        memcpy(&d, src + i * 2, sizeof(d));
+        if (d) {
+            s.min_depth = std::min(s.min_depth, d);
+        }
+        s.max_depth = std::max(s.max_depth, d);
+        s.depth_sum += d;
+        for (int k = 0; k < BINS; k++) {
+            s.at_least[k] += d >= threshold(k);
+        }
+        int lane = static_cast<int>(s.pixels % LANES);
+        s.sum_a[lane] += d;
+        s.sum_b[lane] += s.sum_a[lane];
+        s.pixels++;
+    }
+}
+
+#if CPU_X86
+
+TARGET_SSE41 uint32_t sum_epi16_sse41(__m128i counts) {
+    __m128i sums = _mm_madd_epi16(counts, _mm_set1_epi16(1));
+    sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(1, 0, 3, 2)));
+    sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(2, 3, 0, 1)));
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(sums));
+}
+
+TARGET_SSE41 void fold_range_sse41(State& s, __m128i vmin, __m128i vmax, __m128i vsum) {
+    // Zero was turned into 0xffff for the minimum, so no valid pixel leaves
+    // it at 0xffff, which min() then ignores
+    uint16_t block_min = static_cast<uint16_t>(_mm_cvtsi128_si32(_mm_minpos_epu16(vmin)));
+    uint16_t block_max =
+        static_cast<uint16_t>(~_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_xor_si128(vmax, _mm_set1_epi16(-1)))));
+    s.min_depth = std::min(s.min_depth, block_min);
+    s.max_depth = std::max(s.max_depth, block_max);
+    uint64_t sums[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(sums), vsum);
+    s.depth_sum += sums[0] + sums[1];
+}
+
+// Eight pixels: range, sum and counts below each threshold
+TARGET_SSE41 void step_sse41(__m128i d, const __m128i* thresholds, __m128i* counts, __m128i& vmin, __m128i& vmax,
+                             __m128i& vsum) {
+    const __m128i zero = _mm_setzero_si128();
+    vmin = _mm_min_epu16(vmin, _mm_or_si128(d, _mm_cmpeq_epi16(d, zero)));
+    vmax = _mm_max_epu16(vmax, d);
+    // Byte sums are exact; the high bytes weigh 256
+    __m128i lo = _mm_sad_epu8(_mm_and_si128(d, _mm_set1_epi16(0x00ff)), zero);
+    __m128i hi = _mm_sad_epu8(_mm_srli_epi16(d, 8), zero);
+    vsum = _mm_add_epi64(vsum, _mm_add_epi64(lo, _mm_slli_epi64(hi, 8)));
+    // Counts pixels below each threshold with one signed compare: flipping
+    // the top bit of both sides makes it an unsigned one. The all-ones mask
+    // counts -1.
+    __m128i biased = _mm_xor_si128(d, _mm_set1_epi16(-0x8000));
+    for (int k = 0; k < BINS; k++) {
+        counts[k] = _mm_sub_epi16(counts[k], _mm_cmpgt_epi16(thresholds[k], biased));
+    }
+}
+
+template <bool Copy>
+TARGET_SSE41 void add_sse41(State& s, const uint8_t* src, uint8_t* dst, size_t groups) {
+    __m128i thresholds[BINS];
+    for (int k = 0; k < BINS; k++) {
+        thresholds[k] = _mm_set1_epi16(static_cast<short>(threshold(k) ^ 0x8000));
+    }
+    __m128i vmin = _mm_set1_epi16(-1);
+    __m128i vmax = _mm_setzero_si128();
+    __m128i vsum = _mm_setzero_si128();
+    __m128i a[4];
+    __m128i b[4];
+    for (int j = 0; j < 4; j++) {
+        a[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s.sum_a + j * 4));
+        b[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s.sum_b + j * 4));
+    }
+    s.pixels += groups * LANES;
+
+    while (groups > 0) {
+        size_t block = std::min(groups, BLOCK_GROUPS);
+        __m128i counts[BINS];
+        for (int k = 0; k < BINS; k++) {
+            counts[k] = _mm_setzero_si128();
+        }
+        for (size_t g = 0; g < block; g++) {
+            __m128i d0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+            __m128i d1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+            src += 32;
+            if (Copy) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), d0);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), d1);
+                dst += 32;
+            }
+            step_sse41(d0, thresholds, counts, vmin, vmax, vsum);
+            step_sse41(d1, thresholds, counts, vmin, vmax, vsum);
+            a[0] = _mm_add_epi32(a[0], _mm_cvtepu16_epi32(d0));
+            a[1] = _mm_add_epi32(a[1], _mm_cvtepu16_epi32(_mm_srli_si128(d0, 8)));
+            a[2] = _mm_add_epi32(a[2], _mm_cvtepu16_epi32(d1));
+            a[3] = _mm_add_epi32(a[3], _mm_cvtepu16_epi32(_mm_srli_si128(d1, 8)));
+            for (int j = 0; j < 4; j++) {
+                b[j] = _mm_add_epi32(b[j], a[j]);
+            }
+        }
+        for (int k = 0; k < BINS; k++) {
+            s.at_least[k] += static_cast<uint32_t>(block * LANES) - sum_epi16_sse41(counts[k]);
+        }
+        groups -= block;
+    }
+
+    for (int j = 0; j < 4; j++) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(s.sum_a + j * 4), a[j]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(s.sum_b + j * 4), b[j]);
+    }
+    fold_range_sse41(s, vmin, vmax, vsum);
+}
+
+template <bool Copy>
+TARGET_AVX2 void add_avx2(State& s, const uint8_t* src, uint8_t* dst, size_t groups) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i low_bytes = _mm256_set1_epi16(0x00ff);
+    const __m256i sign = _mm256_set1_epi16(-0x8000);
+    __m256i thresholds[BINS];
+    for (int k = 0; k < BINS; k++) {
+        thresholds[k] = _mm256_set1_epi16(static_cast<short>(threshold(k) ^ 0x8000));
+    }
+    __m256i vmin = _mm256_set1_epi16(-1);
+    __m256i vmax = zero;
+    __m256i vsum = zero;
+    __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s.sum_a));
+    __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s.sum_a + 8));
+    __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s.sum_b));
+    __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s.sum_b + 8));
+    s.pixels += groups * LANES;
+
+    while (groups > 0) {
+        size_t block = std::min(groups, BLOCK_GROUPS);
+        __m256i counts[BINS];
+        for (int k = 0; k < BINS; k++) {
+            counts[k] = zero;
+        }
+        for (size_t g = 0; g < block; g++) {
+            __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+            src += 32;
+            if (Copy) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), d);
+                dst += 32;
+            }
+            vmin = _mm256_min_epu16(vmin, _mm256_or_si256(d, _mm256_cmpeq_epi16(d, zero)));
+            vmax = _mm256_max_epu16(vmax, d);
+            __m256i lo = _mm256_sad_epu8(_mm256_and_si256(d, low_bytes), zero);
+            __m256i hi = _mm256_sad_epu8(_mm256_srli_epi16(d, 8), zero);
+            vsum = _mm256_add_epi64(vsum, _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 8)));
+            __m256i biased = _mm256_xor_si256(d, sign);
+            for (int k = 0; k < BINS; k++) {
+                counts[k] = _mm256_sub_epi16(counts[k], _mm256_cmpgt_epi16(thresholds[k], biased));
+            }
+            a0 = _mm256_add_epi32(a0, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(d)));
+            a1 = _mm256_add_epi32(a1, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(d, 1)));
+            b0 = _mm256_add_epi32(b0, a0);
+            b1 = _mm256_add_epi32(b1, a1);
+        }
+        for (int k = 0; k < BINS; k++) {
+            __m128i folded = _mm_add_epi16(_mm256_castsi256_si128(counts[k]), _mm256_extracti128_si256(counts[k], 1));
+            s.at_least[k] += static_cast<uint32_t>(block * LANES) - sum_epi16_sse41(folded);
+        }
+        groups -= block;
+    }
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(s.sum_a), a0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(s.sum_a + 8), a1);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(s.sum_b), b0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(s.sum_b + 8), b1);
+    fold_range_sse41(s, _mm_min_epu16(_mm256_castsi256_si128(vmin), _mm256_extracti128_si256(vmin, 1)),
+                     _mm_max_epu16(_mm256_castsi256_si128(vmax), _mm256_extracti128_si256(vmax, 1)),
+                     _mm_add_epi64(_mm256_castsi256_si128(vsum), _mm256_extracti128_si256(vsum, 1)));
+}
+
+#endif
+
+}  // namespace
+
+constexpr uint16_t DepthStats::BIN_EDGES[];
+
+double DepthStats::mean_depth() const {
+    return valid_pixels ? static_cast<double>(depth_sum) / valid_pixels : 0.0;
+}
+
+double DepthStats::valid_ratio() const {
+    uint64_t pixels = static_cast<uint64_t>(valid_pixels) + zero_pixels;
+    return pixels ? static_cast<double>(valid_pixels) / pixels : 0.0;
+}
+
+DepthStatsAccumulator::DepthStatsAccumulator()
+    : simd_level_(CpuFeatures::simd_level()), have_byte_(false), byte_(0) {
+}
+
+void DepthStatsAccumulator::set_simd_level(SimdLevel level) {
+    simd_level_ = CpuFeatures::clamp(level);
+}
+
+SimdLevel DepthStatsAccumulator::simd_level() const {
+    return simd_level_;
+}
+
+void DepthStatsAccumulator::reset() {
+    state_ = State();
+    have_byte_ = false;
+}
+
+void DepthStatsAccumulator::add(const uint8_t* src, uint8_t* dst, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    if (have_byte_) {
+        // Completes the pixel the last piece ended in the middle of
+        uint8_t pixel[2] = {byte_, src[0]};
+        add_scalar(state_, pixel, nullptr, 1);
+        if (dst) {
+            *dst++ = src[0];
+        }
+        src++;
+        length--;
+        have_byte_ = false;
+    }
+    size_t pixels = length / 2;
+    add_pixels(src, dst, pixels);
+    if (length & 1) {
+        byte_ = src[length - 1];
+        if (dst) {
+            dst[length - 1] = byte_;
+        }
+        have_byte_ = true;
+    }
+}
+
+void DepthStatsAccumulator::add_pixels(const uint8_t* src, uint8_t* dst, size_t pixel_count) {
+    // The SIMD kernels take whole groups of LANES pixels starting at lane 0,
+    // so the lanes of the checksum line up whatever the piece boundaries
+    size_t head = std::min(pixel_count, (LANES - state_.pixels % LANES) % LANES);
+    add_scalar(state_, src, dst, head);
+    src += head * 2;
+    dst = dst ? dst + head * 2 : nullptr;
+    pixel_count -= head;
+
+    size_t groups = pixel_count / LANES;
+    size_t body = 0;
+    switch (simd_level_) {
+#if CPU_X86
+    case SimdLevel::Avx2:
+        dst ? add_avx2<true>(state_, src, dst, groups) : add_avx2<false>(state_, src, dst, groups);
+        body = groups * LANES;
+        break;
+    case SimdLevel::Sse41:
+        dst ? add_sse41<true>(state_, src, dst, groups) : add_sse41<false>(state_, src, dst, groups);
+        body = groups * LANES;
+        break;
+#endif
+    default:
+        break;
+    }
+    add_scalar(state_, src + body * 2, dst ? dst + body * 2 : nullptr, pixel_count - body);
+}
+
+void DepthStatsAccumulator::finish(DepthStats& stats) {
+    const State& s = state_;
+    uint32_t valid = s.at_least[0];
+    stats.computed = true;
+    stats.min_depth = valid ? s.min_depth : 0;
+    stats.max_depth = s.max_depth;
+    stats.valid_pixels = valid;
+    stats.zero_pixels = static_cast<uint32_t>(s.pixels - valid);
+    stats.depth_sum = s.depth_sum;
+    for (int k = 0; k < BINS; k++) {
+        stats.histogram[k] = s.at_least[k] - (k + 1 < BINS ? s.at_least[k + 1] : 0);
+    }
+    // FNV-1a over the lane sums, so each lane's position counts too
+    uint32_t hash = 2166136261u ^ static_cast<uint32_t>(s.pixels);
+    for (int lane = 0; lane < LANES; lane++) {
+        hash = (hash ^ s.sum_a[lane]) * 16777619u;
+        hash = (hash ^ s.sum_b[lane]) * 16777619u;
+    }
+    stats.checksum = hash;
+    reset();
+}
+
+void DepthStatsAccumulator::compute(const uint16_t* depth, size_t pixel_count, DepthStats& stats, SimdLevel level) {
+    DepthStatsAccumulator accumulator;
+    accumulator.set_simd_level(level);
+    accumulator.add(reinterpret_cast<const uint8_t*>(depth), nullptr, pixel_count * 2);
+    accumulator.finish(stats);
+}
@@ -0,0 +1,165 @@
+#include "filter_chain.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void record(FilterChain::FilterTiming& timing, double ms) {
+    timing.frames++;
+    timing.total_ms += ms;
+    timing.max_ms = std::max(timing.max_ms, ms);
+}
+
+}  // namespace
+
+FilterChain::FilterChain(ThreadPool* pool)
+    : pool_(pool ? pool : &ThreadPool::shared()), fusion_(true), planned_(false),
+      input_width_(0), input_height_(0), output_width_(0), output_height_(0) {
+    frame_timing_.name = "frame";
+}
+
+void FilterChain::add(std::unique_ptr<DepthFilter> filter) {
+    filters_.push_back(std::move(filter));
+    FilterTiming timing;
+    timing.name = filters_.back()->name();
+    timings_.push_back(timing);
+
+    frame_ns_.reset(new std::atomic<uint64_t>[filters_.size()]);
+    for (size_t i = 0; i < filters_.size(); i++) {
+        frame_ns_[i] = 0;
+    }
+    planned_ = false;
+}
+
+size_t FilterChain::size() const {
+    return filters_.size();
+}
+
+DepthFilter& FilterChain::filter(size_t index) {
+    return *filters_[index];
+}
+
+void FilterChain::set_simd_level(SimdLevel level) {
+    for (auto& filter : filters_) {
+        filter->set_simd_level(level);
+    }
+}
+
+void FilterChain::set_fusion(bool enabled) {
+    fusion_ = enabled;
+    planned_ = false;
+}
+
+void FilterChain::output_size(int width, int height, int& out_width, int& out_height) {
+    if (!planned_ || width != input_width_ || height != input_height_) {
+        plan(width, height);
+    }
+    out_width = output_width_;
+    out_height = output_height_;
+}
+
+void FilterChain::plan(int width, int height) {
+    passes_.clear();
+    input_width_ = width;
+    input_height_ = height;
+
+    for (size_t i = 0; i < filters_.size(); i++) {
+        DepthFilter& filter = *filters_[i];
+        filter.configure(width, height);
+        width = filter.out_width();
+        height = filter.out_height();
+
+        bool fuse = fusion_ && filter.row_local() && !passes_.empty();
+        if (fuse) {
+            passes_.back().last = i + 1;
+        } else {
+            passes_.push_back(Pass{i, i + 1, filter.row_local(), height});
+        }
+    }
+
+    output_width_ = width;
+    output_height_ = height;
+    // Filters never grow the image, so the input size bounds every pass
+    scratch_.resize(static_cast<size_t>(input_width_) * input_height_);
+    planned_ = true;
+}
+
+void FilterChain::run_pass(const Pass& pass, const uint16_t* src, uint16_t* dst) {
+    const int tiles = (pass.height + ROWS_PER_TILE - 1) / ROWS_PER_TILE;
+    pool_->run(tiles, [&](size_t tile) {
+        int first_row = static_cast<int>(tile) * ROWS_PER_TILE;
+        int last_row = std::min(first_row + ROWS_PER_TILE, pass.height);
+        for (size_t i = pass.first; i < pass.last; i++) {
+            const uint16_t* input = (i == pass.first && !pass.in_place) ? src : dst;
+            Clock::time_point start = Clock::now();
+            filters_[i]->process_rows(input, dst, first_row, last_row);
+            frame_ns_[i].fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - start).count(), std::memory_order_relaxed);
+        }
+    });
+}
+
+void FilterChain::process(uint16_t* depth, int& width, int& height) {
+    if (filters_.empty()) {
+        return;
+    }
+    Clock::time_point start = Clock::now();
+    if (!planned_ || width != input_width_ || height != input_height_) {
+        plan(width, height);
+    }
+
+    // Ping-pong between the caller's buffer and the scratch buffer
+    uint16_t* current = depth;
+    uint16_t* other = scratch_.data();
+    for (const Pass& pass : passes_) {
+        if (pass.in_place) {
+            run_pass(pass, current, current);
+        } else {
+            run_pass(pass, current, other);
+            std::swap(current, other);
+        }
+    }
+    if (current != depth) {
+        memcpy(depth, current, static_cast<size_t>(output_width_) * output_height_ * sizeof(uint16_t));
+    }
+
+    width = output_width_;
+    height = output_height_;
+    for (size_t i = 0; i < filters_.size(); i++) {
+        record(timings_[i], frame_ns_[i].exchange(0, std::memory_order_relaxed) / 1e6);
+    }
+    record(frame_timing_, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+}
+
+bool FilterChain::process(Frame& frame, int& width, int& height) {
+    size_t bytes = static_cast<size_t>(width) * height * sizeof(uint16_t);
+    if (!frame || frame.size() < bytes) {
+        return false;
+    }
+    size_t offset = frame.data() - frame.storage();
+    process(reinterpret_cast<uint16_t*>(frame.data()), width, height);
+    frame.set_data(offset, static_cast<size_t>(width) * height * sizeof(uint16_t));
+    return true;
+}
+
+std::vector<FilterChain::FilterTiming> FilterChain::timings() const {
+    return timings_;
+}
+
+FilterChain::FilterTiming FilterChain::frame_timing() const {
+    return frame_timing_;
+}
+
+void FilterChain::reset_timings() {
+    for (FilterTiming& timing : timings_) {
+        const char* name = timing.name;
+        timing = FilterTiming();
+        timing.name = name;
+    }
+    frame_timing_ = FilterTiming();
+    frame_timing_.name = "frame";
+}
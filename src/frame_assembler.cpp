@@ -0,0 +1,129 @@
+#include "frame_assembler.hpp"
+#include <cstring>
+
+FrameAssembler::FrameAssembler(size_t frame_size)
+    : parser_(frame_size), statistics_(false), have_checksum_(false), last_checksum_(0),
+      zero_copy_frames_(0), copied_bytes_(0), dropped_frames_(0), torn_frames_(0), invalid_payloads_(0),
+      repeated_frames_(0) {
+}
+
+bool FrameAssembler::add(Frame& payload, FramePool& pool, Frame& frame) {
+    UvcPayloadParser::Result result = parser_.parse(payload.data(), payload.size());
+
+    if (result.abort_frame) {
+        assembly_frame_.reset();
+        torn_frames_.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (result.header.length == 0) {
+        invalid_payloads_.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (result.frame_end == UvcPayloadParser::FrameEnd::Torn) {
+        // No point gathering the last piece of a frame we are about to drop
+        assembly_frame_.reset();
+        torn_frames_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (!result.accepted) {
+        return false;
+    }
+
+    // The whole frame arrived in one payload: hand out the transfer buffer
+    // itself, no copy.
+    if (result.frame_start && result.frame_end == UvcPayloadParser::FrameEnd::Complete) {
+        payload.set_data(result.header.length, result.length);
+        payload.metadata().device_timestamp = result.header.pts;
+        if (statistics_) {
+            accumulator_.reset();
+            accumulator_.add(payload.data(), nullptr, payload.size());
+            finish_statistics(payload);
+        }
+        zero_copy_frames_.fetch_add(1, std::memory_order_relaxed);
+        frame = std::move(payload);
+        return true;
+    }
+
+    // Otherwise gather the payloads of this frame into a pool buffer
+    if (result.frame_start) {
+        assembly_frame_ = pool.acquire();
+        if (!assembly_frame_) {
+            dropped_frames_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            assembly_frame_.metadata().timestamp_ns = payload.metadata().timestamp_ns;
+            assembly_frame_.metadata().device_timestamp = result.header.pts;
+        }
+        accumulator_.reset();
+    }
+    if (!assembly_frame_) {
+        return false;
+    }
+
+    // Payloads arrive in order, so the statistics can ride along with the copy
+    if (statistics_) {
+        accumulator_.add(result.data, assembly_frame_.storage() + result.offset, result.length);
+    } else {
+        memcpy(assembly_frame_.storage() + result.offset, result.data, result.length);
+    }
+    copied_bytes_.fetch_add(result.length, std::memory_order_relaxed);
+
+    if (result.frame_end != UvcPayloadParser::FrameEnd::Complete) {
+        return false;
+    }
+    assembly_frame_.set_data(0, parser_.frame_size());
+    if (statistics_) {
+        finish_statistics(assembly_frame_);
+    }
+    frame = std::move(assembly_frame_);
+    return true;
+}
+
+void FrameAssembler::reset() {
+    assembly_frame_.reset();
+    parser_.reset();
+    have_checksum_ = false;
+}
+
+void FrameAssembler::set_frame_size(size_t frame_size) {
+    assembly_frame_.reset();
+    parser_ = UvcPayloadParser(frame_size);
+    have_checksum_ = false;
+}
+
+size_t FrameAssembler::frame_size() const {
+    return parser_.frame_size();
+}
+
+void FrameAssembler::set_statistics(bool enabled) {
+    statistics_ = enabled;
+    have_checksum_ = false;
+}
+
+bool FrameAssembler::statistics() const {
+    return statistics_;
+}
+
+void FrameAssembler::set_simd_level(SimdLevel level) {
+    accumulator_.set_simd_level(level);
+}
+
+void FrameAssembler::finish_statistics(Frame& frame) {
+    DepthStats& stats = frame.metadata().depth_stats;
+    accumulator_.finish(stats);
+    // Consecutive frames of a live scene never match pixel for pixel, the
+    // noise alone sees to that
+    if (have_checksum_ && stats.checksum == last_checksum_) {
+        repeated_frames_.fetch_add(1, std::memory_order_relaxed);
+    }
+    have_checksum_ = true;
+    last_checksum_ = stats.checksum;
+}
+
+FrameAssembler::Stats FrameAssembler::stats() const {
+    Stats stats;
+    stats.zero_copy_frames = zero_copy_frames_.load(std::memory_order_relaxed);
+    stats.copied_bytes = copied_bytes_.load(std::memory_order_relaxed);
+    stats.dropped_frames = dropped_frames_.load(std::memory_order_relaxed);
+    stats.torn_frames = torn_frames_.load(std::memory_order_relaxed);
+    stats.invalid_payloads = invalid_payloads_.load(std::memory_order_relaxed);
+    stats.repeated_frames = repeated_frames_.load(std::memory_order_relaxed);
+    return stats;
+}
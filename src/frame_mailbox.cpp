@@ -0,0 +1,137 @@
+#include "frame_mailbox.hpp"
+#include <chrono>
+#include <thread>
+
+namespace {
+
+// Spin briefly, then yield, then sleep: keeps hand-off latency low without
+// burning a core while the other side is idle.
+void backoff(int& attempt) {
+    if (attempt < 64) {
+        attempt++;
+    } else if (attempt < 128) {
+        attempt++;
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+}  // namespace
+
+FrameMailbox::FrameMailbox(Policy policy, size_t capacity)
+    : policy_(policy), closed_(false), middle_(1), back_(0), front_(2),
+      capacity_(capacity > 0 ? capacity : 1), ring_(new Frame[capacity > 0 ? capacity : 1]),
+      head_(0), tail_(0), published_(0), dropped_(0), producer_waits_(0), delivered_(0) {
+}
+
+bool FrameMailbox::publish(Frame&& frame) {
+    if (closed_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    return policy_ == Policy::DropOldest ? publish_latest(std::move(frame)) : publish_queued(std::move(frame));
+}
+
+bool FrameMailbox::try_consume(Frame& frame) {
+    return policy_ == Policy::DropOldest ? consume_latest(frame) : consume_queued(frame);
+}
+
+bool FrameMailbox::consume(Frame& frame, unsigned int timeout_ms) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    int attempt = 0;
+    while (!try_consume(frame)) {
+        if (closed_.load(std::memory_order_acquire) || std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+        backoff(attempt);
+    }
+    return true;
+}
+
+bool FrameMailbox::publish_latest(Frame&& frame) {
+    triple_[back_] = std::move(frame);
+    uint8_t previous = middle_.exchange(back_ | FRESH, std::memory_order_acq_rel);
+    back_ = previous & INDEX_MASK;
+
+    published_.fetch_add(1, std::memory_order_relaxed);
+    if (previous & FRESH) {
+        // The consumer never saw it; give the buffer back to the pool now
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        triple_[back_].reset();
+    }
+    return true;
+}
+
+bool FrameMailbox::consume_latest(Frame& frame) {
+    if (!(middle_.load(std::memory_order_acquire) & FRESH)) {
+        return false;
+    }
+    uint8_t previous = middle_.exchange(front_, std::memory_order_acq_rel);
+    front_ = previous & INDEX_MASK;
+    frame = std::move(triple_[front_]);
+    delivered_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool FrameMailbox::publish_queued(Frame&& frame) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) >= capacity_) {
+        producer_waits_.fetch_add(1, std::memory_order_relaxed);
+        int attempt = 0;
+        while (tail - head_.load(std::memory_order_acquire) >= capacity_) {
+            if (closed_.load(std::memory_order_acquire)) {
+                return false;
+            }
+            backoff(attempt);
+        }
+    }
+
+    ring_[tail % capacity_] = std::move(frame);
+    tail_.store(tail + 1, std::memory_order_release);
+    published_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool FrameMailbox::consume_queued(Frame& frame) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    frame = std::move(ring_[head % capacity_]);
+    head_.store(head + 1, std::memory_order_release);
+    delivered_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void FrameMailbox::close() {
+    closed_.store(true, std::memory_order_release);
+}
+
+void FrameMailbox::reopen() {
+    // Only call while neither side is active
+    for (Frame& frame : triple_) {
+        frame.reset();
+    }
+    middle_.store(1, std::memory_order_relaxed);
+    back_ = 0;
+    front_ = 2;
+    for (size_t i = 0; i < capacity_; i++) {
+        ring_[i].reset();
+    }
+    head_.store(0, std::memory_order_relaxed);
+    tail_.store(0, std::memory_order_relaxed);
+    closed_.store(false, std::memory_order_release);
+}
+
+FrameMailbox::Policy FrameMailbox::policy() const {
+    return policy_;
+}
+
+FrameMailbox::Stats FrameMailbox::stats() const {
+    Stats stats;
+    stats.published = published_.load(std::memory_order_relaxed);
+    stats.delivered = delivered_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    stats.producer_waits = producer_waits_.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,89 @@
+#include "frame_memory.hpp"
+#include "logger.hpp"
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define LOG_COMPONENT "memory"
+
+FrameMemory::FrameMemory(size_t size, const Options& options)
+    : data_(nullptr), size_(size), mapped_size_(0), locked_(false), huge_pages_(false), numa_node_(-1) {
+#ifdef __linux__
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    void* mapping = MAP_FAILED;
+    if (options.huge_pages) {
+        // Reserved huge pages first (vm.nr_hugepages); most hosts have none
+        mapped_size_ = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        mapping = mmap(nullptr, mapped_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                       -1, 0);
+        huge_pages_ = mapping != MAP_FAILED;
+    }
+    if (mapping == MAP_FAILED) {
+        mapped_size_ = (size + page - 1) / page * page;
+        mapping = mmap(nullptr, mapped_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (mapping == MAP_FAILED) {
+        LOG_WARN("Failed to map %zu bytes of frame memory: %s", size, std::strerror(errno));
+        mapped_size_ = 0;
+    } else {
+        data_ = static_cast<uint8_t*>(mapping);
+        if (options.huge_pages && !huge_pages_) {
+            huge_pages_ = madvise(data_, mapped_size_, MADV_HUGEPAGE) == 0;
+            if (!huge_pages_) {
+                LOG_WARN("No huge pages for frame memory: %s", std::strerror(errno));
+            }
+        }
+        if (options.numa_node >= 0) {
+            // Preferred rather than bound, so a full node spills over
+            // instead of failing the allocation
+            unsigned long mask[4] = {};
+            const unsigned long bits = sizeof(mask) * 8;
+            if (static_cast<unsigned long>(options.numa_node) < bits) {
+                mask[options.numa_node / (sizeof(unsigned long) * 8)] |=
+                    1ul << (options.numa_node % (sizeof(unsigned long) * 8));
+                if (syscall(SYS_mbind, data_, mapped_size_, MPOL_PREFERRED, mask, bits + 1, 0) == 0) {
+                    numa_node_ = options.numa_node;
+                } else {
+                    LOG_WARN("Failed to place frame memory on NUMA node %d: %s", options.numa_node,
+                             std::strerror(errno));
+                }
+            }
+        }
+        if (options.lock) {
+            locked_ = mlock(data_, mapped_size_) == 0;
+            if (!locked_) {
+                LOG_WARN("Failed to lock %zu bytes of frame memory (RLIMIT_MEMLOCK?): %s", mapped_size_,
+                         std::strerror(errno));
+            }
+        }
+        // Fault every page in now, under the policy above, rather than on
+        // the capture path. mlock already has.
+        if (!locked_) {
+            memset(data_, 0, mapped_size_);
+        }
+    }
+#else
+    if (options.any()) {
+        LOG_DEBUG("Locked, huge-page and NUMA frame memory are not supported here");
+    }
+#endif
+    if (!data_) {
+        heap_.reset(new uint8_t[size]);
+        data_ = heap_.get();
+    }
+}
+
+FrameMemory::~FrameMemory() {
+#ifdef __linux__
+    if (mapped_size_ > 0) {
+        // Unmapping unlocks too
+        munmap(data_, mapped_size_);
+    }
+#endif
+}
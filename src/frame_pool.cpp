@@ -0,0 +1,179 @@
+#include "frame_pool.hpp"
+#include <utility>
+
+Frame::Frame() noexcept : slot_(nullptr) {
+}
+
+Frame::Frame(FrameSlot* slot) noexcept : slot_(slot) {
+}
+
+Frame::Frame(const Frame& other) noexcept : slot_(other.slot_) {
+    if (slot_) {
+        slot_->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+Frame::Frame(Frame&& other) noexcept : slot_(other.slot_) {
+    other.slot_ = nullptr;
+}
+
+Frame& Frame::operator=(const Frame& other) noexcept {
+    if (this != &other) {
+        Frame copy(other);
+        std::swap(slot_, copy.slot_);
+    }
+    return *this;
+}
+
+Frame& Frame::operator=(Frame&& other) noexcept {
+    if (this != &other) {
+        reset();
+        slot_ = other.slot_;
+        other.slot_ = nullptr;
+    }
+    return *this;
+}
+
+Frame::~Frame() {
+    reset();
+}
+
+void Frame::set_data(size_t offset, size_t size) {
+    slot_->data_offset = offset;
+    slot_->data_size = size;
+}
+
+uint32_t Frame::use_count() const {
+    return slot_ ? slot_->refs.load(std::memory_order_relaxed) : 0;
+}
+
+void Frame::reset() {
+    if (!slot_) {
+        return;
+    }
+    if (slot_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        slot_->pool->release(slot_);
+    }
+    slot_ = nullptr;
+}
+
+FramePool::FramePool(size_t frame_count, size_t frame_capacity)
+    : FramePool(frame_count, frame_capacity, FrameMemory::Options()) {
+}
+
+FramePool::FramePool(size_t frame_count, size_t frame_capacity, const FrameMemory::Options& memory)
+    : frame_count_(frame_count), frame_capacity_(frame_capacity),
+      free_head_(EMPTY), acquired_(0), released_(0), exhausted_(0), allocations_(0) {
+    // One block for every buffer, each cache-line aligned
+    size_t stride = stride_for(frame_capacity);
+    uint8_t* block;
+    if (memory.any()) {
+        memory_ = std::make_unique<FrameMemory>(stride * frame_count + ALIGNMENT, memory);
+        block = memory_->data();
+    } else {
+        storage_.reset(new uint8_t[stride * frame_count + ALIGNMENT]);
+        block = storage_.get();
+    }
+    allocations_ = 1;
+
+    uintptr_t base = reinterpret_cast<uintptr_t>(block);
+    base = (base + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    init_slots(reinterpret_cast<uint8_t*>(base), stride);
+}
+
+FramePool::FramePool(uint8_t* memory, size_t memory_size, size_t frame_capacity)
+    : frame_count_(0), frame_capacity_(frame_capacity),
+      free_head_(EMPTY), acquired_(0), released_(0), exhausted_(0), allocations_(0) {
+    uintptr_t base = reinterpret_cast<uintptr_t>(memory);
+    uintptr_t aligned = (base + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    size_t stride = stride_for(frame_capacity);
+    size_t usable = memory_size > aligned - base ? memory_size - (aligned - base) : 0;
+    frame_count_ = usable / stride;
+    init_slots(reinterpret_cast<uint8_t*>(aligned), stride);
+}
+
+size_t FramePool::required_memory(size_t frame_count, size_t frame_capacity) {
+    return stride_for(frame_capacity) * frame_count + ALIGNMENT;
+}
+
+size_t FramePool::stride_for(size_t frame_capacity) {
+    return (frame_capacity + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+void FramePool::init_slots(uint8_t* memory, size_t stride) {
+    slots_.reset(new FrameSlot[frame_count_]);
+    allocations_++;
+
+    for (size_t i = frame_count_; i-- > 0;) {
+        FrameSlot& slot = slots_[i];
+        slot.storage = memory + stride * i;
+        slot.capacity = frame_capacity_;
+        slot.pool = this;
+        slot.index = static_cast<uint32_t>(i);
+        push_free(&slot);
+    }
+}
+
+FramePool::~FramePool() {
+}
+
+Frame FramePool::acquire() {
+    uint64_t head = free_head_.load(std::memory_order_acquire);
+    for (;;) {
+        uint32_t index = static_cast<uint32_t>(head);
+        if (index == EMPTY) {
+            exhausted_.fetch_add(1, std::memory_order_relaxed);
+            return Frame();
+        }
+        uint32_t next = slots_[index].next_free.load(std::memory_order_relaxed);
+        uint64_t tag = (head >> 32) + 1;
+        if (free_head_.compare_exchange_weak(head, (tag << 32) | next,
+                                             std::memory_order_acq_rel, std::memory_order_acquire)) {
+            FrameSlot* slot = &slots_[index];
+            slot->refs.store(1, std::memory_order_relaxed);
+            slot->data_offset = 0;
+            slot->data_size = 0;
+            slot->metadata = FrameMetadata();
+            acquired_.fetch_add(1, std::memory_order_relaxed);
+            return Frame(slot);
+        }
+    }
+}
+
+void FramePool::release(FrameSlot* slot) {
+    released_.fetch_add(1, std::memory_order_relaxed);
+    push_free(slot);
+}
+
+void FramePool::push_free(FrameSlot* slot) {
+    uint64_t head = free_head_.load(std::memory_order_relaxed);
+    for (;;) {
+        slot->next_free.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+        uint64_t tag = (head >> 32) + 1;
+        if (free_head_.compare_exchange_weak(head, (tag << 32) | slot->index,
+                                             std::memory_order_release, std::memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+size_t FramePool::frame_capacity() const {
+    return frame_capacity_;
+}
+
+size_t FramePool::frame_count() const {
+    return frame_count_;
+}
+
+FramePool::Stats FramePool::stats() const {
+    Stats stats;
+    stats.frame_count = frame_count_;
+    stats.acquired = acquired_.load(std::memory_order_relaxed);
+    stats.released = released_.load(std::memory_order_relaxed);
+    stats.exhausted = exhausted_.load(std::memory_order_relaxed);
+    stats.allocations = allocations_;
+    stats.memory_locked = memory_ && memory_->locked();
+    stats.huge_pages = memory_ && memory_->huge_pages();
+    stats.in_use = static_cast<size_t>(stats.acquired - stats.released);
+    return stats;
+}
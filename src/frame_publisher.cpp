@@ -0,0 +1,202 @@
+#include "frame_publisher.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#define LOG_COMPONENT "publish"
+
+FramePublisher::FramePublisher() : FramePublisher(Config()) {
+}
+
+FramePublisher::FramePublisher(const Config& config)
+    : config_(config), fd_(-1), map_(nullptr), map_size_(0), header_(nullptr), too_large_(0) {
+}
+
+FramePublisher::~FramePublisher() {
+    close();
+}
+
+bool FramePublisher::open() {
+    if (header_) {
+        return true;
+    }
+    if (config_.slots < 2 || config_.width <= 0 || config_.height <= 0) {
+        LOG_ERROR("Invalid publisher configuration");
+        return false;
+    }
+
+    // Start from a fresh ring: subscribers still holding an old one see it
+    // marked closed, or, if its publisher crashed, stop getting frames
+    shm_unlink(config_.name.c_str());
+    fd_ = shm_open(config_.name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660);
+    if (fd_ < 0) {
+        LOG_ERROR("Failed to create shared memory %s: %s", config_.name.c_str(), std::strerror(errno));
+        return false;
+    }
+
+    size_t frame_capacity = static_cast<size_t>(config_.width) * config_.height * sizeof(uint16_t);
+    size_t stride = ShmRingFormat::slot_stride(frame_capacity);
+    map_size_ = ShmRingFormat::HEADER_SPACE + stride * config_.slots;
+    void* map = MAP_FAILED;
+    if (ftruncate(fd_, static_cast<off_t>(map_size_)) == 0) {
+        map = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    }
+    if (map == MAP_FAILED) {
+        LOG_ERROR("Failed to map shared memory %s: %s", config_.name.c_str(), std::strerror(errno));
+        ::close(fd_);
+        fd_ = -1;
+        shm_unlink(config_.name.c_str());
+        return false;
+    }
+    map_ = static_cast<uint8_t*>(map);
+
+    // The new mapping is zero-filled, which is every slot's initial state
+    header_ = new (map_) ShmRingHeader();
+    header_->version = ShmRingFormat::VERSION;
+    header_->header_size = sizeof(ShmRingHeader);
+    header_->slot_count = static_cast<uint32_t>(config_.slots);
+    header_->slot_stride = static_cast<uint32_t>(stride);
+    header_->frame_capacity = static_cast<uint32_t>(frame_capacity);
+    header_->width = static_cast<uint32_t>(config_.width);
+    header_->height = static_cast<uint32_t>(config_.height);
+    header_->pixel_format = ShmRingFormat::PIXEL_FORMAT_Z16;
+    header_->publisher_pid = static_cast<uint32_t>(getpid());
+    for (int i = 0; i < config_.slots; i++) {
+        new (map_ + ShmRingFormat::HEADER_SPACE + stride * i) ShmSlotHeader();
+    }
+    // Magic last, so a subscriber that maps the ring early sees all or nothing
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header_->magic, ShmRingFormat::MAGIC, sizeof(header_->magic));
+
+    too_large_ = 0;
+    register_metrics();
+    LOG_INFO("Publishing %dx%d frames to %s in %d slots", config_.width, config_.height, config_.name.c_str(),
+             config_.slots);
+    return true;
+}
+
+void FramePublisher::close() {
+    if (!header_) {
+        return;
+    }
+    Metrics::instance().remove(this);
+    header_->closed.store(1);
+    wake_subscribers();
+    munmap(map_, map_size_);
+    ::close(fd_);
+    shm_unlink(config_.name.c_str());
+    map_ = nullptr;
+    header_ = nullptr;
+    fd_ = -1;
+}
+
+bool FramePublisher::is_open() const {
+    return header_ != nullptr;
+}
+
+bool FramePublisher::publish(const Frame& frame) {
+    return publish(frame.data(), frame.size(), frame.metadata());
+}
+
+bool FramePublisher::publish(const uint8_t* data, size_t size, const FrameMetadata& metadata) {
+    if (!header_) {
+        return false;
+    }
+    if (size > header_->frame_capacity) {
+        too_large_.fetch_add(1, std::memory_order_relaxed);
+        LOG_ERROR("Frame of %zu bytes does not fit a %u byte slot", size, header_->frame_capacity);
+        return false;
+    }
+
+    uint64_t number = header_->published.load(std::memory_order_relaxed);
+    uint8_t* slot_memory = map_ + ShmRingFormat::HEADER_SPACE +
+                           static_cast<size_t>(number % header_->slot_count) * header_->slot_stride;
+    ShmSlotHeader* slot = reinterpret_cast<ShmSlotHeader*>(slot_memory);
+
+    // Seqlock write: odd version, contents, then the even version
+    slot->version.store(2 * number + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->sequence = metadata.sequence;
+    slot->timestamp_ns = metadata.timestamp_ns;
+    slot->device_timestamp = metadata.device_timestamp;
+    slot->size = static_cast<uint32_t>(size);
+    std::memcpy(slot_memory + sizeof(ShmSlotHeader), data, size);
+    slot->published_ns = monotonic_ns();
+    slot->version.store(2 * number + 2, std::memory_order_release);
+
+    header_->published.store(number + 1, std::memory_order_release);
+    wake_subscribers();
+    return true;
+}
+
+void FramePublisher::wake_subscribers() {
+    // Pairs with FrameSubscriber::wait(): either it sees the new wake value
+    // or this sees it waiting. No system call unless someone is waiting.
+    header_->wake.fetch_add(1);
+    if (header_->waiters.load() == 0) {
+        return;
+    }
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&header_->wake), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+uint64_t FramePublisher::published() const {
+    return header_ ? header_->published.load(std::memory_order_relaxed) : 0;
+}
+
+std::vector<FramePublisher::SubscriberInfo> FramePublisher::subscribers() {
+    std::vector<SubscriberInfo> result;
+    if (!header_) {
+        return result;
+    }
+    uint64_t published = header_->published.load(std::memory_order_acquire);
+    for (ShmSubscriberEntry& entry : header_->subscribers) {
+        uint32_t pid = entry.pid.load(std::memory_order_acquire);
+        if (pid == 0) {
+            continue;
+        }
+        if (kill(static_cast<pid_t>(pid), 0) != 0 && errno == ESRCH) {
+            entry.pid.compare_exchange_strong(pid, 0);
+            continue;
+        }
+        SubscriberInfo info;
+        info.pid = pid;
+        uint64_t position = entry.position.load(std::memory_order_relaxed);
+        info.lag = published > position ? published - position : 0;
+        info.skipped = entry.skipped.load(std::memory_order_relaxed);
+        result.push_back(info);
+    }
+    return result;
+}
+
+void FramePublisher::register_metrics() {
+    Metrics& metrics = Metrics::instance();
+    metrics.add(this, "shm_frames_published_total", "Frames published to shared memory", Metrics::Kind::Counter,
+                [this] { return static_cast<double>(published()); });
+    metrics.add(this, "shm_frames_too_large_total", "Frames larger than a shared-memory slot",
+                Metrics::Kind::Counter,
+                [this] { return static_cast<double>(too_large_.load(std::memory_order_relaxed)); });
+    metrics.add(this, "shm_subscribers", "Processes reading the shared-memory ring", Metrics::Kind::Gauge,
+                [this] { return static_cast<double>(subscribers().size()); });
+    metrics.add(this, "shm_subscriber_max_lag", "Frames the slowest subscriber is behind", Metrics::Kind::Gauge,
+                [this] {
+                    uint64_t lag = 0;
+                    for (const SubscriberInfo& info : subscribers()) {
+                        lag = std::max(lag, info.lag);
+                    }
+                    return static_cast<double>(lag);
+                });
+}
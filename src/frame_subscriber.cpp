@@ -0,0 +1,259 @@
+#include "frame_subscriber.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+
+#define LOG_COMPONENT "subscribe"
+
+#ifndef __linux__
+namespace {
+
+// Without futexes, how often to look for a new frame
+constexpr int POLL_US = 500;
+
+}
+#endif
+
+FrameSubscriber::FrameSubscriber() : FrameSubscriber(Config()) {
+}
+
+FrameSubscriber::FrameSubscriber(const Config& config)
+    : config_(config), fd_(-1), map_(nullptr), map_size_(0), header_(nullptr), entry_(nullptr), position_(0) {
+}
+
+FrameSubscriber::~FrameSubscriber() {
+    close();
+}
+
+bool FrameSubscriber::open() {
+    close();
+
+    fd_ = shm_open(config_.name.c_str(), O_RDWR, 0);
+    if (fd_ < 0) {
+        LOG_ERROR("No frames published at %s: %s", config_.name.c_str(), std::strerror(errno));
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd_, &info) != 0 || static_cast<size_t>(info.st_size) < ShmRingFormat::HEADER_SPACE) {
+        LOG_ERROR("%s is not a frame ring", config_.name.c_str());
+        close();
+        return false;
+    }
+    map_size_ = static_cast<size_t>(info.st_size);
+    void* map = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (map == MAP_FAILED) {
+        LOG_ERROR("Failed to map %s: %s", config_.name.c_str(), std::strerror(errno));
+        map_size_ = 0;
+        close();
+        return false;
+    }
+    map_ = static_cast<uint8_t*>(map);
+    header_ = reinterpret_cast<ShmRingHeader*>(map_);
+
+    bool valid = std::memcmp(header_->magic, ShmRingFormat::MAGIC, sizeof(header_->magic)) == 0;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    valid = valid && header_->version == ShmRingFormat::VERSION &&
+            header_->pixel_format == ShmRingFormat::PIXEL_FORMAT_Z16 && header_->slot_count >= 2 &&
+            header_->frame_capacity >= static_cast<uint64_t>(header_->width) * header_->height * sizeof(uint16_t) &&
+            header_->slot_stride >= sizeof(ShmSlotHeader) + header_->frame_capacity &&
+            ShmRingFormat::HEADER_SPACE + static_cast<size_t>(header_->slot_stride) * header_->slot_count <= map_size_;
+    if (!valid) {
+        LOG_ERROR("%s is not a frame ring this version can read", config_.name.c_str());
+        close();
+        return false;
+    }
+    // Caught between the publisher closing the ring and unlinking it
+    if (header_->closed.load(std::memory_order_acquire) != 0) {
+        LOG_DEBUG("%s is closed", config_.name.c_str());
+        close();
+        return false;
+    }
+
+    // Claim a row in the subscriber table so the publisher can see our lag
+    uint32_t pid = static_cast<uint32_t>(getpid());
+    for (ShmSubscriberEntry& entry : header_->subscribers) {
+        uint32_t free_pid = 0;
+        if (entry.pid.compare_exchange_strong(free_pid, pid)) {
+            entry_ = &entry;
+            break;
+        }
+    }
+    if (!entry_) {
+        LOG_WARN("Subscriber table of %s is full, the publisher will not see this subscriber",
+                 config_.name.c_str());
+    }
+
+    uint64_t published = header_->published.load(std::memory_order_acquire);
+    position_ = published > 0 ? published - 1 : 0;
+    stats_ = Stats();
+    if (entry_) {
+        entry_->position.store(position_, std::memory_order_relaxed);
+        entry_->skipped.store(0, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+void FrameSubscriber::close() {
+    if (entry_) {
+        entry_->pid.store(0, std::memory_order_release);
+        entry_ = nullptr;
+    }
+    if (map_) {
+        munmap(map_, map_size_);
+        map_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    header_ = nullptr;
+    map_size_ = 0;
+}
+
+bool FrameSubscriber::is_open() const {
+    return header_ != nullptr;
+}
+
+int FrameSubscriber::width() const {
+    return header_ ? static_cast<int>(header_->width) : 0;
+}
+
+int FrameSubscriber::height() const {
+    return header_ ? static_cast<int>(header_->height) : 0;
+}
+
+bool FrameSubscriber::publisher_closed() const {
+    return header_ && header_->closed.load(std::memory_order_acquire) != 0;
+}
+
+const ShmSlotHeader* FrameSubscriber::slot(uint64_t number) const {
+    return reinterpret_cast<const ShmSlotHeader*>(
+        map_ + ShmRingFormat::HEADER_SPACE + static_cast<size_t>(number % header_->slot_count) * header_->slot_stride);
+}
+
+bool FrameSubscriber::next(FrameView& view, unsigned int timeout_ms) {
+    if (!header_) {
+        return false;
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    for (;;) {
+        if (publisher_closed()) {
+            return false;
+        }
+        uint64_t published = header_->published.load(std::memory_order_acquire);
+        if (position_ >= published) {
+            auto now = std::chrono::steady_clock::now();
+            if (now >= deadline) {
+                return false;
+            }
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+            wait(position_, static_cast<unsigned int>(remaining) + 1);
+            continue;
+        }
+
+        // The slot being written holds the frame slot_count back, so the
+        // oldest intact one is slot_count - 1 frames back
+        uint64_t oldest = published - std::min<uint64_t>(published, header_->slot_count - 1);
+        if (config_.latest_only) {
+            oldest = published - 1;
+        }
+        if (position_ < oldest) {
+            stats_.skipped += oldest - position_;
+            position_ = oldest;
+        }
+
+        const ShmSlotHeader* current = slot(position_);
+        uint64_t version = current->version.load(std::memory_order_acquire);
+        bool intact = version == 2 * position_ + 2;
+        if (intact) {
+            view.depth = reinterpret_cast<const uint16_t*>(reinterpret_cast<const uint8_t*>(current) +
+                                                           sizeof(ShmSlotHeader));
+            view.size = std::min<size_t>(current->size, header_->frame_capacity);
+            view.width = static_cast<int>(header_->width);
+            view.height = static_cast<int>(header_->height);
+            view.number = position_;
+            view.published_ns = current->published_ns;
+            view.metadata.sequence = current->sequence;
+            view.metadata.timestamp_ns = current->timestamp_ns;
+            view.metadata.device_timestamp = current->device_timestamp;
+            view.metadata.assembled_ns = 0;
+            view.version = version;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            intact = current->version.load(std::memory_order_relaxed) == version;
+        }
+        if (!intact) {
+            // Overwritten since published was read: the publisher lapped us
+            stats_.skipped++;
+            position_++;
+            continue;
+        }
+
+        position_++;
+        stats_.received++;
+        stats_.lag = published - position_;
+        if (entry_) {
+            entry_->position.store(position_, std::memory_order_relaxed);
+            entry_->skipped.store(stats_.skipped, std::memory_order_relaxed);
+        }
+        return true;
+    }
+}
+
+bool FrameSubscriber::release(const FrameView& view) {
+    if (!header_) {
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot(view.number)->version.load(std::memory_order_relaxed) != view.version) {
+        stats_.torn++;
+        return false;
+    }
+    return true;
+}
+
+bool FrameSubscriber::next_copy(uint16_t* depth, FrameView& view, unsigned int timeout_ms) {
+    while (next(view, timeout_ms)) {
+        std::memcpy(depth, view.depth, view.size);
+        if (release(view)) {
+            view.depth = depth;
+            return true;
+        }
+    }
+    return false;
+}
+
+FrameSubscriber::Stats FrameSubscriber::stats() const {
+    return stats_;
+}
+
+bool FrameSubscriber::wait(uint64_t position, unsigned int timeout_ms) {
+#ifdef __linux__
+    // Pairs with FramePublisher::wake_subscribers(): register as a waiter,
+    // then re-check, then sleep only if wake still has the value read first
+    uint32_t wake = header_->wake.load();
+    header_->waiters.fetch_add(1);
+    if (header_->published.load() <= position && !header_->closed.load()) {
+        struct timespec timeout;
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_nsec = static_cast<long>(timeout_ms % 1000) * 1000000;
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&header_->wake), FUTEX_WAIT, wake, &timeout, nullptr, 0);
+    }
+    header_->waiters.fetch_sub(1);
+#else
+    (void)timeout_ms;
+    std::this_thread::sleep_for(std::chrono::microseconds(POLL_US));
+#endif
+    return header_->published.load(std::memory_order_acquire) > position;
+}
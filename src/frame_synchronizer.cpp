@@ -0,0 +1,113 @@
+#include "frame_synchronizer.hpp"
+#include <algorithm>
+#include <chrono>
+
+FrameSynchronizer::FrameSynchronizer() : FrameSynchronizer(Config()) {
+}
+
+FrameSynchronizer::FrameSynchronizer(const Config& config)
+    : config_(config), queues_(std::max(config.cameras, 1)), closed_(false), next_number_(0),
+      skew_(Metrics::instance().histogram("camera_sync_skew", "Spread of the frame times within a synced set")) {
+    config_.queue_frames = std::max<size_t>(config_.queue_frames, 1);
+    config_.queue_sets = std::max<size_t>(config_.queue_sets, 1);
+}
+
+void FrameSynchronizer::push(int camera, Frame&& frame) {
+    if (camera < 0 || camera >= static_cast<int>(queues_.size()) || !frame) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) {
+        return;
+    }
+    std::deque<Frame>& queue = queues_[camera];
+    if (queue.size() >= config_.queue_frames) {
+        queue.pop_front();
+        stats_.overflowed++;
+    }
+    queue.push_back(std::move(frame));
+    match();
+}
+
+void FrameSynchronizer::match() {
+    bool made_set = false;
+    for (;;) {
+        // Nothing can be decided until every camera has a frame
+        size_t oldest = 0;
+        uint64_t earliest = UINT64_MAX;
+        uint64_t latest = 0;
+        for (size_t i = 0; i < queues_.size(); i++) {
+            if (queues_[i].empty()) {
+                if (made_set) {
+                    ready_cv_.notify_one();
+                }
+                return;
+            }
+            uint64_t timestamp = queues_[i].front().metadata().timestamp_ns;
+            if (timestamp < earliest) {
+                earliest = timestamp;
+                oldest = i;
+            }
+            latest = std::max(latest, timestamp);
+        }
+
+        // The oldest frame is too old for the others' oldest, and theirs
+        // only get newer, so it will never match
+        if (latest - earliest > config_.tolerance_ns) {
+            queues_[oldest].pop_front();
+            stats_.unmatched++;
+            continue;
+        }
+
+        FrameSet set;
+        set.frames.reserve(queues_.size());
+        for (std::deque<Frame>& queue : queues_) {
+            set.frames.push_back(std::move(queue.front()));
+            queue.pop_front();
+        }
+        set.number = next_number_++;
+        set.timestamp_ns = earliest;
+        set.skew_ns = latest - earliest;
+        skew_.record(set.skew_ns);
+        stats_.sets++;
+        stats_.max_skew_ns = std::max(stats_.max_skew_ns, set.skew_ns);
+        if (ready_.size() >= config_.queue_sets) {
+            ready_.pop_front();
+            stats_.dropped_sets++;
+        }
+        ready_.push_back(std::move(set));
+        made_set = true;
+    }
+}
+
+bool FrameSynchronizer::next(FrameSet& set, unsigned int timeout_ms) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!ready_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                            [this] { return !ready_.empty() || closed_; }) ||
+        ready_.empty()) {
+        return false;
+    }
+    set = std::move(ready_.front());
+    ready_.pop_front();
+    return true;
+}
+
+void FrameSynchronizer::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    ready_cv_.notify_all();
+}
+
+void FrameSynchronizer::reopen() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::deque<Frame>& queue : queues_) {
+        queue.clear();
+    }
+    ready_.clear();
+    closed_ = false;
+}
+
+FrameSynchronizer::Stats FrameSynchronizer::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
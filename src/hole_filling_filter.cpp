@@ -0,0 +1,171 @@
+#include "depth_filter.hpp"
+
+#if CPU_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+void fill_from_left_scalar(uint16_t* row, int x, int width) {
+    uint16_t carry = x > 0 ? row[x - 1] : 0;
+    for (; x < width; x++) {
+        if (row[x]) {
+            carry = row[x];
+        } else {
+            row[x] = carry;
+        }
+    }
+}
+
+uint16_t fill_around_pixel(const uint16_t* src, int width, int height, int x, int y, bool nearest) {
+    uint16_t center = src[static_cast<size_t>(y) * width + x];
+    if (center) {
+        return center;
+    }
+    uint16_t best = 0;
+    for (int ny = y - 1; ny <= y + 1; ny++) {
+        if (ny < 0 || ny >= height) {
+            continue;
+        }
+        for (int nx = x - 1; nx <= x + 1; nx++) {
+            if (nx < 0 || nx >= width) {
+                continue;
+            }
+            uint16_t n = src[static_cast<size_t>(ny) * width + nx];
+            if (n && (best == 0 || (nearest ? n < best : n > best))) {
+                best = n;
+            }
+        }
+    }
+    return best;
+}
+
+#if CPU_X86
+
+// Propagates the last valid value rightwards within eight lanes in three
+// shift-and-blend steps, then carries in the value from the previous block.
+// Byte shifts stay within 128-bit lanes, so this serves the AVX2 level too.
+TARGET_SSE41 int fill_from_left_sse41(uint16_t* row, int width) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i last_lane = _mm_set1_epi16(0x0f0e);
+    __m128i carry = zero;
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+        v = _mm_blendv_epi8(v, _mm_slli_si128(v, 2), _mm_cmpeq_epi16(v, zero));
+        v = _mm_blendv_epi8(v, _mm_slli_si128(v, 4), _mm_cmpeq_epi16(v, zero));
+        v = _mm_blendv_epi8(v, _mm_slli_si128(v, 8), _mm_cmpeq_epi16(v, zero));
+        v = _mm_blendv_epi8(v, carry, _mm_cmpeq_epi16(v, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(row + x), v);
+        carry = _mm_shuffle_epi8(v, last_lane);
+    }
+    return x;
+}
+
+TARGET_SSE41 int fill_around_row_sse41(const uint16_t* src, int width, int y, bool nearest, uint16_t* dst, int x) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i all_ones = _mm_set1_epi16(-1);
+    const uint16_t* rows[3] = {
+        src + static_cast<size_t>(y - 1) * width,
+        src + static_cast<size_t>(y) * width,
+        src + static_cast<size_t>(y + 1) * width,
+    };
+    for (; x + 8 <= width - 1; x += 8) {
+        __m128i center = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[1] + x));
+        __m128i best = nearest ? all_ones : zero;
+        for (int dy = 0; dy < 3; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                __m128i n = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[dy] + x + dx));
+                if (nearest) {
+                    best = _mm_min_epu16(best, _mm_or_si128(n, _mm_cmpeq_epi16(n, zero)));
+                } else {
+                    best = _mm_max_epu16(best, n);
+                }
+            }
+        }
+        if (nearest) {
+            best = _mm_andnot_si128(_mm_cmpeq_epi16(best, all_ones), best);
+        }
+        __m128i result = _mm_blendv_epi8(center, best, _mm_cmpeq_epi16(center, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), result);
+    }
+    return x;
+}
+
+TARGET_AVX2 int fill_around_row_avx2(const uint16_t* src, int width, int y, bool nearest, uint16_t* dst, int x) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i all_ones = _mm256_set1_epi16(-1);
+    const uint16_t* rows[3] = {
+        src + static_cast<size_t>(y - 1) * width,
+        src + static_cast<size_t>(y) * width,
+        src + static_cast<size_t>(y + 1) * width,
+    };
+    for (; x + 16 <= width - 1; x += 16) {
+        __m256i center = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[1] + x));
+        __m256i best = nearest ? all_ones : zero;
+        for (int dy = 0; dy < 3; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                __m256i n = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[dy] + x + dx));
+                if (nearest) {
+                    best = _mm256_min_epu16(best, _mm256_or_si256(n, _mm256_cmpeq_epi16(n, zero)));
+                } else {
+                    best = _mm256_max_epu16(best, n);
+                }
+            }
+        }
+        if (nearest) {
+            best = _mm256_andnot_si256(_mm256_cmpeq_epi16(best, all_ones), best);
+        }
+        __m256i result = _mm256_blendv_epi8(center, best, _mm256_cmpeq_epi16(center, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), result);
+    }
+    return x;
+}
+
+#endif
+
+}  // namespace
+
+HoleFillingFilter::HoleFillingFilter(Mode mode) : mode_(mode) {
+}
+
+void HoleFillingFilter::process_rows(const uint16_t* src, uint16_t* dst, int first_row, int last_row) {
+    if (mode_ == Mode::FillFromLeft) {
+        for (int y = first_row; y < last_row; y++) {
+            uint16_t* row = dst + static_cast<size_t>(y) * width_;
+            int x = 0;
+#if CPU_X86
+            if (simd_level_ != SimdLevel::Scalar) {
+                x = fill_from_left_sse41(row, width_);
+            }
+#endif
+            fill_from_left_scalar(row, x, width_);
+        }
+        return;
+    }
+
+    const bool nearest = mode_ == Mode::NearestFromAround;
+    for (int y = first_row; y < last_row; y++) {
+        uint16_t* out = dst + static_cast<size_t>(y) * width_;
+        int x = 0;
+        if (y > 0 && y < height_ - 1 && width_ > 2) {
+            out[0] = fill_around_pixel(src, width_, height_, 0, y, nearest);
+            x = 1;
+            switch (simd_level_) {
+#if CPU_X86
+            case SimdLevel::Avx2:
+                x = fill_around_row_avx2(src, width_, y, nearest, out, x);
+                break;
+            case SimdLevel::Sse41:
+                x = fill_around_row_sse41(src, width_, y, nearest, out, x);
+                break;
+#endif
+            default:
+                break;
+            }
+        }
+        for (; x < width_; x++) {
+            out[x] = fill_around_pixel(src, width_, height_, x, y, nearest);
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#include "imu_sample_ring.hpp"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+size_t round_up_pow2(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+}  // namespace
+
+ImuSampleRing::ImuSampleRing(size_t capacity)
+    : mask_(round_up_pow2(std::max<size_t>(capacity, 1)) - 1), samples_(new ImuSample[mask_ + 1]),
+      head_(0), tail_(0), overruns_(0) {
+}
+
+bool ImuSampleRing::push(const ImuSample& sample) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) > mask_) {
+        overruns_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    samples_[tail & mask_] = sample;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+size_t ImuSampleRing::try_read(ImuSample* samples, size_t max_samples) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t count = std::min(tail_.load(std::memory_order_acquire) - head, max_samples);
+    for (size_t i = 0; i < count; i++) {
+        samples[i] = samples_[(head + i) & mask_];
+    }
+    head_.store(head + count, std::memory_order_release);
+    return count;
+}
+
+size_t ImuSampleRing::read(ImuSample* samples, size_t max_samples, unsigned int timeout_ms) {
+    // Same spin, yield, sleep progression as FrameMailbox, at a finer sleep
+    // to suit the sample rate
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    int attempt = 0;
+    for (;;) {
+        size_t count = try_read(samples, max_samples);
+        if (count > 0 || max_samples == 0 || std::chrono::steady_clock::now() >= deadline) {
+            return count;
+        }
+        if (attempt < 64) {
+            attempt++;
+        } else if (attempt < 128) {
+            attempt++;
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+}
+
+void ImuSampleRing::clear() {
+    head_.store(tail_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+size_t ImuSampleRing::size() const {
+    return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+}
+
+size_t ImuSampleRing::capacity() const {
+    return mask_ + 1;
+}
+
+ImuSampleRing::Stats ImuSampleRing::stats() const {
+    Stats stats;
+    stats.pushed = tail_.load(std::memory_order_relaxed);
+    stats.read = head_.load(std::memory_order_relaxed);
+    stats.overruns = overruns_.load(std::memory_order_relaxed);
+    return stats;
+}
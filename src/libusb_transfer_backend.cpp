@@ -0,0 +1,105 @@
+#include "libusb_transfer_backend.hpp"
+#include "logger.hpp"
+
+#define LOG_COMPONENT "usb"
+
+LibusbTransferBackend::LibusbTransferBackend(libusb_context* context, libusb_device_handle* device_handle,
+                                             uint8_t endpoint, unsigned int timeout_ms, bool interrupt)
+    : context_(context), device_handle_(device_handle), endpoint_(endpoint), timeout_ms_(timeout_ms),
+      interrupt_(interrupt) {
+}
+
+bool LibusbTransferBackend::prepare(TransferRequest* request) {
+    libusb_transfer* transfer = libusb_alloc_transfer(0);
+    if (!transfer) {
+        LOG_ERROR("Failed to allocate libusb transfer");
+        return false;
+    }
+    request->backend_data = transfer;
+    return true;
+}
+
+void LibusbTransferBackend::release(TransferRequest* request) {
+    if (request->backend_data) {
+        libusb_free_transfer(static_cast<libusb_transfer*>(request->backend_data));
+        request->backend_data = nullptr;
+    }
+}
+
+TransferStatus LibusbTransferBackend::submit(TransferRequest* request) {
+    libusb_transfer* transfer = static_cast<libusb_transfer*>(request->backend_data);
+    if (interrupt_) {
+        libusb_fill_interrupt_transfer(transfer, device_handle_, endpoint_, request->buffer, request->length,
+                                       &LibusbTransferBackend::transfer_callback, request, timeout_ms_);
+    } else {
+        libusb_fill_bulk_transfer(transfer, device_handle_, endpoint_, request->buffer, request->length,
+                                  &LibusbTransferBackend::transfer_callback, request, timeout_ms_);
+    }
+
+    int result = libusb_submit_transfer(transfer);
+    if (result == LIBUSB_ERROR_NO_DEVICE) {
+        return TransferStatus::NoDevice;
+    }
+    if (result < 0) {
+        LOG_ERROR("Failed to submit transfer: %s", libusb_error_name(result));
+        return TransferStatus::Error;
+    }
+    return TransferStatus::Completed;
+}
+
+void LibusbTransferBackend::cancel(TransferRequest* request) {
+    if (request->backend_data) {
+        // LIBUSB_ERROR_NOT_FOUND just means the transfer is not in flight.
+        libusb_cancel_transfer(static_cast<libusb_transfer*>(request->backend_data));
+    }
+}
+
+bool LibusbTransferBackend::clear_halt() {
+    int result = libusb_clear_halt(device_handle_, endpoint_);
+    if (result < 0) {
+        LOG_ERROR("Failed to clear halt on endpoint 0x%02x: %s", endpoint_, libusb_error_name(result));
+        return false;
+    }
+    return true;
+}
+
+void LibusbTransferBackend::handle_events(int timeout_ms) {
+    timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    int result = libusb_handle_events_timeout_completed(context_, &tv, nullptr);
+    if (result < 0 && result != LIBUSB_ERROR_INTERRUPTED) {
+        LOG_ERROR("Failed to handle USB events: %s", libusb_error_name(result));
+    }
+}
+
+void LIBUSB_CALL LibusbTransferBackend::transfer_callback(libusb_transfer* transfer) {
+    TransferRequest* request = static_cast<TransferRequest*>(transfer->user_data);
+    request->actual_length = transfer->actual_length;
+
+    switch (transfer->status) {
+    case LIBUSB_TRANSFER_COMPLETED:
+        request->status = TransferStatus::Completed;
+        break;
+    case LIBUSB_TRANSFER_TIMED_OUT:
+        request->status = TransferStatus::TimedOut;
+        break;
+    case LIBUSB_TRANSFER_CANCELLED:
+        request->status = TransferStatus::Cancelled;
+        break;
+    case LIBUSB_TRANSFER_STALL:
+        request->status = TransferStatus::Stall;
+        break;
+    case LIBUSB_TRANSFER_NO_DEVICE:
+        request->status = TransferStatus::NoDevice;
+        break;
+    case LIBUSB_TRANSFER_OVERFLOW:
+        request->status = TransferStatus::Overflow;
+        break;
+    default:
+        request->status = TransferStatus::Error;
+        break;
+    }
+
+    request->on_complete(request);
+}
@@ -0,0 +1,207 @@
+#include "logger.hpp"
+#include <chrono>
+#include <cstdarg>
+
+#define LOG_COMPONENT "log"
+
+namespace {
+
+constexpr int WRITE_INTERVAL_MS = 20;
+
+uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+bool LogRateLimiter::allow(uint64_t now_ns, uint32_t& suppressed) {
+    uint64_t start = window_start_ns_.load(std::memory_order_relaxed);
+    if (start == 0 || now_ns - start >= INTERVAL_NS) {
+        // Whoever moves the window on resets the budget
+        if (window_start_ns_.compare_exchange_strong(start, now_ns, std::memory_order_relaxed)) {
+            count_.store(0, std::memory_order_relaxed);
+        }
+    }
+    if (count_.fetch_add(1, std::memory_order_relaxed) < BURST) {
+        suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+    suppressed_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+Logger& Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger()
+    : slots_(new Slot[RING_SIZE]),
+      enqueue_pos_(0),
+      dequeue_pos_(0),
+      level_(static_cast<int>(LogLevel::Info)),
+      written_(0),
+      dropped_(0),
+      suppressed_(0),
+      start_ns_(now_ns()),
+      stopping_(false),
+      output_(stderr) {
+    for (size_t i = 0; i < RING_SIZE; i++) {
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    writer_ = std::thread(&Logger::writer_loop, this);
+}
+
+Logger::~Logger() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    writer_.join();
+    if (output_ != stderr) {
+        std::fclose(output_);
+    }
+}
+
+void Logger::set_level(LogLevel level) {
+    level_.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+LogLevel Logger::level() const {
+    return static_cast<LogLevel>(level_.load(std::memory_order_relaxed));
+}
+
+bool Logger::set_output(const std::string& path) {
+    std::FILE* file = std::fopen(path.c_str(), "a");
+    if (!file) {
+        LOG_AT(LogLevel::Error, nullptr, "Failed to open log file %s", path.c_str());
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (output_ != stderr) {
+        std::fclose(output_);
+    }
+    output_ = file;
+    return true;
+}
+
+void Logger::log(LogLevel level, const char* component, LogRateLimiter* limiter, const char* format, ...) {
+    uint64_t timestamp = now_ns();
+    uint32_t suppressed = 0;
+    if (limiter && !limiter->allow(timestamp, suppressed)) {
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Claim a slot. A slot is free for position pos when its sequence is
+    // pos; a smaller sequence means the writer has not got to it yet, so
+    // the ring is full.
+    Slot* slot;
+    uint64_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+        slot = &slots_[pos & (RING_SIZE - 1)];
+        uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        int64_t diff = static_cast<int64_t>(sequence - pos);
+        if (diff == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->timestamp_ns = timestamp;
+    slot->level = level;
+    slot->component = component;
+    va_list args;
+    va_start(args, format);
+    int length = std::vsnprintf(slot->message, MESSAGE_SIZE, format, args);
+    va_end(args);
+    if (suppressed > 0 && length >= 0 && static_cast<size_t>(length) < MESSAGE_SIZE) {
+        std::snprintf(slot->message + length, MESSAGE_SIZE - length,
+                      " (%u similar messages suppressed)", suppressed);
+    }
+    slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+void Logger::flush() {
+    uint64_t target = enqueue_pos_.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> lock(mutex_);
+    wake_.notify_one();
+    drained_.wait(lock, [this, target] { return dequeue_pos_ >= target || stopping_; });
+}
+
+Logger::Stats Logger::stats() const {
+    Stats stats;
+    stats.written = written_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    stats.suppressed = suppressed_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+const char* Logger::level_name(LogLevel level) {
+    switch (level) {
+    case LogLevel::Trace: return "trace";
+    case LogLevel::Debug: return "debug";
+    case LogLevel::Info: return "info";
+    case LogLevel::Warn: return "warn";
+    case LogLevel::Error: return "error";
+    case LogLevel::Off: return "off";
+    }
+    return "unknown";
+}
+
+bool Logger::parse_level(const std::string& name, LogLevel& level) {
+    for (int i = LOG_LEVEL_TRACE; i <= LOG_LEVEL_OFF; i++) {
+        if (name == level_name(static_cast<LogLevel>(i))) {
+            level = static_cast<LogLevel>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Logger::writer_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        bool wrote = false;
+        while (write_next()) {
+            wrote = true;
+        }
+        if (wrote) {
+            std::fflush(output_);
+        }
+        drained_.notify_all();
+        if (stopping_) {
+            break;
+        }
+        // Producers do not signal, so that logging never makes a syscall;
+        // the writer polls instead, and flush() wakes it early.
+        wake_.wait_for(lock, std::chrono::milliseconds(WRITE_INTERVAL_MS));
+    }
+}
+
+bool Logger::write_next() {
+    Slot& slot = slots_[dequeue_pos_ & (RING_SIZE - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1) {
+        return false;
+    }
+
+    static const char LEVEL_TAGS[] = "TDIWE";
+    uint64_t elapsed_us = (slot.timestamp_ns - start_ns_) / 1000;
+    std::fprintf(output_, "[%6llu.%06llu] %c %s: %s\n",
+                 static_cast<unsigned long long>(elapsed_us / 1000000),
+                 static_cast<unsigned long long>(elapsed_us % 1000000),
+                 LEVEL_TAGS[static_cast<int>(slot.level)], slot.component, slot.message);
+
+    slot.sequence.store(dequeue_pos_ + RING_SIZE, std::memory_order_release);
+    dequeue_pos_++;
+    written_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
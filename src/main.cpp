@@ -1,34 +1,749 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 #include "visualizer.hpp"
 #include "camera_device.hpp"
+#include "depth_recorder.hpp"
+#include "filter_chain.hpp"
+#include "frame_publisher.hpp"
+#include "logger.hpp"
+#include "metrics_exporter.hpp"
+#include "playback_transport.hpp"
+#include "simulated_transport.hpp"
+#include "stream_manager.hpp"
+#include "stream_server.hpp"
+#include "tsdf_volume.hpp"
+#include "usb_controller.hpp"
+#include "usb_stream_set.hpp"
+#include "usb_transport.hpp"
+
+#define LOG_COMPONENT "main"
+
+static void print_usage(const char* program) {
+    std::cout << "Usage: " << program << " [--list-devices] [--device SERIAL|BUS_PATH] [--profile WxH[@FPS]]"
+              << " [--simulate] [--sim-fps N] [--sim-jitter-us N]"
+              << " [--sim-loss P] [--sim-short P] [--sim-unplug-every N] [--sim-unplug-ms MS] [--backpressure]"
+              << " [--upload teximage|orphan|persistent] [--no-dirty-tiles] [--tile-threshold N] [--frame-stats]"
+              << " [--colormap gray|jet|turbo] [--depth-range NEAR FAR]"
+              << " [--filters decimate,spatial,temporal,fill,fill-nearest]"
+              << " [--headless] [--frames N] [--snapshot FILE.ppm]"
+              << " [--log-level trace|debug|info|warn|error|off] [--log-file FILE]"
+              << " [--metrics FILE|unix:PATH] [--metrics-format json|prometheus] [--metrics-period MS]"
+              << " [--record FILE] [--record-raw] [--replay FILE] [--replay-fast] [--replay-loop]"
+              << " [--publish SHM_NAME] [--serve PORT] [--serve-queue N] [--serve-keyframes N]"
+              << " [--serve-delta-threshold N] [--fuse] [--fuse-voxel MM] [--fuse-points FILE.ply]"
+              << " [--cpu N] [--rt-priority 1-99] [--lock-memory] [--huge-pages] [--all-streams]"
+              << std::endl;
+}
+
+static void print_stage(const char* name, const Visualizer::StageTiming& timing) {
+    std::cout << "  " << name << ": mean " << timing.mean_ms() << " ms, max " << timing.max_ms
+              << " ms over " << timing.count << " frames" << std::endl;
+}
+
+static void print_latencies() {
+    Metrics::Snapshot snapshot = Metrics::instance().snapshot();
+    std::cout << "Latency (us):" << std::endl;
+    for (const Metrics::Histogram& histogram : snapshot.histograms) {
+        const LatencyHistogram::Snapshot& data = histogram.data;
+        if (data.count == 0) {
+            continue;
+        }
+        std::cout << "  " << histogram.name << ": p50 " << data.percentile(0.5) / 1e3
+                  << ", p99 " << data.percentile(0.99) / 1e3 << ", max " << data.max_ns / 1e3
+                  << " over " << data.count << std::endl;
+    }
+}
+
+// Writes the fused surface points as a binary PLY point cloud
+static bool write_points(const TsdfVolume::SurfacePoints& points, const std::string& path) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+    out << "ply\nformat binary_little_endian 1.0\nelement vertex " << points.count
+        << "\nproperty float x\nproperty float y\nproperty float z\nend_header\n";
+    for (size_t i = 0; i < points.count; i++) {
+        float xyz[3] = {points.x[i], points.y[i], points.z[i]};
+        out.write(reinterpret_cast<const char*>(xyz), sizeof(xyz));
+    }
+    return static_cast<bool>(out);
+}
+
+// Builds the post-processing chain from a comma separated list of filters
+static bool build_filter_chain(const std::string& list, FilterChain& chain) {
+    std::stringstream stream(list);
+    std::string name;
+    while (std::getline(stream, name, ',')) {
+        if (name == "decimate") {
+            chain.add(std::make_unique<DecimationFilter>(2));
+        } else if (name == "spatial") {
+            chain.add(std::make_unique<SpatialFilter>());
+        } else if (name == "temporal") {
+            chain.add(std::make_unique<TemporalFilter>());
+        } else if (name == "fill") {
+            chain.add(std::make_unique<HoleFillingFilter>(HoleFillingFilter::Mode::FillFromLeft));
+        } else if (name == "fill-nearest") {
+            chain.add(std::make_unique<HoleFillingFilter>(HoleFillingFilter::Mode::NearestFromAround));
+        } else {
+            std::cerr << "Unknown filter: " << name << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Writes the visualizer's latest readback as a binary PPM. GL rows run
+// bottom-up, so they are flipped on the way out.
+static bool write_snapshot(Visualizer& visualizer, int width, int height, const std::string& path) {
+    std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4);
+    if (!visualizer.read_snapshot(rgba.data(), rgba.size())) {
+        std::cerr << "No rendered frame to snapshot" << std::endl;
+        return false;
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+    out << "P6\n" << width << " " << height << "\n255\n";
+    std::vector<char> row(static_cast<size_t>(width) * 3);
+    for (int y = height - 1; y >= 0; y--) {
+        const uint8_t* src = rgba.data() + static_cast<size_t>(y) * width * 4;
+        for (int x = 0; x < width; x++) {
+            row[x * 3 + 0] = static_cast<char>(src[x * 4 + 0]);
+            row[x * 3 + 1] = static_cast<char>(src[x * 4 + 1]);
+            row[x * 3 + 2] = static_cast<char>(src[x * 4 + 2]);
+        }
+        out.write(row.data(), row.size());
+    }
+    return static_cast<bool>(out);
+}
+
+static void list_devices() {
+    USBController controller;
+    std::vector<USBController::DeviceInfo> devices =
+        controller.list_devices(USBController::INTEL_VENDOR_ID, USBController::D435I_PRODUCT_ID);
+    std::cout << devices.size() << " RealSense D435i camera" << (devices.size() == 1 ? "" : "s") << std::endl;
+    for (const USBController::DeviceInfo& device : devices) {
+        std::cout << "  bus path " << device.bus_path << ", serial "
+                  << (device.serial.empty() ? "unknown" : device.serial) << std::endl;
+    }
+}
+
+// Consumes every stream of manager, each on a thread of its own, until
+// count frames of the first video stream (IMU samples without one) have
+// arrived, then prints what each delivered. Returns false if the device
+// went away or stopped sending.
+static bool consume_all_streams(StreamManager& manager, long count, const std::atomic<bool>& device_lost) {
+    StreamKind video[] = {StreamKind::Depth, StreamKind::Color};
+    std::atomic<bool> consuming(true);
+    std::atomic<uint64_t> received[StreamManager::STREAM_KINDS] = {};
+    std::vector<std::thread> consumers;
+    for (StreamKind kind : video) {
+        if (!manager.has_stream(kind)) {
+            continue;
+        }
+        consumers.emplace_back([&manager, &consuming, &received, kind] {
+            Frame frame;
+            while (consuming) {
+                if (manager.get_frame(kind, frame, 100)) {
+                    received[static_cast<int>(kind)]++;
+                    frame.reset();
+                }
+            }
+        });
+    }
+    if (manager.has_stream(StreamKind::Imu)) {
+        consumers.emplace_back([&manager, &consuming, &received] {
+            std::vector<ImuSample> samples(256);
+            while (consuming) {
+                received[static_cast<int>(StreamKind::Imu)] += manager.read_imu(samples.data(), samples.size(), 100);
+            }
+        });
+    }
+
+    StreamKind counted = manager.has_stream(StreamKind::Depth)   ? StreamKind::Depth
+                         : manager.has_stream(StreamKind::Color) ? StreamKind::Color
+                                                                 : StreamKind::Imu;
+    auto start = std::chrono::steady_clock::now();
+    auto last_progress = start;
+    uint64_t last_count = 0;
+    bool ok = true;
+    while (received[static_cast<int>(counted)] < static_cast<uint64_t>(count)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        auto now = std::chrono::steady_clock::now();
+        uint64_t current = received[static_cast<int>(counted)];
+        if (current != last_count) {
+            last_count = current;
+            last_progress = now;
+        }
+        if (device_lost) {
+            ok = false;
+            break;
+        }
+        if (now - last_progress > std::chrono::seconds(1)) {
+            LOG_ERROR("No %s data within 1 s, stopping", StreamManager::name(counted));
+            ok = false;
+            break;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    consuming = false;
+    for (std::thread& consumer : consumers) {
+        consumer.join();
+    }
+
+    for (StreamKind kind : video) {
+        if (!manager.has_stream(kind)) {
+            continue;
+        }
+        StreamManager::Stats stats = manager.stats(kind);
+        uint64_t frames = received[static_cast<int>(kind)];
+        std::cout << StreamManager::name(kind) << ": " << frames << " frames, " << frames / seconds << " fps, "
+                  << manager.mailbox_stats(kind).dropped << " replaced unread, " << stats.assembly.torn_frames
+                  << " torn" << std::endl;
+    }
+    if (manager.has_stream(StreamKind::Imu)) {
+        uint64_t samples = received[static_cast<int>(StreamKind::Imu)];
+        std::cout << StreamManager::name(StreamKind::Imu) << ": " << samples << " samples, " << samples / seconds
+                  << " Hz, " << manager.imu_stats().overruns << " overrun, "
+                  << manager.stats(StreamKind::Imu).invalid_reports << " invalid reports" << std::endl;
+    }
+    return ok;
+}
+
+// --all-streams: depth, color and IMU of one camera together, through a
+// StreamManager on the endpoints UsbStreamSet claims
+static int capture_all_streams(const std::string& selector, long count, int cpu, int priority,
+                               const FrameMemory::Options& memory) {
+    UsbStreamSet streams(selector);
+    if (!streams.open()) {
+        LOG_ERROR("Failed to open the camera's streams");
+        return -1;
+    }
+
+    std::atomic<bool> device_lost(false);
+    StreamManager::Config config;
+    config.cpu = cpu;
+    config.priority = priority;
+    config.memory = memory;
+    config.on_device_lost = [&device_lost] { device_lost = true; };
+    bool ok = true;
+    {
+        StreamManager manager(config);
+        for (StreamKind kind : {StreamKind::Depth, StreamKind::Color, StreamKind::Imu}) {
+            StreamManager::StreamConfig stream;
+            if (streams.stream_config(kind, stream)) {
+                manager.add_stream(stream);
+            }
+        }
+        ok = manager.start() && consume_all_streams(manager, count, device_lost);
+        manager.stop();
+    }
+    streams.close();
+    return ok ? 0 : -1;
+}
+
+int main(int argc, char** argv) {
+    bool simulate = false;
+    std::string device_selector;
+    StreamProfile profile;
+    double sim_fps = -1.0;
+    FrameMailbox::Policy delivery_policy = FrameMailbox::Policy::DropOldest;
+    Visualizer::UploadMode upload_mode = Visualizer::UploadMode::PboPersistent;
+    bool dirty_tiles = true;
+    uint16_t tile_threshold = 0;
+    bool frame_stats = false;
+    bool headless = false;
+    long max_frames = 0;
+    std::string snapshot_path;
+    Colorizer::Colormap colormap = Colorizer::Colormap::Turbo;
+    uint16_t near_depth = 300;
+    uint16_t far_depth = 4000;
+    std::string filter_list;
+    MetricsExporter::Config metrics_config;
+    std::string record_path;
+    DepthRecorder::Config record_config;
+    record_config.codec = RecordCodec::Lossless;
+    PlaybackTransport::Config replay_config;
+    FramePublisher::Config publish_config;
+    publish_config.name.clear();
+    bool serve = false;
+    StreamServer::Config serve_config;
+    SimulatedDevice::Config sim_config;
+    bool fuse = false;
+    TsdfVolume::Config fuse_config;
+    std::string fuse_points_path;
+    int capture_cpu = -1;
+    int capture_priority = 0;
+    FrameMemory::Options frame_memory;
+    bool all_streams = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--list-devices") {
+            list_devices();
+            return 0;
+        } else if (arg == "--device" && has_value) {
+            device_selector = argv[++i];
+        } else if (arg == "--profile" && has_value) {
+            if (!StreamProfile::parse(argv[++i], profile)) {
+                std::cerr << "Expected a profile like 848x480@90: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--simulate") {
+            simulate = true;
+        } else if (arg == "--sim-fps" && has_value) {
+            sim_fps = std::stod(argv[++i]);
+        } else if (arg == "--sim-jitter-us" && has_value) {
+            sim_config.jitter_us = std::stod(argv[++i]);
+        } else if (arg == "--sim-loss" && has_value) {
+            sim_config.payload_loss = std::stod(argv[++i]);
+        } else if (arg == "--sim-short" && has_value) {
+            sim_config.short_payload = std::stod(argv[++i]);
+        } else if (arg == "--sim-unplug-every" && has_value) {
+            sim_config.unplug_every = std::stoull(argv[++i]);
+        } else if (arg == "--sim-unplug-ms" && has_value) {
+            sim_config.unplug_ms = std::stod(argv[++i]);
+        } else if (arg == "--backpressure") {
+            delivery_policy = FrameMailbox::Policy::Block;
+        } else if (arg == "--upload" && has_value) {
+            std::string mode = argv[++i];
+            if (mode == "teximage") {
+                upload_mode = Visualizer::UploadMode::TexImage;
+            } else if (mode == "orphan") {
+                upload_mode = Visualizer::UploadMode::PboOrphan;
+            } else {
+                upload_mode = Visualizer::UploadMode::PboPersistent;
+            }
+        } else if (arg == "--no-dirty-tiles") {
+            dirty_tiles = false;
+        } else if (arg == "--tile-threshold" && has_value) {
+            tile_threshold = static_cast<uint16_t>(std::stoi(argv[++i]));
+        } else if (arg == "--colormap" && has_value) {
+            std::string name = argv[++i];
+            if (name == "gray") {
+                colormap = Colorizer::Colormap::Grayscale;
+            } else if (name == "jet") {
+                colormap = Colorizer::Colormap::Jet;
+            } else {
+                colormap = Colorizer::Colormap::Turbo;
+            }
+        } else if (arg == "--depth-range" && i + 2 < argc) {
+            near_depth = static_cast<uint16_t>(std::stoi(argv[++i]));
+            far_depth = static_cast<uint16_t>(std::stoi(argv[++i]));
+        } else if (arg == "--filters" && has_value) {
+            filter_list = argv[++i];
+        } else if (arg == "--frame-stats") {
+            frame_stats = true;
+        } else if (arg == "--headless") {
+            headless = true;
+        } else if (arg == "--frames" && has_value) {
+            max_frames = std::stol(argv[++i]);
+        } else if (arg == "--snapshot" && has_value) {
+            snapshot_path = argv[++i];
+        } else if (arg == "--log-level" && has_value) {
+            LogLevel level;
+            if (!Logger::parse_level(argv[++i], level)) {
+                std::cerr << "Unknown log level: " << argv[i] << std::endl;
+                return -1;
+            }
+            Logger::instance().set_level(level);
+        } else if (arg == "--metrics" && has_value) {
+            metrics_config.destination = argv[++i];
+        } else if (arg == "--metrics-format" && has_value) {
+            if (!MetricsExporter::parse_format(argv[++i], metrics_config.format)) {
+                std::cerr << "Unknown metrics format: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--metrics-period" && has_value) {
+            metrics_config.period_ms = std::stoi(argv[++i]);
+        } else if (arg == "--record" && has_value) {
+            record_path = argv[++i];
+        } else if (arg == "--record-raw") {
+            record_config.codec = RecordCodec::Raw;
+        } else if (arg == "--replay" && has_value) {
+            replay_config.path = argv[++i];
+        } else if (arg == "--replay-fast") {
+            replay_config.realtime = false;
+        } else if (arg == "--replay-loop") {
+            replay_config.loop = true;
+        } else if (arg == "--publish" && has_value) {
+            publish_config.name = argv[++i];
+        } else if (arg == "--serve" && has_value) {
+            serve = true;
+            serve_config.port = std::stoi(argv[++i]);
+        } else if (arg == "--serve-queue" && has_value) {
+            serve_config.queue_frames = std::stoi(argv[++i]);
+        } else if (arg == "--serve-keyframes" && has_value) {
+            serve_config.delta.keyframe_interval = std::stoi(argv[++i]);
+        } else if (arg == "--serve-delta-threshold" && has_value) {
+            serve_config.delta.threshold = static_cast<uint16_t>(std::stoi(argv[++i]));
+        } else if (arg == "--fuse") {
+            fuse = true;
+        } else if (arg == "--fuse-voxel" && has_value) {
+            fuse = true;
+            fuse_config.voxel_size = std::stof(argv[++i]) / 1000.0f;
+            fuse_config.truncation = 4.0f * fuse_config.voxel_size;
+        } else if (arg == "--fuse-points" && has_value) {
+            fuse = true;
+            fuse_points_path = argv[++i];
+        } else if (arg == "--cpu" && has_value) {
+            capture_cpu = std::stoi(argv[++i]);
+        } else if (arg == "--rt-priority" && has_value) {
+            capture_priority = std::stoi(argv[++i]);
+        } else if (arg == "--all-streams") {
+            all_streams = true;
+        } else if (arg == "--lock-memory") {
+            frame_memory.lock = true;
+        } else if (arg == "--huge-pages") {
+            frame_memory.huge_pages = true;
+        } else if (arg == "--log-file" && has_value) {
+            if (!Logger::instance().set_output(argv[++i])) {
+                return -1;
+            }
+        } else {
+            print_usage(argv[0]);
+            return arg == "--help" ? 0 : -1;
+        }
+    }
+
+    // Depth, color and IMU from the camera, counted rather than shown
+    if (all_streams) {
+        if (simulate || !replay_config.path.empty()) {
+            std::cerr << "--all-streams needs a camera" << std::endl;
+            return -1;
+        }
+        return capture_all_streams(device_selector, max_frames > 0 ? max_frames : 300, capture_cpu,
+                                   capture_priority, frame_memory);
+    }
+
+    // The simulated camera streams exactly the profile asked for, at its
+    // own rate if one was given
+    sim_config.width = profile.width;
+    sim_config.height = profile.height;
+    sim_config.fps = profile.fps;
+    if (sim_fps >= 0.0) {
+        sim_config.fps = sim_fps;
+        profile.fps = static_cast<int>(std::lround(sim_fps));
+    }
+
+    // Flat out replay should not lose frames to a slower consumer
+    if (!replay_config.path.empty() && !replay_config.realtime) {
+        delivery_policy = FrameMailbox::Policy::Block;
+    }
+
+    std::unique_ptr<CameraDevice> camera_ptr;
+    PlaybackTransport* playback = nullptr;
+    if (!replay_config.path.empty()) {
+        auto transport = std::make_unique<PlaybackTransport>(replay_config);
+        playback = transport.get();
+        camera_ptr = std::make_unique<CameraDevice>(std::move(transport));
+    } else if (simulate) {
+        camera_ptr = std::make_unique<CameraDevice>(std::make_unique<SimulatedTransport>(sim_config));
+    } else {
+        camera_ptr = std::make_unique<CameraDevice>(std::make_unique<UsbTransport>(device_selector));
+    }
+    CameraDevice& camera = *camera_ptr;
+    camera.set_delivery_policy(delivery_policy);
+    camera.set_profile(profile);
+    // All best effort: without the privileges the camera streams as usual
+    camera.set_cpu(capture_cpu);
+    camera.set_realtime_priority(capture_priority);
+    camera.set_frame_memory_options(frame_memory);
 
-int main() {
-    CameraDevice camera;
     if (!camera.initialize()) {
-        std::cerr << "Failed to initialize camera" << std::endl;
+        LOG_ERROR("Failed to initialize camera");
         return -1;
     }
+    // Everything downstream works in whatever the device agreed to
+    const StreamProfile& stream = camera.profile();
+    if (stream != profile) {
+        std::cout << "Streaming " << stream.to_string() << " (asked for " << profile.to_string() << ")" << std::endl;
+    }
+    record_config.width = stream.width;
+    record_config.height = stream.height;
+    publish_config.width = stream.width;
+    publish_config.height = stream.height;
+    serve_config.width = stream.width;
+    serve_config.height = stream.height;
 
-    if (!camera.start_streaming()) {
-        std::cerr << "Failed to start streaming" << std::endl;
+    DepthRecorder recorder(record_config);
+    if (!record_path.empty() && !recorder.open(record_path)) {
         return -1;
     }
 
-    Visualizer visualizer(CameraDevice::DEFAULT_WIDTH, CameraDevice::DEFAULT_HEIGHT);
+    // Without a window there is nothing to close, so stop after a frame count
+    if (headless && max_frames == 0) {
+        max_frames = 300;
+    }
+
+    FilterChain filters;
+    if (!filter_list.empty() && !build_filter_chain(filter_list, filters)) {
+        return -1;
+    }
+    int view_width = stream.width;
+    int view_height = stream.height;
+    filters.output_size(view_width, view_height, view_width, view_height);
+
+    Visualizer visualizer(view_width, view_height);
+    visualizer.set_upload_mode(upload_mode);
+    visualizer.set_dirty_tiles(dirty_tiles, tile_threshold);
+    visualizer.set_colormap(colormap);
+    visualizer.set_depth_range(near_depth, far_depth);
+    visualizer.set_headless(headless);
+    visualizer.set_readback(!snapshot_path.empty());
     if (!visualizer.initialize()) {
-        std::cerr << "Failed to initialize visualizer" << std::endl;
+        LOG_ERROR("Failed to initialize visualizer");
+        return -1;
+    }
+
+    // Let transfers land directly in GL-visible memory when we can
+    uint8_t* arena = visualizer.map_frame_arena(camera.frame_memory_size());
+    if (arena) {
+        camera.use_frame_memory(arena, camera.frame_memory_size());
+    }
+
+    // Other processes get every frame the camera delivers, before filtering
+    // (see the frame tap below)
+    FramePublisher publisher(publish_config);
+    if (!publish_config.name.empty() && !publisher.open()) {
+        return -1;
+    }
+
+    // So do network clients, each at its own pace
+    StreamServer server(serve_config);
+    if (serve && !server.start()) {
+        return -1;
+    }
+
+    // Fusion sees the frames before filtering, at the stream's own size.
+    // Nothing tracks the camera here, so the volume assumes it stays put
+    // and fusion averages out sensor noise; moving cameras go through the
+    // library with their poses. It runs on a thread of its own, fed copies
+    // of the frames (the render loop filters them in place) through its own
+    // mailbox, so a volume slower than the camera skips frames instead of
+    // holding up display, recording or distribution. It has its own
+    // ThreadPool too: run() calls on the shared one are serialized, and the
+    // filters would queue behind each integrate().
+    std::unique_ptr<TsdfVolume> volume;
+    std::unique_ptr<ThreadPool> fuse_threads;
+    std::unique_ptr<FramePool> fuse_pool;
+    FrameMailbox fuse_mailbox(FrameMailbox::Policy::DropOldest);
+    std::atomic<bool> fusing(false);
+    std::thread fuse_thread;
+    if (fuse) {
+        fuse_threads = std::make_unique<ThreadPool>();
+        fuse_config.pool = fuse_threads.get();
+        volume = std::make_unique<TsdfVolume>(CameraIntrinsics::nominal(stream.width, stream.height), fuse_config);
+        // One being copied into, one waiting, one being integrated
+        fuse_pool = std::make_unique<FramePool>(3, stream.frame_size());
+    }
+
+    MetricsExporter exporter(metrics_config);
+    if (!metrics_config.destination.empty() && !exporter.start()) {
+        return -1;
+    }
+
+    // Recording, distribution and fusion take every frame on the capture
+    // thread, where each only copies it and returns (encoding and sending
+    // happen on their own threads), rather than from the mailbox, which
+    // keeps only the latest frame for a render loop slower than the camera
+    if (recorder.is_open() || publisher.is_open() || server.is_running() || volume) {
+        camera.set_frame_tap([&](const Frame& captured) {
+            if (recorder.is_open()) {
+                recorder.write(captured);
+            }
+            if (publisher.is_open()) {
+                publisher.publish(captured);
+            }
+            if (server.is_running()) {
+                server.publish(captured);
+            }
+            if (volume && captured.size() == stream.frame_size()) {
+                Frame copy = fuse_pool->acquire();
+                if (copy) {
+                    std::memcpy(copy.storage(), captured.data(), captured.size());
+                    copy.set_data(0, captured.size());
+                    copy.metadata() = captured.metadata();
+                    fuse_mailbox.publish(std::move(copy));
+                }
+            }
+        });
+    }
+
+    if (!camera.start_streaming()) {
+        LOG_ERROR("Failed to start streaming");
         return -1;
     }
+    if (volume) {
+        fusing = true;
+        fuse_thread = std::thread([&] {
+            Frame depth;
+            while (fusing) {
+                if (fuse_mailbox.consume(depth, 100)) {
+                    volume->integrate(reinterpret_cast<const uint16_t*>(depth.data()), CameraPose());
+                    depth.reset();
+                }
+            }
+        });
+    }
 
-    std::vector<uint8_t> depth_buffer(CameraDevice::DEPTH_FRAME_SIZE);
+    // Capture runs on the transport's event thread; this loop only renders,
+    // paced by vsync, and picks up whatever frame the mailbox holds. Headless
+    // there is no vsync, so it waits for each new frame instead.
+    Frame frame;
+    long rendered = 0;
 
-    while (!visualizer.should_close()) {
-        if (camera.get_depth_frame(depth_buffer.data(), depth_buffer.size())) {
-            visualizer.render_frame(depth_buffer.data());
+    while (!visualizer.should_close() && (max_frames == 0 || rendered < max_frames)) {
+        // Replay can end, so check for that more often than for a stall
+        unsigned int wait_ms = headless ? (playback ? 100 : 1000) : 0;
+        if (camera.get_depth_frame(frame, wait_ms)) {
+            int width = stream.width;
+            int height = stream.height;
+            if (filters.size() > 0 && !filters.process(frame, width, height)) {
+                frame.reset();
+                continue;
+            }
+            visualizer.render_frame(frame);
+            frame.reset();
+            rendered++;
+        } else if (playback && playback->finished()) {
+            LOG_INFO("Replay finished");
+            break;
+        } else if (headless && !playback && !camera.is_recovering()) {
+            LOG_ERROR("No frame from camera within 1 s, stopping");
+            break;
+        } else {
+            visualizer.render_frame(nullptr);
         }
         visualizer.process_events();
     }
 
+    // Last export while the camera's counters are still registered
+    exporter.stop();
     camera.stop_streaming();
+    if (recorder.is_open()) {
+        recorder.close();
+        DepthRecorder::Stats record_stats = recorder.stats();
+        std::cout << "Recorded " << record_stats.frames << " frames to " << record_path
+                  << ", dropped " << record_stats.dropped;
+        if (record_stats.bytes > 0) {
+            std::cout << ", " << static_cast<double>(record_stats.raw_bytes) / record_stats.bytes
+                      << ":1 compression";
+        }
+        std::cout << std::endl;
+    }
+    if (publisher.is_open()) {
+        std::cout << "Published " << publisher.published() << " frames to " << publish_config.name << std::endl;
+        for (const FramePublisher::SubscriberInfo& subscriber : publisher.subscribers()) {
+            std::cout << "  subscriber " << subscriber.pid << ": " << subscriber.lag << " behind, skipped "
+                      << subscriber.skipped << std::endl;
+        }
+        publisher.close();
+    }
+    if (server.is_running()) {
+        StreamServer::Stats serve_stats = server.stats();
+        std::cout << "Streamed " << serve_stats.sent << " frames, " << serve_stats.bytes / 1e6 << " MB to "
+                  << serve_stats.clients << " clients, dropped " << serve_stats.dropped << std::endl;
+        if (serve_stats.delta_frames + serve_stats.keyframes > 0) {
+            std::cout << "  " << serve_stats.delta_frames << " delta frames and " << serve_stats.keyframes
+                      << " keyframes, deltas saving " << serve_stats.delta_saved_bytes / 1e6 << " MB" << std::endl;
+        }
+        for (const StreamServer::ClientInfo& client : server.clients()) {
+            std::cout << "  client " << client.peer << ": sent " << client.sent << ", dropped "
+                      << client.dropped << ", " << client.queued << " queued" << std::endl;
+        }
+        server.stop();
+    }
+
+    if (volume) {
+        fusing = false;
+        fuse_thread.join();
+        TsdfVolume::SurfacePoints points;
+        volume->extract(points, false);
+        TsdfVolume::Stats fuse_stats = volume->stats();
+        std::cout << "Fused " << fuse_stats.frames << " frames into " << fuse_stats.blocks << " blocks ("
+                  << fuse_stats.memory_bytes / 1e6 << " MB), "
+                  << (fuse_stats.frames ? fuse_stats.integrate_ns / 1e6 / fuse_stats.frames : 0.0)
+                  << " ms per frame (skipped " << fuse_mailbox.stats().dropped << "), " << points.count
+                  << " surface points";
+        if (fuse_stats.blocks_dropped > 0) {
+            std::cout << ", " << fuse_stats.blocks_dropped << " blocks refused for lack of pool";
+        }
+        std::cout << std::endl;
+        if (!fuse_points_path.empty() && write_points(points, fuse_points_path)) {
+            std::cout << "Wrote " << fuse_points_path << std::endl;
+        }
+    }
+
+    // Keep the statistics below after whatever was logged during the run
+    Logger::instance().flush();
+
+    FrameMailbox::Stats mailbox_stats = camera.mailbox_stats();
+    CameraDevice::Stats camera_stats = camera.stats();
+    std::cout << "First frame after " << camera_stats.first_frame_ns / 1e6 << " ms";
+    if (camera_stats.disconnects > 0) {
+        std::cout << ", recovered from " << camera_stats.reconnects << " of " << camera_stats.disconnects
+                  << " disconnects, the last in " << camera_stats.last_recovery_ns / 1e6 << " ms";
+    }
+    std::cout << std::endl;
+    std::cout << "Frames delivered: " << mailbox_stats.delivered
+              << ", dropped: " << mailbox_stats.dropped << std::endl;
+    if (camera_stats.repeated_frames > 0) {
+        std::cout << "Frames repeating the one before (stuck sensor?): " << camera_stats.repeated_frames << std::endl;
+    }
+
+    if (frame_stats) {
+        Visualizer::FrameTimings timings = visualizer.timings();
+        std::cout << "Frame timings:" << std::endl;
+        print_stage("upload", timings.upload);
+        print_stage("draw", timings.draw);
+        if (timings.readback.count) {
+            print_stage("readback", timings.readback);
+        }
+        print_stage("present", timings.present);
+        print_stage("frame", timings.frame);
+        Visualizer::UploadStats upload = visualizer.upload_stats();
+        if (upload.tiles > 0) {
+            std::cout << "  dirty tiles: " << 100.0 * upload.dirty_tiles / upload.tiles << "%, "
+                      << static_cast<double>(upload.regions) / upload.frames << " uploads per frame, "
+                      << 100.0 * upload.skipped_bytes / (upload.bytes + upload.skipped_bytes)
+                      << "% of bytes skipped" << std::endl;
+        }
+        print_latencies();
+
+        if (filters.size() > 0) {
+            std::cout << "Filter timings (CPU time per frame):" << std::endl;
+            for (const FilterChain::FilterTiming& timing : filters.timings()) {
+                std::cout << "  " << timing.name << ": mean " << timing.mean_ms() << " ms, max "
+                          << timing.max_ms << " ms" << std::endl;
+            }
+            FilterChain::FilterTiming total = filters.frame_timing();
+            std::cout << "  chain: mean " << total.mean_ms() << " ms, max " << total.max_ms
+                      << " ms over " << total.frames << " frames" << std::endl;
+        }
+
+        Logger::Stats log_stats = Logger::instance().stats();
+        std::cout << "Log messages written: " << log_stats.written << ", dropped: " << log_stats.dropped
+                  << ", rate-limited: " << log_stats.suppressed << std::endl;
+    }
+
+    if (!snapshot_path.empty() &&
+        write_snapshot(visualizer, view_width, view_height, snapshot_path)) {
+        std::cout << "Wrote " << snapshot_path << std::endl;
+    }
     return 0;
 }
@@ -0,0 +1,137 @@
+#include "metrics.hpp"
+#include <algorithm>
+#include <cmath>
+
+LatencyHistogram::LatencyHistogram()
+    : counts_(new std::atomic<uint64_t>[BUCKETS]), sum_ns_(0), max_ns_(0) {
+    for (int i = 0; i < BUCKETS; i++) {
+        counts_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+int LatencyHistogram::bucket_index(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return static_cast<int>(value);
+    }
+    // The top SUB_BUCKET_BITS + 1 bits pick the bucket
+    int exponent = 63 - __builtin_clzll(value);
+    int shift = exponent - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS + static_cast<int>((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+uint64_t LatencyHistogram::bucket_upper(int index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    int shift = index / SUB_BUCKETS - 1;
+    uint64_t lower = static_cast<uint64_t>(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+    return lower + ((uint64_t(1) << shift) - 1);
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+    counts_[bucket_index(ns)].fetch_add(1, std::memory_order_relaxed);
+    sum_ns_.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t max = max_ns_.load(std::memory_order_relaxed);
+    while (ns > max && !max_ns_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::record_since(uint64_t start_ns) {
+    uint64_t now = monotonic_ns();
+    record(now > start_ns ? now - start_ns : 0);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    // Not atomic as a whole: a record() racing with this may show up in
+    // the bucket counts but not yet in the sum, which is fine for export.
+    Snapshot snapshot;
+    snapshot.counts.resize(BUCKETS);
+    for (int i = 0; i < BUCKETS; i++) {
+        snapshot.counts[i] = counts_[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.counts[i];
+    }
+    snapshot.sum_ns = sum_ns_.load(std::memory_order_relaxed);
+    snapshot.max_ns = max_ns_.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+uint64_t LatencyHistogram::Snapshot::percentile(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(std::ceil(std::min(std::max(q, 0.0), 1.0) * count));
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::min(bucket_upper(static_cast<int>(i)), max_ns);
+        }
+    }
+    return max_ns;
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::Snapshot::since(const Snapshot& earlier) const {
+    Snapshot window;
+    window.counts.resize(counts.size());
+    int highest = -1;
+    for (size_t i = 0; i < counts.size(); i++) {
+        uint64_t before = i < earlier.counts.size() ? earlier.counts[i] : 0;
+        window.counts[i] = counts[i] - std::min(counts[i], before);
+        window.count += window.counts[i];
+        if (window.counts[i]) {
+            highest = static_cast<int>(i);
+        }
+    }
+    window.sum_ns = sum_ns - std::min(sum_ns, earlier.sum_ns);
+    // The exact maximum is only kept overall; the window's is known to
+    // bucket precision.
+    window.max_ns = highest < 0 ? 0 : std::min(bucket_upper(highest), max_ns);
+    return window;
+}
+
+Metrics& Metrics::instance() {
+    static Metrics metrics;
+    return metrics;
+}
+
+LatencyHistogram& Metrics::histogram(const std::string& name, const std::string& help) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    NamedHistogram& entry = histograms_[name];
+    if (!entry.histogram) {
+        entry.help = help;
+        entry.histogram = std::make_unique<LatencyHistogram>();
+    }
+    return *entry.histogram;
+}
+
+void Metrics::add(const void* owner, const std::string& name, const std::string& help, Kind kind,
+                  std::function<double()> read) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sources_.push_back(Source{owner, name, help, kind, std::move(read)});
+}
+
+void Metrics::remove(const void* owner) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sources_.erase(std::remove_if(sources_.begin(), sources_.end(),
+                                  [owner](const Source& source) { return source.owner == owner; }),
+                   sources_.end());
+}
+
+Metrics::Snapshot Metrics::snapshot() const {
+    Snapshot snapshot;
+    snapshot.timestamp_ns = monotonic_ns();
+
+    // Callbacks run under the lock so that remove() can guarantee none is
+    // still running once it returns
+    std::lock_guard<std::mutex> lock(mutex_);
+    snapshot.values.reserve(sources_.size());
+    for (const Source& source : sources_) {
+        snapshot.values.push_back(Value{source.name, source.help, source.kind, source.read()});
+    }
+    snapshot.histograms.reserve(histograms_.size());
+    for (const auto& entry : histograms_) {
+        snapshot.histograms.push_back(Histogram{entry.first, entry.second.help, entry.second.histogram->snapshot()});
+    }
+    return snapshot;
+}
@@ -0,0 +1,253 @@
+#include "metrics_exporter.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define LOG_COMPONENT "metrics"
+
+namespace {
+
+constexpr double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+constexpr const char* QUANTILE_KEYS[] = {"p50", "p90", "p99", "p999"};
+
+void append(std::string& out, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+void append(std::string& out, const char* format, ...) {
+    char buffer[512];
+    va_list args;
+    va_start(args, format);
+    int length = std::vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length > 0) {
+        out.append(buffer, std::min<size_t>(length, sizeof(buffer) - 1));
+    }
+}
+
+LatencyHistogram::Snapshot window_of(const Metrics::Histogram& histogram, const Metrics::Snapshot* previous) {
+    if (previous) {
+        for (const Metrics::Histogram& earlier : previous->histograms) {
+            if (earlier.name == histogram.name) {
+                return histogram.data.since(earlier.data);
+            }
+        }
+    }
+    return histogram.data;
+}
+
+std::string to_json(const Metrics::Snapshot& current, const Metrics::Snapshot* previous) {
+    std::string out;
+    append(out, "{\"timestamp_ns\":%llu", static_cast<unsigned long long>(current.timestamp_ns));
+    for (Metrics::Kind kind : {Metrics::Kind::Counter, Metrics::Kind::Gauge}) {
+        out += kind == Metrics::Kind::Counter ? ",\"counters\":{" : ",\"gauges\":{";
+        bool first = true;
+        for (const Metrics::Value& value : current.values) {
+            if (value.kind == kind) {
+                append(out, "%s\"%s\":%.17g", first ? "" : ",", value.name.c_str(), value.value);
+                first = false;
+            }
+        }
+        out += "}";
+    }
+    out += ",\"latency_us\":{";
+    for (size_t i = 0; i < current.histograms.size(); i++) {
+        const Metrics::Histogram& histogram = current.histograms[i];
+        LatencyHistogram::Snapshot window = window_of(histogram, previous);
+        append(out, "%s\"%s\":{\"total_count\":%llu,\"count\":%llu,\"mean\":%.3f", i ? "," : "",
+               histogram.name.c_str(), static_cast<unsigned long long>(histogram.data.count),
+               static_cast<unsigned long long>(window.count), window.mean_ns() / 1e3);
+        for (size_t q = 0; q < sizeof(QUANTILES) / sizeof(QUANTILES[0]); q++) {
+            append(out, ",\"%s\":%.3f", QUANTILE_KEYS[q], window.percentile(QUANTILES[q]) / 1e3);
+        }
+        append(out, ",\"max\":%.3f}", window.max_ns / 1e3);
+    }
+    out += "}}\n";
+    return out;
+}
+
+std::string to_prometheus(const Metrics::Snapshot& current, const Metrics::Snapshot* previous) {
+    std::string out;
+    for (const Metrics::Value& value : current.values) {
+        const char* name = value.name.c_str();
+        append(out, "# HELP realsense_%s %s\n", name, value.help.c_str());
+        append(out, "# TYPE realsense_%s %s\n", name, value.kind == Metrics::Kind::Counter ? "counter" : "gauge");
+        append(out, "realsense_%s %.17g\n", name, value.value);
+    }
+    for (const Metrics::Histogram& histogram : current.histograms) {
+        LatencyHistogram::Snapshot window = window_of(histogram, previous);
+        const char* name = histogram.name.c_str();
+        append(out, "# HELP realsense_%s_seconds %s\n", name, histogram.help.c_str());
+        append(out, "# TYPE realsense_%s_seconds summary\n", name);
+        for (double quantile : QUANTILES) {
+            append(out, "realsense_%s_seconds{quantile=\"%g\"} %.9f\n", name, quantile,
+                   window.percentile(quantile) / 1e9);
+        }
+        append(out, "realsense_%s_seconds_sum %.9f\n", name, histogram.data.sum_ns / 1e9);
+        append(out, "realsense_%s_seconds_count %llu\n", name,
+               static_cast<unsigned long long>(histogram.data.count));
+    }
+    return out;
+}
+
+}
+
+MetricsExporter::MetricsExporter(const Config& config)
+    : config_(config), use_socket_(false), listen_fd_(-1), running_(false), have_previous_(false) {
+}
+
+MetricsExporter::~MetricsExporter() {
+    stop();
+}
+
+bool MetricsExporter::parse_format(const std::string& name, Format& format) {
+    if (name == "json") {
+        format = Format::Json;
+    } else if (name == "prometheus") {
+        format = Format::Prometheus;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::string MetricsExporter::format(Format format, const Metrics::Snapshot& current,
+                                    const Metrics::Snapshot* previous) {
+    return format == Format::Json ? to_json(current, previous) : to_prometheus(current, previous);
+}
+
+bool MetricsExporter::start() {
+    if (running_) {
+        return true;
+    }
+    if (config_.destination.empty() || config_.period_ms <= 0) {
+        LOG_ERROR("Invalid metrics exporter configuration");
+        return false;
+    }
+
+    static const std::string SOCKET_PREFIX = "unix:";
+    use_socket_ = config_.destination.compare(0, SOCKET_PREFIX.size(), SOCKET_PREFIX) == 0;
+    if (use_socket_ && !open_socket(config_.destination.substr(SOCKET_PREFIX.size()))) {
+        return false;
+    }
+
+    running_ = true;
+    thread_ = std::thread(&MetricsExporter::run, this);
+    return true;
+}
+
+void MetricsExporter::stop() {
+    if (!running_) {
+        return;
+    }
+    running_ = false;
+    thread_.join();
+    publish();
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        unlink(socket_path_.c_str());
+        listen_fd_ = -1;
+    }
+}
+
+bool MetricsExporter::open_socket(const std::string& path) {
+    sockaddr_un address{};
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        LOG_ERROR("Invalid metrics socket path: %s", path.c_str());
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        LOG_ERROR("Failed to create metrics socket: %s", std::strerror(errno));
+        return false;
+    }
+    // A socket file left behind by an earlier run would make bind() fail
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, 8) < 0) {
+        LOG_ERROR("Failed to listen on %s: %s", path.c_str(), std::strerror(errno));
+        close(fd);
+        return false;
+    }
+    listen_fd_ = fd;
+    socket_path_ = path;
+    return true;
+}
+
+void MetricsExporter::run() {
+    uint64_t next_ns = monotonic_ns();
+    while (running_) {
+        uint64_t now = monotonic_ns();
+        if (now >= next_ns) {
+            publish();
+            next_ns += static_cast<uint64_t>(config_.period_ms) * 1000000;
+            if (next_ns <= now) {
+                next_ns = now + static_cast<uint64_t>(config_.period_ms) * 1000000;
+            }
+            continue;
+        }
+        int timeout_ms = static_cast<int>(std::min<uint64_t>((next_ns - now) / 1000000 + 1, POLL_MS));
+        if (use_socket_) {
+            serve_clients(timeout_ms);
+        } else {
+            usleep(timeout_ms * 1000);
+        }
+    }
+}
+
+void MetricsExporter::publish() {
+    Metrics::Snapshot current = Metrics::instance().snapshot();
+    latest_ = format(config_.format, current, have_previous_ ? &previous_ : nullptr);
+    previous_ = std::move(current);
+    have_previous_ = true;
+    if (!use_socket_) {
+        write_file(latest_);
+    }
+}
+
+bool MetricsExporter::write_file(const std::string& text) {
+    std::string temporary = config_.destination + ".tmp";
+    std::FILE* file = std::fopen(temporary.c_str(), "w");
+    if (!file) {
+        LOG_ERROR("Failed to open %s: %s", temporary.c_str(), std::strerror(errno));
+        return false;
+    }
+    bool ok = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok || std::rename(temporary.c_str(), config_.destination.c_str()) != 0) {
+        LOG_ERROR("Failed to write %s", config_.destination.c_str());
+        return false;
+    }
+    return true;
+}
+
+void MetricsExporter::serve_clients(int timeout_ms) {
+    pollfd listener{listen_fd_, POLLIN, 0};
+    if (poll(&listener, 1, timeout_ms) <= 0) {
+        return;
+    }
+    int client = accept(listen_fd_, nullptr, nullptr);
+    if (client < 0) {
+        return;
+    }
+    // One snapshot and close. A client too slow to take a few kilobytes
+    // gets a truncated one rather than holding up the exporter.
+    int flags = MSG_DONTWAIT;
+#ifdef MSG_NOSIGNAL
+    flags |= MSG_NOSIGNAL;
+#elif defined(SO_NOSIGPIPE)
+    int on = 1;
+    setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    if (send(client, latest_.data(), latest_.size(), flags) < 0) {
+        LOG_WARN("Failed to send metrics: %s", std::strerror(errno));
+    }
+    close(client);
+}
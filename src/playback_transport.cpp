@@ -0,0 +1,173 @@
+#include "playback_transport.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "thread_affinity.hpp"
+#include "uvc_protocol.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#define LOG_COMPONENT "replay"
+
+namespace {
+
+constexpr size_t PAYLOAD_HEADER_SIZE = 6;    // Header with a PTS, no SCR
+constexpr uint64_t MAX_SLEEP_NS = 10000000;   // So stop() is noticed while pacing
+
+}
+
+PlaybackTransport::PlaybackTransport(const Config& config)
+    : config_(config), start_frame_(0), running_(false), finished_(false) {
+}
+
+PlaybackTransport::~PlaybackTransport() {
+    stop();
+}
+
+bool PlaybackTransport::open() {
+    if (!reader_.open(config_.path)) {
+        return false;
+    }
+    LOG_INFO("Replaying %s: %zu frames of %dx%d over %.1f s%s", config_.path.c_str(), reader_.frame_count(),
+             reader_.width(), reader_.height(),
+             (reader_.last_timestamp_ns() - reader_.first_timestamp_ns()) / 1e9,
+             config_.realtime ? "" : ", as fast as possible");
+    return true;
+}
+
+bool PlaybackTransport::probe(const StreamProfile& requested, StreamProfile& negotiated) {
+    negotiated = requested;
+    negotiated.width = reader_.width();
+    negotiated.height = reader_.height();
+    uint64_t span_ns = reader_.last_timestamp_ns() - reader_.first_timestamp_ns();
+    if (reader_.frame_count() > 1 && span_ns > 0) {
+        negotiated.fps = static_cast<int>(std::lround((reader_.frame_count() - 1) * 1e9 / span_ns));
+    }
+    return true;
+}
+
+bool PlaybackTransport::start(FramePool& pool, PayloadCallback on_payload) {
+    if (running_) {
+        return true;
+    }
+    if (!reader_.is_open() || reader_.frame_count() == 0) {
+        LOG_ERROR("No recorded frames to replay");
+        return false;
+    }
+    running_ = true;
+    finished_ = false;
+    thread_ = std::thread(&PlaybackTransport::replay_loop, this, std::ref(pool), std::move(on_payload));
+    return true;
+}
+
+void PlaybackTransport::stop() {
+    running_ = false;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+const char* PlaybackTransport::name() const {
+    return "playback";
+}
+
+const RecordingReader& PlaybackTransport::reader() const {
+    return reader_;
+}
+
+void PlaybackTransport::seek(size_t frame) {
+    start_frame_ = frame;
+}
+
+bool PlaybackTransport::finished() const {
+    return finished_;
+}
+
+void PlaybackTransport::replay_loop(FramePool& pool, PayloadCallback on_payload) {
+    ThreadAffinity::pin_current_thread(cpu_);
+    ThreadAffinity::set_realtime_priority(priority_);
+    size_t index = std::min(start_frame_, reader_.frame_count() - 1);
+    uint64_t base_timestamp = reader_.timestamp(index);
+    uint64_t base_ns = monotonic_ns();
+    uint8_t fid = 0;
+
+    while (running_) {
+        if (index >= reader_.frame_count()) {
+            if (!config_.loop) {
+                finished_ = true;
+                break;
+            }
+            index = 0;
+            base_timestamp = reader_.timestamp(0);
+            base_ns = monotonic_ns();
+        }
+
+        RecordingReader::FrameView view;
+        if (!reader_.frame(index, view)) {
+            index++;
+            continue;
+        }
+        if (view.codec != RecordCodec::Raw && view.codec != RecordCodec::Lossless) {
+            LOG_ERROR("Frame %zu uses codec %d, which replay cannot decode", index, static_cast<int>(view.codec));
+            index++;
+            continue;
+        }
+
+        // Pace to the recorded timestamps, in short sleeps so stop() is
+        // noticed promptly
+        if (config_.realtime) {
+            uint64_t offset = static_cast<uint64_t>((view.metadata.timestamp_ns - base_timestamp) / config_.speed);
+            for (;;) {
+                uint64_t now = monotonic_ns();
+                if (!running_ || now >= base_ns + offset) {
+                    break;
+                }
+                uint64_t wait = std::min(base_ns + offset - now, MAX_SLEEP_NS);
+                std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+            }
+        }
+        reader_.prefetch(index + 1);
+
+        // A camera drops a frame when the host has nowhere to put it; flat
+        // out replay waits for the consumer instead, so nothing is lost
+        Frame frame = pool.acquire();
+        while (!frame && running_ && !config_.realtime) {
+            std::this_thread::sleep_for(std::chrono::microseconds(POOL_RETRY_US));
+            frame = pool.acquire();
+        }
+        if (!frame) {
+            index++;
+            continue;
+        }
+        if (PAYLOAD_HEADER_SIZE + view.raw_size > frame.capacity()) {
+            LOG_ERROR("Recorded frame %zu does not fit a %zu byte buffer", index, frame.capacity());
+            index++;
+            continue;
+        }
+
+        uint8_t* payload = frame.storage();
+        uint32_t pts = view.metadata.device_timestamp;
+        payload[0] = PAYLOAD_HEADER_SIZE;
+        payload[1] = UvcHeader::EOH | UvcHeader::PTS | UvcHeader::EOF_BIT | fid;
+        payload[2] = pts & 0xff;
+        payload[3] = (pts >> 8) & 0xff;
+        payload[4] = (pts >> 16) & 0xff;
+        payload[5] = (pts >> 24) & 0xff;
+        if (view.codec == RecordCodec::Raw) {
+            std::memcpy(payload + PAYLOAD_HEADER_SIZE, view.data, view.size);
+        } else if (view.raw_size != static_cast<size_t>(reader_.width()) * reader_.height() * sizeof(uint16_t) ||
+                   !codec_.decode(view.data, view.size, reinterpret_cast<uint16_t*>(payload + PAYLOAD_HEADER_SIZE),
+                                  reader_.width(), reader_.height())) {
+            LOG_ERROR("Recorded frame %zu does not decode", index);
+            index++;
+            continue;
+        }
+        frame.set_data(0, PAYLOAD_HEADER_SIZE + view.raw_size);
+        frame.metadata().timestamp_ns = monotonic_ns();
+        fid ^= UvcHeader::FID;
+
+        on_payload(frame);
+        index++;
+    }
+}
@@ -0,0 +1,314 @@
+#include "point_cloud.hpp"
+#include <algorithm>
+
+#if CPU_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+size_t count_valid_scalar(const uint16_t* depth, size_t count) {
+    size_t valid = 0;
+    for (size_t i = 0; i < count; i++) {
+        valid += depth[i] != 0;
+    }
+    return valid;
+}
+
+// Deprojects one row into x/y/z starting at index n and returns the index
+// after the last point written. The vector versions also take the end of
+// the band's output, which compacted stores must not cross.
+size_t deproject_row_scalar(const uint16_t* depth, int width, const float* ray_x, float ray_y, float scale,
+                            float* x, float* y, float* z, size_t n, bool compact) {
+    for (int u = 0; u < width; u++) {
+        float depth_m = depth[u] * scale;
+        if (compact && depth[u] == 0) {
+            continue;
+        }
+        x[n] = depth_m * ray_x[u];
+        y[n] = depth_m * ray_y;
+        z[n] = depth_m;
+        n++;
+    }
+    return n;
+}
+
+#if CPU_X86
+
+// Lane permutations that move the selected lanes of a vector to the front,
+// indexed by the selection bitmask.
+struct CompactTables {
+    alignas(32) int32_t avx2[256][8];
+    alignas(16) uint8_t sse[16][16];
+
+    CompactTables() {
+        for (int mask = 0; mask < 256; mask++) {
+            int n = 0;
+            for (int lane = 0; lane < 8; lane++) {
+                if (mask & (1 << lane)) {
+                    avx2[mask][n++] = lane;
+                }
+            }
+            while (n < 8) {
+                avx2[mask][n++] = 0;
+            }
+        }
+        for (int mask = 0; mask < 16; mask++) {
+            int n = 0;
+            for (int lane = 0; lane < 4; lane++) {
+                if (mask & (1 << lane)) {
+                    for (int byte = 0; byte < 4; byte++) {
+                        sse[mask][n * 4 + byte] = static_cast<uint8_t>(lane * 4 + byte);
+                    }
+                    n++;
+                }
+            }
+            for (int byte = n * 4; byte < 16; byte++) {
+                sse[mask][byte] = 0x80;
+            }
+        }
+    }
+};
+
+const CompactTables& compact_tables() {
+    static const CompactTables tables;
+    return tables;
+}
+
+TARGET_SSE41 size_t count_valid_sse41(const uint16_t* depth, size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t invalid = 0;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(depth + i));
+        invalid += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi16(d, zero)));
+    }
+    return i - invalid / 2 + count_valid_scalar(depth + i, count - i);
+}
+
+TARGET_SSE41 size_t deproject_row_sse41(const uint16_t* depth, int width, const float* ray_x, float ray_y,
+                                        float scale, float* x, float* y, float* z, size_t n, size_t limit,
+                                        bool compact) {
+    const CompactTables& tables = compact_tables();
+    const __m128 vscale = _mm_set1_ps(scale);
+    const __m128 vray_y = _mm_set1_ps(ray_y);
+    const __m128 zero = _mm_setzero_ps();
+    int u = 0;
+    for (; u + 4 <= width; u += 4) {
+        __m128i d = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(depth + u)));
+        __m128 zf = _mm_mul_ps(_mm_cvtepi32_ps(d), vscale);
+        __m128 xf = _mm_mul_ps(zf, _mm_loadu_ps(ray_x + u));
+        __m128 yf = _mm_mul_ps(zf, vray_y);
+        if (!compact) {
+            _mm_storeu_ps(x + n, xf);
+            _mm_storeu_ps(y + n, yf);
+            _mm_storeu_ps(z + n, zf);
+            n += 4;
+            continue;
+        }
+
+        int mask = _mm_movemask_ps(_mm_cmpgt_ps(zf, zero));
+        if (!mask) {
+            continue;
+        }
+        __m128i shuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(tables.sse[mask]));
+        xf = _mm_castsi128_ps(_mm_shuffle_epi8(_mm_castps_si128(xf), shuffle));
+        yf = _mm_castsi128_ps(_mm_shuffle_epi8(_mm_castps_si128(yf), shuffle));
+        zf = _mm_castsi128_ps(_mm_shuffle_epi8(_mm_castps_si128(zf), shuffle));
+        int valid = __builtin_popcount(mask);
+        if (n + 4 <= limit) {
+            _mm_storeu_ps(x + n, xf);
+            _mm_storeu_ps(y + n, yf);
+            _mm_storeu_ps(z + n, zf);
+        } else {
+            // Last points of the band: a full store would spill into the next
+            alignas(16) float lanes[3][4];
+            _mm_store_ps(lanes[0], xf);
+            _mm_store_ps(lanes[1], yf);
+            _mm_store_ps(lanes[2], zf);
+            for (int lane = 0; lane < valid; lane++) {
+                x[n + lane] = lanes[0][lane];
+                y[n + lane] = lanes[1][lane];
+                z[n + lane] = lanes[2][lane];
+            }
+        }
+        n += valid;
+    }
+    return deproject_row_scalar(depth + u, width - u, ray_x + u, ray_y, scale, x, y, z, n, compact);
+}
+
+TARGET_AVX2 size_t count_valid_avx2(const uint16_t* depth, size_t count) {
+    const __m256i zero = _mm256_setzero_si256();
+    size_t invalid = 0;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(depth + i));
+        invalid += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi16(d, zero)));
+    }
+    return i - invalid / 2 + count_valid_scalar(depth + i, count - i);
+}
+
+TARGET_AVX2 size_t deproject_row_avx2(const uint16_t* depth, int width, const float* ray_x, float ray_y,
+                                      float scale, float* x, float* y, float* z, size_t n, size_t limit,
+                                      bool compact) {
+    const CompactTables& tables = compact_tables();
+    const __m256 vscale = _mm256_set1_ps(scale);
+    const __m256 vray_y = _mm256_set1_ps(ray_y);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256i lane_index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    int u = 0;
+    for (; u + 8 <= width; u += 8) {
+        __m256i d = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(depth + u)));
+        __m256 zf = _mm256_mul_ps(_mm256_cvtepi32_ps(d), vscale);
+        __m256 xf = _mm256_mul_ps(zf, _mm256_loadu_ps(ray_x + u));
+        __m256 yf = _mm256_mul_ps(zf, vray_y);
+        if (!compact) {
+            _mm256_storeu_ps(x + n, xf);
+            _mm256_storeu_ps(y + n, yf);
+            _mm256_storeu_ps(z + n, zf);
+            n += 8;
+            continue;
+        }
+
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(zf, zero, _CMP_GT_OQ));
+        if (!mask) {
+            continue;
+        }
+        __m256i permutation = _mm256_load_si256(reinterpret_cast<const __m256i*>(tables.avx2[mask]));
+        xf = _mm256_permutevar8x32_ps(xf, permutation);
+        yf = _mm256_permutevar8x32_ps(yf, permutation);
+        zf = _mm256_permutevar8x32_ps(zf, permutation);
+        int valid = __builtin_popcount(mask);
+        if (n + 8 <= limit) {
+            _mm256_storeu_ps(x + n, xf);
+            _mm256_storeu_ps(y + n, yf);
+            _mm256_storeu_ps(z + n, zf);
+        } else {
+            // Last points of the band: a full store would spill into the next
+            __m256i store_mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(valid), lane_index);
+            _mm256_maskstore_ps(x + n, store_mask, xf);
+            _mm256_maskstore_ps(y + n, store_mask, yf);
+            _mm256_maskstore_ps(z + n, store_mask, zf);
+        }
+        n += valid;
+    }
+    return deproject_row_scalar(depth + u, width - u, ray_x + u, ray_y, scale, x, y, z, n, compact);
+}
+
+#endif
+
+}  // namespace
+
+PointCloud::PointCloud(const CameraIntrinsics& intrinsics, const Config& config)
+    : intrinsics_(intrinsics), config_(config), simd_level_(CpuFeatures::simd_level()),
+      pool_(config.pool ? config.pool : &ThreadPool::shared()) {
+    ray_x_.resize(intrinsics_.width);
+    for (int u = 0; u < intrinsics_.width; u++) {
+        ray_x_[u] = (u - intrinsics_.ppx) / intrinsics_.fx;
+    }
+    ray_y_.resize(intrinsics_.height);
+    for (int v = 0; v < intrinsics_.height; v++) {
+        ray_y_[v] = (v - intrinsics_.ppy) / intrinsics_.fy;
+    }
+}
+
+void PointCloud::set_simd_level(SimdLevel level) {
+    simd_level_ = CpuFeatures::clamp(level);
+}
+
+SimdLevel PointCloud::simd_level() const {
+    return simd_level_;
+}
+
+const CameraIntrinsics& PointCloud::intrinsics() const {
+    return intrinsics_;
+}
+
+size_t PointCloud::count_valid(const uint16_t* depth, size_t count) const {
+    switch (simd_level_) {
+#if CPU_X86
+    case SimdLevel::Avx2:
+        return count_valid_avx2(depth, count);
+    case SimdLevel::Sse41:
+        return count_valid_sse41(depth, count);
+#endif
+    default:
+        return count_valid_scalar(depth, count);
+    }
+}
+
+size_t PointCloud::deproject_rows(const uint16_t* depth, int first_row, int last_row, Points& points,
+                                  size_t offset, size_t limit) const {
+    const int width = intrinsics_.width;
+    const float scale = config_.depth_scale;
+    const bool compact = config_.compact;
+    float* x = points.x.data();
+    float* y = points.y.data();
+    float* z = points.z.data();
+
+    size_t n = offset;
+    for (int v = first_row; v < last_row; v++) {
+        const uint16_t* row = depth + static_cast<size_t>(v) * width;
+        switch (simd_level_) {
+#if CPU_X86
+        case SimdLevel::Avx2:
+            n = deproject_row_avx2(row, width, ray_x_.data(), ray_y_[v], scale, x, y, z, n, limit, compact);
+            break;
+        case SimdLevel::Sse41:
+            n = deproject_row_sse41(row, width, ray_x_.data(), ray_y_[v], scale, x, y, z, n, limit, compact);
+            break;
+#endif
+        default:
+            n = deproject_row_scalar(row, width, ray_x_.data(), ray_y_[v], scale, x, y, z, n, compact);
+            break;
+        }
+    }
+    return n;
+}
+
+size_t PointCloud::deproject(const uint16_t* depth, Points& points) {
+    const int width = intrinsics_.width;
+    const int height = intrinsics_.height;
+    const size_t pixels = static_cast<size_t>(width) * height;
+    points.x.resize(pixels);
+    points.y.resize(pixels);
+    points.z.resize(pixels);
+
+    const int bands = (height + ROWS_PER_BAND - 1) / ROWS_PER_BAND;
+    auto band_rows = [&](size_t band, int& first, int& last) {
+        first = static_cast<int>(band) * ROWS_PER_BAND;
+        last = std::min(first + ROWS_PER_BAND, height);
+    };
+
+    if (!config_.compact) {
+        pool_->run(bands, [&](size_t band) {
+            int first, last;
+            band_rows(band, first, last);
+            size_t offset = static_cast<size_t>(first) * width;
+            deproject_rows(depth, first, last, points, offset, static_cast<size_t>(last) * width);
+        });
+        points.count = pixels;
+        return points.count;
+    }
+
+    // Count first so every band knows where its points start and the bands
+    // can be written in parallel without gaps.
+    band_offsets_.assign(bands + 1, 0);
+    pool_->run(bands, [&](size_t band) {
+        int first, last;
+        band_rows(band, first, last);
+        band_offsets_[band + 1] = count_valid(depth + static_cast<size_t>(first) * width,
+                                              static_cast<size_t>(last - first) * width);
+    });
+    for (int band = 0; band < bands; band++) {
+        band_offsets_[band + 1] += band_offsets_[band];
+    }
+
+    pool_->run(bands, [&](size_t band) {
+        int first, last;
+        band_rows(band, first, last);
+        deproject_rows(depth, first, last, points, band_offsets_[band], band_offsets_[band + 1]);
+    });
+    points.count = band_offsets_[bands];
+    return points.count;
+}
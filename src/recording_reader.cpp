@@ -0,0 +1,251 @@
+#include "recording_reader.hpp"
+#include "logger.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define LOG_COMPONENT "replay"
+
+RecordingReader::RecordingReader()
+    : fd_(-1), map_(nullptr), map_size_(0), header_(), index_(nullptr), frame_count_(0), recovered_(false) {
+}
+
+RecordingReader::~RecordingReader() {
+    close();
+}
+
+bool RecordingReader::open(const std::string& path) {
+    close();
+
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        LOG_ERROR("Failed to open %s: %s", path.c_str(), std::strerror(errno));
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd_, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(RecordingFileHeader)) {
+        LOG_ERROR("%s is not a depth recording", path.c_str());
+        close();
+        return false;
+    }
+    map_size_ = static_cast<size_t>(info.st_size);
+    void* map = mmap(nullptr, map_size_, PROT_READ, MAP_SHARED, fd_, 0);
+    if (map == MAP_FAILED) {
+        LOG_ERROR("Failed to map %s: %s", path.c_str(), std::strerror(errno));
+        map_size_ = 0;
+        close();
+        return false;
+    }
+    map_ = static_cast<const uint8_t*>(map);
+
+    std::memcpy(&header_, map_, sizeof(header_));
+    if (std::memcmp(header_.magic, RecordingFormat::MAGIC, sizeof(header_.magic)) != 0 ||
+        header_.version != RecordingFormat::VERSION ||
+        header_.pixel_format != RecordingFormat::PIXEL_FORMAT_Z16) {
+        LOG_ERROR("%s is not a depth recording this version can read", path.c_str());
+        close();
+        return false;
+    }
+
+    // Use the trailing index in place when the recording was closed properly
+    // and it is intact; anything else is rebuilt from the frame records.
+    bool have_index = false;
+    if (header_.index_offset != 0 && header_.index_offset <= map_size_ - sizeof(RecordingIndexHeader)) {
+        RecordingIndexHeader index_header;
+        std::memcpy(&index_header, map_ + header_.index_offset, sizeof(index_header));
+        uint64_t max_count = (map_size_ - header_.index_offset - sizeof(index_header)) / sizeof(RecordingIndexEntry);
+        if (index_header.magic == RecordingFormat::INDEX_MAGIC && index_header.count <= max_count) {
+            const RecordingIndexEntry* entries =
+                reinterpret_cast<const RecordingIndexEntry*>(map_ + header_.index_offset + sizeof(index_header));
+            if (index_valid(entries, index_header.count, header_.index_offset)) {
+                index_ = entries;
+                frame_count_ = index_header.count;
+                have_index = true;
+            }
+        }
+    }
+    if (!have_index) {
+        LOG_WARN("%s has no usable index, rebuilding it", path.c_str());
+        if (!rebuild_index()) {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool RecordingReader::index_valid(const RecordingIndexEntry* entries, uint64_t count, uint64_t index_offset) {
+    // find() and prefetch() rely on offsets and timestamps that only go forward,
+    // and frame() on every record starting before the index.
+    if (count > 0 && index_offset < sizeof(RecordingFileHeader) + sizeof(RecordingFrameHeader)) {
+        return false;
+    }
+    uint64_t offset = sizeof(RecordingFileHeader);
+    uint64_t timestamp_ns = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        if (entries[i].offset < offset || entries[i].offset > index_offset - sizeof(RecordingFrameHeader) ||
+            entries[i].timestamp_ns < timestamp_ns) {
+            return false;
+        }
+        offset = entries[i].offset + sizeof(RecordingFrameHeader);
+        timestamp_ns = entries[i].timestamp_ns;
+    }
+    return true;
+}
+
+bool RecordingReader::rebuild_index() {
+    // Walk the records until the first one that is missing or cut short:
+    // that is where the recorder stopped, the rest is preallocated space.
+    rebuilt_index_.clear();
+    size_t offset = RecordingFormat::align(sizeof(RecordingFileHeader));
+    while (offset + sizeof(RecordingFrameHeader) <= map_size_) {
+        RecordingFrameHeader header;
+        std::memcpy(&header, map_ + offset, sizeof(header));
+        size_t record_size = RecordingFormat::align(sizeof(header) + header.size);
+        if (header.magic != RecordingFormat::FRAME_MAGIC || offset + record_size > map_size_) {
+            break;
+        }
+        // A record older than the one before it is not part of this recording
+        if (!rebuilt_index_.empty() && header.timestamp_ns < rebuilt_index_.back().timestamp_ns) {
+            break;
+        }
+        rebuilt_index_.push_back(RecordingIndexEntry{offset, header.timestamp_ns});
+        offset += record_size;
+    }
+    index_ = rebuilt_index_.data();
+    frame_count_ = rebuilt_index_.size();
+    recovered_ = true;
+    if (frame_count_ > 0) {
+        header_.first_timestamp_ns = rebuilt_index_.front().timestamp_ns;
+        header_.last_timestamp_ns = rebuilt_index_.back().timestamp_ns;
+    }
+    return true;
+}
+
+void RecordingReader::close() {
+    if (map_) {
+        munmap(const_cast<uint8_t*>(map_), map_size_);
+        map_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    map_size_ = 0;
+    index_ = nullptr;
+    frame_count_ = 0;
+    recovered_ = false;
+    rebuilt_index_.clear();
+}
+
+bool RecordingReader::is_open() const {
+    return map_ != nullptr;
+}
+
+int RecordingReader::width() const {
+    return static_cast<int>(header_.width);
+}
+
+int RecordingReader::height() const {
+    return static_cast<int>(header_.height);
+}
+
+size_t RecordingReader::frame_count() const {
+    return frame_count_;
+}
+
+uint64_t RecordingReader::first_timestamp_ns() const {
+    return header_.first_timestamp_ns;
+}
+
+uint64_t RecordingReader::last_timestamp_ns() const {
+    return header_.last_timestamp_ns;
+}
+
+bool RecordingReader::recovered() const {
+    return recovered_;
+}
+
+bool RecordingReader::frame(size_t index, FrameView& view) const {
+    if (index >= frame_count_) {
+        return false;
+    }
+    uint64_t offset = index_[index].offset;
+    if (offset + sizeof(RecordingFrameHeader) > map_size_) {
+        return false;
+    }
+    RecordingFrameHeader header;
+    std::memcpy(&header, map_ + offset, sizeof(header));
+    if (header.magic != RecordingFormat::FRAME_MAGIC ||
+        offset + sizeof(header) + header.size > map_size_) {
+        LOG_ERROR("Frame %zu of the recording is corrupt", index);
+        return false;
+    }
+
+    view.data = map_ + offset + sizeof(header);
+    view.size = header.size;
+    view.raw_size = header.raw_size;
+    view.codec = static_cast<RecordCodec>(header.codec);
+    view.metadata.sequence = header.sequence;
+    view.metadata.timestamp_ns = header.timestamp_ns;
+    view.metadata.device_timestamp = header.device_timestamp;
+    view.metadata.assembled_ns = 0;
+    return true;
+}
+
+uint64_t RecordingReader::timestamp(size_t index) const {
+    return index < frame_count_ ? index_[index].timestamp_ns : 0;
+}
+
+size_t RecordingReader::find(uint64_t timestamp_ns) const {
+    if (frame_count_ == 0 || timestamp_ns <= index_[0].timestamp_ns) {
+        return 0;
+    }
+    size_t last = frame_count_ - 1;
+    if (timestamp_ns >= index_[last].timestamp_ns) {
+        return last;
+    }
+
+    // Guess from the average frame interval, then walk; at a steady frame
+    // rate the guess is already right or one off.
+    uint64_t span = index_[last].timestamp_ns - index_[0].timestamp_ns;
+    size_t guess = static_cast<size_t>(static_cast<double>(timestamp_ns - index_[0].timestamp_ns) / span * last);
+    guess = guess < last ? guess : last - 1;
+    for (int step = 0; step < SEEK_STEPS; step++) {
+        if (index_[guess].timestamp_ns > timestamp_ns) {
+            guess--;
+        } else if (index_[guess + 1].timestamp_ns <= timestamp_ns) {
+            guess++;
+        } else {
+            return guess;
+        }
+    }
+
+    // Irregular timing: bisect for the last frame at or before timestamp_ns.
+    // index_[0] is at or before it and index_[last] after it.
+    size_t low = 0;
+    size_t high = last;
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        if (index_[middle].timestamp_ns <= timestamp_ns) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+void RecordingReader::prefetch(size_t index) const {
+    if (index >= frame_count_) {
+        return;
+    }
+    static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    uint64_t offset = index_[index].offset;
+    uint64_t end = index + 1 < frame_count_ ? index_[index + 1].offset : offset + sizeof(RecordingFrameHeader);
+    uint64_t start = offset / page * page;
+    madvise(const_cast<uint8_t*>(map_) + start, end - start, MADV_WILLNEED);
+}
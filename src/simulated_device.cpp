@@ -0,0 +1,228 @@
+#include "simulated_device.hpp"
+#include "uvc_protocol.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+void write_le32(uint8_t* p, uint32_t v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+}
+
+}  // namespace
+
+SimulatedDevice::SimulatedDevice(const Config& config)
+    : config_(config),
+      frame_size_(0), payload_data_size_(0),
+      rng_(config.seed),
+      uniform_(0.0, 1.0),
+      jitter_(0.0, config.jitter_us > 0.0 ? config.jitter_us : 1.0),
+      frame_due_set_(false), frame_index_(0), frame_offset_(0), fid_(0), pts_(0), sof_(0), started_(false),
+      stream_first_frame_(0), next_unplug_(config.unplug_every), unplugged_(false) {
+    resize();
+}
+
+void SimulatedDevice::resize() {
+    frame_size_ = static_cast<size_t>(config_.width) * config_.height * sizeof(uint16_t);
+    if (config_.payload_size > UvcHeader::MAX_LENGTH) {
+        payload_data_size_ = std::min(config_.payload_size - UvcHeader::MAX_LENGTH, frame_size_);
+    } else {
+        payload_data_size_ = frame_size_;
+    }
+    render_scene();
+}
+
+StreamProfile SimulatedDevice::profile() const {
+    return {config_.width, config_.height, static_cast<int>(std::lround(config_.fps))};
+}
+
+void SimulatedDevice::set_profile(const StreamProfile& profile) {
+    // The configured rate may be fractional or unpaced; keep it when only
+    // rounding tells them apart
+    if (profile.fps != static_cast<int>(std::lround(config_.fps))) {
+        config_.fps = profile.fps;
+    }
+    if (profile.width != config_.width || profile.height != config_.height) {
+        config_.width = profile.width;
+        config_.height = profile.height;
+        resize();
+    }
+    started_ = false;
+    frame_offset_ = 0;
+}
+
+size_t SimulatedDevice::max_payload_size() const {
+    return UvcHeader::MAX_LENGTH + payload_data_size_;
+}
+
+size_t SimulatedDevice::frame_size() const {
+    return frame_size_;
+}
+
+bool SimulatedDevice::present() {
+    auto now = std::chrono::steady_clock::now();
+    if (unplugged_) {
+        if (now < replug_at_) {
+            return false;
+        }
+        // Replugged: the camera streams from scratch, on its own clock
+        unplugged_ = false;
+        started_ = false;
+        frame_offset_ = 0;
+        return true;
+    }
+    // Unplug between frames, once the count comes up
+    if (next_unplug_ > 0 && frame_index_ >= next_unplug_ && frame_offset_ == 0) {
+        next_unplug_ = frame_index_ + config_.unplug_every;
+        unplugged_ = true;
+        replug_at_ = now + std::chrono::microseconds(static_cast<int64_t>(config_.unplug_ms * 1000.0));
+        return false;
+    }
+    return true;
+}
+
+bool SimulatedDevice::wait_present(unsigned int timeout_ms) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    if (unplugged_) {
+        std::this_thread::sleep_until(std::min(replug_at_, deadline));
+    }
+    return present();
+}
+
+uint64_t SimulatedDevice::frames_generated() const {
+    return frame_index_;
+}
+
+void SimulatedDevice::render_scene() {
+    // A slanted back wall with a sphere sweeping across it, an invalid band
+    // on the left edge like the D4xx stereo overlap, and sparse dropouts.
+    const int width = config_.width;
+    const int height = config_.height;
+    const int invalid_band = width / 16;
+    std::mt19937 holes(config_.seed ^ 0x5eed);
+
+    scene_frames_.resize(ANIMATION_FRAMES);
+    for (int f = 0; f < ANIMATION_FRAMES; f++) {
+        std::vector<uint16_t>& frame = scene_frames_[f];
+        frame.resize(static_cast<size_t>(width) * height);
+
+        double phase = 2.0 * M_PI * f / ANIMATION_FRAMES;
+        double cx = width * (0.5 + 0.3 * std::sin(phase));
+        double cy = height * 0.5;
+        double radius = height * 0.25;
+
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                double depth = 2500.0 + 1500.0 * x / width;
+                double dx = x - cx;
+                double dy = y - cy;
+                double r2 = dx * dx + dy * dy;
+                if (r2 < radius * radius) {
+                    depth = 1200.0 - 400.0 * std::sqrt(1.0 - r2 / (radius * radius));
+                }
+                if (x < invalid_band || (holes() & 0x3f) == 0) {
+                    depth = 0.0;
+                }
+                frame[static_cast<size_t>(y) * width + x] = static_cast<uint16_t>(depth);
+            }
+        }
+    }
+}
+
+std::chrono::steady_clock::time_point SimulatedDevice::frame_due() {
+    auto now = std::chrono::steady_clock::now();
+    if (!started_) {
+        stream_start_ = now + std::chrono::microseconds(static_cast<int64_t>(config_.start_offset_us));
+        stream_first_frame_ = frame_index_;
+        started_ = true;
+        frame_due_set_ = false;
+    }
+    if (frame_due_set_) {
+        return frame_due_;
+    }
+
+    // Drawn once per frame, however often it is asked for
+    frame_due_ = now;
+    if (config_.fps > 0.0) {
+        double due_us = (frame_index_ - stream_first_frame_) * 1e6 / config_.fps;
+        if (config_.jitter_us > 0.0) {
+            due_us += jitter_(rng_);
+        }
+        frame_due_ = stream_start_ + std::chrono::microseconds(static_cast<int64_t>(due_us));
+    }
+    frame_due_set_ = true;
+    return frame_due_;
+}
+
+std::chrono::steady_clock::time_point SimulatedDevice::next_payload_due() {
+    // The rest of a frame follows its first payload straight away
+    return frame_offset_ == 0 ? frame_due() : std::chrono::steady_clock::now();
+}
+
+void SimulatedDevice::begin_frame() {
+    auto due = frame_due();
+    if (due > std::chrono::steady_clock::now()) {
+        std::this_thread::sleep_until(due);
+    }
+    frame_due_set_ = false;
+
+    fid_ ^= UvcHeader::FID;
+    pts_ = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - stream_start_).count());
+}
+
+size_t SimulatedDevice::read_payload(uint8_t* buffer, size_t capacity) {
+    for (;;) {
+        if (frame_offset_ == 0) {
+            begin_frame();
+        }
+
+        size_t data_size = std::min(payload_data_size_, frame_size_ - frame_offset_);
+        bool end_of_frame = frame_offset_ + data_size == frame_size_;
+        size_t offset = frame_offset_;
+        const uint8_t* pixels = reinterpret_cast<const uint8_t*>(
+            scene_frames_[frame_index_ % ANIMATION_FRAMES].data());
+
+        frame_offset_ += data_size;
+        sof_++;
+        if (end_of_frame) {
+            frame_offset_ = 0;
+            frame_index_++;
+        }
+
+        if (uniform_(rng_) < config_.payload_loss) {
+            continue;
+        }
+
+        uint8_t header[UvcHeader::MAX_LENGTH];
+        header[0] = UvcHeader::MAX_LENGTH;
+        header[1] = UvcHeader::EOH | UvcHeader::PTS | UvcHeader::SCR | fid_;
+        if (end_of_frame) {
+            header[1] |= UvcHeader::EOF_BIT;
+        }
+        write_le32(header + 2, pts_);
+        uint32_t stc = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - stream_start_).count());
+        write_le32(header + 6, stc);
+        header[10] = sof_ & 0xff;
+        header[11] = (sof_ >> 8) & 0x07;
+
+        size_t length = std::min(sizeof(header) + data_size, capacity);
+        if (uniform_(rng_) < config_.short_payload) {
+            length = sizeof(header) + static_cast<size_t>(uniform_(rng_) * data_size);
+            length = std::min(length, capacity);
+        }
+
+        size_t header_bytes = std::min(sizeof(header), length);
+        memcpy(buffer, header, header_bytes);
+        if (length > header_bytes) {
+            memcpy(buffer + header_bytes, pixels + offset, length - header_bytes);
+        }
+        return length;
+    }
+}
@@ -0,0 +1,132 @@
+#include "simulated_endpoint.hpp"
+#include <algorithm>
+
+SimulatedEndpoint::SimulatedEndpoint(FillFn fill, const Config& config)
+    : own_bus_(std::make_unique<SimulatedBus>()), bus_(*own_bus_), fill_(std::move(fill)), config_(config),
+      bus_free_at_(Clock::now()) {
+}
+
+SimulatedEndpoint::SimulatedEndpoint(SimulatedBus& bus, FillFn fill, DueFn due, const Config& config)
+    : bus_(bus), fill_(std::move(fill)), due_(std::move(due)), config_(config), bus_free_at_(Clock::now()) {
+}
+
+bool SimulatedEndpoint::prepare(TransferRequest*) {
+    return true;
+}
+
+void SimulatedEndpoint::release(TransferRequest*) {
+}
+
+TransferStatus SimulatedEndpoint::submit(TransferRequest* request) {
+    std::lock_guard<std::mutex> lock(bus_.mutex_);
+
+    // The bus services requests back to back; a request submitted while the
+    // bus is idle starts immediately.
+    Clock::time_point start = std::max(Clock::now(), bus_free_at_);
+    Clock::duration wire_time(0);
+    if (config_.bandwidth_bytes_per_sec > 0.0) {
+        wire_time = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(request->length / config_.bandwidth_bytes_per_sec));
+    }
+    bus_free_at_ = start + wire_time;
+
+    Clock::duration latency = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double, std::micro>(config_.completion_latency_us));
+
+    bus_.pending_.push_back({this, request, bus_free_at_ + latency});
+    bus_.cv_.notify_one();
+    return TransferStatus::Completed;
+}
+
+void SimulatedEndpoint::cancel(TransferRequest* request) {
+    std::lock_guard<std::mutex> lock(bus_.mutex_);
+    auto it = std::find_if(bus_.pending_.begin(), bus_.pending_.end(),
+                           [request](const SimulatedBus::Pending& p) { return p.request == request; });
+    if (it == bus_.pending_.end()) {
+        return;
+    }
+    bus_.pending_.erase(it);
+    bus_.cancelled_.push_back(request);
+    bus_.cv_.notify_one();
+}
+
+bool SimulatedEndpoint::clear_halt() {
+    // Simulated endpoints never stall
+    return true;
+}
+
+void SimulatedEndpoint::handle_events(int timeout_ms) {
+    bus_.handle_events(timeout_ms);
+}
+
+std::deque<SimulatedBus::Pending>::iterator SimulatedBus::next_completion(Clock::time_point& due) {
+    // Each endpoint completes its transfers in order, so only its oldest
+    // one is a candidate
+    auto next = pending_.end();
+    for (auto it = pending_.begin(); it != pending_.end(); ++it) {
+        bool oldest = std::none_of(pending_.begin(), it,
+                                   [&it](const Pending& p) { return p.endpoint == it->endpoint; });
+        if (!oldest) {
+            continue;
+        }
+        Clock::time_point at = it->complete_at;
+        if (it->endpoint->due_) {
+            at = std::max(at, it->endpoint->due_());
+        }
+        if (next == pending_.end() || at < due) {
+            next = it;
+            due = at;
+        }
+    }
+    return next;
+}
+
+void SimulatedBus::handle_events(int timeout_ms) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    for (;;) {
+        // Cancellations are reported from the event loop, like libusb does.
+        if (!cancelled_.empty()) {
+            while (!cancelled_.empty()) {
+                TransferRequest* request = cancelled_.front();
+                cancelled_.pop_front();
+                request->status = TransferStatus::Cancelled;
+                request->actual_length = 0;
+                lock.unlock();
+                request->on_complete(request);
+                lock.lock();
+            }
+            return;
+        }
+
+        Clock::time_point due;
+        auto next = next_completion(due);
+        Clock::time_point now = Clock::now();
+        if (next != pending_.end() && due <= now) {
+            Pending completed = *next;
+            pending_.erase(next);
+            lock.unlock();
+
+            TransferRequest* request = completed.request;
+            size_t filled = completed.endpoint->fill_(request->buffer, request->length);
+            if (filled == SimulatedEndpoint::NO_DEVICE) {
+                request->actual_length = 0;
+                request->status = TransferStatus::NoDevice;
+            } else {
+                request->actual_length = static_cast<int>(filled);
+                request->status = TransferStatus::Completed;
+            }
+            request->on_complete(request);
+            return;
+        }
+        if (now >= deadline) {
+            return;
+        }
+
+        // Woken early by a submission or cancellation, which may change
+        // what completes next
+        Clock::time_point wake = next != pending_.end() ? std::min(due, deadline) : deadline;
+        cv_.wait_until(lock, wake);
+    }
+}
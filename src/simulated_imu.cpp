@@ -0,0 +1,100 @@
+#include "simulated_imu.hpp"
+#include "hid_protocol.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+constexpr double kRockHz = 0.5;             // The camera rocks back and forth at this rate
+constexpr double kRockAmplitude = 0.2;      // Radians
+constexpr double kGravity = 1000.0;         // Raw accelerometer units per g
+constexpr double kGyroScale = 1000.0;       // Raw gyro units per rad/s
+
+int16_t to_raw(double value) {
+    return static_cast<int16_t>(std::max(-32768.0, std::min(32767.0, std::round(value))));
+}
+
+}  // namespace
+
+SimulatedImu::SimulatedImu(const Config& config)
+    : config_(config), rng_(config.seed), noise_(0.0, config.noise > 0.0 ? config.noise : 1e-9),
+      started_(false), accel_index_(0), gyro_index_(0) {
+}
+
+void SimulatedImu::start() {
+    start_ = Clock::now();
+    started_ = true;
+}
+
+SimulatedImu::Clock::time_point SimulatedImu::due(uint64_t index, double hz) const {
+    if (hz <= 0.0) {
+        return Clock::time_point::max();
+    }
+    return start_ + std::chrono::microseconds(static_cast<int64_t>(index * 1e6 / hz));
+}
+
+bool SimulatedImu::accel_next() const {
+    return due(accel_index_, config_.accel_hz) <= due(gyro_index_, config_.gyro_hz);
+}
+
+SimulatedImu::Clock::time_point SimulatedImu::next_report_due() {
+    if (!started_) {
+        start();
+    }
+    return accel_next() ? due(accel_index_, config_.accel_hz) : due(gyro_index_, config_.gyro_hz);
+}
+
+size_t SimulatedImu::read_reports(uint8_t* buffer, size_t capacity) {
+    Clock::time_point first = next_report_due();
+    if (first == Clock::time_point::max() || capacity < sizeof(ImuHidReport)) {
+        return 0;
+    }
+    if (first > Clock::now()) {
+        std::this_thread::sleep_until(first);
+    }
+
+    size_t written = 0;
+    Clock::time_point now = Clock::now();
+    while (written + sizeof(ImuHidReport) <= capacity) {
+        bool accel = accel_next();
+        Clock::time_point at = accel ? due(accel_index_, config_.accel_hz) : due(gyro_index_, config_.gyro_hz);
+        if (at > now) {
+            break;
+        }
+
+        double t = std::chrono::duration<double>(at - start_).count();
+        double phase = 2.0 * M_PI * kRockHz * t;
+        double angle = kRockAmplitude * std::sin(phase);
+        ImuHidReport report{};
+        report.timestamp_us = static_cast<uint64_t>(t * 1e6);
+        if (accel) {
+            // Gravity, tilting with the camera
+            report.report_id = ImuHid::ACCEL_REPORT;
+            report.x = to_raw(noise_(rng_));
+            report.y = to_raw(-kGravity * std::cos(angle) + noise_(rng_));
+            report.z = to_raw(kGravity * std::sin(angle) + noise_(rng_));
+            accel_index_++;
+        } else {
+            // The rate of that tilt
+            double rate = kRockAmplitude * 2.0 * M_PI * kRockHz * std::cos(phase);
+            report.report_id = ImuHid::GYRO_REPORT;
+            report.x = to_raw(kGyroScale * rate + noise_(rng_));
+            report.y = to_raw(noise_(rng_));
+            report.z = to_raw(noise_(rng_));
+            gyro_index_++;
+        }
+        memcpy(buffer + written, &report, sizeof(report));
+        written += sizeof(report);
+    }
+    return written;
+}
+
+uint64_t SimulatedImu::accel_reports() const {
+    return accel_index_;
+}
+
+uint64_t SimulatedImu::gyro_reports() const {
+    return gyro_index_;
+}
@@ -0,0 +1,93 @@
+#include "simulated_transport.hpp"
+#include "logger.hpp"
+#include <algorithm>
+
+#define LOG_COMPONENT "sim"
+
+SimulatedTransport::SimulatedTransport(const SimulatedDevice::Config& device_config,
+                                       const SimulatedEndpoint::Config& endpoint_config)
+    : device_(device_config), endpoint_config_(endpoint_config) {
+}
+
+SimulatedTransport::~SimulatedTransport() {
+    stop();
+}
+
+bool SimulatedTransport::open() {
+    LOG_INFO("Using simulated device (%zu byte frames, %zu byte payloads)",
+             device_.frame_size(), device_.max_payload_size());
+    return true;
+}
+
+bool SimulatedTransport::start(FramePool& pool, PayloadCallback on_payload) {
+    if (capture_engine_ && capture_engine_->is_running()) {
+        return true;
+    }
+
+    capture_engine_.reset();
+    endpoint_ = std::make_unique<SimulatedEndpoint>(
+        [this](uint8_t* buffer, size_t capacity) {
+            return device_.present() ? device_.read_payload(buffer, capacity) : SimulatedEndpoint::NO_DEVICE;
+        },
+        endpoint_config_);
+
+    UsbCaptureEngine::Config engine_config;
+    engine_config.transfer_size = std::min(device_.max_payload_size(), pool.frame_capacity());
+    engine_config.queue_depth = 4;
+    engine_config.pool = &pool;
+    engine_config.cpu = cpu_;
+    engine_config.priority = priority_;
+    engine_config.metrics_prefix = metrics_prefix_;
+    engine_config.on_device_lost = on_lost_;
+    capture_engine_ = std::make_unique<UsbCaptureEngine>(*endpoint_, engine_config);
+    if (!capture_engine_->start(std::move(on_payload))) {
+        capture_engine_.reset();
+        endpoint_.reset();
+        return false;
+    }
+    return true;
+}
+
+void SimulatedTransport::stop() {
+    if (capture_engine_) {
+        capture_engine_->stop();
+    }
+}
+
+const char* SimulatedTransport::name() const {
+    return "simulated";
+}
+
+bool SimulatedTransport::reconnect(unsigned int timeout_ms) {
+    if (!device_.wait_present(timeout_ms)) {
+        return false;
+    }
+    LOG_INFO("Simulated device is back");
+    return true;
+}
+
+bool SimulatedTransport::probe(const StreamProfile& requested, StreamProfile& negotiated) {
+    negotiated = device_.profile();
+    if (negotiated != requested) {
+        LOG_INFO("Simulated device offers %s in place of %s", negotiated.to_string().c_str(),
+                 requested.to_string().c_str());
+    }
+    return true;
+}
+
+bool SimulatedTransport::commit(const StreamProfile& profile) {
+    if (capture_engine_ && capture_engine_->is_running()) {
+        LOG_ERROR("Cannot change the simulated profile while streaming");
+        return false;
+    }
+    device_.set_profile(profile);
+    return true;
+}
+
+SimulatedDevice& SimulatedTransport::device() {
+    return device_;
+}
+
+UsbCaptureEngine::Stats SimulatedTransport::engine_stats() const {
+    return capture_engine_ ? capture_engine_->stats() : UsbCaptureEngine::Stats();
+}
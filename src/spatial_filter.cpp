@@ -0,0 +1,162 @@
+#include "depth_filter.hpp"
+#include "frame_shape.hpp"
+#include <cmath>
+
+#if CPU_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+template <typename Shape>
+uint16_t spatial_pixel(const uint16_t* src, Shape shape, int x, int y, uint16_t delta) {
+    const int width = shape.width;
+    const int height = shape.height;
+    uint16_t center = src[static_cast<size_t>(y) * width + x];
+    if (center == 0) {
+        return 0;
+    }
+    uint32_t sum = center;
+    uint32_t count = 1;
+    for (int dy = -1; dy <= 1; dy++) {
+        int ny = y + dy;
+        if (ny < 0 || ny >= height) {
+            continue;
+        }
+        for (int dx = -1; dx <= 1; dx++) {
+            int nx = x + dx;
+            if ((dx == 0 && dy == 0) || nx < 0 || nx >= width) {
+                continue;
+            }
+            uint16_t n = src[static_cast<size_t>(ny) * width + nx];
+            int diff = n > center ? n - center : center - n;
+            if (n != 0 && diff <= delta) {
+                sum += n;
+                count++;
+            }
+        }
+    }
+    // Same rounding as the vector kernels: float divide, round to nearest even
+    return static_cast<uint16_t>(std::nearbyint(static_cast<float>(sum) / static_cast<float>(count)));
+}
+
+#if CPU_X86
+
+// Interior pixels [x, width - 1) of row y, eight at a time
+template <typename Shape>
+TARGET_SSE41 int spatial_row_sse41(const uint16_t* src, Shape shape, int y, uint16_t delta, uint16_t* dst, int x) {
+    const int width = shape.width;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vdelta = _mm_set1_epi16(static_cast<short>(delta));
+    const uint16_t* rows[3] = {
+        src + static_cast<size_t>(y - 1) * width,
+        src + static_cast<size_t>(y) * width,
+        src + static_cast<size_t>(y + 1) * width,
+    };
+    for (; x + 8 <= width - 1; x += 8) {
+        __m128i center = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[1] + x));
+        __m128i sum_lo = _mm_cvtepu16_epi32(center);
+        __m128i sum_hi = _mm_cvtepu16_epi32(_mm_srli_si128(center, 8));
+        __m128i count = _mm_set1_epi16(1);
+        for (int dy = 0; dy < 3; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                if (dy == 1 && dx == 0) {
+                    continue;
+                }
+                __m128i n = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[dy] + x + dx));
+                __m128i diff = _mm_or_si128(_mm_subs_epu16(n, center), _mm_subs_epu16(center, n));
+                __m128i close = _mm_cmpeq_epi16(_mm_min_epu16(diff, vdelta), diff);
+                __m128i use = _mm_andnot_si128(_mm_cmpeq_epi16(n, zero), close);
+                __m128i picked = _mm_and_si128(n, use);
+                sum_lo = _mm_add_epi32(sum_lo, _mm_cvtepu16_epi32(picked));
+                sum_hi = _mm_add_epi32(sum_hi, _mm_cvtepu16_epi32(_mm_srli_si128(picked, 8)));
+                count = _mm_sub_epi16(count, use);
+            }
+        }
+        __m128 mean_lo = _mm_div_ps(_mm_cvtepi32_ps(sum_lo), _mm_cvtepi32_ps(_mm_cvtepu16_epi32(count)));
+        __m128 mean_hi = _mm_div_ps(_mm_cvtepi32_ps(sum_hi),
+                                    _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_srli_si128(count, 8))));
+        __m128i result = _mm_packus_epi32(_mm_cvtps_epi32(mean_lo), _mm_cvtps_epi32(mean_hi));
+        result = _mm_andnot_si128(_mm_cmpeq_epi16(center, zero), result);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), result);
+    }
+    return x;
+}
+
+template <typename Shape>
+TARGET_AVX2 int spatial_row_avx2(const uint16_t* src, Shape shape, int y, uint16_t delta, uint16_t* dst, int x) {
+    const int width = shape.width;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i vdelta = _mm256_set1_epi16(static_cast<short>(delta));
+    const uint16_t* rows[3] = {
+        src + static_cast<size_t>(y - 1) * width,
+        src + static_cast<size_t>(y) * width,
+        src + static_cast<size_t>(y + 1) * width,
+    };
+    for (; x + 16 <= width - 1; x += 16) {
+        __m256i center = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[1] + x));
+        __m256i sum_lo = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(center));
+        __m256i sum_hi = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(center, 1));
+        __m256i count = _mm256_set1_epi16(1);
+        for (int dy = 0; dy < 3; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                if (dy == 1 && dx == 0) {
+                    continue;
+                }
+                __m256i n = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[dy] + x + dx));
+                __m256i diff = _mm256_or_si256(_mm256_subs_epu16(n, center), _mm256_subs_epu16(center, n));
+                __m256i close = _mm256_cmpeq_epi16(_mm256_min_epu16(diff, vdelta), diff);
+                __m256i use = _mm256_andnot_si256(_mm256_cmpeq_epi16(n, zero), close);
+                __m256i picked = _mm256_and_si256(n, use);
+                sum_lo = _mm256_add_epi32(sum_lo, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(picked)));
+                sum_hi = _mm256_add_epi32(sum_hi, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(picked, 1)));
+                count = _mm256_sub_epi16(count, use);
+            }
+        }
+        __m256 mean_lo = _mm256_div_ps(_mm256_cvtepi32_ps(sum_lo),
+                                       _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(count))));
+        __m256 mean_hi = _mm256_div_ps(_mm256_cvtepi32_ps(sum_hi),
+                                       _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(count, 1))));
+        __m256i result = _mm256_permute4x64_epi64(
+            _mm256_packus_epi32(_mm256_cvtps_epi32(mean_lo), _mm256_cvtps_epi32(mean_hi)), 0xd8);
+        result = _mm256_andnot_si256(_mm256_cmpeq_epi16(center, zero), result);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), result);
+    }
+    return x;
+}
+
+#endif
+
+}  // namespace
+
+SpatialFilter::SpatialFilter(uint16_t delta) : delta_(delta) {
+}
+
+void SpatialFilter::process_rows(const uint16_t* src, uint16_t* dst, int first_row, int last_row) {
+    dispatch_shape(width_, height_, specialized_, [&](auto shape) {
+        for (int y = first_row; y < last_row; y++) {
+            uint16_t* out = dst + static_cast<size_t>(y) * shape.width;
+            int x = 0;
+            // The vector kernels need a full 3x3 neighbourhood
+            if (y > 0 && y < shape.height - 1 && shape.width > 2) {
+                out[0] = spatial_pixel(src, shape, 0, y, delta_);
+                x = 1;
+                switch (simd_level_) {
+#if CPU_X86
+                case SimdLevel::Avx2:
+                    x = spatial_row_avx2(src, shape, y, delta_, out, x);
+                    break;
+                case SimdLevel::Sse41:
+                    x = spatial_row_sse41(src, shape, y, delta_, out, x);
+                    break;
+#endif
+                default:
+                    break;
+                }
+            }
+            for (; x < shape.width; x++) {
+                out[x] = spatial_pixel(src, shape, x, y, delta_);
+            }
+        }
+    });
+}
@@ -0,0 +1,180 @@
+#include "stream_client.hpp"
+#include "logger.hpp"
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define LOG_COMPONENT "stream"
+
+StreamClient::StreamClient() : StreamClient(Config()) {
+}
+
+StreamClient::StreamClient(const Config& config)
+    : config_(config), fd_(-1), image_sequence_(0), image_width_(0), image_height_(0) {
+}
+
+StreamClient::~StreamClient() {
+    close();
+}
+
+bool StreamClient::connect() {
+    close();
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    std::string port = std::to_string(config_.port);
+    int error = getaddrinfo(config_.host.c_str(), port.c_str(), &hints, &addresses);
+    if (error != 0) {
+        LOG_ERROR("Failed to resolve %s: %s", config_.host.c_str(), gai_strerror(error));
+        return false;
+    }
+    for (addrinfo* address = addresses; address; address = address->ai_next) {
+        fd_ = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd_ < 0) {
+            continue;
+        }
+        if (::connect(fd_, address->ai_addr, address->ai_addrlen) == 0) {
+            break;
+        }
+        ::close(fd_);
+        fd_ = -1;
+    }
+    freeaddrinfo(addresses);
+    if (fd_ < 0) {
+        LOG_DEBUG("Failed to connect to %s:%d", config_.host.c_str(), config_.port);
+        return false;
+    }
+    int one = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    StreamHello hello{};
+    hello.magic = StreamProtocol::HELLO_MAGIC;
+    hello.version = StreamProtocol::VERSION;
+    hello.codec = static_cast<uint16_t>(config_.codec);
+    hello.decimation = static_cast<uint16_t>(config_.decimation);
+    hello.queue_frames = static_cast<uint16_t>(config_.queue_frames);
+    hello.flags = config_.delta ? StreamProtocol::HELLO_DELTA : 0;
+    if (send(fd_, &hello, sizeof(hello), MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof(hello))) {
+        LOG_ERROR("Failed to send hello to %s:%d", config_.host.c_str(), config_.port);
+        close();
+        return false;
+    }
+    return true;
+}
+
+void StreamClient::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    // A new connection starts from a keyframe
+    image_.clear();
+}
+
+bool StreamClient::is_connected() const {
+    return fd_ >= 0;
+}
+
+bool StreamClient::read_fully(void* data, size_t size) {
+    uint8_t* bytes = static_cast<uint8_t*>(data);
+    while (size > 0) {
+        ssize_t received = recv(fd_, bytes, size, 0);
+        if (received <= 0) {
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += received;
+        size -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+bool StreamClient::receive(std::vector<uint16_t>& depth, FrameInfo& info, unsigned int timeout_ms) {
+    for (;;) {
+        if (fd_ < 0) {
+            return false;
+        }
+        pollfd descriptor{fd_, POLLIN, 0};
+        int ready = poll(&descriptor, 1, static_cast<int>(timeout_ms));
+        if (ready == 0 || (ready < 0 && errno == EINTR)) {
+            return false;
+        }
+
+        StreamFrameHeader header;
+        if (ready < 0 || !read_fully(&header, sizeof(header))) {
+            LOG_INFO("Connection to %s:%d closed", config_.host.c_str(), config_.port);
+            close();
+            return false;
+        }
+        RecordCodec codec = static_cast<RecordCodec>(header.codec);
+        bool delta = (header.flags & StreamProtocol::FRAME_DELTA) != 0;
+        if (header.magic != StreamProtocol::FRAME_MAGIC || header.width == 0 || header.height == 0 ||
+            header.raw_size != static_cast<size_t>(header.width) * header.height * sizeof(uint16_t) ||
+            (codec == RecordCodec::Raw && !delta && header.size != header.raw_size) ||
+            header.size > DepthCodec::max_encoded_size(header.width, header.height)) {
+            LOG_ERROR("Malformed frame header from %s:%d", config_.host.c_str(), config_.port);
+            close();
+            return false;
+        }
+        int width = static_cast<int>(header.width);
+        int height = static_cast<int>(header.height);
+
+        bool ok;
+        if (codec == RecordCodec::Raw && !delta) {
+            depth.resize(header.raw_size / sizeof(uint16_t));
+            ok = read_fully(depth.data(), header.size);
+        } else {
+            payload_.resize(header.size);
+            ok = read_fully(payload_.data(), header.size);
+            if (ok && !delta) {
+                depth.resize(header.raw_size / sizeof(uint16_t));
+                ok = codec_.decode(payload_.data(), header.size, depth.data(), width, height);
+            }
+        }
+        if (ok && delta) {
+            if (image_.empty() || header.base_sequence != image_sequence_ || width != image_width_ ||
+                height != image_height_) {
+                LOG_DEBUG("Skipping delta frame %llu until the next keyframe",
+                          static_cast<unsigned long long>(header.sequence));
+                image_.clear();
+                continue;
+            }
+            ok = delta_decoder_.apply(payload_.data(), header.size, codec, codec_, image_.data(), width, height);
+            if (ok) {
+                depth = image_;
+            }
+        } else if (ok && config_.delta) {
+            image_ = depth;
+        }
+        if (!ok) {
+            LOG_ERROR("Failed to receive frame %llu from %s:%d", static_cast<unsigned long long>(header.sequence),
+                      config_.host.c_str(), config_.port);
+            close();
+            return false;
+        }
+        image_sequence_ = header.sequence;
+        image_width_ = width;
+        image_height_ = height;
+
+        info.width = width;
+        info.height = height;
+        info.codec = codec;
+        info.delta = delta;
+        info.wire_size = sizeof(header) + header.size;
+        info.sequence = header.sequence;
+        info.timestamp_ns = header.timestamp_ns;
+        info.queued_ns = header.queued_ns;
+        info.device_timestamp = header.device_timestamp;
+        info.dropped = header.dropped;
+        return true;
+    }
+}
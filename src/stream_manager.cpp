@@ -0,0 +1,296 @@
+#include "stream_manager.hpp"
+#include "logger.hpp"
+#include "hid_protocol.hpp"
+#include "thread_affinity.hpp"
+#include <algorithm>
+#include <cstring>
+
+#define LOG_COMPONENT "streams"
+
+StreamManager::Stream::Stream(const StreamConfig& config)
+    : config(config), mailbox(FrameMailbox::Policy::DropOldest), assembler(config.frame_size) {
+    assembler.set_statistics(config.kind == StreamKind::Depth);
+}
+
+StreamManager::StreamManager() : StreamManager(Config()) {
+}
+
+StreamManager::StreamManager(const Config& config)
+    : config_(config), events_(nullptr), imu_ring_(config.imu_capacity), running_(false), device_lost_(false) {
+}
+
+StreamManager::~StreamManager() {
+    stop();
+    Metrics::instance().remove(this);
+}
+
+const char* StreamManager::name(StreamKind kind) {
+    switch (kind) {
+    case StreamKind::Depth:
+        return "depth";
+    case StreamKind::Color:
+        return "color";
+    case StreamKind::Imu:
+        return "imu";
+    }
+    return "unknown";
+}
+
+bool StreamManager::add_stream(const StreamConfig& config) {
+    int index = static_cast<int>(config.kind);
+    if (running_ || event_thread_.joinable()) {
+        LOG_ERROR("Cannot add the %s stream while streaming", name(config.kind));
+        return false;
+    }
+    if (streams_[index]) {
+        LOG_ERROR("There already is a %s stream", name(config.kind));
+        return false;
+    }
+    bool video = config.kind != StreamKind::Imu;
+    if (!config.backend || config.transfer_size == 0 || config.queue_depth <= 0 ||
+        (video && (config.frame_size == 0 || config.frame_count <= 0))) {
+        LOG_ERROR("Invalid %s stream configuration", name(config.kind));
+        return false;
+    }
+
+    auto stream = std::make_unique<Stream>(config);
+    // Video buffers hold a whole payload or a whole frame, whichever is
+    // larger, so single-payload frames go downstream in the transfer buffer
+    size_t capacity = video ? std::max(config.transfer_size, config.frame_size) : config.transfer_size;
+    size_t count = config.queue_depth + (video ? config.frame_count : 0);
+    FrameMemory::Options memory = config_.memory;
+    if (memory.any() && memory.numa_node < 0) {
+        memory.numa_node = ThreadAffinity::numa_node(config_.cpu);
+    }
+    stream->pool = std::make_unique<FramePool>(count, capacity, memory);
+
+    UsbCaptureEngine::Config engine_config;
+    engine_config.transfer_size = config.transfer_size;
+    engine_config.queue_depth = config.queue_depth;
+    engine_config.pool = stream->pool.get();
+    engine_config.metrics_prefix = config_.metrics_prefix + name(config.kind) + "_";
+    engine_config.on_device_lost = [this] { on_device_lost(); };
+    engine_config.event_thread = false;
+    stream->engine = std::make_unique<UsbCaptureEngine>(*config.backend, engine_config);
+
+    streams_[index] = std::move(stream);
+    register_metrics(*streams_[index]);
+    if (!events_) {
+        events_ = config.backend;
+    }
+    return true;
+}
+
+bool StreamManager::has_stream(StreamKind kind) const {
+    return streams_[static_cast<int>(kind)] != nullptr;
+}
+
+void StreamManager::register_metrics(Stream& stream) {
+    Metrics& metrics = Metrics::instance();
+    std::string prefix = config_.metrics_prefix + name(stream.config.kind) + "_";
+    if (stream.config.kind == StreamKind::Imu) {
+        metrics.add(this, prefix + "samples_total", "IMU samples decoded", Metrics::Kind::Counter,
+                    [&stream] { return static_cast<double>(stream.samples.load(std::memory_order_relaxed)); });
+        metrics.add(this, prefix + "overruns_total", "IMU samples dropped for a consumer a whole ring behind",
+                    Metrics::Kind::Counter, [this] { return static_cast<double>(imu_ring_.stats().overruns); });
+        return;
+    }
+    metrics.add(this, prefix + "frames_total", "Frames assembled and published", Metrics::Kind::Counter,
+                [&stream] { return static_cast<double>(stream.frames.load(std::memory_order_relaxed)); });
+    metrics.add(this, prefix + "frames_torn_total", "Frames lost to missing, short or corrupt payloads",
+                Metrics::Kind::Counter,
+                [&stream] { return static_cast<double>(stream.assembler.stats().torn_frames); });
+    if (stream.assembler.statistics()) {
+        metrics.add(this, prefix + "frames_repeated_total", "Frames identical to the one before, as from a stuck sensor",
+                    Metrics::Kind::Counter,
+                    [&stream] { return static_cast<double>(stream.assembler.stats().repeated_frames); });
+    }
+    metrics.add(this, prefix + "frames_overwritten_total",
+                "Frames replaced in the mailbox before the consumer took them", Metrics::Kind::Counter,
+                [&stream] { return static_cast<double>(stream.mailbox.stats().dropped); });
+}
+
+bool StreamManager::start() {
+    if (event_thread_.joinable()) {
+        return true;
+    }
+    if (!events_) {
+        LOG_ERROR("No streams to start");
+        return false;
+    }
+
+    imu_ring_.clear();
+    device_lost_ = false;
+    running_ = true;
+    for (std::unique_ptr<Stream>& stream : streams_) {
+        if (!stream) {
+            continue;
+        }
+        stream->assembler.reset();
+        stream->mailbox.reopen();
+        Stream* target = stream.get();
+        UsbCaptureEngine::PayloadCallback on_payload;
+        if (stream->config.kind == StreamKind::Imu) {
+            on_payload = [this, target](Frame& payload) { on_imu_payload(*target, payload); };
+        } else {
+            on_payload = [this, target](Frame& payload) { on_video_payload(*target, payload); };
+        }
+        if (!stream->engine->start(std::move(on_payload))) {
+            LOG_ERROR("Failed to start the %s stream", name(stream->config.kind));
+            // Those already started have reads in flight, which only an
+            // event loop can reap
+            event_thread_ = std::thread(&StreamManager::event_loop, this);
+            stop();
+            return false;
+        }
+    }
+
+    event_thread_ = std::thread(&StreamManager::event_loop, this);
+    return true;
+}
+
+void StreamManager::stop() {
+    if (!event_thread_.joinable()) {
+        return;
+    }
+
+    running_ = false;
+    // Consumers waiting for a frame give up; the event thread reaps every
+    // cancelled read before it exits
+    for (std::unique_ptr<Stream>& stream : streams_) {
+        if (stream) {
+            stream->mailbox.close();
+            stream->engine->cancel();
+        }
+    }
+    event_thread_.join();
+
+    for (std::unique_ptr<Stream>& stream : streams_) {
+        if (stream) {
+            stream->engine->stop();
+            stream->assembler.reset();
+            stream->mailbox.reopen();
+        }
+    }
+}
+
+bool StreamManager::is_running() const {
+    return running_;
+}
+
+void StreamManager::event_loop() {
+    ThreadAffinity::pin_current_thread(config_.cpu);
+    ThreadAffinity::set_realtime_priority(config_.priority);
+    for (;;) {
+        bool active = false;
+        bool starved = false;
+        for (std::unique_ptr<Stream>& stream : streams_) {
+            if (stream) {
+                active = active || stream->engine->is_running() || stream->engine->in_flight() > 0;
+                starved = starved || stream->engine->starved();
+            }
+        }
+        if (!active) {
+            break;
+        }
+
+        // One call services the reads of every stream
+        events_->handle_events(starved ? 1 : 100);
+        for (std::unique_ptr<Stream>& stream : streams_) {
+            if (stream) {
+                stream->engine->poll();
+            }
+        }
+    }
+}
+
+void StreamManager::on_device_lost() {
+    // Every stream's reads fail the same way; report it once
+    if (!device_lost_.exchange(true)) {
+        LOG_ERROR("Device disconnected, stopping all streams");
+        if (config_.on_device_lost) {
+            config_.on_device_lost();
+        }
+    }
+}
+
+void StreamManager::on_video_payload(Stream& stream, Frame& payload) {
+    // Runs on the event thread
+    Frame frame;
+    if (!stream.assembler.add(payload, *stream.pool, frame)) {
+        return;
+    }
+    frame.metadata().assembled_ns = monotonic_ns();
+    frame.metadata().sequence = stream.sequence++;
+    stream.frames.fetch_add(1, std::memory_order_relaxed);
+    stream.mailbox.publish(std::move(frame));
+}
+
+void StreamManager::on_imu_payload(Stream& stream, Frame& payload) {
+    // A read may carry several reports; the buffer is reused afterwards
+    const uint8_t* data = payload.data();
+    size_t size = payload.size();
+    size_t offset = 0;
+    for (; offset + sizeof(ImuHidReport) <= size; offset += sizeof(ImuHidReport)) {
+        ImuHidReport report;
+        memcpy(&report, data + offset, sizeof(report));
+        if (report.report_id != ImuHid::ACCEL_REPORT && report.report_id != ImuHid::GYRO_REPORT) {
+            stream.invalid_reports.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        ImuSample sample;
+        sample.timestamp_ns = payload.metadata().timestamp_ns;
+        sample.device_timestamp_us = report.timestamp_us;
+        sample.x = report.x;
+        sample.y = report.y;
+        sample.z = report.z;
+        sample.sensor = report.report_id == ImuHid::ACCEL_REPORT ? ImuSensor::Accel : ImuSensor::Gyro;
+        imu_ring_.push(sample);
+        stream.samples.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (offset < size) {
+        stream.invalid_reports.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool StreamManager::get_frame(StreamKind kind, Frame& frame, unsigned int timeout_ms) {
+    Stream* stream = streams_[static_cast<int>(kind)].get();
+    if (!stream || kind == StreamKind::Imu) {
+        LOG_ERROR("No %s frames to get", name(kind));
+        return false;
+    }
+    return timeout_ms == 0 ? stream->mailbox.try_consume(frame) : stream->mailbox.consume(frame, timeout_ms);
+}
+
+size_t StreamManager::read_imu(ImuSample* samples, size_t max_samples, unsigned int timeout_ms) {
+    return timeout_ms == 0 ? imu_ring_.try_read(samples, max_samples)
+                           : imu_ring_.read(samples, max_samples, timeout_ms);
+}
+
+StreamManager::Stats StreamManager::stats(StreamKind kind) const {
+    Stats stats;
+    const Stream* stream = streams_[static_cast<int>(kind)].get();
+    if (!stream) {
+        return stats;
+    }
+    stats.transfers = stream->engine->stats();
+    stats.assembly = stream->assembler.stats();
+    stats.frames = stream->frames.load(std::memory_order_relaxed);
+    stats.samples = stream->samples.load(std::memory_order_relaxed);
+    stats.invalid_reports = stream->invalid_reports.load(std::memory_order_relaxed);
+    return stats;
+}
+
+FramePool::Stats StreamManager::pool_stats(StreamKind kind) const {
+    const Stream* stream = streams_[static_cast<int>(kind)].get();
+    return stream ? stream->pool->stats() : FramePool::Stats();
+}
+
+FrameMailbox::Stats StreamManager::mailbox_stats(StreamKind kind) const {
+    const Stream* stream = streams_[static_cast<int>(kind)].get();
+    return stream ? stream->mailbox.stats() : FrameMailbox::Stats();
+}
+
+ImuSampleRing::Stats StreamManager::imu_stats() const {
+    return imu_ring_.stats();
+}
@@ -0,0 +1,64 @@
+#include "stream_profile.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+std::string StreamProfile::to_string() const {
+    char text[32];
+    snprintf(text, sizeof(text), "%dx%d@%d", width, height, fps);
+    return text;
+}
+
+bool StreamProfile::parse(const std::string& text, StreamProfile& profile) {
+    int width = 0;
+    int height = 0;
+    int fps = profile.fps;
+    char end = 0;
+    int fields = sscanf(text.c_str(), "%dx%d@%d%c", &width, &height, &fps, &end);
+    if ((fields != 2 && fields != 3) || width <= 0 || height <= 0 || fps <= 0) {
+        return false;
+    }
+    profile.width = width;
+    profile.height = height;
+    profile.fps = fps;
+    return true;
+}
+
+const std::vector<StreamProfile>& StreamProfile::table() {
+    static const std::vector<StreamProfile> profiles = {
+        {1280, 720, 6}, {1280, 720, 15}, {1280, 720, 30},
+        {848, 480, 6}, {848, 480, 15}, {848, 480, 30}, {848, 480, 60}, {848, 480, 90},
+        {640, 480, 6}, {640, 480, 15}, {640, 480, 30}, {640, 480, 60}, {640, 480, 90},
+        {640, 360, 6}, {640, 360, 15}, {640, 360, 30}, {640, 360, 60}, {640, 360, 90},
+        {480, 270, 6}, {480, 270, 15}, {480, 270, 30}, {480, 270, 60}, {480, 270, 90}, {480, 270, 300},
+        {424, 240, 6}, {424, 240, 15}, {424, 240, 30}, {424, 240, 60}, {424, 240, 90},
+        {256, 144, 90}, {256, 144, 300},
+        {848, 100, 100}, {848, 100, 300},
+    };
+    return profiles;
+}
+
+bool StreamProfile::closest(const std::vector<StreamProfile>& offered, const StreamProfile& requested,
+                            StreamProfile& chosen) {
+    const StreamProfile* best = nullptr;
+    long long best_size = 0;
+    int best_rate = 0;
+    for (const StreamProfile& profile : offered) {
+        // Any other resolution ranks behind the requested one, even at the same pixel count
+        bool same = profile.width == requested.width && profile.height == requested.height;
+        long long size = same ? 0 : llabs(static_cast<long long>(profile.pixels()) -
+                                          static_cast<long long>(requested.pixels())) + 1;
+        int rate = abs(profile.fps - requested.fps);
+        // Ties go to the faster mode
+        if (!best || size < best_size || (size == best_size && rate < best_rate) ||
+            (size == best_size && rate == best_rate && profile.fps > best->fps)) {
+            best = &profile;
+            best_size = size;
+            best_rate = rate;
+        }
+    }
+    if (!best) {
+        return false;
+    }
+    chosen = *best;
+    return true;
+}
@@ -0,0 +1,663 @@
+#include "stream_server.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#define LOG_COMPONENT "stream"
+
+StreamServer::StreamServer() : StreamServer(Config()) {
+}
+
+StreamServer::StreamServer(const Config& config)
+    : config_(config), listen_fd_(-1), epoll_fd_(-1), event_fd_(-1), port_(0), running_(false),
+      pool_(static_cast<size_t>(std::max(config.pool_frames, 2)),
+            DepthCodec::max_encoded_size(config.width, config.height)),
+      streaming_clients_(0), distributed_(0), decimate_by_2_(2), decimate_by_4_(4),
+      published_(0), ingest_dropped_(0), sent_(0), dropped_(0), bytes_(0), keyframes_(0), delta_frames_(0),
+      delta_saved_bytes_(0) {
+}
+
+StreamServer::~StreamServer() {
+    stop();
+}
+
+bool StreamServer::is_running() const {
+    return running_;
+}
+
+int StreamServer::port() const {
+    return port_;
+}
+
+bool StreamServer::publish(const Frame& frame) {
+    if (!running_ || streaming_clients_.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+    size_t image_size = static_cast<size_t>(config_.width) * config_.height * sizeof(uint16_t);
+    if (frame.size() != image_size) {
+        LOG_ERROR("Frame of %zu bytes is not a %dx%d image", frame.size(), config_.width, config_.height);
+        return false;
+    }
+
+    // One copy into a buffer the server owns: the caller's frame may be
+    // filtered in place or recycled as soon as this returns
+    Frame copy = pool_.acquire();
+    if (!copy) {
+        ingest_dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    std::memcpy(copy.storage(), frame.data(), image_size);
+    copy.set_data(0, image_size);
+    copy.metadata() = frame.metadata();
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        if (pending_) {
+            ingest_dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+        pending_ = std::move(copy);
+    }
+    published_.fetch_add(1, std::memory_order_relaxed);
+#ifdef __linux__
+    uint64_t one = 1;
+    ssize_t written = write(event_fd_, &one, sizeof(one));
+    (void)written;
+#endif
+    return true;
+}
+
+std::vector<StreamServer::ClientInfo> StreamServer::clients() const {
+    std::vector<ClientInfo> result;
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    for (const auto& client : clients_) {
+        ClientInfo info;
+        info.peer = client->peer;
+        info.decimation = client->decimation;
+        info.codec = client->codec;
+        info.delta = client->delta;
+        info.sent = client->sent.load(std::memory_order_relaxed);
+        info.dropped = client->dropped.load(std::memory_order_relaxed);
+        info.bytes = client->bytes.load(std::memory_order_relaxed);
+        info.queued = client->queued.load(std::memory_order_relaxed);
+        result.push_back(info);
+    }
+    return result;
+}
+
+StreamServer::Stats StreamServer::stats() const {
+    Stats stats;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        stats.clients = clients_.size();
+    }
+    stats.published = published_.load(std::memory_order_relaxed);
+    stats.ingest_dropped = ingest_dropped_.load(std::memory_order_relaxed);
+    stats.sent = sent_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    stats.bytes = bytes_.load(std::memory_order_relaxed);
+    stats.keyframes = keyframes_.load(std::memory_order_relaxed);
+    stats.delta_frames = delta_frames_.load(std::memory_order_relaxed);
+    stats.delta_saved_bytes = delta_saved_bytes_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void StreamServer::register_metrics() {
+    Metrics& metrics = Metrics::instance();
+    auto counter = [&](const char* name, const char* help, const std::atomic<uint64_t>& value) {
+        metrics.add(this, name, help, Metrics::Kind::Counter,
+                    [&value] { return static_cast<double>(value.load(std::memory_order_relaxed)); });
+    };
+    counter("stream_frames_published_total", "Frames handed to the streaming server", published_);
+    counter("stream_frames_ingest_dropped_total", "Frames the streaming server had no buffer or time for",
+            ingest_dropped_);
+    counter("stream_frames_sent_total", "Frames sent to streaming clients, summed over clients", sent_);
+    counter("stream_frames_dropped_total", "Frames dropped from full client queues", dropped_);
+    counter("stream_bytes_sent_total", "Bytes sent to streaming clients", bytes_);
+    counter("stream_keyframes_sent_total", "Keyframes sent to delta streaming clients", keyframes_);
+    counter("stream_delta_frames_sent_total", "Delta frames sent to streaming clients", delta_frames_);
+    counter("stream_delta_saved_bytes_total", "Bytes delta frames saved against sending keyframes",
+            delta_saved_bytes_);
+    metrics.add(this, "stream_clients", "Connected streaming clients", Metrics::Kind::Gauge,
+                [this] { return static_cast<double>(stats().clients); });
+}
+
+#ifdef __linux__
+
+bool StreamServer::start() {
+    if (running_) {
+        return true;
+    }
+
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        LOG_ERROR("Failed to create socket: %s", std::strerror(errno));
+        return false;
+    }
+    int one = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(config_.port));
+    if (inet_pton(AF_INET, config_.address.c_str(), &address.sin_addr) != 1) {
+        LOG_ERROR("Invalid listen address %s", config_.address.c_str());
+        stop();
+        return false;
+    }
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listen_fd_, 16) != 0) {
+        LOG_ERROR("Failed to listen on %s:%d: %s", config_.address.c_str(), config_.port, std::strerror(errno));
+        stop();
+        return false;
+    }
+    socklen_t length = sizeof(address);
+    getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &length);
+    port_ = ntohs(address.sin_port);
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd_ < 0 || event_fd_ < 0) {
+        LOG_ERROR("Failed to create epoll instance: %s", std::strerror(errno));
+        stop();
+        return false;
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = &listen_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event);
+    event.data.ptr = &event_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, event_fd_, &event);
+
+    running_ = true;
+    register_metrics();
+    thread_ = std::thread(&StreamServer::event_loop, this);
+    LOG_INFO("Streaming %dx%d depth on %s:%d", config_.width, config_.height, config_.address.c_str(), port_);
+    return true;
+}
+
+void StreamServer::stop() {
+    if (running_) {
+        running_ = false;
+        uint64_t one = 1;
+        ssize_t written = write(event_fd_, &one, sizeof(one));
+        (void)written;
+        thread_.join();
+        Metrics::instance().remove(this);
+    }
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        for (const auto& client : clients_) {
+            close(client->fd);
+        }
+        clients_.clear();
+    }
+    streaming_clients_ = 0;
+    variants_.clear();
+    delta_streams_.clear();
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        pending_.reset();
+    }
+    for (int* fd : {&listen_fd_, &epoll_fd_, &event_fd_}) {
+        if (*fd >= 0) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+void StreamServer::event_loop() {
+    epoll_event events[MAX_EVENTS];
+    while (running_) {
+        int count = epoll_wait(epoll_fd_, events, MAX_EVENTS, 1000);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("epoll_wait failed: %s", std::strerror(errno));
+            break;
+        }
+
+        // Clients dropped while handling this batch are closed after it, so
+        // no event below refers to a freed client
+        for (int i = 0; i < count && running_; i++) {
+            void* tag = events[i].data.ptr;
+            if (tag == &listen_fd_) {
+                accept_clients();
+            } else if (tag == &event_fd_) {
+                uint64_t value;
+                ssize_t result = read(event_fd_, &value, sizeof(value));
+                (void)result;
+                Frame frame;
+                {
+                    std::lock_guard<std::mutex> lock(pending_mutex_);
+                    frame = std::move(pending_);
+                }
+                if (frame) {
+                    distribute(std::move(frame));
+                }
+            } else {
+                Client& client = *static_cast<Client*>(tag);
+                if (client.fd < 0) {
+                    continue;
+                }
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    drop_client(client);
+                    continue;
+                }
+                if (events[i].events & EPOLLIN) {
+                    read_client(client);
+                }
+                if (client.fd >= 0 && (events[i].events & EPOLLOUT)) {
+                    flush_client(client);
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        clients_.erase(std::remove_if(clients_.begin(), clients_.end(),
+                                      [](const std::unique_ptr<Client>& client) { return client->fd < 0; }),
+                       clients_.end());
+    }
+}
+
+void StreamServer::accept_clients() {
+    for (;;) {
+        sockaddr_in address{};
+        socklen_t length = sizeof(address);
+        int fd = accept4(listen_fd_, reinterpret_cast<sockaddr*>(&address), &length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                LOG_WARN("accept failed: %s", std::strerror(errno));
+            }
+            return;
+        }
+        char host[INET_ADDRSTRLEN] = "";
+        inet_ntop(AF_INET, &address.sin_addr, host, sizeof(host));
+        std::string peer = std::string(host) + ":" + std::to_string(ntohs(address.sin_port));
+
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        if (static_cast<int>(clients_.size()) >= config_.max_clients) {
+            LOG_WARN("Refusing %s: already serving %d clients", peer.c_str(), config_.max_clients);
+            close(fd);
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        int buffer = SEND_BUFFER;
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+
+        std::unique_ptr<Client> client(new Client());
+        client->fd = fd;
+        client->peer = peer;
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.ptr = client.get();
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close(fd);
+            continue;
+        }
+        clients_.push_back(std::move(client));
+        LOG_INFO("Client %s connected", peer.c_str());
+    }
+}
+
+void StreamServer::read_client(Client& client) {
+    uint8_t buffer[256];
+    for (;;) {
+        ssize_t received = recv(client.fd, buffer, sizeof(buffer), 0);
+        if (received == 0) {
+            drop_client(client);
+            return;
+        }
+        if (received < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                drop_client(client);
+            }
+            return;
+        }
+        if (client.streaming) {
+            continue;   // Nothing more is expected from the client
+        }
+
+        size_t take = std::min(static_cast<size_t>(received), sizeof(StreamHello) - client.hello_received);
+        std::memcpy(reinterpret_cast<uint8_t*>(&client.hello) + client.hello_received, buffer, take);
+        client.hello_received += take;
+        if (client.hello_received < sizeof(StreamHello)) {
+            continue;
+        }
+
+        const StreamHello& hello = client.hello;
+        RecordCodec codec = static_cast<RecordCodec>(hello.codec);
+        if (hello.magic != StreamProtocol::HELLO_MAGIC || hello.version != StreamProtocol::VERSION ||
+            (hello.decimation != 1 && hello.decimation != 2 && hello.decimation != 4) ||
+            (codec != RecordCodec::Raw && codec != RecordCodec::Lossless)) {
+            LOG_WARN("Client %s sent an invalid hello", client.peer.c_str());
+            drop_client(client);
+            return;
+        }
+        client.decimation = hello.decimation;
+        client.codec = codec;
+        client.delta = (hello.flags & StreamProtocol::HELLO_DELTA) != 0;
+        if (client.delta) {
+            client.need_keyframe = true;
+            request_keyframe(client.decimation);
+        }
+        client.queue_limit = static_cast<size_t>(config_.queue_frames);
+        if (hello.queue_frames > 0) {
+            client.queue_limit = std::min(client.queue_limit, static_cast<size_t>(hello.queue_frames));
+        }
+        client.queue_limit = std::max<size_t>(client.queue_limit, 1);
+        client.streaming = true;
+        streaming_clients_.fetch_add(1, std::memory_order_relaxed);
+        LOG_INFO("Client %s streaming, decimation %d, %s%s", client.peer.c_str(), client.decimation,
+                 codec == RecordCodec::Lossless ? "lossless" : "raw", client.delta ? ", deltas" : "");
+    }
+}
+
+void StreamServer::drop_client(Client& client) {
+    if (client.fd < 0) {
+        return;
+    }
+    LOG_INFO("Client %s disconnected after %llu frames, %llu dropped", client.peer.c_str(),
+             static_cast<unsigned long long>(client.sent.load()),
+             static_cast<unsigned long long>(client.dropped.load()));
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, client.fd, nullptr);
+    close(client.fd);
+    client.fd = -1;
+    client.queue.clear();
+    client.queued = 0;
+    if (client.streaming) {
+        streaming_clients_.fetch_sub(1, std::memory_order_relaxed);
+        client.streaming = false;
+    }
+}
+
+void StreamServer::set_want_write(Client& client, bool want) {
+    if (client.want_write == want) {
+        return;
+    }
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLRDHUP | (want ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    event.data.ptr = &client;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, client.fd, &event);
+    client.want_write = want;
+}
+
+void StreamServer::distribute(Frame frame) {
+    // Room for every decimation, codec and delta combination, so pointers
+    // to the variants stay valid while more are made
+    variants_.clear();
+    variants_.reserve(12);
+    distributed_++;
+    uint64_t now = monotonic_ns();
+    for (const auto& pointer : clients_) {
+        Client& client = *pointer;
+        if (client.fd < 0 || !client.streaming) {
+            continue;
+        }
+        const Variant* prepared = variant(frame, client.decimation, client.codec, client.delta);
+        if (!prepared) {
+            client.dropped.fetch_add(1, std::memory_order_relaxed);
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            if (client.delta) {
+                client.need_keyframe = true;
+                request_keyframe(client.decimation);
+            }
+            continue;
+        }
+
+        bool is_delta = (prepared->flags & StreamProtocol::FRAME_DELTA) != 0;
+        if (client.queue.size() >= client.queue_limit && !(client.need_keyframe && is_delta)) {
+            drop_oldest(client);
+        }
+        if (client.need_keyframe && is_delta) {
+            // Of no use without the frames before it
+            client.dropped.fetch_add(1, std::memory_order_relaxed);
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        client.need_keyframe = false;
+
+        Queued queued;
+        queued.frame = prepared->frame;
+        queued.saved = prepared->saved;
+        StreamFrameHeader& header = queued.header;
+        std::memset(&header, 0, sizeof(header));
+        header.magic = StreamProtocol::FRAME_MAGIC;
+        header.codec = static_cast<uint16_t>(prepared->codec);
+        header.flags = prepared->flags;
+        header.width = static_cast<uint32_t>(prepared->width);
+        header.height = static_cast<uint32_t>(prepared->height);
+        header.size = static_cast<uint32_t>(prepared->frame.size());
+        header.raw_size = static_cast<uint32_t>(static_cast<size_t>(prepared->width) * prepared->height *
+                                                sizeof(uint16_t));
+        header.sequence = frame.metadata().sequence;
+        header.timestamp_ns = frame.metadata().timestamp_ns;
+        header.queued_ns = now;
+        header.device_timestamp = frame.metadata().device_timestamp;
+        header.dropped = static_cast<uint32_t>(client.dropped.load(std::memory_order_relaxed));
+        header.base_sequence = prepared->base_sequence;
+        client.queue.push_back(std::move(queued));
+        client.queued.store(client.queue.size(), std::memory_order_relaxed);
+        flush_client(client);
+    }
+    // Prepared copies stay alive only through the client queues
+    variants_.clear();
+}
+
+void StreamServer::drop_oldest(Client& client) {
+    // The oldest frame not already on its way
+    size_t victim = client.front_sent > 0 ? 1 : 0;
+    if (victim >= client.queue.size()) {
+        return;
+    }
+    size_t end = victim + 1;
+    if (client.delta) {
+        // Deltas queued after it have lost their base; a keyframe has not
+        while (end < client.queue.size() && (client.queue[end].header.flags & StreamProtocol::FRAME_DELTA)) {
+            end++;
+        }
+        if (end == client.queue.size()) {
+            client.need_keyframe = true;
+            request_keyframe(client.decimation);
+        }
+    }
+    client.queue.erase(client.queue.begin() + victim, client.queue.begin() + end);
+    client.dropped.fetch_add(end - victim, std::memory_order_relaxed);
+    dropped_.fetch_add(end - victim, std::memory_order_relaxed);
+}
+
+const StreamServer::Variant* StreamServer::variant(const Frame& frame, int decimation, RecordCodec codec,
+                                                   bool delta) {
+    for (const Variant& existing : variants_) {
+        if (existing.decimation == decimation && existing.codec == codec && existing.delta == delta) {
+            return &existing;
+        }
+    }
+    if (delta) {
+        return delta_variant(frame, decimation, codec);
+    }
+
+    Variant made{decimation, codec, false, Frame(), config_.width, config_.height};
+    if (decimation == 1 && codec == RecordCodec::Raw) {
+        made.frame = frame;
+    } else if (codec == RecordCodec::Raw) {
+        DecimationFilter& filter = decimation == 2 ? decimate_by_2_ : decimate_by_4_;
+        filter.configure(config_.width, config_.height);
+        made.width = filter.out_width();
+        made.height = filter.out_height();
+        made.frame = pool_.acquire();
+        if (!made.frame) {
+            return nullptr;
+        }
+        filter.process_rows(reinterpret_cast<const uint16_t*>(frame.data()),
+                            reinterpret_cast<uint16_t*>(made.frame.storage()), 0, made.height);
+        made.frame.set_data(0, static_cast<size_t>(made.width) * made.height * sizeof(uint16_t));
+    } else {
+        const Variant* raw = variant(frame, decimation, RecordCodec::Raw, false);
+        if (!raw) {
+            return nullptr;
+        }
+        made.width = raw->width;
+        made.height = raw->height;
+        size_t size = codec_.encode(reinterpret_cast<const uint16_t*>(raw->frame.data()), raw->width,
+                                    raw->height, encoded_);
+        made.frame = pool_.acquire();
+        if (!made.frame) {
+            return nullptr;
+        }
+        std::memcpy(made.frame.storage(), encoded_.data(), size);
+        made.frame.set_data(0, size);
+    }
+    variants_.push_back(std::move(made));
+    return &variants_.back();
+}
+
+const StreamServer::Variant* StreamServer::delta_variant(const Frame& frame, int decimation, RecordCodec codec) {
+    const Variant* raw = variant(frame, decimation, RecordCodec::Raw, false);
+    if (!raw) {
+        return nullptr;
+    }
+    DeltaStream* stream = delta_stream(decimation);
+    if (!stream) {
+        delta_streams_.emplace_back(new DeltaStream(decimation, config_.delta));
+        stream = delta_streams_.back().get();
+        stream->encoder.configure(raw->width, raw->height);
+        stream->keyframe_size[static_cast<int>(RecordCodec::Raw)] = raw->frame.size();
+    }
+    // Once per frame, however many kinds of client want deltas of it
+    if (stream->distributed != distributed_) {
+        stream->distributed = distributed_;
+        stream->base_sequence = stream->sequence;
+        stream->sequence = frame.metadata().sequence;
+        stream->delta = stream->encoder.update(reinterpret_cast<const uint16_t*>(raw->frame.data()));
+    }
+
+    Variant made{decimation, codec, true, Frame(), raw->width, raw->height};
+    size_t& keyframe_size = stream->keyframe_size[static_cast<int>(codec)];
+    if (!stream->delta) {
+        const Variant* whole = codec == RecordCodec::Raw ? raw : variant(frame, decimation, codec, false);
+        if (!whole) {
+            return nullptr;
+        }
+        made.frame = whole->frame;
+        made.flags = StreamProtocol::FRAME_KEYFRAME;
+        keyframe_size = whole->frame.size();
+    } else {
+        size_t size = stream->encoder.write_delta(codec, codec_, encoded_);
+        made.frame = pool_.acquire();
+        if (!made.frame) {
+            return nullptr;
+        }
+        std::memcpy(made.frame.storage(), encoded_.data(), size);
+        made.frame.set_data(0, size);
+        made.flags = StreamProtocol::FRAME_DELTA;
+        made.base_sequence = stream->base_sequence;
+        made.saved = keyframe_size > size ? keyframe_size - size : 0;
+    }
+    variants_.push_back(std::move(made));
+    return &variants_.back();
+}
+
+StreamServer::DeltaStream* StreamServer::delta_stream(int decimation) {
+    for (const auto& stream : delta_streams_) {
+        if (stream->decimation == decimation) {
+            return stream.get();
+        }
+    }
+    return nullptr;
+}
+
+void StreamServer::request_keyframe(int decimation) {
+    // A stream not made yet starts with a keyframe anyway
+    DeltaStream* stream = delta_stream(decimation);
+    if (stream) {
+        stream->encoder.request_keyframe();
+    }
+}
+
+void StreamServer::flush_client(Client& client) {
+    while (!client.queue.empty()) {
+        // Everything queued, as far as fits in one send
+        iovec vectors[MAX_IOVECS];
+        int count = 0;
+        size_t skip = client.front_sent;
+        for (size_t i = 0; i < client.queue.size() && count + 2 <= MAX_IOVECS; i++) {
+            Queued& queued = client.queue[i];
+            uint8_t* parts[2] = {reinterpret_cast<uint8_t*>(&queued.header), queued.frame.data()};
+            size_t sizes[2] = {sizeof(queued.header), queued.frame.size()};
+            for (int part = 0; part < 2; part++) {
+                if (skip >= sizes[part]) {
+                    skip -= sizes[part];
+                    continue;
+                }
+                vectors[count].iov_base = parts[part] + skip;
+                vectors[count].iov_len = sizes[part] - skip;
+                count++;
+                skip = 0;
+            }
+        }
+
+        msghdr message{};
+        message.msg_iov = vectors;
+        message.msg_iovlen = count;
+        ssize_t sent = sendmsg(client.fd, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                set_want_write(client, true);
+            } else if (errno != EINTR) {
+                drop_client(client);
+            }
+            return;
+        }
+        client.bytes.fetch_add(sent, std::memory_order_relaxed);
+        bytes_.fetch_add(sent, std::memory_order_relaxed);
+
+        // Retire the frames that went out completely
+        size_t remaining = client.front_sent + static_cast<size_t>(sent);
+        while (!client.queue.empty()) {
+            size_t frame_bytes = sizeof(StreamFrameHeader) + client.queue.front().frame.size();
+            if (remaining < frame_bytes) {
+                break;
+            }
+            remaining -= frame_bytes;
+            const Queued& front = client.queue.front();
+            if (front.header.flags & StreamProtocol::FRAME_DELTA) {
+                delta_frames_.fetch_add(1, std::memory_order_relaxed);
+                delta_saved_bytes_.fetch_add(front.saved, std::memory_order_relaxed);
+            } else if (front.header.flags & StreamProtocol::FRAME_KEYFRAME) {
+                keyframes_.fetch_add(1, std::memory_order_relaxed);
+            }
+            client.queue.pop_front();
+            client.sent.fetch_add(1, std::memory_order_relaxed);
+            sent_.fetch_add(1, std::memory_order_relaxed);
+        }
+        client.front_sent = remaining;
+        client.queued.store(client.queue.size(), std::memory_order_relaxed);
+    }
+    set_want_write(client, false);
+}
+
+#else
+
+bool StreamServer::start() {
+    LOG_ERROR("The streaming server needs epoll and is only available on Linux");
+    return false;
+}
+
+void StreamServer::stop() {
+}
+
+#endif
@@ -0,0 +1,173 @@
+#include "depth_filter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if CPU_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+struct TemporalParams {
+    int alpha;
+    int delta;
+    int persistence;   // 0 = off
+};
+
+void temporal_scalar(uint16_t* depth, uint16_t* previous, uint8_t* history, int count, const TemporalParams& params) {
+    for (int i = 0; i < count; i++) {
+        uint16_t current = depth[i];
+        uint16_t last = previous[i];
+        uint8_t seen = static_cast<uint8_t>(history[i] << 1 | (current != 0));
+        uint16_t out;
+        if (current) {
+            int diff = current - last;
+            if (last && std::abs(diff) <= params.delta) {
+                out = static_cast<uint16_t>(last + ((diff * params.alpha) >> 8));
+            } else {
+                out = current;
+            }
+            previous[i] = out;
+        } else {
+            bool keep = params.persistence > 0 && last && __builtin_popcount(seen) >= params.persistence;
+            out = keep ? last : 0;
+        }
+        history[i] = seen;
+        depth[i] = out;
+    }
+}
+
+#if CPU_X86
+
+TARGET_SSE41 int temporal_sse41(uint16_t* depth, uint16_t* previous, uint8_t* history, int count,
+                                const TemporalParams& params) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i byte_mask = _mm_set1_epi32(0xff);
+    const __m128i nibble_mask = _mm_set1_epi32(0x0f);
+    const __m128i nibble_bits = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m128i alpha = _mm_set1_epi32(params.alpha);
+    const __m128i delta_limit = _mm_set1_epi32(params.delta + 1);
+    // Persistence off: a threshold no popcount can reach
+    const __m128i persistence = _mm_set1_epi32(params.persistence > 0 ? params.persistence - 1 : 8);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i current = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(depth + i)));
+        __m128i last = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(previous + i)));
+        int history_bytes;
+        memcpy(&history_bytes, history + i, sizeof(history_bytes));
+        __m128i seen = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(history_bytes));
+
+        __m128i valid = _mm_cmpgt_epi32(current, zero);
+        __m128i had_last = _mm_cmpgt_epi32(last, zero);
+        seen = _mm_or_si128(_mm_and_si128(_mm_slli_epi32(seen, 1), byte_mask), _mm_and_si128(valid, one));
+
+        __m128i diff = _mm_sub_epi32(current, last);
+        __m128i smooth = _mm_and_si128(had_last, _mm_cmpgt_epi32(delta_limit, _mm_abs_epi32(diff)));
+        __m128i average = _mm_add_epi32(last, _mm_srai_epi32(_mm_mullo_epi32(diff, alpha), 8));
+        __m128i filtered = _mm_blendv_epi8(current, average, smooth);
+
+        __m128i bits = _mm_add_epi32(_mm_shuffle_epi8(nibble_bits, _mm_and_si128(seen, nibble_mask)),
+                                     _mm_shuffle_epi8(nibble_bits, _mm_srli_epi32(seen, 4)));
+        __m128i keep = _mm_and_si128(had_last, _mm_cmpgt_epi32(bits, persistence));
+        __m128i out = _mm_blendv_epi8(_mm_and_si128(last, keep), filtered, valid);
+        __m128i next = _mm_blendv_epi8(last, filtered, valid);
+
+        __m128i out16 = _mm_packus_epi32(out, out);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(depth + i), out16);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(previous + i), _mm_packus_epi32(next, next));
+        __m128i seen16 = _mm_packus_epi32(seen, seen);
+        history_bytes = _mm_cvtsi128_si32(_mm_packus_epi16(seen16, seen16));
+        memcpy(history + i, &history_bytes, sizeof(history_bytes));
+    }
+    return i;
+}
+
+TARGET_AVX2 int temporal_avx2(uint16_t* depth, uint16_t* previous, uint8_t* history, int count,
+                              const TemporalParams& params) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i byte_mask = _mm256_set1_epi32(0xff);
+    const __m256i nibble_mask = _mm256_set1_epi32(0x0f);
+    const __m256i nibble_bits = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i alpha = _mm256_set1_epi32(params.alpha);
+    const __m256i delta_limit = _mm256_set1_epi32(params.delta + 1);
+    const __m256i persistence = _mm256_set1_epi32(params.persistence > 0 ? params.persistence - 1 : 8);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i current = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(depth + i)));
+        __m256i last = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + i)));
+        __m256i seen = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(history + i)));
+
+        __m256i valid = _mm256_cmpgt_epi32(current, zero);
+        __m256i had_last = _mm256_cmpgt_epi32(last, zero);
+        seen = _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi32(seen, 1), byte_mask), _mm256_and_si256(valid, one));
+
+        __m256i diff = _mm256_sub_epi32(current, last);
+        __m256i smooth = _mm256_and_si256(had_last, _mm256_cmpgt_epi32(delta_limit, _mm256_abs_epi32(diff)));
+        __m256i average = _mm256_add_epi32(last, _mm256_srai_epi32(_mm256_mullo_epi32(diff, alpha), 8));
+        __m256i filtered = _mm256_blendv_epi8(current, average, smooth);
+
+        __m256i bits = _mm256_add_epi32(_mm256_shuffle_epi8(nibble_bits, _mm256_and_si256(seen, nibble_mask)),
+                                        _mm256_shuffle_epi8(nibble_bits, _mm256_srli_epi32(seen, 4)));
+        __m256i keep = _mm256_and_si256(had_last, _mm256_cmpgt_epi32(bits, persistence));
+        __m256i out = _mm256_blendv_epi8(_mm256_and_si256(last, keep), filtered, valid);
+        __m256i next = _mm256_blendv_epi8(last, filtered, valid);
+
+        // packus works per 128-bit lane; gather the low quadwords back together
+        __m128i out16 = _mm256_castsi256_si128(_mm256_permute4x64_epi64(_mm256_packus_epi32(out, out), 0x08));
+        __m128i next16 = _mm256_castsi256_si128(_mm256_permute4x64_epi64(_mm256_packus_epi32(next, next), 0x08));
+        __m128i seen16 = _mm256_castsi256_si128(_mm256_permute4x64_epi64(_mm256_packus_epi32(seen, seen), 0x08));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(depth + i), out16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(previous + i), next16);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(history + i), _mm_packus_epi16(seen16, seen16));
+    }
+    return i;
+}
+
+#endif
+
+}  // namespace
+
+TemporalFilter::TemporalFilter(float alpha, uint16_t delta, int persistence)
+    : alpha_(std::min(std::max(static_cast<int>(std::lround(alpha * 256.0f)), 1), 256)),
+      delta_(delta), persistence_(std::min(std::max(persistence, 0), 8)) {
+}
+
+void TemporalFilter::configure(int width, int height) {
+    DepthFilter::configure(width, height);
+    previous_.assign(static_cast<size_t>(width) * height, 0);
+    history_.assign(static_cast<size_t>(width) * height, 0);
+}
+
+void TemporalFilter::reset() {
+    std::fill(previous_.begin(), previous_.end(), 0);
+    std::fill(history_.begin(), history_.end(), 0);
+}
+
+void TemporalFilter::process_rows(const uint16_t*, uint16_t* dst, int first_row, int last_row) {
+    const TemporalParams params = {alpha_, delta_, persistence_};
+    const size_t offset = static_cast<size_t>(first_row) * width_;
+    const int count = (last_row - first_row) * width_;
+    uint16_t* depth = dst + offset;
+    uint16_t* previous = previous_.data() + offset;
+    uint8_t* history = history_.data() + offset;
+
+    // Pixels are independent, so the whole row range is one run
+    int done = 0;
+    switch (simd_level_) {
+#if CPU_X86
+    case SimdLevel::Avx2:
+        done = temporal_avx2(depth, previous, history, count, params);
+        break;
+    case SimdLevel::Sse41:
+        done = temporal_sse41(depth, previous, history, count, params);
+        break;
+#endif
+    default:
+        break;
+    }
+    temporal_scalar(depth + done, previous + done, history + done, count - done, params);
+}
@@ -0,0 +1,92 @@
+#include "thread_affinity.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#define LOG_COMPONENT "affinity"
+
+int ThreadAffinity::cpu_count() {
+#ifdef __linux__
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        return CPU_COUNT(&set);
+    }
+#endif
+    unsigned int count = std::thread::hardware_concurrency();
+    return count > 0 ? static_cast<int>(count) : 1;
+}
+
+bool ThreadAffinity::pin_current_thread(int cpu) {
+    if (cpu < 0) {
+        return true;
+    }
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (result != 0) {
+        LOG_WARN("Failed to pin thread to CPU %d: %s", cpu, std::strerror(result));
+        return false;
+    }
+    return true;
+#else
+    LOG_DEBUG("Thread pinning is not supported here, CPU %d ignored", cpu);
+    return false;
+#endif
+}
+
+bool ThreadAffinity::set_realtime_priority(int priority) {
+    if (priority <= 0) {
+        return true;
+    }
+#ifdef __linux__
+    sched_param param;
+    param.sched_priority = std::min(priority, sched_get_priority_max(SCHED_FIFO));
+    int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (result != 0) {
+        LOG_WARN("Failed to run thread SCHED_FIFO at priority %d (needs CAP_SYS_NICE or RLIMIT_RTPRIO): %s",
+                 param.sched_priority, std::strerror(result));
+        return false;
+    }
+    return true;
+#else
+    LOG_DEBUG("Real-time scheduling is not supported here, priority %d ignored", priority);
+    return false;
+#endif
+}
+
+int ThreadAffinity::numa_node(int cpu) {
+    if (cpu < 0) {
+        return -1;
+    }
+#ifdef __linux__
+    // The CPU's sysfs directory links to its node as "node<N>"
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+        return -1;
+    }
+    int node = -1;
+    while (dirent* entry = readdir(dir)) {
+        if (strncmp(entry->d_name, "node", 4) == 0 && isdigit(static_cast<unsigned char>(entry->d_name[4]))) {
+            node = atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+#else
+    return -1;
+#endif
+}
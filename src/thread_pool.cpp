@@ -0,0 +1,143 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+
+namespace {
+
+uint64_t pack_range(uint64_t begin, uint64_t end) {
+    return end << 32 | begin;
+}
+
+}  // namespace
+
+ThreadPool::ThreadPool(int threads)
+    : generation_(0), active_workers_(0), stopping_(false), fn_(nullptr), context_(nullptr) {
+    if (threads <= 0) {
+        threads = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+    }
+    ranges_.reset(new TaskRange[threads]);
+    for (int i = 1; i < threads; i++) {
+        workers_.emplace_back(&ThreadPool::worker_loop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+int ThreadPool::size() const {
+    return static_cast<int>(workers_.size()) + 1;
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::run_tasks(size_t tasks, TaskFn fn, void* context) {
+    if (tasks == 0) {
+        return;
+    }
+    if (workers_.empty() || tasks == 1) {
+        for (size_t task = 0; task < tasks; task++) {
+            fn(context, task);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> run_lock(run_mutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fn_ = fn;
+        context_ = context;
+        size_t threads = static_cast<size_t>(size());
+        for (size_t i = 0; i < threads; i++) {
+            ranges_[i].bounds.store(pack_range(tasks * i / threads, tasks * (i + 1) / threads),
+                                    std::memory_order_relaxed);
+        }
+        active_workers_ = static_cast<int>(workers_.size());
+        generation_++;
+    }
+    wake_.notify_all();
+
+    execute(0);
+
+    // Every worker has to check out of this job before the next one can
+    // reuse fn_ and the task ranges.
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return active_workers_ == 0; });
+}
+
+void ThreadPool::execute(int slot) {
+    std::atomic<uint64_t>& own = ranges_[slot].bounds;
+    for (;;) {
+        uint64_t bounds = own.load(std::memory_order_acquire);
+        uint32_t begin = static_cast<uint32_t>(bounds);
+        uint32_t end = static_cast<uint32_t>(bounds >> 32);
+        size_t task = begin;
+        if (begin < end) {
+            if (!own.compare_exchange_weak(bounds, pack_range(begin + 1, end), std::memory_order_acq_rel)) {
+                continue;
+            }
+        } else if (!steal(slot, task)) {
+            // Everything left is already running somewhere
+            return;
+        }
+        fn_(context_, task);
+    }
+}
+
+// Takes the back half, rounded up, of the first other range with tasks
+// left: the first of them to run here, the rest in this thread's range for
+// others to steal from in turn. A single stolen task is never put back, and
+// ranges only ever shrink or split, so a range a thief read cannot come back
+// with the same bounds and fool its compare-and-swap.
+bool ThreadPool::steal(int slot, size_t& task) {
+    int threads = size();
+    for (int i = 1; i < threads; i++) {
+        std::atomic<uint64_t>& victim = ranges_[(slot + i) % threads].bounds;
+        uint64_t bounds = victim.load(std::memory_order_acquire);
+        for (;;) {
+            uint32_t begin = static_cast<uint32_t>(bounds);
+            uint32_t end = static_cast<uint32_t>(bounds >> 32);
+            if (begin >= end) {
+                break;
+            }
+            uint32_t split = end - (end - begin + 1) / 2;
+            if (victim.compare_exchange_weak(bounds, pack_range(begin, split), std::memory_order_acq_rel,
+                                             std::memory_order_acquire)) {
+                ranges_[slot].bounds.store(pack_range(split + 1, end), std::memory_order_release);
+                task = split;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void ThreadPool::worker_loop(int slot) {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+            if (stopping_) {
+                return;
+            }
+            seen = generation_;
+        }
+
+        execute(slot);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--active_workers_ == 0) {
+            done_.notify_one();
+        }
+    }
+}
@@ -0,0 +1,207 @@
+#include "tile_diff.hpp"
+#include <algorithm>
+#include <cstring>
+
+#if CPU_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr int TILE = TileDiff::TILE_SIZE;
+
+bool differs_scalar(const uint16_t* a, const uint16_t* b, int count, uint16_t threshold) {
+    for (int i = 0; i < count; i++) {
+        int delta = a[i] - b[i];
+        if (delta > threshold || -delta > threshold) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// One image row: flags the tiles it finds a change in, skipping tiles
+// already known to be dirty
+void diff_row_scalar(const uint16_t* a, const uint16_t* b, int width, uint16_t threshold, uint8_t* dirty) {
+    for (int x = 0, tile = 0; x < width; x += TILE, tile++) {
+        if (!dirty[tile]) {
+            dirty[tile] = differs_scalar(a + x, b + x, std::min(TILE, width - x), threshold);
+        }
+    }
+}
+
+#if CPU_X86
+
+// |a - b| > threshold, as saturating subtractions: the larger of a - b and
+// b - a is the distance, and whatever is left after taking the threshold
+// off is the excess
+TARGET_SSE41 __m128i excess_sse41(const uint16_t* a, const uint16_t* b, __m128i limit) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+    __m128i distance = _mm_or_si128(_mm_subs_epu16(va, vb), _mm_subs_epu16(vb, va));
+    return _mm_subs_epu16(distance, limit);
+}
+
+TARGET_SSE41 void diff_row_sse41(const uint16_t* a, const uint16_t* b, int width, uint16_t threshold,
+                                 uint8_t* dirty) {
+    __m128i limit = _mm_set1_epi16(static_cast<short>(threshold));
+    int full = width / TILE;
+    for (int tile = 0; tile < full; tile++) {
+        if (dirty[tile]) {
+            continue;
+        }
+        const uint16_t* ta = a + tile * TILE;
+        const uint16_t* tb = b + tile * TILE;
+        __m128i excess = _mm_or_si128(_mm_or_si128(excess_sse41(ta, tb, limit), excess_sse41(ta + 8, tb + 8, limit)),
+                                      _mm_or_si128(excess_sse41(ta + 16, tb + 16, limit),
+                                                   excess_sse41(ta + 24, tb + 24, limit)));
+        dirty[tile] = !_mm_testz_si128(excess, excess);
+    }
+    diff_row_scalar(a + full * TILE, b + full * TILE, width - full * TILE, threshold, dirty + full);
+}
+
+TARGET_AVX2 __m256i excess_avx2(const uint16_t* a, const uint16_t* b, __m256i limit) {
+    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+    __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+    __m256i distance = _mm256_or_si256(_mm256_subs_epu16(va, vb), _mm256_subs_epu16(vb, va));
+    return _mm256_subs_epu16(distance, limit);
+}
+
+TARGET_AVX2 void diff_row_avx2(const uint16_t* a, const uint16_t* b, int width, uint16_t threshold,
+                               uint8_t* dirty) {
+    __m256i limit = _mm256_set1_epi16(static_cast<short>(threshold));
+    int full = width / TILE;
+    for (int tile = 0; tile < full; tile++) {
+        if (dirty[tile]) {
+            continue;
+        }
+        const uint16_t* ta = a + tile * TILE;
+        const uint16_t* tb = b + tile * TILE;
+        __m256i excess = _mm256_or_si256(excess_avx2(ta, tb, limit), excess_avx2(ta + 16, tb + 16, limit));
+        dirty[tile] = !_mm256_testz_si256(excess, excess);
+    }
+    diff_row_scalar(a + full * TILE, b + full * TILE, width - full * TILE, threshold, dirty + full);
+}
+
+#endif
+
+}  // namespace
+
+TileDiff::TileDiff()
+    : simd_level_(CpuFeatures::simd_level()), threshold_(0), width_(0), height_(0), tiles_x_(0), tiles_y_(0),
+      valid_(false) {
+}
+
+void TileDiff::set_simd_level(SimdLevel level) {
+    simd_level_ = CpuFeatures::clamp(level);
+}
+
+SimdLevel TileDiff::simd_level() const {
+    return simd_level_;
+}
+
+void TileDiff::set_threshold(uint16_t threshold) {
+    threshold_ = threshold;
+}
+
+uint16_t TileDiff::threshold() const {
+    return threshold_;
+}
+
+void TileDiff::configure(int width, int height) {
+    width_ = width;
+    height_ = height;
+    tiles_x_ = (width + TILE - 1) / TILE;
+    tiles_y_ = (height + TILE - 1) / TILE;
+    reference_.assign(static_cast<size_t>(width) * height, 0);
+    valid_ = false;
+}
+
+int TileDiff::width() const {
+    return width_;
+}
+
+int TileDiff::height() const {
+    return height_;
+}
+
+int TileDiff::tiles_x() const {
+    return tiles_x_;
+}
+
+int TileDiff::tiles_y() const {
+    return tiles_y_;
+}
+
+size_t TileDiff::tile_count() const {
+    return static_cast<size_t>(tiles_x_) * tiles_y_;
+}
+
+void TileDiff::invalidate() {
+    valid_ = false;
+}
+
+void TileDiff::set_reference(const uint16_t* image) {
+    std::memcpy(reference_.data(), image, reference_.size() * sizeof(uint16_t));
+    valid_ = true;
+}
+
+size_t TileDiff::update(const uint16_t* image, std::vector<uint8_t>& mask) {
+    if (!valid_) {
+        mask.assign(tile_count(), 1);
+        set_reference(image);
+        return tile_count();
+    }
+
+    mask.assign(tile_count(), 0);
+    size_t dirty_count = 0;
+    for (int ty = 0; ty < tiles_y_; ty++) {
+        uint8_t* dirty = mask.data() + static_cast<size_t>(ty) * tiles_x_;
+        int y_begin = ty * TILE;
+        int y_end = std::min(y_begin + TILE, height_);
+
+        // Row by row through the band of tiles, streaming through memory;
+        // a tile stops being looked at once it is found dirty
+        for (int y = y_begin; y < y_end; y++) {
+            const uint16_t* a = image + static_cast<size_t>(y) * width_;
+            const uint16_t* b = reference_.data() + static_cast<size_t>(y) * width_;
+            switch (simd_level_) {
+#if CPU_X86
+            case SimdLevel::Avx2:
+                diff_row_avx2(a, b, width_, threshold_, dirty);
+                break;
+            case SimdLevel::Sse41:
+                diff_row_sse41(a, b, width_, threshold_, dirty);
+                break;
+#endif
+            default:
+                diff_row_scalar(a, b, width_, threshold_, dirty);
+                break;
+            }
+        }
+
+        // Bring the reference up to date, one copy per run of dirty tiles
+        for (int tx = 0; tx < tiles_x_;) {
+            if (!dirty[tx]) {
+                tx++;
+                continue;
+            }
+            int run_begin = tx;
+            while (tx < tiles_x_ && dirty[tx]) {
+                tx++;
+            }
+            dirty_count += tx - run_begin;
+            int x = run_begin * TILE;
+            size_t bytes = static_cast<size_t>(std::min(tx * TILE, width_) - x) * sizeof(uint16_t);
+            for (int y = y_begin; y < y_end; y++) {
+                size_t offset = static_cast<size_t>(y) * width_ + x;
+                std::memcpy(reference_.data() + offset, image + offset, bytes);
+            }
+        }
+    }
+    return dirty_count;
+}
+
+const uint16_t* TileDiff::reference() const {
+    return reference_.data();
+}
@@ -0,0 +1,465 @@
+#include "tsdf_volume.hpp"
+#include "metrics.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+constexpr int B = TsdfVolume::BLOCK_SIZE;
+constexpr float SDF_SCALE = 32767.0f;
+// A voxel moving less than this, in quantized truncations, does not make
+// its block count as changed: a settled surface under sensor noise stays
+// quiet instead of being extracted again every frame
+constexpr int CHANGE_THRESHOLD = 512;
+// Samples along each ray when finding the blocks its truncation band crosses
+constexpr int MAX_RAY_SAMPLES = 16;
+
+// Block coordinates of 21 bits each, offset to be non-negative
+constexpr int64_t COORD_OFFSET = int64_t(1) << 20;
+constexpr int64_t COORD_LIMIT = int64_t(1) << 21;
+
+bool block_key(int64_t x, int64_t y, int64_t z, uint64_t& key) {
+    x += COORD_OFFSET;
+    y += COORD_OFFSET;
+    z += COORD_OFFSET;
+    if (x < 0 || y < 0 || z < 0 || x >= COORD_LIMIT || y >= COORD_LIMIT || z >= COORD_LIMIT) {
+        return false;
+    }
+    key = static_cast<uint64_t>(x) << 42 | static_cast<uint64_t>(y) << 21 | static_cast<uint64_t>(z);
+    return true;
+}
+
+TsdfVolume::BlockCoord block_coord(uint64_t key) {
+    const uint64_t mask = COORD_LIMIT - 1;
+    return {static_cast<int32_t>(static_cast<int64_t>(key >> 42 & mask) - COORD_OFFSET),
+            static_cast<int32_t>(static_cast<int64_t>(key >> 21 & mask) - COORD_OFFSET),
+            static_cast<int32_t>(static_cast<int64_t>(key & mask) - COORD_OFFSET)};
+}
+
+size_t hash_key(uint64_t key) {
+    return static_cast<size_t>((key * 0x9e3779b97f4a7c15ull) >> 32);
+}
+
+}  // namespace
+
+TsdfVolume::TsdfVolume(const CameraIntrinsics& intrinsics, const Config& config)
+    : intrinsics_(intrinsics), config_(config), pool_(config.pool ? config.pool : &ThreadPool::shared()),
+      block_extent_(config.voxel_size * BLOCK_SIZE), table_(1024, Entry{NO_KEY, NO_BLOCK}), table_used_(0),
+      block_count_(0), frame_(0), pass_(0), frames_(0), integrate_ns_(0), blocks_(0), pool_bytes_(0),
+      blocks_dropped_(0), last_blocks_(0) {
+    ray_x_.resize(intrinsics.width);
+    for (int u = 0; u < intrinsics.width; u++) {
+        ray_x_[u] = (u - intrinsics.ppx) / intrinsics.fx;
+    }
+    ray_y_.resize(intrinsics.height);
+    for (int v = 0; v < intrinsics.height; v++) {
+        ray_y_[v] = (v - intrinsics.ppy) / intrinsics.fy;
+    }
+    band_keys_.resize((intrinsics.height + ROWS_PER_BAND - 1) / ROWS_PER_BAND);
+
+    Metrics& metrics = Metrics::instance();
+    auto add = [&](const char* name, const char* help, Metrics::Kind kind, const std::atomic<uint64_t>& value) {
+        metrics.add(this, name, help, kind,
+                    [&value] { return static_cast<double>(value.load(std::memory_order_relaxed)); });
+    };
+    add("tsdf_frames_total", "Depth frames fused into the TSDF volume", Metrics::Kind::Counter, frames_);
+    add("tsdf_blocks", "Voxel blocks allocated in the TSDF volume", Metrics::Kind::Gauge, blocks_);
+    add("tsdf_pool_bytes", "Memory of the TSDF block pool", Metrics::Kind::Gauge, pool_bytes_);
+    add("tsdf_blocks_dropped_total", "TSDF block allocations refused for lack of pool", Metrics::Kind::Counter,
+        blocks_dropped_);
+}
+
+TsdfVolume::~TsdfVolume() {
+    Metrics::instance().remove(this);
+}
+
+const CameraIntrinsics& TsdfVolume::intrinsics() const {
+    return intrinsics_;
+}
+
+const TsdfVolume::Config& TsdfVolume::config() const {
+    return config_;
+}
+
+TsdfVolume::Block& TsdfVolume::block(uint32_t index) const {
+    return chunks_[index / BLOCKS_PER_CHUNK][index % BLOCKS_PER_CHUNK];
+}
+
+uint32_t TsdfVolume::find(uint64_t key) const {
+    size_t mask = table_.size() - 1;
+    for (size_t slot = hash_key(key) & mask;; slot = (slot + 1) & mask) {
+        const Entry& entry = table_[slot];
+        if (entry.key == key) {
+            return entry.block;
+        }
+        if (entry.key == NO_KEY) {
+            return NO_BLOCK;
+        }
+    }
+}
+
+uint32_t TsdfVolume::find(int64_t x, int64_t y, int64_t z) const {
+    uint64_t key;
+    return block_key(x, y, z, key) ? find(key) : NO_BLOCK;
+}
+
+uint32_t TsdfVolume::find_or_allocate(uint64_t key) {
+    // Half full at most, so probes stay short
+    if ((table_used_ + 1) * 2 > table_.size()) {
+        grow_table();
+    }
+    size_t mask = table_.size() - 1;
+    for (size_t slot = hash_key(key) & mask;; slot = (slot + 1) & mask) {
+        Entry& entry = table_[slot];
+        if (entry.key == key) {
+            return entry.block;
+        }
+        if (entry.key != NO_KEY) {
+            continue;
+        }
+
+        if (block_count_ >= config_.max_blocks) {
+            return NO_BLOCK;
+        }
+        uint32_t index = block_count_++;
+        if (index / BLOCKS_PER_CHUNK >= chunks_.size()) {
+            chunks_.emplace_back(new Block[BLOCKS_PER_CHUNK]);
+            pool_bytes_.store(chunks_.size() * BLOCKS_PER_CHUNK * sizeof(Block), std::memory_order_relaxed);
+        }
+        Block& fresh = block(index);
+        std::fill(fresh.voxels, fresh.voxels + BLOCK_VOXELS, Voxel{static_cast<int16_t>(SDF_SCALE), 0});
+        fresh.coord = block_coord(key);
+        fresh.frame = 0;
+        fresh.pass = 0;
+        fresh.changed = false;
+        fresh.queued = false;
+        entry.key = key;
+        entry.block = index;
+        table_used_++;
+        blocks_.store(block_count_, std::memory_order_relaxed);
+        return index;
+    }
+}
+
+void TsdfVolume::grow_table() {
+    std::vector<Entry> old(table_.size() * 2, Entry{NO_KEY, NO_BLOCK});
+    old.swap(table_);
+    size_t mask = table_.size() - 1;
+    for (const Entry& entry : old) {
+        if (entry.key == NO_KEY) {
+            continue;
+        }
+        size_t slot = hash_key(entry.key) & mask;
+        while (table_[slot].key != NO_KEY) {
+            slot = (slot + 1) & mask;
+        }
+        table_[slot] = entry;
+    }
+}
+
+// Blocks that the truncation band around this band of rows' surface points
+// passes through, sorted and without repeats
+void TsdfVolume::collect_band(const uint16_t* depth, const CameraPose& camera_to_world, size_t band) {
+    std::vector<uint64_t>& keys = band_keys_[band];
+    keys.clear();
+
+    // Samples at most half a block apart, from the near to the far end of
+    // the band, rarely step over a block
+    float band_length = 2.0f * config_.truncation;
+    int samples = std::min(static_cast<int>(std::ceil(band_length / (0.5f * block_extent_))) + 1, MAX_RAY_SAMPLES);
+    float step = samples > 1 ? band_length / (samples - 1) : 0.0f;
+    // Neighbouring pixels mostly hit the same blocks: repeats of what the
+    // same sample of the pixel before hit are dropped straight away
+    uint64_t last_keys[MAX_RAY_SAMPLES];
+    std::fill(last_keys, last_keys + samples, NO_KEY);
+
+    const float* r = camera_to_world.rotation;
+    const float* t = camera_to_world.translation;
+    float inverse_extent = 1.0f / block_extent_;
+    int width = intrinsics_.width;
+    int first_row = static_cast<int>(band) * ROWS_PER_BAND;
+    int last_row = std::min(first_row + ROWS_PER_BAND, intrinsics_.height);
+    for (int v = first_row; v < last_row; v++) {
+        const uint16_t* row = depth + static_cast<size_t>(v) * width;
+        for (int u = 0; u < width; u++) {
+            float depth_m = row[u] * config_.depth_scale;
+            if (row[u] == 0 || depth_m < config_.min_depth || depth_m > config_.max_depth) {
+                continue;
+            }
+            // World direction of the ray, per metre of camera z
+            float ray[3] = {ray_x_[u], ray_y_[v], 1.0f};
+            float direction[3];
+            for (int i = 0; i < 3; i++) {
+                direction[i] = r[i * 3 + 0] * ray[0] + r[i * 3 + 1] * ray[1] + r[i * 3 + 2] * ray[2];
+            }
+            for (int s = 0; s < samples; s++) {
+                float z = depth_m - config_.truncation + s * step;
+                uint64_t key;
+                if (z <= 0.0f ||
+                    !block_key(static_cast<int64_t>(std::floor((t[0] + direction[0] * z) * inverse_extent)),
+                               static_cast<int64_t>(std::floor((t[1] + direction[1] * z) * inverse_extent)),
+                               static_cast<int64_t>(std::floor((t[2] + direction[2] * z) * inverse_extent)), key) ||
+                    key == last_keys[s]) {
+                    continue;
+                }
+                last_keys[s] = key;
+                keys.push_back(key);
+            }
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+size_t TsdfVolume::integrate(const uint16_t* depth, const CameraPose& pose) {
+    auto start = std::chrono::steady_clock::now();
+    frame_++;
+
+    // Find the blocks near the surface in parallel; allocate them here,
+    // since the table is not thread-safe
+    pool_->run(band_keys_.size(), [&](size_t band) { collect_band(depth, pose, band); });
+    touched_.clear();
+    uint64_t dropped = 0;
+    for (const std::vector<uint64_t>& keys : band_keys_) {
+        for (uint64_t key : keys) {
+            uint32_t index = find_or_allocate(key);
+            if (index == NO_BLOCK) {
+                dropped++;
+                continue;
+            }
+            Block& touched = block(index);
+            if (touched.frame != frame_) {
+                touched.frame = frame_;
+                touched_.push_back(index);
+            }
+        }
+    }
+
+    // Every block is updated by exactly one task
+    CameraPose world_to_camera = pose.inverse();
+    pool_->run(touched_.size(), [&](size_t i) {
+        Block& target = block(touched_[i]);
+        target.changed = integrate_block(target, depth, world_to_camera);
+    });
+
+    size_t updated = 0;
+    for (uint32_t index : touched_) {
+        Block& touched = block(index);
+        if (!touched.changed) {
+            continue;
+        }
+        updated++;
+        if (!touched.queued) {
+            touched.queued = true;
+            changed_.push_back(index);
+        }
+    }
+
+    uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    frames_.fetch_add(1, std::memory_order_relaxed);
+    integrate_ns_.fetch_add(elapsed, std::memory_order_relaxed);
+    blocks_dropped_.fetch_add(dropped, std::memory_order_relaxed);
+    last_blocks_.store(touched_.size(), std::memory_order_relaxed);
+    return updated;
+}
+
+// Projects each voxel centre into the depth image and folds the distance
+// from it to the surface along the view axis into the voxel's average.
+// Returns whether any voxel changed enough to count.
+bool TsdfVolume::integrate_block(Block& block, const uint16_t* depth, const CameraPose& world_to_camera) const {
+    const float* r = world_to_camera.rotation;
+    float voxel = config_.voxel_size;
+    // Camera coordinates of the block's first voxel centre, and the steps to
+    // the next voxel along each world axis
+    float origin[3] = {(block.coord.x * B + 0.5f) * voxel, (block.coord.y * B + 0.5f) * voxel,
+                       (block.coord.z * B + 0.5f) * voxel};
+    float base[3];
+    world_to_camera.transform(origin, base);
+    float step_x[3] = {r[0] * voxel, r[3] * voxel, r[6] * voxel};
+    float step_y[3] = {r[1] * voxel, r[4] * voxel, r[7] * voxel};
+    float step_z[3] = {r[2] * voxel, r[5] * voxel, r[8] * voxel};
+
+    int width = intrinsics_.width;
+    int height = intrinsics_.height;
+    float inverse_truncation = 1.0f / config_.truncation;
+    bool changed = false;
+    Voxel* target = block.voxels;
+    for (int k = 0; k < B; k++) {
+        for (int j = 0; j < B; j++) {
+            float row[3];
+            for (int i = 0; i < 3; i++) {
+                row[i] = base[i] + j * step_y[i] + k * step_z[i];
+            }
+            for (int i = 0; i < B; i++, target++) {
+                float z = row[2] + i * step_x[2];
+                if (z < config_.min_depth) {
+                    continue;
+                }
+                float u = intrinsics_.fx * (row[0] + i * step_x[0]) / z + intrinsics_.ppx + 0.5f;
+                float v = intrinsics_.fy * (row[1] + i * step_x[1]) / z + intrinsics_.ppy + 0.5f;
+                if (!(u >= 0.0f && v >= 0.0f && u < width && v < height)) {
+                    continue;
+                }
+                uint16_t raw = depth[static_cast<size_t>(v) * width + static_cast<size_t>(u)];
+                float depth_m = raw * config_.depth_scale;
+                if (raw == 0 || depth_m < config_.min_depth || depth_m > config_.max_depth) {
+                    continue;
+                }
+                float distance = depth_m - z;
+                if (distance < -config_.truncation) {
+                    // Hidden behind the surface
+                    continue;
+                }
+
+                float sdf = std::min(distance * inverse_truncation, 1.0f);
+                float weight = target->weight;
+                float average = (target->sdf * weight + sdf * SDF_SCALE) / (weight + 1.0f);
+                int16_t quantized = static_cast<int16_t>(std::lrint(average));
+                changed |= target->weight == 0 || (quantized < 0) != (target->sdf < 0) ||
+                           std::abs(quantized - target->sdf) >= CHANGE_THRESHOLD;
+                target->sdf = quantized;
+                target->weight = static_cast<uint16_t>(std::min<int>(target->weight + 1, config_.max_weight));
+            }
+        }
+    }
+    return changed;
+}
+
+// Points where the distance changes sign along the edges from each voxel to
+// its next neighbour in x, y and z, which may be in the next block over.
+// Counts them if x is nullptr. Jumps of a whole truncation or more are
+// where the band around one surface meets another's, not a surface.
+size_t TsdfVolume::surface_points(const Block& block, float* x, float* y, float* z) const {
+    const BlockCoord& c = block.coord;
+    uint32_t next_blocks[3] = {find(static_cast<int64_t>(c.x) + 1, c.y, c.z),
+                               find(c.x, static_cast<int64_t>(c.y) + 1, c.z),
+                               find(c.x, c.y, static_cast<int64_t>(c.z) + 1)};
+    const Block* next[3];
+    for (int axis = 0; axis < 3; axis++) {
+        next[axis] = next_blocks[axis] == NO_BLOCK ? nullptr : &this->block(next_blocks[axis]);
+    }
+    const int strides[3] = {1, B, B * B};
+
+    float voxel = config_.voxel_size;
+    float origin[3] = {(c.x * B + 0.5f) * voxel, (c.y * B + 0.5f) * voxel, (c.z * B + 0.5f) * voxel};
+    size_t n = 0;
+    for (int k = 0; k < B; k++) {
+        for (int j = 0; j < B; j++) {
+            for (int i = 0; i < B; i++) {
+                int index = i + j * B + k * B * B;
+                const Voxel& a = block.voxels[index];
+                // Voxels a whole truncation or more from the surface, the
+                // bulk of most blocks, cannot start a crossing
+                if (a.weight == 0 || std::abs(a.sdf) >= static_cast<int>(SDF_SCALE)) {
+                    continue;
+                }
+                const int position[3] = {i, j, k};
+                for (int axis = 0; axis < 3; axis++) {
+                    const Voxel* b;
+                    if (position[axis] + 1 < B) {
+                        b = &block.voxels[index + strides[axis]];
+                    } else if (next[axis]) {
+                        b = &next[axis]->voxels[index - (B - 1) * strides[axis]];
+                    } else {
+                        continue;
+                    }
+                    if (b->weight == 0 || (a.sdf < 0) == (b->sdf < 0) ||
+                        std::abs(a.sdf - b->sdf) >= static_cast<int>(SDF_SCALE)) {
+                        continue;
+                    }
+                    if (x) {
+                        float t = static_cast<float>(a.sdf) / (a.sdf - b->sdf);
+                        x[n] = origin[0] + (i + (axis == 0 ? t : 0.0f)) * voxel;
+                        y[n] = origin[1] + (j + (axis == 1 ? t : 0.0f)) * voxel;
+                        z[n] = origin[2] + (k + (axis == 2 ? t : 0.0f)) * voxel;
+                    }
+                    n++;
+                }
+            }
+        }
+    }
+    return n;
+}
+
+size_t TsdfVolume::extract(SurfacePoints& points, bool changed_only) {
+    pass_++;
+    extracting_.clear();
+    auto list = [this](uint32_t index) {
+        Block& listed = block(index);
+        if (listed.pass != pass_) {
+            listed.pass = pass_;
+            extracting_.push_back(index);
+        }
+    };
+    if (changed_only) {
+        for (uint32_t index : changed_) {
+            list(index);
+            // The blocks below own the edges into this one
+            const BlockCoord& c = block(index).coord;
+            uint32_t below[3] = {find(static_cast<int64_t>(c.x) - 1, c.y, c.z),
+                                 find(c.x, static_cast<int64_t>(c.y) - 1, c.z),
+                                 find(c.x, c.y, static_cast<int64_t>(c.z) - 1)};
+            for (uint32_t neighbour : below) {
+                if (neighbour != NO_BLOCK) {
+                    list(neighbour);
+                }
+            }
+        }
+    } else {
+        for (uint32_t index = 0; index < block_count_; index++) {
+            list(index);
+        }
+    }
+    for (uint32_t index : changed_) {
+        block(index).queued = false;
+    }
+    changed_.clear();
+
+    // Count, then write each block's points where the counts put them
+    size_t count = extracting_.size();
+    point_counts_.resize(count);
+    pool_->run(count, [&](size_t i) {
+        point_counts_[i] = static_cast<uint32_t>(surface_points(block(extracting_[i]), nullptr, nullptr, nullptr));
+    });
+    points.blocks.resize(count);
+    points.offsets.resize(count + 1);
+    points.offsets[0] = 0;
+    for (size_t i = 0; i < count; i++) {
+        points.blocks[i] = block(extracting_[i]).coord;
+        points.offsets[i + 1] = points.offsets[i] + point_counts_[i];
+    }
+    points.count = points.offsets[count];
+    points.x.resize(points.count);
+    points.y.resize(points.count);
+    points.z.resize(points.count);
+    pool_->run(count, [&](size_t i) {
+        uint32_t offset = points.offsets[i];
+        if (point_counts_[i] == 0) {
+            return;
+        }
+        surface_points(block(extracting_[i]), points.x.data() + offset, points.y.data() + offset,
+                       points.z.data() + offset);
+    });
+    return points.count;
+}
+
+void TsdfVolume::clear() {
+    std::fill(table_.begin(), table_.end(), Entry{NO_KEY, NO_BLOCK});
+    table_used_ = 0;
+    block_count_ = 0;
+    changed_.clear();
+    blocks_.store(0, std::memory_order_relaxed);
+}
+
+TsdfVolume::Stats TsdfVolume::stats() const {
+    Stats stats;
+    stats.frames = frames_.load(std::memory_order_relaxed);
+    stats.integrate_ns = integrate_ns_.load(std::memory_order_relaxed);
+    stats.blocks = blocks_.load(std::memory_order_relaxed);
+    stats.memory_bytes = pool_bytes_.load(std::memory_order_relaxed);
+    stats.blocks_dropped = blocks_dropped_.load(std::memory_order_relaxed);
+    stats.last_blocks = last_blocks_.load(std::memory_order_relaxed);
+    return stats;
+}
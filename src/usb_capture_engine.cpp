@@ -0,0 +1,319 @@
+#include "usb_capture_engine.hpp"
+#include "logger.hpp"
+#include "thread_affinity.hpp"
+#include <algorithm>
+
+#define LOG_COMPONENT "capture"
+
+UsbCaptureEngine::UsbCaptureEngine(TransferBackend& backend, const Config& config)
+    : backend_(backend), config_(config), pool_(config.pool), parked_count_(0),
+      retry_at_ns_(0), retry_delay_ns_(0), failed_rounds_(0), halted_(false), started_(false), running_(false), in_flight_(0),
+      bytes_(0), transfers_(0), zero_length_(0), timeouts_(0), errors_(0), starved_(0),
+      transfer_latency_(Metrics::instance().histogram(
+          config.metrics_prefix + "usb_transfer", "Bulk read from submission to completion, including time queued behind other reads")) {
+    Metrics& metrics = Metrics::instance();
+    auto counter = [&](const char* name, const char* help, const std::atomic<uint64_t>& value) {
+        metrics.add(this, config_.metrics_prefix + name, help, Metrics::Kind::Counter,
+                    [&value] { return static_cast<double>(value.load(std::memory_order_relaxed)); });
+    };
+    counter("usb_bytes_total", "Bytes received from the device", bytes_);
+    counter("usb_transfers_total", "Completed transfers with data", transfers_);
+    counter("usb_zero_length_total", "Transfers that completed without data", zero_length_);
+    counter("usb_timeouts_total", "Transfers that timed out", timeouts_);
+    counter("usb_errors_total", "Failed transfers and submissions", errors_);
+    counter("usb_starved_total", "Resubmissions delayed for lack of a free buffer", starved_);
+}
+
+UsbCaptureEngine::~UsbCaptureEngine() {
+    stop();
+    Metrics::instance().remove(this);
+}
+
+bool UsbCaptureEngine::start(PayloadCallback on_payload) {
+    if (running_) {
+        return true;
+    }
+    if (config_.queue_depth <= 0 || config_.transfer_size == 0) {
+        LOG_ERROR("Invalid capture engine configuration");
+        return false;
+    }
+
+    on_payload_ = std::move(on_payload);
+
+    // All buffers come from the pool, so nothing is allocated once
+    // streaming has started.
+    if (!pool_) {
+        if (!own_pool_) {
+            FrameMemory::Options memory = config_.memory;
+            if (memory.any() && memory.numa_node < 0) {
+                memory.numa_node = ThreadAffinity::numa_node(config_.cpu);
+            }
+            own_pool_ = std::make_unique<FramePool>(config_.queue_depth, config_.transfer_size, memory);
+        }
+        pool_ = own_pool_.get();
+    }
+    requests_.assign(config_.queue_depth, TransferRequest());
+    request_frames_.assign(config_.queue_depth, Frame());
+    parked_.assign(config_.queue_depth, false);
+    parked_count_ = 0;
+    retry_at_ns_ = 0;
+    retry_delay_ns_ = 0;
+    failed_rounds_ = 0;
+    halted_ = false;
+
+    for (int i = 0; i < config_.queue_depth; i++) {
+        TransferRequest& request = requests_[i];
+        request.on_complete = &UsbCaptureEngine::on_transfer_complete;
+        request.user_data = this;
+        request.index = i;
+        if (!backend_.prepare(&request)) {
+            LOG_ERROR("Failed to prepare transfer %d", i);
+            for (int j = 0; j < i; j++) {
+                backend_.release(&requests_[j]);
+            }
+            return false;
+        }
+    }
+
+    running_ = true;
+    for (TransferRequest& request : requests_) {
+        arm(&request);
+    }
+
+    if (!running_ || in_flight_ == 0) {
+        LOG_ERROR(running_ ? "Failed to submit any transfers" : "Device disconnected while starting capture");
+        // Reap whatever did go out before the requests are released
+        cancel();
+        while (in_flight_ > 0) {
+            backend_.handle_events(100);
+        }
+        for (TransferRequest& request : requests_) {
+            backend_.release(&request);
+        }
+        request_frames_.clear();
+        return false;
+    }
+
+    started_ = true;
+    if (config_.event_thread) {
+        event_thread_ = std::thread(&UsbCaptureEngine::event_loop, this);
+    }
+    return true;
+}
+
+void UsbCaptureEngine::stop() {
+    if (!started_) {
+        return;
+    }
+
+    // The event thread keeps servicing completions until every cancelled
+    // transfer has been reaped. Without one, the owner already has.
+    cancel();
+    if (event_thread_.joinable()) {
+        event_thread_.join();
+    }
+
+    for (TransferRequest& request : requests_) {
+        backend_.release(&request);
+    }
+    request_frames_.clear();
+    started_ = false;
+}
+
+void UsbCaptureEngine::cancel() {
+    running_ = false;
+    for (TransferRequest& request : requests_) {
+        backend_.cancel(&request);
+    }
+}
+
+bool UsbCaptureEngine::is_running() const {
+    return running_;
+}
+
+UsbCaptureEngine::Stats UsbCaptureEngine::stats() const {
+    Stats stats;
+    stats.bytes = bytes_.load(std::memory_order_relaxed);
+    stats.transfers = transfers_.load(std::memory_order_relaxed);
+    stats.zero_length = zero_length_.load(std::memory_order_relaxed);
+    stats.timeouts = timeouts_.load(std::memory_order_relaxed);
+    stats.errors = errors_.load(std::memory_order_relaxed);
+    stats.starved = starved_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void UsbCaptureEngine::poll() {
+    if (parked_count_ == 0 || !running_ || monotonic_ns() < retry_at_ns_) {
+        return;
+    }
+    if (halted_) {
+        // Resubmitting to a halted endpoint only stalls again
+        halted_ = false;
+        backend_.clear_halt();
+    }
+    rearm_parked();
+}
+
+bool UsbCaptureEngine::starved() const {
+    return parked_count_ > 0;
+}
+
+int UsbCaptureEngine::in_flight() const {
+    return in_flight_;
+}
+
+void UsbCaptureEngine::on_transfer_complete(TransferRequest* request) {
+    static_cast<UsbCaptureEngine*>(request->user_data)->handle_completion(request);
+}
+
+bool UsbCaptureEngine::arm(TransferRequest* request) {
+    Frame& frame = request_frames_[request->index];
+    if (!frame) {
+        frame = pool_->acquire();
+        if (!frame) {
+            // Every buffer is held downstream; retry from the event loop
+            park(request);
+            starved_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    request->buffer = frame.storage();
+    request->length = static_cast<int>(std::min(config_.transfer_size, frame.capacity()));
+    request->actual_length = 0;
+
+    in_flight_++;
+    request->submitted_ns = monotonic_ns();
+    TransferStatus status = backend_.submit(request);
+    if (status != TransferStatus::Completed) {
+        in_flight_--;
+        if (status == TransferStatus::NoDevice) {
+            // Gone between a completion and its resubmission
+            device_lost();
+        } else {
+            // Keep the slot: retry from the event loop, as when starved
+            transfer_failed(request, status);
+        }
+        return false;
+    }
+    return true;
+}
+
+void UsbCaptureEngine::park(TransferRequest* request) {
+    if (!parked_[request->index]) {
+        parked_[request->index] = true;
+        parked_count_++;
+    }
+}
+
+void UsbCaptureEngine::rearm_parked() {
+    for (size_t i = 0; i < parked_.size() && parked_count_ > 0 && running_; i++) {
+        if (!parked_[i]) {
+            continue;
+        }
+        parked_[i] = false;
+        parked_count_--;
+        arm(&requests_[i]);
+    }
+}
+
+void UsbCaptureEngine::handle_completion(TransferRequest* request) {
+    in_flight_--;
+    bool resubmit = true;
+    Frame& frame = request_frames_[request->index];
+
+    switch (request->status) {
+    case TransferStatus::Completed:
+    case TransferStatus::TimedOut:
+        retry_delay_ns_ = 0;
+        failed_rounds_ = 0;
+        // A timed-out bulk transfer can still carry the packets that arrived
+        // before the deadline.
+        if (request->actual_length > 0) {
+            uint64_t now = monotonic_ns();
+            if (request->status == TransferStatus::Completed) {
+                transfer_latency_.record(now - request->submitted_ns);
+            }
+            bytes_.fetch_add(request->actual_length, std::memory_order_relaxed);
+            transfers_.fetch_add(1, std::memory_order_relaxed);
+            frame.set_data(0, request->actual_length);
+            frame.metadata().timestamp_ns = now;
+            if (on_payload_) {
+                on_payload_(frame);
+            }
+        } else if (request->status == TransferStatus::Completed) {
+            zero_length_.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (request->status == TransferStatus::TimedOut) {
+            timeouts_.fetch_add(1, std::memory_order_relaxed);
+        }
+        break;
+    case TransferStatus::Cancelled:
+        resubmit = false;
+        break;
+    case TransferStatus::NoDevice:
+        device_lost();
+        resubmit = false;
+        break;
+    default:
+        transfer_failed(request, request->status);
+        resubmit = false;
+        break;
+    }
+
+    if (resubmit && running_) {
+        arm(request);
+    }
+}
+
+// Stalls, overflows and other errors, of a transfer or its submission. The
+// request waits for the next retry round; failures until then join that
+// round. Rounds that keep failing give the device up as lost, so the owner
+// reopens it.
+void UsbCaptureEngine::transfer_failed(TransferRequest* request, TransferStatus status) {
+    errors_.fetch_add(1, std::memory_order_relaxed);
+    if (status == TransferStatus::Stall) {
+        halted_ = true;
+    }
+    park(request);
+
+    uint64_t now = monotonic_ns();
+    if (now < retry_at_ns_) {
+        return;
+    }
+    if (++failed_rounds_ > config_.max_retries) {
+        LOG_ERROR("Transfers still failing after %d retries, giving the device up", config_.max_retries);
+        device_lost();
+        for (TransferRequest& pending : requests_) {
+            backend_.cancel(&pending);
+        }
+        return;
+    }
+    retry_delay_ns_ = retry_delay_ns_ == 0 ? RETRY_MIN_NS : std::min(retry_delay_ns_ * 2, RETRY_MAX_NS);
+    retry_at_ns_ = now + retry_delay_ns_;
+    LOG_WARN("Transfer failed with status %d, retrying in %.0f ms", static_cast<int>(status),
+             retry_delay_ns_ / 1e6);
+}
+
+// Every transfer still in flight, and every resubmission, fails the same
+// way; report once. A device lost while starting fails start() instead.
+void UsbCaptureEngine::device_lost() {
+    if (!running_) {
+        return;
+    }
+    LOG_ERROR("Device disconnected, stopping capture");
+    errors_.fetch_add(1, std::memory_order_relaxed);
+    running_ = false;
+    if (started_ && config_.on_device_lost) {
+        config_.on_device_lost();
+    }
+}
+
+void UsbCaptureEngine::event_loop() {
+    ThreadAffinity::pin_current_thread(config_.cpu);
+    ThreadAffinity::set_realtime_priority(config_.priority);
+    while (running_ || in_flight_ > 0) {
+        backend_.handle_events(parked_count_ > 0 ? 1 : 100);
+        poll();
+    }
+}
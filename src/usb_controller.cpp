@@ -1,10 +1,12 @@
 #include "usb_controller.hpp"
-#include <iostream>
+#include "logger.hpp"
 
-USBController::USBController() : device_handle_(nullptr) {
+#define LOG_COMPONENT "usb"
+
+USBController::USBController() : device_handle_(nullptr), initialized_(false) {
     int result = libusb_init(nullptr);
     if (result < 0) {
-        std::cerr << "Failed to initialize libusb: " << libusb_error_name(result) << std::endl;
+        LOG_ERROR("Failed to initialize libusb: %s", libusb_error_name(result));
         return;
     }
     initialized_ = true;
@@ -19,9 +21,75 @@ USBController::~USBController() {
     }
 }
 
-bool USBController::connect_to_device(uint16_t vendor_id, uint16_t product_id) {
+std::string USBController::bus_path(libusb_device* device) {
+    uint8_t ports[8];
+    int depth = libusb_get_port_numbers(device, ports, sizeof(ports));
+    std::string path = std::to_string(libusb_get_bus_number(device));
+    for (int i = 0; i < depth; i++) {
+        path += (i == 0 ? "-" : ".") + std::to_string(ports[i]);
+    }
+    return path;
+}
+
+std::string USBController::serial_number(libusb_device* device, const libusb_device_descriptor& descriptor) {
+    if (descriptor.iSerialNumber == 0) {
+        return std::string();
+    }
+    // Reading a string descriptor needs the device open; one claimed by
+    // another process can still be opened for this
+    libusb_device_handle* handle = nullptr;
+    if (libusb_open(device, &handle) < 0) {
+        return std::string();
+    }
+    std::string serial = read_serial(handle, descriptor.iSerialNumber);
+    libusb_close(handle);
+    return serial;
+}
+
+std::string USBController::read_serial(libusb_device_handle* handle, uint8_t index) {
+    if (index == 0) {
+        return std::string();
+    }
+    unsigned char serial[128];
+    int length = libusb_get_string_descriptor_ascii(handle, index, serial, sizeof(serial));
+    return length > 0 ? std::string(reinterpret_cast<char*>(serial), length) : std::string();
+}
+
+std::vector<USBController::DeviceInfo> USBController::list_devices(uint16_t vendor_id, uint16_t product_id) {
+    std::vector<DeviceInfo> devices;
     if (!initialized_) {
-        std::cerr << "USB controller not initialized" << std::endl;
+        LOG_ERROR("USB controller not initialized");
+        return devices;
+    }
+
+    libusb_device **device_list;
+    ssize_t device_count = libusb_get_device_list(nullptr, &device_list);
+    if (device_count < 0) {
+        LOG_ERROR("Failed to get device list: %s", libusb_error_name(device_count));
+        return devices;
+    }
+    for (ssize_t i = 0; i < device_count; i++) {
+        libusb_device_descriptor desc;
+        if (libusb_get_device_descriptor(device_list[i], &desc) < 0 ||
+            desc.idVendor != vendor_id || desc.idProduct != product_id) {
+            continue;
+        }
+        DeviceInfo info;
+        info.bus = libusb_get_bus_number(device_list[i]);
+        info.address = libusb_get_device_address(device_list[i]);
+        info.bus_path = bus_path(device_list[i]);
+        info.serial = serial_number(device_list[i], desc);
+        devices.push_back(info);
+    }
+    libusb_free_device_list(device_list, 1);
+    return devices;
+}
+
+bool USBController::connect_to_device(uint16_t vendor_id, uint16_t product_id, const std::string& selector,
+                                     bool force_reset) {
+    disconnect();
+    if (!initialized_) {
+        LOG_ERROR("USB controller not initialized");
         return false;
     }
 
@@ -29,66 +97,94 @@ bool USBController::connect_to_device(uint16_t vendor_id, uint16_t product_id) {
     libusb_device **device_list;
     ssize_t device_count = libusb_get_device_list(nullptr, &device_list);
     if (device_count < 0) {
-        std::cerr << "Failed to get device list: " << libusb_error_name(device_count) << std::endl;
+        LOG_ERROR("Failed to get device list: %s", libusb_error_name(device_count));
         return false;
     }
 
     // Find our device
     libusb_device *target_device = nullptr;
+    libusb_device_descriptor target_desc{};
     for (ssize_t i = 0; i < device_count; i++) {
         libusb_device_descriptor desc;
         int result = libusb_get_device_descriptor(device_list[i], &desc);
         if (result < 0) {
-            std::cerr << "Failed to get device descriptor: " << libusb_error_name(result) << std::endl;
+            LOG_ERROR("Failed to get device descriptor: %s", libusb_error_name(result));
             continue;
         }
 
-        if (desc.idVendor == vendor_id && desc.idProduct == product_id) {
+        if (desc.idVendor == vendor_id && desc.idProduct == product_id &&
+            (selector.empty() || bus_path(device_list[i]) == selector ||
+             serial_number(device_list[i], desc) == selector)) {
             target_device = device_list[i];
+            target_desc = desc;
             break;
         }
     }
 
     if (!target_device) {
-        std::cerr << "Device not found (VID=0x" << std::hex << vendor_id
-                  << ", PID=0x" << product_id << std::dec << ")" << std::endl;
+        LOG_ERROR("Device not found (VID=0x%04x, PID=0x%04x%s%s)", vendor_id, product_id,
+                  selector.empty() ? "" : ", ", selector.c_str());
         libusb_free_device_list(device_list, 1);
         return false;
     }
 
     // Open the device
+    connected_ = DeviceInfo();
+    connected_.bus = libusb_get_bus_number(target_device);
+    connected_.address = libusb_get_device_address(target_device);
+    connected_.bus_path = bus_path(target_device);
     int result = libusb_open(target_device, &device_handle_);
     libusb_free_device_list(device_list, 1);
 
     if (result < 0) {
-        std::cerr << "Failed to open device: " << libusb_error_name(result) << std::endl;
+        LOG_ERROR("Failed to open device: %s", libusb_error_name(result));
         return false;
     }
-
-    // Reset the device
-    result = libusb_reset_device(device_handle_);
-    if (result < 0) {
-        std::cerr << "Failed to reset device: " << libusb_error_name(result) << std::endl;
-        libusb_close(device_handle_);
-        device_handle_ = nullptr;
-        return false;
+    connected_.serial = read_serial(device_handle_, target_desc.iSerialNumber);
+
+    // A reset re-enumerates the device and costs seconds; a device that is
+    // still in its streaming configuration, e.g. after a previous run or a
+    // brief cable glitch, does not need one
+    int configuration = 0;
+    bool configured = libusb_get_configuration(device_handle_, &configuration) == 0 && configuration == 1;
+    if (force_reset || !configured) {
+        result = libusb_reset_device(device_handle_);
+        if (result < 0) {
+            LOG_ERROR("Failed to reset device: %s", libusb_error_name(result));
+            disconnect();
+            return false;
+        }
+    } else {
+        LOG_DEBUG("Device %s already configured, not resetting", connected_.bus_path.c_str());
     }
 
     // Set configuration
-    result = libusb_set_configuration(device_handle_, 1);
-    if (result < 0) {
-        std::cerr << "Failed to set configuration: " << libusb_error_name(result) << std::endl;
+    if (!configured || force_reset) {
+        result = libusb_set_configuration(device_handle_, 1);
+        if (result < 0) {
+            LOG_ERROR("Failed to set configuration: %s", libusb_error_name(result));
+            disconnect();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void USBController::disconnect() {
+    if (device_handle_) {
         libusb_close(device_handle_);
         device_handle_ = nullptr;
-        return false;
     }
+}
 
-    return true;
+const USBController::DeviceInfo& USBController::connected_device() const {
+    return connected_;
 }
 
 bool USBController::claim_interface(uint8_t interface_number) {
     if (!device_handle_) {
-        std::cerr << "No device connected" << std::endl;
+        LOG_ERROR("No device connected");
         return false;
     }
 
@@ -96,7 +192,7 @@ bool USBController::claim_interface(uint8_t interface_number) {
     if (libusb_kernel_driver_active(device_handle_, interface_number)) {
         int result = libusb_detach_kernel_driver(device_handle_, interface_number);
         if (result < 0) {
-            std::cerr << "Failed to detach kernel driver: " << libusb_error_name(result) << std::endl;
+            LOG_ERROR("Failed to detach kernel driver: %s", libusb_error_name(result));
             return false;
         }
     }
@@ -104,7 +200,7 @@ bool USBController::claim_interface(uint8_t interface_number) {
     // Claim the interface
     int result = libusb_claim_interface(device_handle_, interface_number);
     if (result < 0) {
-        std::cerr << "Failed to claim interface: " << libusb_error_name(result) << std::endl;
+        LOG_ERROR("Failed to claim interface: %s", libusb_error_name(result));
         return false;
     }
 
@@ -113,14 +209,14 @@ bool USBController::claim_interface(uint8_t interface_number) {
 
 bool USBController::bulk_transfer(uint8_t endpoint, uint8_t* data, int length, int* actual_length, unsigned int timeout) {
     if (!device_handle_) {
-        std::cerr << "No device connected" << std::endl;
+        LOG_ERROR("No device connected");
         return false;
     }
 
     int result = libusb_bulk_transfer(device_handle_, endpoint, data, length, actual_length, timeout);
     if (result < 0) {
         if (result != LIBUSB_ERROR_TIMEOUT) {
-            std::cerr << "Bulk transfer failed: " << libusb_error_name(result) << std::endl;
+            LOG_ERROR("Bulk transfer failed: %s", libusb_error_name(result));
         }
         return false;
     }
@@ -128,6 +224,27 @@ bool USBController::bulk_transfer(uint8_t endpoint, uint8_t* data, int length, i
     return true;
 }
 
+bool USBController::interface_request(uint8_t request, uint16_t value, uint16_t interface_number, uint8_t* data,
+                                      uint16_t length, int* actual_length, unsigned int timeout) {
+    if (!device_handle_) {
+        LOG_ERROR("No device connected");
+        return false;
+    }
+
+    uint8_t request_type = LIBUSB_REQUEST_TYPE_CLASS | LIBUSB_RECIPIENT_INTERFACE |
+                           ((request & 0x80) ? LIBUSB_ENDPOINT_IN : LIBUSB_ENDPOINT_OUT);
+    int result = libusb_control_transfer(device_handle_, request_type, request, value, interface_number,
+                                         data, length, timeout);
+    if (result < 0) {
+        LOG_ERROR("Control request 0x%02x failed: %s", request, libusb_error_name(result));
+        return false;
+    }
+    if (actual_length) {
+        *actual_length = result;
+    }
+    return true;
+}
+
 libusb_device_handle* USBController::get_device_handle() {
     return device_handle_;
 }
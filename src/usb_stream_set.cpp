@@ -0,0 +1,217 @@
+#include "usb_stream_set.hpp"
+#include "logger.hpp"
+#include "hid_protocol.hpp"
+#include "uvc_protocol.hpp"
+#include <algorithm>
+#include <cstring>
+
+#define LOG_COMPONENT "usb"
+
+namespace {
+
+// The first IN endpoint of the given transfer type, if any
+const libusb_endpoint_descriptor* find_in_endpoint(const libusb_interface_descriptor* interface_desc,
+                                                   uint8_t transfer_type) {
+    for (int k = 0; k < interface_desc->bNumEndpoints; k++) {
+        const libusb_endpoint_descriptor* endpoint = &interface_desc->endpoint[k];
+        if ((endpoint->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) == transfer_type &&
+            (endpoint->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_IN) {
+            return endpoint;
+        }
+    }
+    return nullptr;
+}
+
+// Finds the uncompressed format with this fourcc among a streaming
+// interface's class-specific descriptors, and the first frame listed
+// after it
+bool find_format(const libusb_interface_descriptor* interface_desc, const uint8_t* fourcc,
+                 uint8_t& format_index, uint8_t& frame_index) {
+    const uint8_t* extra = interface_desc->extra;
+    int remaining = interface_desc->extra_length;
+    bool in_format = false;
+    while (remaining >= 3 && extra[0] >= 3 && extra[0] <= remaining) {
+        uint8_t length = extra[0];
+        if (extra[1] == UvcStreaming::CS_INTERFACE && extra[2] == UvcStreaming::FORMAT_UNCOMPRESSED &&
+            length >= 21) {
+            in_format = memcmp(extra + 5, fourcc, 4) == 0;
+            format_index = extra[3];
+        } else if (in_format && extra[1] == UvcStreaming::CS_INTERFACE &&
+                   extra[2] == UvcStreaming::FRAME_UNCOMPRESSED && length >= 26) {
+            frame_index = extra[3];
+            return true;
+        }
+        extra += length;
+        remaining -= length;
+    }
+    return false;
+}
+
+}  // namespace
+
+UsbStreamSet::UsbStreamSet(const std::string& selector)
+    : selector_(selector), device_handle_(nullptr) {
+}
+
+UsbStreamSet::~UsbStreamSet() {
+    close();
+}
+
+bool UsbStreamSet::open() {
+    usb_controller_ = std::make_unique<USBController>();
+    if (!usb_controller_->connect_to_device(USBController::INTEL_VENDOR_ID, USBController::D435I_PRODUCT_ID,
+                                            selector_)) {
+        LOG_ERROR("Failed to connect to RealSense device");
+        return false;
+    }
+    device_handle_ = usb_controller_->get_device_handle();
+    find_endpoints();
+
+    int opened = 0;
+    for (int i = 0; i < StreamManager::STREAM_KINDS; i++) {
+        StreamKind kind = static_cast<StreamKind>(i);
+        Endpoint& endpoint = endpoints_[i];
+        if (!endpoint.found) {
+            LOG_WARN("No %s stream on this device", StreamManager::name(kind));
+            continue;
+        }
+        if (!usb_controller_->claim_interface(endpoint.interface_number) ||
+            (kind != StreamKind::Imu && !commit_video(kind, endpoint))) {
+            LOG_ERROR("Failed to set up the %s stream", StreamManager::name(kind));
+            endpoint.found = false;
+            continue;
+        }
+        libusb_clear_halt(device_handle_, endpoint.address);
+        endpoint.backend = std::make_unique<LibusbTransferBackend>(nullptr, device_handle_, endpoint.address,
+                                                                   TRANSFER_TIMEOUT_MS, endpoint.interrupt);
+        LOG_INFO("%s stream on interface %u, endpoint 0x%02x", StreamManager::name(kind), endpoint.interface_number,
+                 endpoint.address);
+        opened++;
+    }
+    return opened > 0;
+}
+
+void UsbStreamSet::close() {
+    for (Endpoint& endpoint : endpoints_) {
+        endpoint.backend.reset();
+        if (endpoint.found && device_handle_) {
+            libusb_release_interface(device_handle_, endpoint.interface_number);
+        }
+        endpoint = Endpoint();
+    }
+    device_handle_ = nullptr;
+    if (usb_controller_) {
+        usb_controller_->disconnect();
+    }
+}
+
+void UsbStreamSet::find_endpoints() {
+    libusb_config_descriptor* config;
+    int result = libusb_get_active_config_descriptor(libusb_get_device(device_handle_), &config);
+    if (result < 0) {
+        LOG_ERROR("Failed to get config descriptor: %s", libusb_error_name(result));
+        return;
+    }
+
+    for (int i = 0; i < config->bNumInterfaces; i++) {
+        const libusb_interface* interface = &config->interface[i];
+        if (interface->num_altsetting == 0) {
+            continue;
+        }
+        // Formats trail the first alternate setting; the endpoint may be on any
+        const libusb_interface_descriptor* first = &interface->altsetting[0];
+        for (int j = 0; j < interface->num_altsetting; j++) {
+            const libusb_interface_descriptor* interface_desc = &interface->altsetting[j];
+            Endpoint candidate;
+            candidate.interface_number = interface_desc->bInterfaceNumber;
+            StreamKind kind;
+            const libusb_endpoint_descriptor* endpoint = nullptr;
+
+            if (interface_desc->bInterfaceClass == 14 && interface_desc->bInterfaceSubClass == 2) {
+                endpoint = find_in_endpoint(interface_desc, LIBUSB_TRANSFER_TYPE_BULK);
+                if (find_format(first, UvcStreaming::Z16_FOURCC, candidate.format_index, candidate.frame_index)) {
+                    kind = StreamKind::Depth;
+                } else if (find_format(first, UvcStreaming::YUY2_FOURCC, candidate.format_index,
+                                       candidate.frame_index)) {
+                    kind = StreamKind::Color;
+                } else {
+                    continue;
+                }
+            } else if (interface_desc->bInterfaceClass == ImuHid::INTERFACE_CLASS) {
+                endpoint = find_in_endpoint(interface_desc, LIBUSB_TRANSFER_TYPE_INTERRUPT);
+                candidate.interrupt = true;
+                kind = StreamKind::Imu;
+            } else {
+                continue;
+            }
+
+            Endpoint& slot = endpoints_[static_cast<int>(kind)];
+            if (!endpoint || slot.found) {
+                continue;
+            }
+            candidate.found = true;
+            candidate.address = endpoint->bEndpointAddress;
+            candidate.max_packet_size = endpoint->wMaxPacketSize;
+            slot = std::move(candidate);
+        }
+    }
+
+    libusb_free_config_descriptor(config);
+}
+
+bool UsbStreamSet::commit_video(StreamKind kind, Endpoint& endpoint) {
+    // Probe with just the format and frame; the device fills in its default
+    // interval and the sizes, and the same block is committed
+    UvcStreamingControl control{};
+    control.format_index = endpoint.format_index;
+    control.frame_index = endpoint.frame_index;
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(&control);
+    int length = 0;
+    if (!usb_controller_->interface_request(UvcStreaming::SET_CUR, UvcStreaming::PROBE_CONTROL << 8,
+                                            endpoint.interface_number, bytes, sizeof(control), nullptr,
+                                            CONTROL_TIMEOUT_MS) ||
+        !usb_controller_->interface_request(UvcStreaming::GET_CUR, UvcStreaming::PROBE_CONTROL << 8,
+                                            endpoint.interface_number, bytes, sizeof(control), &length,
+                                            CONTROL_TIMEOUT_MS) ||
+        length < 26 || control.max_video_frame_size == 0) {
+        LOG_ERROR("UVC probe of the %s stream failed", StreamManager::name(kind));
+        return false;
+    }
+    if (!usb_controller_->interface_request(UvcStreaming::SET_CUR, UvcStreaming::COMMIT_CONTROL << 8,
+                                            endpoint.interface_number, bytes, static_cast<uint16_t>(length),
+                                            nullptr, CONTROL_TIMEOUT_MS)) {
+        LOG_ERROR("UVC commit of the %s stream failed", StreamManager::name(kind));
+        return false;
+    }
+    endpoint.frame_size = control.max_video_frame_size;
+    endpoint.payload_size = control.max_payload_transfer_size != 0
+                                ? control.max_payload_transfer_size
+                                : UvcHeader::MAX_LENGTH + endpoint.frame_size;
+    return true;
+}
+
+bool UsbStreamSet::has_stream(StreamKind kind) const {
+    return endpoints_[static_cast<int>(kind)].backend != nullptr;
+}
+
+bool UsbStreamSet::stream_config(StreamKind kind, StreamManager::StreamConfig& config) {
+    Endpoint& endpoint = endpoints_[static_cast<int>(kind)];
+    if (!endpoint.backend) {
+        return false;
+    }
+    config.kind = kind;
+    config.backend = endpoint.backend.get();
+    size_t packet = endpoint.max_packet_size ? endpoint.max_packet_size : 1024;
+    if (kind == StreamKind::Imu) {
+        // As many whole reports as one interrupt packet holds: a read ends
+        // with its packet, which may carry several reports
+        config.transfer_size = std::max(packet, sizeof(ImuHidReport)) / sizeof(ImuHidReport) *
+                               sizeof(ImuHidReport);
+        config.frame_size = 0;
+    } else {
+        // Whole packets, or a full payload would overflow the read
+        config.transfer_size = (endpoint.payload_size + packet - 1) / packet * packet;
+        config.frame_size = endpoint.frame_size;
+    }
+    return true;
+}
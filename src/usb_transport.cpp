@@ -0,0 +1,448 @@
+#include "usb_transport.hpp"
+#include "logger.hpp"
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#define LOG_COMPONENT "usb"
+
+namespace {
+
+struct EndpointLayout {
+    uint8_t depth_interface;
+    uint8_t depth_endpoint;
+    uint16_t max_packet_size;
+};
+
+// Layouts found so far, by device key
+std::mutex layout_mutex;
+std::map<std::string, EndpointLayout> layout_cache;
+
+uint32_t read_le32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+           static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+int interval_fps(uint32_t interval) {
+    return interval ? static_cast<int>(std::lround(1e7 / interval)) : 0;
+}
+
+}  // namespace
+
+UsbTransport::UsbTransport(const std::string& selector)
+    : selector_(selector), device_handle_(nullptr), layout_cached_(false), reset_tried_(false),
+      hotplug_handle_(0), hotplug_registered_(false), arrived_(false), probed_{}, probed_length_(0),
+      DEPTH_INTERFACE(0), CONTROL_INTERFACE(1), DEPTH_ENDPOINT_IN(0x82), DEPTH_MAX_PACKET_SIZE(1024) {
+}
+
+UsbTransport::~UsbTransport() {
+    stop();
+    close_device();
+    if (hotplug_registered_) {
+        libusb_hotplug_deregister_callback(nullptr, hotplug_handle_);
+    }
+}
+
+bool UsbTransport::open() {
+    usb_controller_ = std::make_unique<USBController>();
+    if (!open_device(false)) {
+        return false;
+    }
+
+    // Reconnection waits for the device to reappear without polling the bus
+    if (!hotplug_registered_ && libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
+        int result = libusb_hotplug_register_callback(
+            nullptr, LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED, LIBUSB_HOTPLUG_NO_FLAGS, USBController::INTEL_VENDOR_ID,
+            USBController::D435I_PRODUCT_ID, LIBUSB_HOTPLUG_MATCH_ANY, &UsbTransport::on_hotplug, this,
+            &hotplug_handle_);
+        hotplug_registered_ = result == LIBUSB_SUCCESS;
+        if (!hotplug_registered_) {
+            LOG_WARN("Hotplug unavailable (%s), reconnection will poll", libusb_error_name(result));
+        }
+    }
+    return true;
+}
+
+bool UsbTransport::open_device(bool force_reset) {
+    // After the first open, always come back to the same camera
+    const std::string& selector = device_key_.empty() ? selector_ : device_key_;
+    if (!usb_controller_->connect_to_device(USBController::INTEL_VENDOR_ID, USBController::D435I_PRODUCT_ID,
+                                            selector, force_reset)) {
+        LOG_ERROR("Failed to connect to RealSense device");
+        return false;
+    }
+
+    device_handle_ = usb_controller_->get_device_handle();
+    if (!device_handle_) {
+        LOG_ERROR("Invalid device handle");
+        return false;
+    }
+    const USBController::DeviceInfo& device = usb_controller_->connected_device();
+    device_key_ = device.serial.empty() ? device.bus_path : device.serial;
+
+    {
+        std::lock_guard<std::mutex> lock(layout_mutex);
+        auto cached = layout_cache.find(device_key_);
+        layout_cached_ = cached != layout_cache.end();
+        if (layout_cached_) {
+            DEPTH_INTERFACE = cached->second.depth_interface;
+            DEPTH_ENDPOINT_IN = cached->second.depth_endpoint;
+            DEPTH_MAX_PACKET_SIZE = cached->second.max_packet_size;
+        }
+    }
+    if (!layout_cached_ && !find_depth_endpoint()) {
+        LOG_ERROR("Failed to find video streaming interface with bulk endpoint");
+        return false;
+    }
+
+    // Claim the depth interface
+    if (!usb_controller_->claim_interface(DEPTH_INTERFACE)) {
+        LOG_ERROR("Failed to claim depth interface");
+        return false;
+    }
+
+    LOG_INFO("Opened %s (bus path %s)%s", device.serial.empty() ? "camera" : device.serial.c_str(),
+             device.bus_path.c_str(), layout_cached_ ? " with cached layout" : "");
+    return true;
+}
+
+void UsbTransport::close_device() {
+    // The engine and its transfers refer to the handle, so they go first
+    capture_engine_.reset();
+    transfer_backend_.reset();
+    if (device_handle_) {
+        libusb_release_interface(device_handle_, DEPTH_INTERFACE);
+        libusb_release_interface(device_handle_, CONTROL_INTERFACE);
+        device_handle_ = nullptr;
+    }
+    if (usb_controller_) {
+        usb_controller_->disconnect();
+    }
+}
+
+bool UsbTransport::find_depth_endpoint() {
+    // Get device configuration
+    libusb_config_descriptor* config;
+    int result = libusb_get_active_config_descriptor(libusb_get_device(device_handle_), &config);
+    if (result < 0) {
+        LOG_ERROR("Failed to get config descriptor: %s", libusb_error_name(result));
+        return false;
+    }
+
+    // Find the depth streaming interface (Class 14, SubClass 2)
+    bool found_depth_interface = false;
+    for (int i = 0; i < config->bNumInterfaces; i++) {
+        const libusb_interface* interface = &config->interface[i];
+        for (int j = 0; j < interface->num_altsetting; j++) {
+            const libusb_interface_descriptor* interface_desc = &interface->altsetting[j];
+
+            LOG_DEBUG("Interface %d alt %d: number %d, alternate %d, %d endpoints, class %d, subclass %d",
+                      i, j, interface_desc->bInterfaceNumber, interface_desc->bAlternateSetting,
+                      interface_desc->bNumEndpoints, interface_desc->bInterfaceClass,
+                      interface_desc->bInterfaceSubClass);
+
+            if (interface_desc->bInterfaceClass == 14 &&
+                interface_desc->bInterfaceSubClass == 2 &&
+                interface_desc->bNumEndpoints > 0) {
+
+                // Check for bulk endpoint
+                for (int k = 0; k < interface_desc->bNumEndpoints; k++) {
+                    const libusb_endpoint_descriptor* endpoint = &interface_desc->endpoint[k];
+                    LOG_DEBUG("  Endpoint %d: address 0x%02x, attributes 0x%02x, max packet %d",
+                              k, endpoint->bEndpointAddress, endpoint->bmAttributes, endpoint->wMaxPacketSize);
+
+                    // Check if this is a bulk IN endpoint
+                    if ((endpoint->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) == LIBUSB_TRANSFER_TYPE_BULK &&
+                        (endpoint->bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_IN) {
+
+                        DEPTH_INTERFACE = interface_desc->bInterfaceNumber;
+                        DEPTH_ENDPOINT_IN = endpoint->bEndpointAddress;
+                        DEPTH_MAX_PACKET_SIZE = endpoint->wMaxPacketSize;
+                        found_depth_interface = true;
+                        break;
+                    }
+                }
+            }
+
+            if (found_depth_interface) {
+                break;
+            }
+        }
+        if (found_depth_interface) {
+            break;
+        }
+    }
+
+    libusb_free_config_descriptor(config);
+    return found_depth_interface;
+}
+
+bool UsbTransport::test_endpoint() {
+    // Test the endpoint with exactly one packet size
+    std::vector<uint8_t> test_buffer(DEPTH_MAX_PACKET_SIZE);
+    int actual_length;
+
+    LOG_INFO("Testing depth endpoint with %zu byte buffer...", test_buffer.size());
+
+    // Try multiple times in case the first few reads fail
+    for (int attempt = 0; attempt < 3; attempt++) {
+        if (usb_controller_->bulk_transfer(DEPTH_ENDPOINT_IN, test_buffer.data(), test_buffer.size(), &actual_length, 1000)) {
+            LOG_INFO("Successfully read %d bytes from depth endpoint", actual_length);
+            return true;
+        }
+        LOG_WARN("Attempt %d failed (received %d bytes), retrying...", attempt + 1, actual_length);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return false;
+}
+
+bool UsbTransport::read_modes(std::vector<UvcMode>& modes) {
+    libusb_config_descriptor* config;
+    int result = libusb_get_active_config_descriptor(libusb_get_device(device_handle_), &config);
+    if (result < 0) {
+        LOG_ERROR("Failed to get config descriptor: %s", libusb_error_name(result));
+        return false;
+    }
+
+    // The format and frame descriptors trail the streaming interface's
+    // first alternate setting, each frame after the format it belongs to
+    for (int i = 0; i < config->bNumInterfaces; i++) {
+        if (config->interface[i].num_altsetting == 0 ||
+            config->interface[i].altsetting[0].bInterfaceNumber != DEPTH_INTERFACE) {
+            continue;
+        }
+        const libusb_interface_descriptor* interface_desc = &config->interface[i].altsetting[0];
+        const uint8_t* extra = interface_desc->extra;
+        int remaining = interface_desc->extra_length;
+        uint8_t format_index = 0;
+        bool z16 = false;
+        while (remaining >= 3 && extra[0] >= 3 && extra[0] <= remaining) {
+            uint8_t length = extra[0];
+            if (extra[1] == UvcStreaming::CS_INTERFACE && extra[2] == UvcStreaming::FORMAT_UNCOMPRESSED &&
+                length >= 21) {
+                format_index = extra[3];
+                z16 = memcmp(extra + 5, UvcStreaming::Z16_FOURCC, sizeof(UvcStreaming::Z16_FOURCC)) == 0;
+            } else if (extra[1] == UvcStreaming::CS_INTERFACE && extra[2] == UvcStreaming::FRAME_UNCOMPRESSED &&
+                       length >= 26 && z16) {
+                UvcMode mode;
+                mode.format_index = format_index;
+                mode.frame_index = extra[3];
+                mode.profile.width = extra[5] | extra[6] << 8;
+                mode.profile.height = extra[7] | extra[8] << 8;
+                // Discrete intervals are listed; a continuous range gives
+                // its fastest and slowest ends
+                int intervals = extra[25] ? extra[25] : 2;
+                for (int k = 0; k < intervals && 26 + 4 * (k + 1) <= length; k++) {
+                    mode.frame_interval = read_le32(extra + 26 + 4 * k);
+                    mode.profile.fps = interval_fps(mode.frame_interval);
+                    modes.push_back(mode);
+                }
+            }
+            extra += length;
+            remaining -= length;
+        }
+    }
+
+    libusb_free_config_descriptor(config);
+    return true;
+}
+
+bool UsbTransport::probe(const StreamProfile& requested, StreamProfile& negotiated) {
+    std::vector<UvcMode> modes;
+    if (!read_modes(modes) || modes.empty()) {
+        LOG_ERROR("No Z16 modes in the depth interface descriptors");
+        return false;
+    }
+    std::vector<StreamProfile> offered;
+    for (const UvcMode& mode : modes) {
+        offered.push_back(mode.profile);
+    }
+    StreamProfile chosen;
+    StreamProfile::closest(offered, requested, chosen);
+    const UvcMode* mode = &modes[0];
+    for (const UvcMode& candidate : modes) {
+        if (candidate.profile == chosen) {
+            mode = &candidate;
+            break;
+        }
+    }
+
+    // The device fills in the rest, sizes included, and may move the
+    // interval if it cannot keep to it
+    UvcStreamingControl control{};
+    control.hint = UvcStreaming::HINT_FRAME_INTERVAL;
+    control.format_index = mode->format_index;
+    control.frame_index = mode->frame_index;
+    control.frame_interval = mode->frame_interval;
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(&control);
+    int length = 0;
+    if (!usb_controller_->interface_request(UvcStreaming::SET_CUR, UvcStreaming::PROBE_CONTROL << 8,
+                                            DEPTH_INTERFACE, bytes, sizeof(control), nullptr, CONTROL_TIMEOUT_MS) ||
+        !usb_controller_->interface_request(UvcStreaming::GET_CUR, UvcStreaming::PROBE_CONTROL << 8,
+                                            DEPTH_INTERFACE, bytes, sizeof(control), &length, CONTROL_TIMEOUT_MS)) {
+        LOG_ERROR("UVC probe of %s failed", chosen.to_string().c_str());
+        return false;
+    }
+    if (length < 26) {
+        LOG_ERROR("UVC probe answered with %d bytes", length);
+        return false;
+    }
+
+    const UvcMode* settled = nullptr;
+    for (const UvcMode& candidate : modes) {
+        if (candidate.format_index == control.format_index && candidate.frame_index == control.frame_index) {
+            settled = &candidate;
+            break;
+        }
+    }
+    if (!settled) {
+        LOG_ERROR("UVC probe settled on unknown format %u frame %u", control.format_index, control.frame_index);
+        return false;
+    }
+    negotiated = settled->profile;
+    negotiated.fps = interval_fps(control.frame_interval);
+    if (control.max_video_frame_size != 0 && control.max_video_frame_size != negotiated.frame_size()) {
+        LOG_WARN("Device reports %u byte frames for %s", control.max_video_frame_size,
+                 negotiated.to_string().c_str());
+    }
+
+    probed_ = control;
+    probed_length_ = length;
+    probed_profile_ = negotiated;
+    LOG_INFO("Negotiated %s for %s (format %u, frame %u, payloads up to %u bytes)",
+             negotiated.to_string().c_str(), requested.to_string().c_str(), control.format_index,
+             control.frame_index, control.max_payload_transfer_size);
+    return true;
+}
+
+bool UsbTransport::commit(const StreamProfile& profile) {
+    if (probed_length_ == 0 || profile != probed_profile_) {
+        StreamProfile negotiated;
+        if (!probe(profile, negotiated) || negotiated != profile) {
+            LOG_ERROR("Device does not offer %s", profile.to_string().c_str());
+            return false;
+        }
+    }
+
+    // Also after a reconnect: the device forgets its stream setup with the
+    // cable, while the probed block stays valid for it
+    UvcStreamingControl control = probed_;
+    if (!usb_controller_->interface_request(UvcStreaming::SET_CUR, UvcStreaming::COMMIT_CONTROL << 8,
+                                            DEPTH_INTERFACE, reinterpret_cast<uint8_t*>(&control),
+                                            static_cast<uint16_t>(probed_length_), nullptr, CONTROL_TIMEOUT_MS)) {
+        LOG_ERROR("UVC commit of %s failed", profile.to_string().c_str());
+        return false;
+    }
+    return true;
+}
+
+bool UsbTransport::start(FramePool& pool, PayloadCallback on_payload) {
+    if (capture_engine_ && capture_engine_->is_running()) {
+        return true;
+    }
+
+    // Clear any stall condition
+    int result = libusb_clear_halt(device_handle_, DEPTH_ENDPOINT_IN);
+    if (result < 0) {
+        LOG_ERROR("Failed to clear endpoint halt: %s", libusb_error_name(result));
+        return false;
+    }
+
+    // A layout already proven on this device needs no probing. A fresh one
+    // is probed, and if the endpoint does not answer the device gets the
+    // reset that was skipped on open, once.
+    if (!layout_cached_) {
+        bool endpoint_ok = test_endpoint();
+        if (!endpoint_ok && !reset_tried_) {
+            LOG_WARN("Depth endpoint not answering, resetting the device");
+            reset_tried_ = true;
+            close_device();
+            endpoint_ok = open_device(true) && test_endpoint();
+        }
+        if (!endpoint_ok) {
+            LOG_ERROR("Failed to test depth endpoint after multiple attempts");
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(layout_mutex);
+        layout_cache[device_key_] = EndpointLayout{DEPTH_INTERFACE, DEPTH_ENDPOINT_IN, DEPTH_MAX_PACKET_SIZE};
+        layout_cached_ = true;
+    }
+
+    // One transfer per UVC payload, read directly into a pool buffer. The
+    // request must be whole packets or a full payload would overflow it.
+    size_t packet = DEPTH_MAX_PACKET_SIZE ? DEPTH_MAX_PACKET_SIZE : 1024;
+    UsbCaptureEngine::Config engine_config;
+    engine_config.transfer_size = pool.frame_capacity() / packet * packet;
+    engine_config.pool = &pool;
+    engine_config.cpu = cpu_;
+    engine_config.priority = priority_;
+    engine_config.metrics_prefix = metrics_prefix_;
+    engine_config.on_device_lost = on_lost_;
+
+    capture_engine_.reset();
+    transfer_backend_ = std::make_unique<LibusbTransferBackend>(nullptr, device_handle_, DEPTH_ENDPOINT_IN, 1000);
+    capture_engine_ = std::make_unique<UsbCaptureEngine>(*transfer_backend_, engine_config);
+    if (!capture_engine_->start(std::move(on_payload))) {
+        LOG_ERROR("Failed to start capture engine");
+        return false;
+    }
+
+    return true;
+}
+
+void UsbTransport::stop() {
+    if (capture_engine_) {
+        capture_engine_->stop();
+    }
+}
+
+const char* UsbTransport::name() const {
+    return "usb";
+}
+
+int LIBUSB_CALL UsbTransport::on_hotplug(libusb_context*, libusb_device*, libusb_hotplug_event, void* user_data) {
+    // Only a hint: whether it is our camera is settled by reopening it
+    static_cast<UsbTransport*>(user_data)->arrived_ = true;
+    return 0;
+}
+
+bool UsbTransport::reconnect(unsigned int timeout_ms) {
+    close_device();
+    if (!usb_controller_) {
+        usb_controller_ = std::make_unique<USBController>();
+    }
+
+    // A glitch can be over before we get here, so try straight away, then
+    // whenever a camera arrives
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    for (;;) {
+        arrived_ = false;
+        if (open_device(false)) {
+            return true;
+        }
+        close_device();
+        while (!arrived_) {
+            auto now = std::chrono::steady_clock::now();
+            if (now >= deadline) {
+                return false;
+            }
+            auto wait_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::min(deadline - now, std::chrono::steady_clock::duration(std::chrono::milliseconds(POLL_MS))));
+            if (!hotplug_registered_) {
+                std::this_thread::sleep_for(wait_us);
+                break;
+            }
+            // Nothing else services libusb events while no transfers run
+            timeval timeout{0, static_cast<suseconds_t>(wait_us.count())};
+            libusb_handle_events_timeout_completed(nullptr, &timeout, nullptr);
+        }
+    }
+}
+
+libusb_device_handle* UsbTransport::get_device_handle() {
+    return device_handle_;
+}
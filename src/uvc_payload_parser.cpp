@@ -0,0 +1,145 @@
+#include "uvc_payload_parser.hpp"
+
+namespace {
+
+inline uint32_t read_le32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+}  // namespace
+
+UvcPayloadParser::UvcPayloadParser(size_t frame_size)
+    : frame_size_(frame_size), in_frame_(false), frame_torn_(false),
+      current_fid_(false), have_fid_(false), frame_bytes_(0) {
+}
+
+bool UvcPayloadParser::parse_header(const uint8_t* payload, size_t length, UvcPayloadHeader& header) {
+    if (length < UvcHeader::MIN_LENGTH) {
+        return false;
+    }
+
+    size_t header_length = payload[0];
+    uint8_t flags = payload[1];
+    if (header_length < UvcHeader::MIN_LENGTH || header_length > length || !(flags & UvcHeader::EOH)) {
+        return false;
+    }
+
+    header.length = header_length;
+    header.flags = flags;
+    header.fid = (flags & UvcHeader::FID) != 0;
+    header.end_of_frame = (flags & UvcHeader::EOF_BIT) != 0;
+    header.error = (flags & UvcHeader::ERR) != 0;
+    header.has_pts = (flags & UvcHeader::PTS) != 0;
+    header.has_scr = (flags & UvcHeader::SCR) != 0;
+
+    size_t required = UvcHeader::MIN_LENGTH + (header.has_pts ? 4 : 0) + (header.has_scr ? 6 : 0);
+    if (required > header_length) {
+        return false;
+    }
+
+    const uint8_t* field = payload + UvcHeader::MIN_LENGTH;
+    if (header.has_pts) {
+        header.pts = read_le32(field);
+        field += 4;
+    }
+    if (header.has_scr) {
+        header.scr_stc = read_le32(field);
+        header.scr_sof = static_cast<uint16_t>((field[4] | (field[5] << 8)) & 0x07ff);
+    }
+    return true;
+}
+
+UvcPayloadParser::Result UvcPayloadParser::parse(const uint8_t* payload, size_t length) {
+    Result result;
+    stats_.payloads++;
+    stats_.bytes += length;
+
+    if (!parse_header(payload, length, result.header)) {
+        // Can't trust anything about this payload, including which frame it
+        // belonged to, so the frame in progress is lost.
+        stats_.invalid_headers++;
+        if (in_frame_) {
+            result.abort_frame = true;
+            stats_.torn_frames++;
+            in_frame_ = false;
+        }
+        have_fid_ = false;
+        return result;
+    }
+
+    const UvcPayloadHeader& header = result.header;
+
+    // A FID toggle without a preceding EOF means the end of the last frame
+    // was lost.
+    if (in_frame_ && header.fid != current_fid_) {
+        result.abort_frame = true;
+        stats_.torn_frames++;
+        in_frame_ = false;
+    }
+
+    if (!in_frame_) {
+        // Payloads still carrying the FID of a frame that was already closed
+        // (or torn) are its leftovers.
+        if (have_fid_ && header.fid == current_fid_) {
+            if (header.end_of_frame) {
+                have_fid_ = false;
+            }
+            return result;
+        }
+        in_frame_ = true;
+        frame_torn_ = false;
+        current_fid_ = header.fid;
+        have_fid_ = true;
+        frame_bytes_ = 0;
+        result.frame_start = true;
+    }
+
+    if (header.error) {
+        stats_.error_payloads++;
+        frame_torn_ = true;
+    }
+
+    result.data = payload + header.length;
+    result.length = length - header.length;
+    result.offset = frame_bytes_;
+    if (frame_bytes_ + result.length > frame_size_) {
+        frame_torn_ = true;
+        result.length = frame_size_ > frame_bytes_ ? frame_size_ - frame_bytes_ : 0;
+    }
+    result.accepted = !frame_torn_;
+    frame_bytes_ += result.length;
+
+    bool ends = header.end_of_frame || frame_torn_ || frame_bytes_ == frame_size_;
+    if (ends) {
+        in_frame_ = false;
+        if (!frame_torn_ && frame_bytes_ == frame_size_) {
+            result.frame_end = FrameEnd::Complete;
+            stats_.frames++;
+        } else {
+            result.frame_end = FrameEnd::Torn;
+            stats_.torn_frames++;
+        }
+        // Once EOF is seen the next payload starts a new frame whatever its
+        // FID; otherwise wait for the toggle.
+        if (header.end_of_frame) {
+            have_fid_ = false;
+        }
+    }
+    return result;
+}
+
+void UvcPayloadParser::reset() {
+    in_frame_ = false;
+    frame_torn_ = false;
+    have_fid_ = false;
+    frame_bytes_ = 0;
+}
+
+size_t UvcPayloadParser::frame_size() const {
+    return frame_size_;
+}
+
+const UvcPayloadParser::Stats& UvcPayloadParser::stats() const {
+    return stats_;
+}
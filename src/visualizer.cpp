@@ -1,8 +1,35 @@
 #define GL_SILENCE_DEPRECATION
 #define GLFW_INCLUDE_GLCOREARB
 #include <GLFW/glfw3.h>
-#include <iostream>
+#include <algorithm>
+#include <cstring>
 #include "visualizer.hpp"
+#include "logger.hpp"
+
+#ifdef HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#define LOG_COMPONENT "render"
+
+// Not in every platform header (macOS stops at 4.1)
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_CLIENT_STORAGE_BIT
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+
+namespace {
+
+// Past this many rectangles one covering them all is cheaper to upload
+constexpr size_t MAX_UPLOAD_REGIONS = 64;
+
+}  // namespace
 
 const char* Visualizer::vertex_shader_source = R"(
     #version 330 core
@@ -15,34 +42,183 @@ const char* Visualizer::vertex_shader_source = R"(
     }
 )";
 
+// Colormaps match Colorizer::sample() so GPU and CPU output agree
 const char* Visualizer::fragment_shader_source = R"(
     #version 330 core
     in vec2 TexCoord;
     out vec4 FragColor;
     uniform sampler2D depthTexture;
+    uniform int colormap;       // 0 grayscale, 1 jet, 2 turbo
+    uniform vec2 depthRange;    // near, far as normalized 16-bit depth
+
+    vec3 jet(float t) {
+        return clamp(vec3(1.5) - abs(4.0 * vec3(t) - vec3(3.0, 2.0, 1.0)), 0.0, 1.0);
+    }
+
+    vec3 turbo(float t) {
+        const vec4 r4 = vec4(0.13572138, 4.61539260, -42.66032258, 132.13108234);
+        const vec4 g4 = vec4(0.09140261, 2.19418839, 4.84296658, -14.18503333);
+        const vec4 b4 = vec4(0.10667330, 12.64194608, -60.58204836, 110.36276771);
+        const vec2 r2 = vec2(-152.94239396, 59.28637943);
+        const vec2 g2 = vec2(4.27729857, 2.82956604);
+        const vec2 b2 = vec2(-89.90310912, 27.34824973);
+        vec4 v4 = vec4(1.0, t, t * t, t * t * t);
+        vec2 v2 = v4.zw * v4.z;
+        return clamp(vec3(dot(v4, r4) + dot(v2, r2), dot(v4, g4) + dot(v2, g2), dot(v4, b4) + dot(v2, b2)), 0.0, 1.0);
+    }
+
     void main() {
         float depth = texture(depthTexture, TexCoord).r;
-        // Apply a color mapping to make the depth visualization more clear
-        vec3 color = vec3(1.0 - depth);  // Invert depth for better visualization
+        // Zero is "no data"
+        if (depth == 0.0) {
+            FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+            return;
+        }
+        float t = clamp((depth - depthRange.x) / (depthRange.y - depthRange.x), 0.0, 1.0);
+        vec3 color;
+        if (colormap == 1) {
+            color = jet(t);
+        } else if (colormap == 2) {
+            color = turbo(t);
+        } else {
+            color = vec3(1.0 - 0.875 * t);
+        }
         FragColor = vec4(color, 1.0);
     }
 )";
 
 Visualizer::Visualizer(int width, int height)
-    : window_(nullptr), width_(width), height_(height), texture_id_(0), shader_program_(0) {}
+    : window_(nullptr), glfw_initialized_(false), headless_(false), readback_enabled_(false),
+      egl_display_(nullptr), egl_context_(nullptr), egl_surface_(nullptr),
+      framebuffer_(0), color_texture_(0),
+      width_(width), height_(height),
+      frame_bytes_(static_cast<size_t>(width) * height * sizeof(uint16_t)),
+      texture_id_(0), shader_program_(0), colormap_location_(-1), depth_range_location_(-1),
+      colormap_(Colorizer::Colormap::Turbo), near_depth_(300), far_depth_(4000),
+      upload_mode_(UploadMode::PboPersistent), tex_storage_2d_(nullptr), buffer_storage_(nullptr),
+      pbos_(), pbo_ptrs_(), pbo_fences_(), pbo_index_(0),
+      arena_buffer_(0), arena_ptr_(nullptr), arena_size_(0), arena_fences_(), arena_index_(0),
+      readback_pbos_(), readback_fences_(), readback_count_(0),
+      upload_latency_(Metrics::instance().histogram("texture_upload", "Depth texture upload")),
+      present_latency_(Metrics::instance().histogram("present", "Buffer swap, or flush when headless")),
+      glass_to_glass_latency_(Metrics::instance().histogram(
+          "glass_to_glass", "From a frame's data landing on the host to the frame being presented")),
+      dirty_tiles_(true), uploaded_frames_(0), uploaded_tiles_(0), dirty_tiles_uploaded_(0), uploaded_regions_(0),
+      uploaded_bytes_(0), skipped_bytes_(0) {
+    tile_diff_.configure(width, height);
+
+    Metrics& metrics = Metrics::instance();
+    auto counter = [&](const char* name, const char* help, const std::atomic<uint64_t>& value) {
+        metrics.add(this, name, help, Metrics::Kind::Counter,
+                    [&value] { return static_cast<double>(value.load(std::memory_order_relaxed)); });
+    };
+    counter("texture_tiles_total", "Depth texture tiles checked for changes", uploaded_tiles_);
+    counter("texture_tiles_dirty_total", "Depth texture tiles that changed and were uploaded", dirty_tiles_uploaded_);
+    counter("texture_upload_regions_total", "Sub-image uploads to the depth texture", uploaded_regions_);
+    counter("texture_upload_bytes_total", "Bytes uploaded to the depth texture", uploaded_bytes_);
+    counter("texture_upload_skipped_bytes_total", "Bytes of unchanged tiles left out of depth texture uploads",
+            skipped_bytes_);
+}
 
 Visualizer::~Visualizer() {
-    if (window_) {
-        glfwDestroyWindow(window_);
+    Metrics::instance().remove(this);
+    if (window_ || egl_context_) {
+        for (int i = 0; i < PBO_RING_SIZE; i++) {
+            wait_for_fence(arena_fences_[i]);
+            arena_frames_[i].reset();
+            wait_for_fence(pbo_fences_[i]);
+            wait_for_fence(readback_fences_[i]);
+        }
+        if (arena_buffer_) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, arena_buffer_);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glDeleteBuffers(1, &arena_buffer_);
+        }
+        glDeleteBuffers(PBO_RING_SIZE, pbos_);
+        glDeleteBuffers(PBO_RING_SIZE, readback_pbos_);
+        if (framebuffer_) {
+            glDeleteFramebuffers(1, &framebuffer_);
+            glDeleteTextures(1, &color_texture_);
+        }
     }
-    glfwTerminate();
+    destroy_context();
+}
+
+void Visualizer::set_upload_mode(UploadMode mode) {
+    upload_mode_ = mode;
+}
+
+Visualizer::UploadMode Visualizer::upload_mode() const {
+    return upload_mode_;
+}
+
+void Visualizer::set_colormap(Colorizer::Colormap colormap) {
+    colormap_ = colormap;
+}
+
+void Visualizer::set_depth_range(uint16_t near_depth, uint16_t far_depth) {
+    near_depth_ = near_depth;
+    far_depth_ = far_depth > near_depth ? far_depth : near_depth + 1;
+}
+
+void Visualizer::set_dirty_tiles(bool enabled, uint16_t threshold) {
+    dirty_tiles_ = enabled;
+    tile_diff_.set_threshold(threshold);
+    tile_diff_.invalidate();
+}
+
+void Visualizer::set_headless(bool headless) {
+    headless_ = headless;
+}
+
+bool Visualizer::is_headless() const {
+    return headless_;
+}
+
+void Visualizer::set_readback(bool enabled) {
+    readback_enabled_ = enabled;
 }
 
 bool Visualizer::initialize() {
+    if (headless_ ? !create_headless_context() : !create_window()) {
+        return false;
+    }
+
+    if (!setup_gl()) {
+        return false;
+    }
+
+    if (!compile_shaders()) {
+        return false;
+    }
+
+    if (!setup_upload_path()) {
+        return false;
+    }
+
+    if (headless_ && !setup_offscreen_target()) {
+        return false;
+    }
+
+    if (readback_enabled_) {
+        glGenBuffers(PBO_RING_SIZE, readback_pbos_);
+        for (int i = 0; i < PBO_RING_SIZE; i++) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readback_pbos_[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<size_t>(width_) * height_ * 4, nullptr, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    return true;
+}
+
+bool Visualizer::create_window() {
     if (!glfwInit()) {
-        std::cerr << "Failed to initialize GLFW" << std::endl;
+        LOG_ERROR("Failed to initialize GLFW");
         return false;
     }
+    glfw_initialized_ = true;
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -51,21 +227,139 @@ bool Visualizer::initialize() {
 
     window_ = glfwCreateWindow(width_, height_, "RealSense Depth Viewer", nullptr, nullptr);
     if (!window_) {
-        std::cerr << "Failed to create GLFW window" << std::endl;
+        LOG_ERROR("Failed to create GLFW window");
         glfwTerminate();
         return false;
     }
 
     glfwMakeContextCurrent(window_);
+    glfwSwapInterval(headless_ ? 0 : 1);
 
-    if (!setup_gl()) {
-        return false;
+    return true;
+}
+
+bool Visualizer::create_headless_context() {
+#ifdef HAVE_EGL
+    // Prefer Mesa's surfaceless platform: no display server, no window system
+    EGLDisplay display = EGL_NO_DISPLAY;
+    auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+        eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (get_platform_display) {
+        display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
     }
 
-    if (!compile_shaders()) {
-        return false;
+    EGLint major = 0;
+    EGLint minor = 0;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        LOG_WARN("Failed to initialize EGL, falling back to a hidden window");
+    } else if (!eglBindAPI(EGL_OPENGL_API)) {
+        LOG_WARN("EGL has no desktop OpenGL, falling back to a hidden window");
+        eglTerminate(display);
+    } else {
+        const EGLint config_attribs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_NONE
+        };
+        EGLConfig config = nullptr;
+        EGLint config_count = 0;
+        eglChooseConfig(display, config_attribs, &config, 1, &config_count);
+
+        const EGLint context_attribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        EGLContext context = eglCreateContext(display, config_count ? config : nullptr, EGL_NO_CONTEXT, context_attribs);
+
+        // Surfaceless if the driver allows it, otherwise a 1x1 pbuffer; all
+        // rendering goes to our own framebuffer object either way.
+        EGLSurface surface = EGL_NO_SURFACE;
+        bool current = context != EGL_NO_CONTEXT &&
+                       eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+        if (context != EGL_NO_CONTEXT && !current && config_count) {
+            const EGLint pbuffer_attribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+            surface = eglCreatePbufferSurface(display, config, pbuffer_attribs);
+            current = surface != EGL_NO_SURFACE && eglMakeCurrent(display, surface, surface, context);
+        }
+
+        if (current) {
+            egl_display_ = display;
+            egl_context_ = context;
+            egl_surface_ = surface;
+            LOG_INFO("Headless EGL %d.%d context: %s", major, minor,
+                     reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+            return true;
+        }
+
+        LOG_WARN("Failed to create EGL context, falling back to a hidden window");
+        if (surface != EGL_NO_SURFACE) {
+            eglDestroySurface(display, surface);
+        }
+        if (context != EGL_NO_CONTEXT) {
+            eglDestroyContext(display, context);
+        }
+        eglTerminate(display);
     }
+#endif
+
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    return create_window();
+}
 
+void Visualizer::destroy_context() {
+#ifdef HAVE_EGL
+    if (egl_display_) {
+        EGLDisplay display = static_cast<EGLDisplay>(egl_display_);
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (egl_surface_) {
+            eglDestroySurface(display, static_cast<EGLSurface>(egl_surface_));
+        }
+        eglDestroyContext(display, static_cast<EGLContext>(egl_context_));
+        eglTerminate(display);
+        egl_display_ = nullptr;
+        egl_context_ = nullptr;
+        egl_surface_ = nullptr;
+    }
+#endif
+    if (window_) {
+        glfwDestroyWindow(window_);
+        window_ = nullptr;
+    }
+    if (glfw_initialized_) {
+        glfwTerminate();
+        glfw_initialized_ = false;
+    }
+}
+
+void* Visualizer::get_proc_address(const char* name) {
+#ifdef HAVE_EGL
+    if (egl_context_) {
+        return reinterpret_cast<void*>(eglGetProcAddress(name));
+    }
+#endif
+    return reinterpret_cast<void*>(glfwGetProcAddress(name));
+}
+
+bool Visualizer::setup_offscreen_target() {
+    glGenTextures(1, &color_texture_);
+    glBindTexture(GL_TEXTURE_2D, color_texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width_, height_, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenFramebuffers(1, &framebuffer_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color_texture_, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        LOG_ERROR("Offscreen framebuffer is incomplete");
+        return false;
+    }
+    glViewport(0, 0, width_, height_);
     return true;
 }
 
@@ -93,12 +387,108 @@ bool Visualizer::setup_gl() {
 
     glGenTextures(1, &texture_id_);
     glBindTexture(GL_TEXTURE_2D, texture_id_);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // Nearest, so holes are never blended into their neighbours' depth
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    // Dirty regions are cut out of whole frames
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width_);
+
+    return true;
+}
+
+bool Visualizer::has_gl_support(int major, int minor, const char* extension) {
+    GLint context_major = 0;
+    GLint context_minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &context_major);
+    glGetIntegerv(GL_MINOR_VERSION, &context_minor);
+    if (context_major > major || (context_major == major && context_minor >= minor)) {
+        return true;
+    }
+
+    GLint extension_count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+    for (GLint i = 0; i < extension_count; i++) {
+        const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (name && strcmp(name, extension) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Visualizer::setup_upload_path() {
+    if (has_gl_support(4, 2, "GL_ARB_texture_storage")) {
+        tex_storage_2d_ = reinterpret_cast<TexStorage2DFn>(get_proc_address("glTexStorage2D"));
+    }
+    if (has_gl_support(4, 4, "GL_ARB_buffer_storage")) {
+        buffer_storage_ = reinterpret_cast<BufferStorageFn>(get_proc_address("glBufferStorage"));
+    }
+
+    if (upload_mode_ == UploadMode::PboPersistent && !buffer_storage_) {
+        LOG_INFO("Persistent buffer mapping unavailable, using orphaned PBOs");
+        upload_mode_ = UploadMode::PboOrphan;
+    }
+    if (upload_mode_ == UploadMode::TexImage) {
+        return true;
+    }
+
+    // Allocate the texture once; every frame after this is a sub-image update
+    glBindTexture(GL_TEXTURE_2D, texture_id_);
+    if (tex_storage_2d_) {
+        tex_storage_2d_(GL_TEXTURE_2D, 1, GL_R16, width_, height_);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, width_, height_, 0, GL_RED, GL_UNSIGNED_SHORT, nullptr);
+    }
+
+    glGenBuffers(PBO_RING_SIZE, pbos_);
+    for (int i = 0; i < PBO_RING_SIZE; i++) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos_[i]);
+        if (upload_mode_ == UploadMode::PboPersistent) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            buffer_storage_(GL_PIXEL_UNPACK_BUFFER, frame_bytes_, nullptr, flags);
+            pbo_ptrs_[i] = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, frame_bytes_, flags));
+            if (!pbo_ptrs_[i]) {
+                LOG_ERROR("Failed to map pixel buffer %d", i);
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                return false;
+            }
+        } else {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, frame_bytes_, nullptr, GL_STREAM_DRAW);
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 
     return true;
 }
 
+uint8_t* Visualizer::map_frame_arena(size_t size) {
+    if (arena_ptr_) {
+        return size <= arena_size_ ? arena_ptr_ : nullptr;
+    }
+    if (!buffer_storage_ || upload_mode_ != UploadMode::PboPersistent) {
+        return nullptr;
+    }
+
+    // The capture side reads UVC headers back out of this memory, so ask for
+    // a readable, client-side allocation rather than write-combined VRAM.
+    GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &arena_buffer_);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, arena_buffer_);
+    buffer_storage_(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags | GL_CLIENT_STORAGE_BIT);
+    arena_ptr_ = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (!arena_ptr_) {
+        LOG_ERROR("Failed to map frame arena");
+        glDeleteBuffers(1, &arena_buffer_);
+        arena_buffer_ = 0;
+        return nullptr;
+    }
+    arena_size_ = size;
+    return arena_ptr_;
+}
+
 bool Visualizer::compile_shaders() {
     GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vertex_shader, 1, &vertex_shader_source, NULL);
@@ -109,7 +499,7 @@ bool Visualizer::compile_shaders() {
     if (!success) {
         char info_log[512];
         glGetShaderInfoLog(vertex_shader, 512, NULL, info_log);
-        std::cerr << "Vertex shader compilation failed: " << info_log << std::endl;
+        LOG_ERROR("Vertex shader compilation failed: %s", info_log);
         return false;
     }
 
@@ -121,7 +511,7 @@ bool Visualizer::compile_shaders() {
     if (!success) {
         char info_log[512];
         glGetShaderInfoLog(fragment_shader, 512, NULL, info_log);
-        std::cerr << "Fragment shader compilation failed: " << info_log << std::endl;
+        LOG_ERROR("Fragment shader compilation failed: %s", info_log);
         return false;
     }
 
@@ -134,35 +524,337 @@ bool Visualizer::compile_shaders() {
     if (!success) {
         char info_log[512];
         glGetProgramInfoLog(shader_program_, 512, NULL, info_log);
-        std::cerr << "Shader program linking failed: " << info_log << std::endl;
+        LOG_ERROR("Shader program linking failed: %s", info_log);
         return false;
     }
 
     glDeleteShader(vertex_shader);
     glDeleteShader(fragment_shader);
 
+    colormap_location_ = glGetUniformLocation(shader_program_, "colormap");
+    depth_range_location_ = glGetUniformLocation(shader_program_, "depthRange");
+
     return true;
 }
 
 void Visualizer::render_frame(const uint8_t* depth_data) {
+    Clock::time_point frame_start = Clock::now();
+
+    // No new frame: redraw the last one so presentation keeps display rate
+    if (depth_data) {
+        update_texture(depth_data);
+        record(timings_.upload, upload_latency_, frame_start, Clock::now());
+    }
+
+    draw_and_present(frame_start);
+}
+
+void Visualizer::render_frame(const Frame& frame) {
+    Clock::time_point frame_start = Clock::now();
+
+    if (!update_texture_from_arena(frame)) {
+        update_texture(frame.data());
+    }
+    record(timings_.upload, upload_latency_, frame_start, Clock::now());
+
+    draw_and_present(frame_start);
+    glass_to_glass_latency_.record_since(frame.metadata().timestamp_ns);
+}
+
+void Visualizer::draw_and_present(Clock::time_point frame_start) {
+    Clock::time_point draw_start = Clock::now();
+    if (framebuffer_) {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    }
     glClear(GL_COLOR_BUFFER_BIT);
     glUseProgram(shader_program_);
+    glUniform1i(colormap_location_, static_cast<int>(colormap_));
+    glUniform2f(depth_range_location_, near_depth_ / 65535.0f, far_depth_ / 65535.0f);
+    glBindTexture(GL_TEXTURE_2D, texture_id_);
+    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+    Clock::time_point readback_start = Clock::now();
+    record(timings_.draw, draw_start, readback_start);
 
-    update_texture(depth_data);
+    if (readback_pbos_[0]) {
+        queue_readback();
+        record(timings_.readback, readback_start, Clock::now());
+    }
 
-    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
-    glfwSwapBuffers(window_);
+    Clock::time_point present_start = Clock::now();
+    if (headless_) {
+        glFlush();
+    } else {
+        glfwSwapBuffers(window_);
+    }
+    Clock::time_point end = Clock::now();
+    record(timings_.present, present_latency_, present_start, end);
+    record(timings_.frame, frame_start, end);
+}
+
+void Visualizer::queue_readback() {
+    // glReadPixels into a pack buffer returns immediately; the copy happens
+    // on the GPU timeline and is collected later by read_snapshot().
+    int slot = static_cast<int>(readback_count_ % PBO_RING_SIZE);
+    wait_for_fence(readback_fences_[slot]);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback_pbos_[slot]);
+    glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback_fences_[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback_count_++;
+}
+
+bool Visualizer::read_snapshot(uint8_t* rgba, size_t size) {
+    size_t frame_size = static_cast<size_t>(width_) * height_ * 4;
+    if (!readback_pbos_[0] || readback_count_ == 0 || size < frame_size) {
+        return false;
+    }
+
+    // Newest readback whose fence has already signalled
+    for (uint64_t age = 0; age < PBO_RING_SIZE && age < readback_count_; age++) {
+        int slot = static_cast<int>((readback_count_ - 1 - age) % PBO_RING_SIZE);
+        GLsync fence = readback_fences_[slot];
+        if (fence && glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            continue;
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback_pbos_[slot]);
+        const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frame_size, GL_MAP_READ_BIT);
+        bool ok = pixels != nullptr;
+        if (ok) {
+            memcpy(rgba, pixels, frame_size);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return ok;
+    }
+    return false;
 }
 
 void Visualizer::update_texture(const uint8_t* depth_data) {
+    if (!find_dirty_regions(depth_data)) {
+        return;
+    }
+    glBindTexture(GL_TEXTURE_2D, texture_id_);
+
+    switch (upload_mode_) {
+    case UploadMode::TexImage:
+        // The first frame is always whole, so the texture exists before any
+        // partial upload
+        if (regions_.size() == 1 && regions_[0].width == width_ && regions_[0].height == height_) {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, width_, height_, 0, GL_RED, GL_UNSIGNED_SHORT, depth_data);
+        } else {
+            upload_regions(depth_data);
+        }
+        return;
+
+    case UploadMode::PboOrphan: {
+        // Re-specifying the store lets the driver hand us fresh memory while
+        // the previous upload is still in flight. Only the dirty regions are
+        // copied in, as only they are read out.
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos_[pbo_index_]);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, frame_bytes_, nullptr, GL_STREAM_DRAW);
+        void* ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, frame_bytes_,
+                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (ptr) {
+            copy_regions(depth_data, static_cast<uint8_t*>(ptr));
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            upload_regions(nullptr);
+        } else {
+            // The texture missed this frame, so it has to have all of the next
+            tile_diff_.invalidate();
+        }
+        break;
+    }
+
+    case UploadMode::PboPersistent:
+        wait_for_fence(pbo_fences_[pbo_index_]);
+        copy_regions(depth_data, pbo_ptrs_[pbo_index_]);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos_[pbo_index_]);
+        upload_regions(nullptr);
+        pbo_fences_[pbo_index_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        break;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    pbo_index_ = (pbo_index_ + 1) % PBO_RING_SIZE;
+}
+
+bool Visualizer::update_texture_from_arena(const Frame& frame) {
+    if (!arena_ptr_ || !frame || frame.size() < frame_bytes_) {
+        return false;
+    }
+    const uint8_t* data = frame.data();
+    if (data < arena_ptr_ || data + frame_bytes_ > arena_ptr_ + arena_size_) {
+        return false;
+    }
+    size_t offset = data - arena_ptr_;
+    if (offset % sizeof(uint16_t) != 0) {
+        return false;
+    }
+    if (!find_dirty_regions(data)) {
+        return true;
+    }
+
+    // Keep the frame (and so its pool buffer) alive until the GPU has
+    // finished sourcing from it
+    wait_for_fence(arena_fences_[arena_index_]);
+    arena_frames_[arena_index_] = frame;
+
     glBindTexture(GL_TEXTURE_2D, texture_id_);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, width_, height_, 0, GL_RED, GL_UNSIGNED_SHORT, depth_data);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, arena_buffer_);
+    upload_regions(reinterpret_cast<const uint8_t*>(offset));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    arena_fences_[arena_index_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    arena_index_ = (arena_index_ + 1) % PBO_RING_SIZE;
+    return true;
+}
+
+bool Visualizer::find_dirty_regions(const uint8_t* depth_data) {
+    const int tile = TileDiff::TILE_SIZE;
+    regions_.clear();
+    size_t dirty = tile_diff_.tile_count();
+    if (dirty_tiles_) {
+        dirty = tile_diff_.update(reinterpret_cast<const uint16_t*>(depth_data), tile_mask_);
+    } else {
+        tile_mask_.assign(dirty, 1);
+    }
+
+    // Runs of dirty tiles along each row of tiles, each run extending the
+    // rectangle right above it when that spans the same columns
+    int tiles_x = tile_diff_.tiles_x();
+    int tiles_y = tile_diff_.tiles_y();
+    int first_row = tiles_y;
+    int last_row = -1;
+    int first_column = tiles_x;
+    int last_column = -1;
+    for (int ty = 0; ty < tiles_y; ty++) {
+        const uint8_t* row = tile_mask_.data() + static_cast<size_t>(ty) * tiles_x;
+        for (int tx = 0; tx < tiles_x;) {
+            if (!row[tx]) {
+                tx++;
+                continue;
+            }
+            int run_begin = tx;
+            while (tx < tiles_x && row[tx]) {
+                tx++;
+            }
+            first_row = std::min(first_row, ty);
+            last_row = ty;
+            first_column = std::min(first_column, run_begin);
+            last_column = std::max(last_column, tx - 1);
+
+            if (regions_.size() > MAX_UPLOAD_REGIONS) {
+                continue;
+            }
+            Region region{run_begin * tile, ty * tile, std::min(tx * tile, width_) - run_begin * tile,
+                          std::min(tile, height_ - ty * tile)};
+            auto above = std::find_if(regions_.begin(), regions_.end(), [&region](const Region& other) {
+                return other.x == region.x && other.width == region.width && other.y + other.height == region.y;
+            });
+            if (above != regions_.end()) {
+                above->height += region.height;
+            } else {
+                regions_.push_back(region);
+            }
+        }
+    }
+    if (regions_.size() > MAX_UPLOAD_REGIONS) {
+        int x = first_column * tile;
+        int y = first_row * tile;
+        regions_.assign(1, Region{x, y, std::min((last_column + 1) * tile, width_) - x,
+                                  std::min((last_row + 1) * tile, height_) - y});
+    }
+
+    size_t bytes = 0;
+    for (const Region& region : regions_) {
+        bytes += static_cast<size_t>(region.width) * region.height * sizeof(uint16_t);
+    }
+    uploaded_frames_.fetch_add(1, std::memory_order_relaxed);
+    uploaded_tiles_.fetch_add(tile_diff_.tile_count(), std::memory_order_relaxed);
+    dirty_tiles_uploaded_.fetch_add(dirty, std::memory_order_relaxed);
+    uploaded_regions_.fetch_add(regions_.size(), std::memory_order_relaxed);
+    uploaded_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    skipped_bytes_.fetch_add(frame_bytes_ - bytes, std::memory_order_relaxed);
+    return !regions_.empty();
+}
+
+void Visualizer::copy_regions(const uint8_t* src, uint8_t* dst) const {
+    size_t stride = static_cast<size_t>(width_) * sizeof(uint16_t);
+    for (const Region& region : regions_) {
+        size_t offset = region.y * stride + region.x * sizeof(uint16_t);
+        if (region.width == width_) {
+            memcpy(dst + offset, src + offset, region.height * stride);
+            continue;
+        }
+        size_t bytes = region.width * sizeof(uint16_t);
+        for (int y = 0; y < region.height; y++, offset += stride) {
+            memcpy(dst + offset, src + offset, bytes);
+        }
+    }
+}
+
+void Visualizer::upload_regions(const uint8_t* source) {
+    uintptr_t base = reinterpret_cast<uintptr_t>(source);
+    for (const Region& region : regions_) {
+        size_t offset = (static_cast<size_t>(region.y) * width_ + region.x) * sizeof(uint16_t);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, region.x, region.y, region.width, region.height, GL_RED,
+                        GL_UNSIGNED_SHORT, reinterpret_cast<const void*>(base + offset));
+    }
+}
+
+void Visualizer::wait_for_fence(GLsync& fence) {
+    if (!fence) {
+        return;
+    }
+    glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void Visualizer::record(StageTiming& timing, Clock::time_point start, Clock::time_point end) {
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    timing.count++;
+    timing.total_ms += ms;
+    if (ms > timing.max_ms) {
+        timing.max_ms = ms;
+    }
+}
+
+void Visualizer::record(StageTiming& timing, LatencyHistogram& histogram, Clock::time_point start,
+                        Clock::time_point end) {
+    record(timing, start, end);
+    histogram.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+Visualizer::FrameTimings Visualizer::timings() const {
+    return timings_;
+}
+
+void Visualizer::reset_timings() {
+    timings_ = FrameTimings();
+}
+
+Visualizer::UploadStats Visualizer::upload_stats() const {
+    UploadStats stats;
+    stats.frames = uploaded_frames_.load(std::memory_order_relaxed);
+    stats.tiles = uploaded_tiles_.load(std::memory_order_relaxed);
+    stats.dirty_tiles = dirty_tiles_uploaded_.load(std::memory_order_relaxed);
+    stats.regions = uploaded_regions_.load(std::memory_order_relaxed);
+    stats.bytes = uploaded_bytes_.load(std::memory_order_relaxed);
+    stats.skipped_bytes = skipped_bytes_.load(std::memory_order_relaxed);
+    return stats;
 }
 
 bool Visualizer::should_close() {
+    if (headless_ || !window_) {
+        return false;
+    }
     return glfwWindowShouldClose(window_);
 }
 
 void Visualizer::process_events() {
-    glfwPollEvents();
+    if (window_) {
+        glfwPollEvents();
+    }
 }